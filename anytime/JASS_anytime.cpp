@@ -10,28 +10,51 @@
 #include <limits>
 #include <memory>
 #include <fstream>
+#include <sstream>
 #include <algorithm>
 
 #include "file.h"
 #include "timer.h"
 #include "query.h"
+#include "prefetch.h"
 #include "threads.h"
 #include "decode_d0.h"
 #include "run_export.h"
 #include "commandline.h"
 #include "channel_file.h"
+#include "numa_topology.h"
 #include "compress_integer.h"
 #include "JASS_anytime_stats.h"
+#include "JASS_anytime_batch.h"
 #include "JASS_anytime_query.h"
+#include "JASS_anytime_server.h"
+#include "JASS_anytime_deadline.h"
+#include "JASS_anytime_decode_ahead.h"
+#include "JASS_anytime_intra_query.h"
+#include "JASS_anytime_result_cache.h"
+#include "JASS_anytime_segment_cache.h"
 #include "deserialised_jass_v1.h"
 #include "JASS_anytime_thread_result.h"
 
+/*
+	If ENSURE_NO_ALLOCATIONS is defined (uncomment the line below or add -DENSURE_NO_ALLOCATIONS to the compiler flags) then the global
+	operator new and operator delete are overridden to abort() if a search thread allocates memory between parsing a query and finding
+	its top-k.  The results cache and the decoded segment cache allocate as they fill, so they are not checked.
+*/
+//#define ENSURE_NO_ALLOCATIONS
+
+#ifdef ENSURE_NO_ALLOCATIONS
+	#include "global_new_delete.h"
+#endif
+
 constexpr size_t MAX_QUANTUM = 0x0FFF;
 constexpr size_t MAX_TERMS_PER_QUERY = 1024;
 
-constexpr size_t MAX_DOCUMENTS = 50'000'000;
+constexpr size_t MAX_DOCUMENTS = 0;				///< The accumulators are sized (and allocated) at run time from the number of documents in the index
 constexpr size_t MAX_TOP_K = 1'000;
 
+constexpr size_t CALIBRATION_TERMS = 1'000;		///< The number of terms whose segments are timed to calibrate the deadline cost model
+
 /*
 	PARAMETERS
 	----------
@@ -40,7 +63,22 @@ double rho = 100.0;												///< In the anytime paper rho is the prcentage of
 size_t maximum_number_of_postings_to_process = 0;	///< Computed from
 std::string parameter_queryfilename;					///< Name of file containing the queries
 size_t parameter_threads = 1;								///< Number of concurrent queries
+size_t parameter_intra_query_threads = 1;				///< Number of threads co-operating on each query
+size_t parameter_batch_size = 1;							///< Number of queries each thread searches together (sharing segment decodes)
 size_t parameter_top_k = 10;								///< Number of results to return
+std::string parameter_server;								///< Address to listen on when running as a server
+bool parameter_memory_map = false;						///< Memory map the index rather than reading it into memory
+bool parameter_populate = false;							///< Pre-fault the memory mapped index into memory at startup
+bool parameter_heapless = false;							///< Find the top-k by scanning the accumulators after search rather than maintaining a heap
+bool parameter_huge_pages = false;						///< Ask for the accumulators to be in huge pages
+size_t parameter_pipeline = 0;							///< How the segment loop overlaps the segments (0 = not at all, 1 = prefetch, 2 = prefetch and decode on a helper thread)
+bool parameter_segment_timing = false;					///< Time the decode and the process of each segment
+bool parameter_early_termination = false;				///< Stop each query once no remaining segment can change its top-k
+std::string parameter_numa;								///< How to place the index and the search threads on the NUMA nodes ("pin", "interleave", or "replicate")
+size_t parameter_cache_mb = 0;							///< The size of the results cache in megabytes (0 means no cache)
+size_t parameter_segment_cache_mb = 0;					///< The size of the decoded segment cache in megabytes (0 means no cache)
+std::string parameter_csv_filename;						///< Name of the file to write the per-query statistics to
+size_t parameter_deadline_us = 0;						///< The per-query time budget in microseconds (0 means no deadline)
 bool parameter_help = false;
 
 std::string parameters_errors;							///< Any errors as a result of command line parsing
@@ -49,190 +87,1206 @@ auto parameters = std::make_tuple						///< The  command line parameter block
 	JASS::commandline::parameter("-?", "--help",      "Print this help.", parameter_help),
 	JASS::commandline::parameter("-q", "--queryfile", "<filename>        Name of file containing a list of queries (1 per line, each line prefixed with query-id)", parameter_queryfilename),
 	JASS::commandline::parameter("-t", "--threads",   "<threadcount>     Number of threads to use (one query per thread) [default = -t1]", parameter_threads),
+	JASS::commandline::parameter("-T", "--intra-query-threads", "<threadcount> Number of threads to use within each query (the document ids are partitioned between them) [default = -T1] (overrides -t)", parameter_intra_query_threads),
+	JASS::commandline::parameter("-b", "--batch",     "<queries>         Search <queries> queries at a time in each thread, decoding each impact segment once per batch [default = -b1] (ignored with -T, -C, -S, -D)", parameter_batch_size),
 	JASS::commandline::parameter("-k", "--top-k",     "<top-k>           Number of results to return to the user (top-k value) [default = -k10]", parameter_top_k),
 	JASS::commandline::parameter("-r", "--rho",       "<integer_percent> Percent of the collection size to use as max number of postings to process [default = -r100] (overrides -RHO)", rho),
-	JASS::commandline::parameter("-R", "--RHO",       "<integer_max>     Max number of postings to process [default is all] (overridden by -rho)", maximum_number_of_postings_to_process)
+	JASS::commandline::parameter("-R", "--RHO",       "<integer_max>     Max number of postings to process [default is all] (overridden by -rho)", maximum_number_of_postings_to_process),
+	JASS::commandline::parameter("-s", "--server",    "<address>         Run as a server listening on <address> ([host:]port or unix:path) using -t worker threads, rather than reading a query file", parameter_server),
+	JASS::commandline::parameter("-m", "--memory-map",  "Memory map the index rather than reading it into memory (fast start, shared between processes)", parameter_memory_map),
+	JASS::commandline::parameter("-P", "--populate",    "Pre-fault the memory mapped index into memory at startup (implies -m)", parameter_populate),
+	JASS::commandline::parameter("-H", "--heapless",    "Don't maintain a top-k heap, find the top-k by scanning the used accumulators after search (faster for large rho)", parameter_heapless),
+	JASS::commandline::parameter("-L", "--huge-pages",  "Ask the operating system to put the accumulators in huge (large) pages to reduce TLB misses", parameter_huge_pages),
+	JASS::commandline::parameter("-p", "--pipeline",  "<mode>            Overlap the segments: 0 = decode then process each in turn, 1 = prefetch the next segment while processing this one, 2 = as 1 and decode the next segment on a helper thread (needs a spare core per thread) [default = -p0] (ignored with -T, -b, -S)", parameter_pipeline),
+	JASS::commandline::parameter("-i", "--segment-timing", "Time the decode (or the wait for the helper to decode) and the process of each segment and report the mean per posting, to measure the stalls the pipeline hides (ignored with -T, -b, -S)", parameter_segment_timing),
+	JASS::commandline::parameter("-e", "--early-termination", "Stop each query once no remaining segment can change which documents are in the top-k (exact top-k membership, but rsvs may be lower than exhaustive) and report the postings saved (ignored with -H, -T, -b)", parameter_early_termination),
+	JASS::commandline::parameter("-n", "--numa",      "<policy>          Place the search threads round-robin on the NUMA nodes, pinned so their accumulators are node-local, and: pin = leave the index where it is loaded, interleave = spread the index over the nodes, replicate = load a copy of the index on each node (not with -m) [default is no placement] (ignored with -s, -T)", parameter_numa),
+	JASS::commandline::parameter("-C", "--cache-mb",  "<megabytes>       Cache up to <megabytes> of results lists so repeated queries are not searched again [default is no cache] (ignored with -T)", parameter_cache_mb),
+	JASS::commandline::parameter("-S", "--segment-cache-mb", "<megabytes> Cache up to <megabytes> of decoded hot impact segments so they are not decompressed for each query [default is no cache] (ignored with -T)", parameter_segment_cache_mb),
+	JASS::commandline::parameter("-D", "--deadline-us", "<microseconds>    Per-query time budget, stop before the segment predicted to take the query past it [default is none] (ignored with -T)", parameter_deadline_us),
+	JASS::commandline::parameter("-c", "--csv",       "<filename>        Write per-query statistics (query-id, terms found, segments, postings, postings saved, search time) to <filename> as CSV", parameter_csv_filename)
 	);
 
 /*
-	ANYTIME()
-	---------
+	FORBID_ALLOCATIONS()
+	--------------------
 */
-template <typename DECODER>
-void anytime(JASS_anytime_thread_result &output, const JASS::deserialised_jass_v1 &index, std::vector<JASS_anytime_query> &query_list, size_t postings_to_process, size_t top_k)
+/*!
+	@brief When compiled with ENSURE_NO_ALLOCATIONS, make any use of the global operator new or operator delete by this thread abort() (or allow it again).
+	@param forbidden [in] true to abort() on allocation, false to allow allocation.
+*/
+inline void forbid_allocations(bool forbidden)
 	{
-	/*
-		Extract the compression scheme from the index
-	*/
-	std::string codex_name;
-	JASS::compress_integer &decompressor = index.codex(codex_name);
-	auto decoder = new DECODER(index.document_count() + 4096);				// Some decoders write past the end of the output buffer (e.g. GroupVarInt) so we allocate enough space for the overflow
+#ifdef ENSURE_NO_ALLOCATIONS
+	if (forbidden)
+		global_new_delete_replace();
+	else
+		global_new_delete_return();
+#endif
+	}
 
-	/*
-		Allocate the Score-at-a-Time table
-	*/
-	uint64_t *segment_order = new uint64_t [MAX_TERMS_PER_QUERY * MAX_QUANTUM];
+/*
+	CLASS SEGMENT_CURSOR
+	--------------------
+*/
+/*!
+	@brief The next impact segment of one query term, used while merging the segment lists of the terms.
+*/
+class segment_cursor
+	{
+	public:
+		const uint64_t *current;					///< The offset of the next segment of this term
+		const uint64_t *end;							///< The end of the list of segments of this term
+		uint16_t impact;								///< The impact score of the segment at current
+		uint32_t segment_frequency;				///< The number of postings in the segment at current
+		size_t term;									///< The position of the term in the query (ties are broken on this so the order is deterministic)
+
+	public:
+		/*
+			SEGMENT_CURSOR::LOAD()
+			----------------------
+		*/
+		/*!
+			@brief Copy the sort key of the segment at current out of the postings.
+			@param postings [in] The postings.
+		*/
+		void load(const uint8_t *postings)
+			{
+			const JASS::deserialised_jass_v1::segment_header &header = *reinterpret_cast<const JASS::deserialised_jass_v1::segment_header *>(postings + *current);
+			impact = header.impact;
+			segment_frequency = header.segment_frequency;
+			}
+
+		/*
+			SEGMENT_CURSOR::OPERATOR<()
+			---------------------------
+		*/
+		/*!
+			@brief Is this cursor lower priority than the other (so std::make_heap() gives a heap with the highest priority at the top)?
+			@details The order is highest impact first, but break ties by placing the lowest quantum-frequency first and the highest quantum-frequency last.
+			@param other [in] The cursor to compare to.
+			@return true if this cursor should be processed after other.
+		*/
+		bool operator<(const segment_cursor &other) const
+			{
+			if (impact != other.impact)
+				return impact < other.impact;
+			else if (segment_frequency != other.segment_frequency)
+				return segment_frequency > other.segment_frequency;
+			else
+				return term > other.term;
+			}
+	};
+
+/*
+	ORDER_SEGMENTS()
+	----------------
+*/
+/*!
+	@brief Gather the impact segments of each query term and merge them into the order they should be processed.
+	@details The segments of each term are stored highest impact first, so rather than sorting all the segments (which
+	dereferences segment headers scattered all over the postings) the per-term lists are merged with a heap over the terms.  This
+	takes O(segments log terms) time and walks the headers of each term (which are contiguous) sequentially.
+	@param index [in] The index.
+	@param terms [in] The parsed query.
+	@param segment_order [out] The segments (as offsets into the postings), highest impact first.
+	@param terms_found [out] The number of query terms that are in the vocabulary.
+	@param highest_possible_score [out] The largest score any document can get (the sum of the highest impact of each term).
+	@param segment_term [out] If not nullptr, the position (among the terms found) of the term each segment belongs to, parallel to segment_order.
+	@return A pointer to the end of the list of segments.
+*/
+uint64_t *order_segments(const JASS::deserialised_jass_v1 &index, JASS::query_term_list &terms, uint64_t *segment_order, size_t &terms_found, size_t &highest_possible_score, uint16_t *segment_term = nullptr)
+	{
+	segment_cursor cursors[MAX_TERMS_PER_QUERY];
+	size_t cursors_used = 0;
+	const uint8_t *postings = index.postings();
+
+	highest_possible_score = 0;
 
 	/*
-		Allocate a JASS query object
+		Find the list of impact segments of each term
 	*/
-	JASS::query<uint16_t, MAX_DOCUMENTS, MAX_TOP_K> *jass_query;
-	try
+	for (const auto &term : terms)
 		{
-		jass_query = new JASS::query<uint16_t, MAX_DOCUMENTS, MAX_TOP_K>(index.primary_keys(), index.document_count(), top_k);
+// std::cout << "TERM:" << term << "\n";
+
+		/*
+			Get the metadata for this term (and if this term isn't in the vocab them move on to the next term)
+		*/
+		JASS::deserialised_jass_v1::metadata metadata;
+		if (!index.postings_details(metadata, term) || metadata.impacts == 0 || cursors_used >= MAX_TERMS_PER_QUERY)
+			continue;
+
+		segment_cursor &cursor = cursors[cursors_used];
+		cursor.current = reinterpret_cast<const uint64_t *>(metadata.offset);
+		cursor.end = cursor.current + metadata.impacts;
+		cursor.term = cursors_used;
+		cursor.load(postings);
+		cursors_used++;
+
+		/*
+			The segments are stored highest impact first, so the first is the most this term can add to a document
+		*/
+		highest_possible_score += cursor.impact;
 		}
-	catch (std::bad_array_new_length &)
+
+	terms_found = cursors_used;
+
+	/*
+		Merge the lists from highest impact to lowest impact
+	*/
+	uint64_t *current_segment = segment_order;
+	std::make_heap(cursors, cursors + cursors_used);
+	while (cursors_used > 1)
 		{
-		exit(printf("Can't load index as the number of documents is too large - change MAX_DOCUMENTS in %s\n", __FILE__));
+		std::pop_heap(cursors, cursors + cursors_used);
+		segment_cursor &next = cursors[cursors_used - 1];
+
+		if (segment_term != nullptr)
+			segment_term[current_segment - segment_order] = static_cast<uint16_t>(next.term);
+		*current_segment++ = *next.current;
+		if (++next.current < next.end)
+			{
+			next.load(postings);
+			std::push_heap(cursors, cursors + cursors_used);
+			}
+		else
+			cursors_used--;
 		}
 
 	/*
-		Start the timer
+		When only one term remains its segments are already in order
 	*/
-	auto total_search_time = JASS::timer::start();
+	if (cursors_used == 1)
+		{
+		if (segment_term != nullptr)
+			std::fill(segment_term + (current_segment - segment_order), segment_term + (current_segment - segment_order) + (cursors[0].end - cursors[0].current), static_cast<uint16_t>(cursors[0].term));
+		current_segment = std::copy(cursors[0].current, cursors[0].end, current_segment);
+		}
 
 	/*
-		Now start searching
+		0 terminate the list of segments
 	*/
-	size_t next_query = 0;
-	std::string query = JASS_anytime_query::get_next_query(query_list, next_query);
-	std::string query_id;
+	*current_segment = 0;
 
-	while (query.size() != 0)
-		{
-		static const std::string seperators_between_id_and_query = " \t:";
-		output.queries_executed++;
+	return current_segment;
+	}
+
+/*
+	CLASS ANYTIME_SEARCHER
+	----------------------
+*/
+/*!
+	@brief Everything a single thread needs to search (the decoder, the Score-at-a-Time table, and the query objects), allocated once and re-used for each query.
+	@details There are two query objects, one with 16-bit accumulators and one with 32-bit accumulators.  The 16-bit accumulators are used
+	unless the sum of the highest impact of each query term could overflow them (as can happen with long queries), in which case
+	the 32-bit accumulators are used.  Both are sized at run time and accumulator pages are only touched when used, so the 32-bit
+	accumulators cost address space but (almost) no memory until a long query arrives.
+	@tparam DECODER The postings list decoder.
+	@tparam TOP_K_STRATEGY How the query object finds the top-k (JASS::query_top_k_heap or JASS::query_top_k_scan).
+*/
+template <typename DECODER, typename TOP_K_STRATEGY = JASS::query_top_k_heap>
+class anytime_searcher
+	{
+	private:
+		const JASS::deserialised_jass_v1 &index;								///< The index being searched
+		JASS::compress_integer *decompressor;									///< The codex used to decompress the postings
+		DECODER *decoder;																///< The decoder
+		uint64_t *segment_order;													///< The Score-at-a-Time table
+		JASS::query<uint16_t, MAX_DOCUMENTS, MAX_TOP_K, TOP_K_STRATEGY> *jass_query;		///< The query object (accumulators, top-k heap, etc.)
+		JASS::query<uint32_t, MAX_DOCUMENTS, MAX_TOP_K, TOP_K_STRATEGY> *wide_query;		///< The query object used when a query could overflow the 16-bit accumulators of jass_query
+		size_t postings_to_process;												///< The maximum number of postings to process for each query
+		const JASS_anytime_deadline &deadline;									///< The time budget for each query
+		size_t top_k;																	///< The number of results to return
+		JASS_anytime_result_cache *cache;										///< The results cache (or nullptr if there isn't one)
+		JASS_anytime_segment_cache *segment_cache;							///< The decoded segment cache (or nullptr if there isn't one)
+		std::string cache_key;														///< The cache key of the current query
+		JASS_anytime_result_cache::results_list cached;						///< A results list from (or going to) the cache
+		std::string query_id;														///< The query-id of the current query (when it is passed with the query)
+		bool allocation_free;														///< Is the search expected not to allocate memory between parsing and the top-k (it is unless there is a decoded segment cache)?
+		size_t pipeline;																///< How the segment loop overlaps the segments (0 = not at all, 1 = prefetch, 2 = prefetch and decode ahead)
+		std::unique_ptr<JASS_anytime_decode_ahead<DECODER>> ahead;			///< The helper that decodes the next segment (or nullptr if not decoding ahead)
+		bool segment_timing;															///< Should the decode and process of each segment be timed?
+		size_t decode_time_in_ns;													///< The time spent decoding (or waiting for the helper to decode) the timed segments
+		size_t process_time_in_ns;													///< The time spent processing the timed segments
+		size_t postings_timed;														///< The number of postings in the timed segments
+		bool early_termination;														///< Stop each query once no remaining segment can change which documents are in its top-k
+		std::unique_ptr<uint16_t []> segment_term;							///< The query term each segment in segment_order belongs to (only when terminating early)
+		std::unique_ptr<uint32_t []> remaining_score;						///< The most the segments from segment_order[i] onwards can add to the rsv of a document (only when terminating early)
+		bool stopped_early;															///< Did the last query stop because its top-k could no longer change?
 
+	private:
 		/*
-			Extract the query ID from the query
+			ANYTIME_SEARCHER::SEGMENT()
+			---------------------------
 		*/
-		auto end_of_id = query.find_first_of(seperators_between_id_and_query);
-		if (end_of_id == std::string::npos)
-			query_id = "";
-		else
+		/*!
+			@brief Return the header of a segment.
+			@param offset [in] The offset of the segment in the postings.
+			@return A reference to the segment header.
+		*/
+		const JASS::deserialised_jass_v1::segment_header &segment(uint64_t offset) const
 			{
-			query_id = query.substr(0, end_of_id);
-			auto start_of_query = query.substr(end_of_id, std::string::npos).find_first_not_of(seperators_between_id_and_query);
-			if (start_of_query == std::string::npos)
-				query = query.substr(end_of_id, std::string::npos);
-			else
-				query = query.substr(end_of_id + start_of_query, std::string::npos);
+			return *reinterpret_cast<const JASS::deserialised_jass_v1::segment_header *>(index.postings() + offset);
 			}
 
 		/*
-			Process the query
+			ANYTIME_SEARCHER::MAY_PROCESS()
+			-------------------------------
 		*/
-		jass_query->parse(query);
-		auto &terms = jass_query->terms();
-
-		/*
-			Parse the query and extract the list of impact segments
+		/*!
+			@brief Apply the anytime and deadline stopping rules to the next segment.
+			@param header [in] The next segment.
+			@param postings_processed [in / out] The number of postings processed so far (updated to include this segment only if it is to be processed).
+			@param search_time [in] The time the search started.
+			@return true if the segment should be processed, false if the search should stop.
 		*/
-		uint64_t *current_segment = segment_order;
-		for (const auto &term : terms)
+		bool may_process(const JASS::deserialised_jass_v1::segment_header &header, size_t &postings_processed, decltype(JASS::timer::start()) search_time) const
 			{
-// std::cout << "TERM:" << term << "\n";
+			/*
+				The anytime algorithms basically boils down to this... have we processed enough postings yet?  If so then stop
+				The definition of "enough" is that processing the next segment will exceed postings_to_process so we wil be over
+				the "time limit" so we must not do it.
+			*/
+			if (postings_processed + header.segment_frequency > postings_to_process)
+				return false;
 
 			/*
-				Get the metadata for this term (and if this term isn't in the vocab them move on to the next term)
+				If there's a deadline then stop if this segment is predicted to take us past it.
 			*/
-			JASS::deserialised_jass_v1::metadata metadata;
-			if (!index.postings_details(metadata, term))
-				continue;
+			if (deadline.enabled() && deadline.exceeded(JASS::timer::stop(search_time).nanoseconds(), header))
+				return false;
 
 			/*
-				Add to the list of impact segments that need to be processed
+				Only now is the segment going to be processed, so only now count it
 			*/
-			std::copy((uint64_t *)(metadata.offset), (uint64_t *)(metadata.offset) + metadata.impacts, current_segment);
-			current_segment += metadata.impacts;
+			postings_processed += header.segment_frequency;
+			return true;
 			}
 
 		/*
-			Sort the segments from highest impact to lowest impact
+			ANYTIME_SEARCHER::BOUND_REMAINING_SCORES()
+			------------------------------------------
+		*/
+		/*!
+			@brief Compute remaining_score for each position in segment_order.
+			@details The segments of each term are in segment_order highest impact first, so the most a term can add to a document from a
+			given position onwards is the impact of its next segment, and the bound is the sum of these over the terms.  Walking backwards,
+			each segment replaces the (lower) impact of the segment after it from the same term in the sum.
+			@param end [in] The end of the list of segments in segment_order.
+			@param terms [in] The number of query terms that are in the vocabulary.
+			@return The number of postings in all the segments (the number exhaustive processing would process).
 		*/
-		std::sort
-			(
-			segment_order,
-			current_segment,
-			[postings = index.postings()](uint64_t first, uint64_t second)
+		size_t bound_remaining_scores(const uint64_t *end, size_t terms)
+			{
+			uint16_t next_impact[MAX_TERMS_PER_QUERY];
+			std::fill(next_impact, next_impact + terms, 0);
+
+			size_t segments = end - segment_order;
+			size_t postings = 0;
+			uint32_t bound = 0;
+
+			remaining_score[segments] = 0;
+			for (size_t which = segments; which-- > 0;)
 				{
-				JASS::deserialised_jass_v1::segment_header *lhs = (JASS::deserialised_jass_v1::segment_header *)(postings + first);
-				JASS::deserialised_jass_v1::segment_header *rhs = (JASS::deserialised_jass_v1::segment_header *)(postings + second);
+				const JASS::deserialised_jass_v1::segment_header &header = segment(segment_order[which]);
+				uint16_t &term_impact = next_impact[segment_term[which]];
+
+				bound += header.impact - term_impact;
+				term_impact = header.impact;
+				remaining_score[which] = bound;
+				postings += header.segment_frequency;
+				}
 
+			return postings;
+			}
+
+		/*
+			ANYTIME_SEARCHER::TOP_K_IS_FINAL()
+			----------------------------------
+		*/
+		/*!
+			@brief Can the remaining segments change which documents are in the top-k?
+			@details The query objects hold top-k + 1 documents.  No document outside the top-k has an rsv higher than the (k+1)-th, and
+			the k-th can only go up, so if the (k+1)-th plus the most the remaining segments can add is less than the k-th then no document
+			can enter (or leave) the top-k.  The order of, and the rsvs of, the documents in the top-k can still change.
+			@param accumulators [in] The query object.
+			@param next [in] The position in segment_order of the first segment not yet processed.
+			@return true if the top-k can no longer change, else false.
+		*/
+		template <typename ACCUMULATOR_TYPE>
+		bool top_k_is_final(const JASS::query<ACCUMULATOR_TYPE, MAX_DOCUMENTS, MAX_TOP_K, TOP_K_STRATEGY> &accumulators, size_t next) const
+			{
+			ACCUMULATOR_TYPE k_plus_one_th;
+			ACCUMULATOR_TYPE k_th;
+
+			if (!accumulators.bottom_of_top_k(k_plus_one_th, k_th))
+				return false;
+
+			return static_cast<size_t>(k_plus_one_th) + remaining_score[next] < k_th;
+			}
+
+		/*
+			ANYTIME_SEARCHER::PREFETCH_NEXT()
+			---------------------------------
+		*/
+		/*!
+			@brief Prefetch the compressed postings of the next segment, and the header of the one after that (so that it is in cache
+			when its postings are prefetched on the next call).
+			@param next [in] The next segment in segment_order.
+			@param end [in] The end of the list of segments in segment_order.
+		*/
+		forceinline void prefetch_next(const uint64_t *next, const uint64_t *end) const
+			{
+			if (next + 1 < end)
+				JASS::prefetch::read(index.postings() + next[1]);
+			if (next < end)
+				{
+				const JASS::deserialised_jass_v1::segment_header &header = segment(*next);
+				JASS::prefetch::read(index.postings() + header.offset, header.end - header.offset);
+				}
+			}
+
+		/*
+			ANYTIME_SEARCHER::PROCESS_AHEAD()
+			---------------------------------
+		*/
+		/*!
+			@brief Process the segments in segment_order (up to the anytime, deadline, and early termination stopping points) with the
+			helper thread decoding segment i + 1 while this thread processes segment i.
+			@details The stopping rules are applied to a segment as it is handed to the helper rather than as it is processed.
+			@param accumulators [in] The query object to add the scores to.
+			@param end [in] The end of the list of segments in segment_order.
+			@param postings_processed [out] The number of postings processed.
+			@param search_time [in] The time the search started.
+			@return A pointer to the first segment that was not processed.
+		*/
+		template <typename QUERY_TYPE>
+		uint64_t *process_ahead(QUERY_TYPE &accumulators, uint64_t *end, size_t &postings_processed, decltype(JASS::timer::start()) search_time)
+			{
+			uint64_t *next = segment_order;
+			const JASS::deserialised_jass_v1::segment_header *processing = nullptr;
+			size_t processing_slot = 0;
+
+			if (next < end && may_process(segment(*next), postings_processed, search_time))
+				{
+				processing = &segment(*next++);
+				processing_slot = ahead->request(*processing);
+				}
+
+			while (processing != nullptr)
+				{
 				/*
-					sort from highest to lowest impact, but break ties by placing the lowest quantum-frequency first and the highest quantum-drequency last
+					Hand the next segment to the helper before processing this one
 				*/
-				if (lhs->impact < rhs->impact)
-					return false;
-				else if (lhs->impact > rhs->impact)
-					return true;
-				else			// impact scores are the same, so tie break on the length of the segment
-					return lhs->segment_frequency < rhs->segment_frequency;
+				const JASS::deserialised_jass_v1::segment_header *following = nullptr;
+				size_t following_slot = 0;
+				if (next < end && may_process(segment(*next), postings_processed, search_time))
+					{
+					following = &segment(*next++);
+					prefetch_next(next, end);
+					following_slot = ahead->request(*following);
+					}
+
+				if (segment_timing)
+					{
+					auto clock = JASS::timer::start();
+					const DECODER &decoded = ahead->wait(processing_slot);
+					decode_time_in_ns += JASS::timer::stop(clock).nanoseconds();
+
+					clock = JASS::timer::start();
+					decoded.process(processing->impact, accumulators);
+					process_time_in_ns += JASS::timer::stop(clock).nanoseconds();
+					postings_timed += processing->segment_frequency;
+					}
+				else
+					ahead->wait(processing_slot).process(processing->impact, accumulators);
+				ahead->release(processing_slot);
+
+				/*
+					If the top-k can no longer change then stop, discarding the segment the helper is decoding
+				*/
+				if (early_termination && top_k_is_final(accumulators, (next - segment_order) - (following == nullptr ? 0 : 1)))
+					{
+					if (following != nullptr)
+						{
+						ahead->wait(following_slot);
+						ahead->release(following_slot);
+						postings_processed -= following->segment_frequency;
+						next--;
+						}
+					stopped_early = true;
+					break;
+					}
+
+				processing = following;
+				processing_slot = following_slot;
 				}
-			);
+
+			return next;
+			}
 
 		/*
-			0 terminate the list of segments
+			ANYTIME_SEARCHER::PROCESS()
+			---------------------------
 		*/
-		*current_segment = 0;
+		/*!
+			@brief Process the segments in segment_order (up to the anytime, deadline, and early termination stopping points) then find the top-k.
+			@param accumulators [in] The query object to add the scores to.
+			@param end [in] The end of the list of segments in segment_order.
+			@param postings_processed [out] The number of postings processed.
+			@param search_time [in] The time the search started.
+			@return A pointer to the first segment that was not processed.
+		*/
+		template <typename QUERY_TYPE>
+		uint64_t *process(QUERY_TYPE &accumulators, uint64_t *end, size_t &postings_processed, decltype(JASS::timer::start()) search_time)
+			{
+			accumulators.rewind();
+			stopped_early = false;
+
+			uint64_t *current;
+			if (ahead)
+				current = process_ahead(accumulators, end, postings_processed, search_time);
+			else for (current = segment_order; current < end; current++)
+				{
+//	std::cout << "Process Segment->(" << ((JASS::deserialised_jass_v1::segment_header *)(index.postings() + *current))->impact << ":" << ((JASS::deserialised_jass_v1::segment_header *)(index.postings() + *current))->segment_frequency << ")\n";
+				const JASS::deserialised_jass_v1::segment_header &header = segment(*current);
+
+				if (!may_process(header, postings_processed, search_time))
+					break;
+
+				/*
+					Start fetching the next segment from memory while this one is decoded and processed
+				*/
+				if (pipeline != 0)
+					prefetch_next(current + 1, end);
+
+				/*
+					Process the postings
+				*/
+				uint16_t impact = header.impact;
+				if (segment_cache == nullptr && segment_timing)
+					{
+					auto clock = JASS::timer::start();
+					decoder->decode(*decompressor, header.segment_frequency, index.postings() + header.offset, header.end - header.offset);
+					decode_time_in_ns += JASS::timer::stop(clock).nanoseconds();
+
+					clock = JASS::timer::start();
+					decoder->process(impact, accumulators);
+					process_time_in_ns += JASS::timer::stop(clock).nanoseconds();
+					postings_timed += header.segment_frequency;
+					}
+				else if (segment_cache == nullptr)
+					{
+					decoder->decode(*decompressor, header.segment_frequency, index.postings() + header.offset, header.end - header.offset);
+					decoder->process(impact, accumulators);
+					}
+				else if (const std::vector<uint32_t> *document_ids = segment_cache->find(*current))
+					JASS_anytime_segment_cache::process(*document_ids, impact, accumulators);
+				else
+					{
+					decoder->decode(*decompressor, header.segment_frequency, index.postings() + header.offset, header.end - header.offset);
+					segment_cache->decoded(*current, *decoder, header.segment_frequency);
+					decoder->process(impact, accumulators);
+					}
+
+				/*
+					Stop once the remaining segments can't change the top-k
+				*/
+				if (early_termination && top_k_is_final(accumulators, current + 1 - segment_order))
+					{
+					current++;
+					stopped_early = true;
+					break;
+					}
+				}
+
+			accumulators.sort();
+
+			return current;
+			}
 
 		/*
-			Process the segments
+			ANYTIME_SEARCHER::COPY_RESULTS()
+			--------------------------------
 		*/
-		jass_query->rewind();
+		/*!
+			@brief Copy the top-k of the current query into cached (to add to the cache, or to export when the query object holds top-k + 1).
+			@param accumulators [in] The query object holding the (sorted) results list.
+		*/
+		template <typename QUERY_TYPE>
+		void copy_results(QUERY_TYPE &accumulators)
+			{
+			cached.results.clear();
+			for (const auto &document : accumulators)
+				{
+				if (cached.results.size() == top_k)
+					break;
+				cached.results.push_back(JASS_anytime_result_cache::result{static_cast<uint32_t>(document.document_id), static_cast<uint32_t>(document.rsv)});
+				}
+			}
 
-		size_t postings_processed = 0;
-		for (uint64_t *current = segment_order; current < current_segment; current++)
+	public:
+		/*
+			ANYTIME_SEARCHER::ANYTIME_SEARCHER()
+			------------------------------------
+		*/
+		/*!
+			@brief Constructor
+			@param index [in] The index to search.
+			@param postings_to_process [in] The maximum number of postings to process for each query.
+			@param deadline [in] The time budget for each query.
+			@param top_k [in] The number of results to return.
+			@param huge_pages [in] Ask for the accumulators to be in huge pages.
+			@param cache [in] The results cache shared by all the searchers (or nullptr for no cache).
+			@param segment_cache [in] The decoded segment cache shared by all the searchers (or nullptr for no cache).
+			@param pipeline [in] How the segment loop overlaps the segments (0 = not at all, 1 = prefetch, 2 = prefetch and decode the next segment on a helper thread), ignored if there is a segment cache.
+			@param segment_timing [in] Time the decode and process of each segment (see get_segment_timings()), ignored if there is a segment cache.
+			@param early_termination [in] Stop each query once the remaining segments can't change which documents are in its top-k (only with query_top_k_heap).
+		*/
+		anytime_searcher(const JASS::deserialised_jass_v1 &index, size_t postings_to_process, const JASS_anytime_deadline &deadline, size_t top_k, bool huge_pages, JASS_anytime_result_cache *cache, JASS_anytime_segment_cache *segment_cache, size_t pipeline, bool segment_timing, bool early_termination = false) :
+			index(index),
+			postings_to_process(postings_to_process),
+			deadline(deadline),
+			top_k(top_k),
+			cache(cache),
+			segment_cache(segment_cache),
+			cached(index.primary_keys()),
+			allocation_free(segment_cache == nullptr),
+			pipeline(segment_cache == nullptr ? pipeline : 0),
+			segment_timing(segment_cache == nullptr && segment_timing),
+			decode_time_in_ns(0),
+			process_time_in_ns(0),
+			postings_timed(0),
+			early_termination(early_termination && std::is_same<TOP_K_STRATEGY, JASS::query_top_k_heap>::value),
+			stopped_early(false)
 			{
-//	std::cout << "Process Segment->(" << ((JASS::deserialised_jass_v1::segment_header *)(index.postings() + *current))->impact << ":" << ((JASS::deserialised_jass_v1::segment_header *)(index.postings() + *current))->segment_frequency << ")\n";
-			const JASS::deserialised_jass_v1::segment_header &header = *reinterpret_cast<const JASS::deserialised_jass_v1::segment_header *>(index.postings() + *current);
+			/*
+				Extract the compression scheme from the index
+			*/
+			std::string codex_name;
+			decompressor = &index.codex(codex_name);
+			decoder = new DECODER(index.document_count() + 4096);				// Some decoders write past the end of the output buffer (e.g. GroupVarInt) so we allocate enough space for the overflow
 
 			/*
-				The anytime algorithms basically boils down to this... have we processed enough postings yet?  If so then stop
-				The definition of "enough" is that processing the next segment will exceed postings_to_process so we wil be over
-				the "time limit" so we must not do it.
+				Allocate the Score-at-a-Time table
 			*/
-			if (postings_processed + header.segment_frequency > postings_to_process)
-				break;
-			postings_processed += header.segment_frequency;
+			segment_order = new uint64_t [MAX_TERMS_PER_QUERY * MAX_QUANTUM];
+			if (this->early_termination)
+				{
+				segment_term.reset(new uint16_t [MAX_TERMS_PER_QUERY * MAX_QUANTUM]);
+				remaining_score.reset(new uint32_t [MAX_TERMS_PER_QUERY * MAX_QUANTUM + 1]);
+				}
+
+			/*
+				Allocate a JASS query object (the accumulators are sized to fit the index).  To terminate early the query objects keep one more than the top-k
+			*/
+			size_t heap_size = this->early_termination ? top_k + 1 : top_k;
+			jass_query = new JASS::query<uint16_t, MAX_DOCUMENTS, MAX_TOP_K, TOP_K_STRATEGY>(index.primary_keys(), index.document_count(), heap_size, huge_pages);
+			wide_query = new JASS::query<uint32_t, MAX_DOCUMENTS, MAX_TOP_K, TOP_K_STRATEGY>(index.primary_keys(), index.document_count(), heap_size, huge_pages);
+
+			/*
+				Start the helper that decodes ahead
+			*/
+			if (this->pipeline >= 2)
+				ahead.reset(new JASS_anytime_decode_ahead<DECODER>(index, *decompressor));
+			}
+
+		/*
+			ANYTIME_SEARCHER::~ANYTIME_SEARCHER()
+			-------------------------------------
+		*/
+		/*!
+			@brief Destructor
+		*/
+		~anytime_searcher()
+			{
+			delete jass_query;
+			delete wide_query;
+			delete [] segment_order;
+			delete decoder;
+			}
+
+		/*
+			ANYTIME_SEARCHER::SEARCH()
+			--------------------------
+		*/
+		/*!
+			@brief Search and write the results list as a TREC run.
+			@param query [in] The query, prefixed with the query-id (this string is modified).
+			@param results [out] The results list is appended to this stream.
+			@return The time spent searching (in nanoseconds), which does not include writing the results list.
+		*/
+		size_t search(std::string &query, std::ostream &results)
+			{
+			JASS_anytime_query_record record;
+			return search(query, results, record);
+			}
+
+		/*
+			ANYTIME_SEARCHER::SEARCH()
+			--------------------------
+		*/
+		/*!
+			@brief Search and write the results list as a TREC run, and record what happened.
+			@param query [in] The query, prefixed with the query-id (this string is modified).
+			@param results [out] The results list is appended to this stream.
+			@param record [out] The query-id, the number of terms found, segments processed, postings processed (and saved by terminating early), and the time spent searching.
+			@return The time spent searching (in nanoseconds), which does not include writing the results list.
+		*/
+		size_t search(std::string &query, std::ostream &results, JASS_anytime_query_record &record)
+			{
+			JASS_anytime_query::extract_query_id(query, query_id);
+			return search(query_id, query, results, record);
+			}
+
+		/*
+			ANYTIME_SEARCHER::SEARCH()
+			--------------------------
+		*/
+		/*!
+			@brief Search a query that has been split from its query-id, write the results list as a TREC run, and record what happened.
+			@details Other than the results cache and the decoded segment cache, nothing between parsing the query and finding the top-k
+			allocates memory (the query object recycles its memory), and when compiled with ENSURE_NO_ALLOCATIONS this is enforced.
+			@param query_id [in] The query-id.
+			@param query [in] The query (without the query-id).
+			@param results [out] The results list is appended to this stream.
+			@param record [out] The query-id, the number of terms found, segments processed, postings processed (and saved by terminating early), and the time spent searching.
+			@return The time spent searching (in nanoseconds), which does not include writing the results list.
+		*/
+		size_t search(const std::string &query_id, const std::string &query, std::ostream &results, JASS_anytime_query_record &record)
+			{
+			/*
+				Start the timer
+			*/
+			auto search_time = JASS::timer::start();
+
+			/*
+				Process the query
+			*/
+			forbid_allocations(allocation_free);
+			jass_query->parse(query);
 
 			/*
-				Process the postings
+				If the results list is in the cache then we're done
 			*/
-			uint16_t impact = header.impact;
-			decoder->decode(decompressor, header.segment_frequency, index.postings() + header.offset, header.end - header.offset);
-			decoder->process(impact, *jass_query);
+			if (cache != nullptr)
+				{
+				forbid_allocations(false);
+				JASS_anytime_result_cache::make_key(cache_key, jass_query->terms(), top_k, postings_to_process);
+				bool hit = cache->find(cache_key, cached, record.terms_found);
+				forbid_allocations(allocation_free);
+				if (hit)
+					{
+					jass_query->rewind();				// discard the parsed query
+					forbid_allocations(false);
+					size_t nanoseconds = JASS::timer::stop(search_time).nanoseconds();
+
+					record.query_id = query_id;
+					record.segments_processed = 0;
+					record.postings_processed = 0;
+					record.search_time_in_ns = nanoseconds;
+
+					JASS::run_export(JASS::run_export::TREC, results, query_id.c_str(), cached, "COMPILED", false);
+					return nanoseconds;
+					}
+				}
+
+			size_t highest_possible_score;
+			uint64_t *current_segment = order_segments(index, jass_query->terms(), segment_order, record.terms_found, highest_possible_score, segment_term.get());
+
+			/*
+				To terminate early we need to know the most the remaining segments can add to a document
+			*/
+			size_t exhaustive_postings = 0;
+			if (early_termination)
+				exhaustive_postings = bound_remaining_scores(current_segment, record.terms_found);
+
+			/*
+				Process the segments (with accumulators wide enough that they cannot overflow)
+			*/
+			size_t postings_processed = 0;
+			bool wide = highest_possible_score > (std::numeric_limits<uint16_t>::max)();
+			uint64_t *current;
+			if (wide)
+				{
+				jass_query->rewind();				// discard the parsed query
+				current = process(*wide_query, current_segment, postings_processed, search_time);
+				}
+			else
+				current = process(*jass_query, current_segment, postings_processed, search_time);
+
+			forbid_allocations(false);
+
+			/*
+				Keep the top-k (the query objects hold one more when terminating early) and remember it for next time
+			*/
+			if (cache != nullptr || early_termination)
+				{
+				if (wide)
+					copy_results(*wide_query);
+				else
+					copy_results(*jass_query);
+
+				if (cache != nullptr)
+					cache->insert(cache_key, cached.results, record.terms_found);
+				}
+
+			/*
+				stop the timer
+			*/
+			size_t nanoseconds = JASS::timer::stop(search_time).nanoseconds();
+
+			record.query_id = query_id;
+			record.segments_processed = current - segment_order;
+			record.postings_processed = postings_processed;
+			record.postings_saved = stopped_early ? exhaustive_postings - postings_processed : 0;
+			record.search_time_in_ns = nanoseconds;
+
+			/*
+				Serialise the results list (don't time this)
+			*/
+			if (early_termination)
+				JASS::run_export(JASS::run_export::TREC, results, query_id.c_str(), cached, "COMPILED", false);
+			else if (wide)
+				JASS::run_export(JASS::run_export::TREC, results, query_id.c_str(), *wide_query, "COMPILED", false);
+			else
+				JASS::run_export(JASS::run_export::TREC, results, query_id.c_str(), *jass_query, "COMPILED", false);
+
+			return nanoseconds;
 			}
 
-		jass_query->sort();
-		
+		/*
+			ANYTIME_SEARCHER::GET_SEGMENT_TIMINGS()
+			---------------------------------------
+		*/
+		/*!
+			@brief Add the time spent decoding and processing the timed segments (if segment timing is on) to the given totals.
+			@param decode_time_in_ns [in / out] The time spent decoding (or waiting for the helper to decode).
+			@param process_time_in_ns [in / out] The time spent processing.
+			@param postings [in / out] The number of postings in the timed segments.
+		*/
+		void get_segment_timings(size_t &decode_time_in_ns, size_t &process_time_in_ns, size_t &postings) const
+			{
+			decode_time_in_ns += this->decode_time_in_ns;
+			process_time_in_ns += this->process_time_in_ns;
+			postings += postings_timed;
+			}
+
+		/*
+			ANYTIME_SEARCHER::CALIBRATE()
+			-----------------------------
+		*/
+		/*!
+			@brief Time how long it takes to decode and process the segments of a sample of the terms in the index, and fit the deadline cost model to the timings.
+			@details Terms are taken at even intervals through the vocabulary and each is processed as if it were a one-term query.  This is done twice
+			and only the second (warm) timings are used.
+			@param model [out] The deadline whose cost model is calibrated.
+			@param terms [in] The number of terms to sample.
+		*/
+		void calibrate(JASS_anytime_deadline &model, size_t terms)
+			{
+			size_t step = index.term_count() <= terms ? 1 : index.term_count() / terms;
+
+			for (size_t pass = 0; pass < 2; pass++)
+				for (size_t which = 0; which < index.term_count(); which += step)
+					{
+					auto metadata = index.term_at(which);
+					const uint64_t *segments = reinterpret_cast<const uint64_t *>(metadata.offset);
+
+					jass_query->rewind();
+					for (const uint64_t *current = segments; current < segments + metadata.impacts; current++)
+						{
+						const JASS::deserialised_jass_v1::segment_header &header = *reinterpret_cast<const JASS::deserialised_jass_v1::segment_header *>(index.postings() + *current);
+
+						auto segment_time = JASS::timer::start();
+						decoder->decode(*decompressor, header.segment_frequency, index.postings() + header.offset, header.end - header.offset);
+						decoder->process(header.impact, *jass_query);
+						size_t nanoseconds = JASS::timer::stop(segment_time).nanoseconds();
+
+						if (pass == 1)
+							model.add_observation(header.segment_frequency, header.end - header.offset, nanoseconds);
+						}
+					}
+
+			jass_query->rewind();
+			model.fit();
+			}
+	};
+
+/*
+	ANYTIME()
+	---------
+*/
+template <typename DECODER, typename TOP_K_STRATEGY>
+void anytime(JASS_anytime_thread_result &output, const JASS::deserialised_jass_v1 &index, std::vector<JASS_anytime_query> &query_list, size_t postings_to_process, const JASS_anytime_deadline &deadline, size_t top_k, bool huge_pages, JASS_anytime_result_cache *cache, JASS_anytime_segment_cache *segment_cache, size_t pipeline, bool segment_timing, bool early_termination)
+	{
+	anytime_searcher<DECODER, TOP_K_STRATEGY> searcher(index, postings_to_process, deadline, top_k, huge_pages, cache, segment_cache, pipeline, segment_timing, early_termination);
+
+	/*
+		Now start searching
+	*/
+	size_t next_query = 0;
+	const JASS_anytime_query *query;
+
+	while ((query = JASS_anytime_query::get_next_query(query_list, next_query)) != nullptr)
+		{
+		JASS_anytime_query_record record;
+		record.position = next_query;
+		searcher.search(query->query_id, query->query, output.results_list, record);
+		output.add(record);
+		}
+
+	searcher.get_segment_timings(output.decode_time_in_ns, output.process_time_in_ns, output.postings_timed);
+	}
+
+/*
+	ANYTIME_SERVER()
+	----------------
+*/
+/*!
+	@brief Load the index once then answer queries from clients until told to quit (see JASS_anytime_server).
+	@param stats [out] The statistics of the server once it has stopped.
+	@param index [in] The index to search.
+	@param address [in] The address to listen on, "[host:]port" or "unix:path".
+	@param postings_to_process [in] The maximum number of postings to process for each query.
+	@param deadline [in] The time budget for each query.
+	@param top_k [in] The number of results to return.
+	@param huge_pages [in] Ask for the accumulators to be in huge pages.
+	@param cache [in] The results cache (or nullptr for no cache).
+	@param segment_cache [in] The decoded segment cache (or nullptr for no cache).
+	@param pipeline [in] How the segment loop overlaps the segments (see anytime_searcher).
+	@param early_termination [in] Stop each query once its top-k can no longer change (see anytime_searcher).
+	@param threads [in] The number of worker threads.
+*/
+template <typename DECODER, typename TOP_K_STRATEGY>
+void anytime_server(JASS_anytime_stats &stats, const JASS::deserialised_jass_v1 &index, const std::string &address, size_t postings_to_process, const JASS_anytime_deadline &deadline, size_t top_k, bool huge_pages, JASS_anytime_result_cache *cache, JASS_anytime_segment_cache *segment_cache, size_t pipeline, bool early_termination, size_t threads)
+	{
+	/*
+		Pre-allocate everything each worker needs
+	*/
+	typedef anytime_searcher<DECODER, TOP_K_STRATEGY> searcher_type;
+	std::vector<std::unique_ptr<searcher_type>> searchers;
+	for (size_t which = 0; which < threads; which++)
+		searchers.push_back(std::unique_ptr<searcher_type>(new searcher_type(index, postings_to_process, deadline, top_k, huge_pages, cache, segment_cache, pipeline, false, early_termination)));
+
+	JASS_anytime_server<searcher_type> server(searchers);
+
+	std::cout << "Serving on " << address << "\n";
+	std::cout.flush();
+	if (!server.serve(address))
+		exit(printf("Can't listen on %s\n", address.c_str()));
+
+	server.get_stats(stats);
+	}
+
+/*
+	CALIBRATE()
+	-----------
+*/
+/*!
+	@brief Calibrate the cost model of the deadline by timing segments from the index (see anytime_searcher::calibrate()).
+	@param deadline [in / out] The deadline to calibrate.
+	@param index [in] The index to search.
+	@param top_k [in] The number of results to return.
+*/
+template <typename DECODER>
+void calibrate(JASS_anytime_deadline &deadline, const JASS::deserialised_jass_v1 &index, size_t top_k)
+	{
+	anytime_searcher<DECODER> searcher(index, (std::numeric_limits<size_t>::max)(), deadline, top_k, false, nullptr, nullptr, 0, false);
+	searcher.calibrate(deadline, CALIBRATION_TERMS);
+	}
+
+/*
+	ANYTIME_INTRA_QUERY()
+	---------------------
+*/
+/*!
+	@brief Search using a team of threads co-operating on each query (see JASS_anytime_intra_query).
+	@tparam DECODER The postings list decoder.
+	@tparam ACCUMULATOR_TYPE The type of the accumulators (uint16_t or uint32_t), which must be able to hold the highest possible score of every query.
+	@param output [out] The results of the search.
+	@param index [in] The index to search.
+	@param query_list [in] The queries.
+	@param postings_to_process [in] The maximum number of postings to process for each query.
+	@param top_k [in] The number of results to return.
+	@param huge_pages [in] Ask for the accumulators to be in huge pages.
+	@param threads [in] The number of threads to use for each query.
+*/
+template <typename DECODER, typename ACCUMULATOR_TYPE>
+void anytime_intra_query(JASS_anytime_thread_result &output, const JASS::deserialised_jass_v1 &index, std::vector<JASS_anytime_query> &query_list, size_t postings_to_process, size_t top_k, bool huge_pages, size_t threads)
+	{
+	typedef JASS_anytime_intra_query<DECODER, ACCUMULATOR_TYPE, MAX_DOCUMENTS, MAX_TOP_K> team_type;
+
+	/*
+		Extract the compression scheme from the index
+	*/
+	std::string codex_name;
+	JASS::compress_integer &decompressor = index.codex(codex_name);
+
+	/*
+		Allocate the Score-at-a-Time table
+	*/
+	uint64_t *segment_order = new uint64_t [MAX_TERMS_PER_QUERY * MAX_QUANTUM];
+
+	/*
+		Allocate the team (and their accumulators)
+	*/
+	team_type *team = new team_type(index, decompressor, threads, top_k, huge_pages);
+
+	/*
+		Start the timer
+	*/
+	auto total_search_time = JASS::timer::start();
+
+	/*
+		Now start searching
+	*/
+	size_t next_query = 0;
+	const JASS_anytime_query *query;
+
+	while ((query = JASS_anytime_query::get_next_query(query_list, next_query)) != nullptr)
+		{
+		JASS_anytime_query_record record;
+		record.position = next_query;
+		const std::string &query_id = query->query_id;
+
+		auto &jass_query = team->parser();
+		jass_query.parse(query->query);
+		size_t highest_possible_score;
+		uint64_t *current_segment = order_segments(index, jass_query.terms(), segment_order, record.terms_found, highest_possible_score);
+
+		/*
+			Apply the anytime stopping rule up-front so that the team knows how much work there is
+		*/
+		size_t postings_processed = 0;
+		uint64_t *current;
+		for (current = segment_order; current < current_segment; current++)
+			{
+			const JASS::deserialised_jass_v1::segment_header &header = *reinterpret_cast<const JASS::deserialised_jass_v1::segment_header *>(index.postings() + *current);
+			if (postings_processed + header.segment_frequency > postings_to_process)
+				break;
+			postings_processed += header.segment_frequency;
+			}
+
+		team->search(segment_order, current - segment_order);
+
 		/*
 			stop the timer
 		*/
-		output.search_time_in_ns += JASS::timer::stop(total_search_time).nanoseconds();
+		record.query_id = query_id;
+		record.segments_processed = current - segment_order;
+		record.postings_processed = postings_processed;
+		record.search_time_in_ns = JASS::timer::stop(total_search_time).nanoseconds();
+		output.add(record);
 
 		/*
 			Serialise the results list (don't time this)
 		*/
-		JASS::run_export(JASS::run_export::TREC, output.results_list, query_id.c_str(), *jass_query, "COMPILED", false);
+		JASS::run_export(JASS::run_export::TREC, output.results_list, query_id.c_str(), *team, "COMPILED", false);
 
 		/*
 			Re-start the timer
 		*/
 		total_search_time = JASS::timer::start();
-
-		/*
-			get the next query
-		*/
-		query = JASS_anytime_query::get_next_query(query_list, next_query);
 		}
 
 	/*
 		clean up
 	*/
-	delete jass_query;
+	delete team;
 	delete [] segment_order;
-	delete decoder;
+	}
+
+/*
+	HIGHEST_POSSIBLE_SCORE()
+	------------------------
+*/
+/*!
+	@brief Return the largest score any document can get for any of the queries.
+	@param index [in] The index to search.
+	@param query_list [in] The queries.
+	@return The highest possible score of the query with the highest possible score.
+*/
+size_t highest_possible_score(const JASS::deserialised_jass_v1 &index, const std::vector<JASS_anytime_query> &query_list)
+	{
+	JASS::query<uint16_t, MAX_DOCUMENTS, MAX_TOP_K> parser(index.primary_keys(), 1, 1);
+	std::unique_ptr<uint64_t []> segment_order(new uint64_t [MAX_TERMS_PER_QUERY * MAX_QUANTUM]);
+	size_t highest = 0;
+
+	for (const auto &query : query_list)
+		{
+		parser.parse(query.query);
+
+		size_t terms_found;
+		size_t score;
+		order_segments(index, parser.terms(), segment_order.get(), terms_found, score);
+		highest = (std::max)(highest, score);
+		parser.rewind();
+		}
+
+	return highest;
+	}
+
+/*
+	ANYTIME_INTRA_QUERY()
+	---------------------
+*/
+/*!
+	@brief Search using a team of threads co-operating on each query, with 16-bit accumulators unless one of the queries could overflow them.
+	@details The team is built once for all the queries, so the accumulator width is chosen (from the sum of the highest impact of each
+	term) for the query set as a whole rather than for each query.
+	@param output [out] The results of the search.
+	@param index [in] The index to search.
+	@param query_list [in] The queries.
+	@param postings_to_process [in] The maximum number of postings to process for each query.
+	@param top_k [in] The number of results to return.
+	@param huge_pages [in] Ask for the accumulators to be in huge pages.
+	@param threads [in] The number of threads to use for each query.
+*/
+template <typename DECODER>
+void anytime_intra_query(JASS_anytime_thread_result &output, const JASS::deserialised_jass_v1 &index, std::vector<JASS_anytime_query> &query_list, size_t postings_to_process, size_t top_k, bool huge_pages, size_t threads)
+	{
+	if (highest_possible_score(index, query_list) > (std::numeric_limits<uint16_t>::max)())
+		anytime_intra_query<DECODER, uint32_t>(output, index, query_list, postings_to_process, top_k, huge_pages, threads);
+	else
+		anytime_intra_query<DECODER, uint16_t>(output, index, query_list, postings_to_process, top_k, huge_pages, threads);
+	}
+
+/*
+	ANYTIME_BATCH()
+	---------------
+*/
+/*!
+	@brief Search the queries in batches, decoding each impact segment once per batch (see JASS_anytime_batch).
+	@details The anytime stopping rule is applied to each query before its batch is searched.  The queries of a batch finish together so
+	the search time of each is recorded as its share of the time taken to search the batch.
+	@tparam DECODER The postings list decoder.
+	@tparam ACCUMULATOR_TYPE The type of the accumulators (uint16_t or uint32_t), which must be able to hold the highest possible score of every query.
+	@tparam TOP_K_STRATEGY How the query objects find the top-k (JASS::query_top_k_heap or JASS::query_top_k_scan).
+	@param output [out] The results of the search.
+	@param index [in] The index to search.
+	@param query_list [in] The queries.
+	@param postings_to_process [in] The maximum number of postings to process for each query.
+	@param top_k [in] The number of results to return.
+	@param huge_pages [in] Ask for the accumulators to be in huge pages.
+	@param batch_size [in] The number of queries in each batch.
+*/
+template <typename DECODER, typename ACCUMULATOR_TYPE, typename TOP_K_STRATEGY>
+void anytime_batch(JASS_anytime_thread_result &output, const JASS::deserialised_jass_v1 &index, std::vector<JASS_anytime_query> &query_list, size_t postings_to_process, size_t top_k, bool huge_pages, size_t batch_size)
+	{
+	typedef JASS_anytime_batch<DECODER, ACCUMULATOR_TYPE, MAX_DOCUMENTS, MAX_TOP_K, TOP_K_STRATEGY> batch_type;
+
+	/*
+		Extract the compression scheme from the index
+	*/
+	std::string codex_name;
+	JASS::compress_integer &decompressor = index.codex(codex_name);
+
+	/*
+		Allocate the Score-at-a-Time table and the batch (and its accumulators)
+	*/
+	std::unique_ptr<uint64_t []> segment_order(new uint64_t [MAX_TERMS_PER_QUERY * MAX_QUANTUM]);
+	std::unique_ptr<batch_type> batch(new batch_type(index, decompressor, batch_size, top_k, huge_pages));
+	std::vector<const JASS_anytime_query *> queries(batch_size);
+	std::vector<JASS_anytime_query_record> records(batch_size);
+
+	size_t next_query = 0;
+	while (true)
+		{
+		/*
+			Take the next batch of queries
+		*/
+		size_t queries_in_batch;
+		for (queries_in_batch = 0; queries_in_batch < batch_size; queries_in_batch++)
+			{
+			queries[queries_in_batch] = JASS_anytime_query::get_next_query(query_list, next_query);
+			if (queries[queries_in_batch] == nullptr)
+				break;
+			records[queries_in_batch].position = next_query;
+			}
+		if (queries_in_batch == 0)
+			break;
+
+		/*
+			Start the timer
+		*/
+		auto batch_time = JASS::timer::start();
+
+		/*
+			Work out which segments each query will process
+		*/
+		for (size_t which = 0; which < queries_in_batch; which++)
+			{
+			JASS_anytime_query_record &record = records[which];
+			record.query_id = queries[which]->query_id;
+
+			auto &jass_query = (*batch)[which];
+			jass_query.parse(queries[which]->query);
+			size_t highest_possible_score;
+			uint64_t *current_segment = order_segments(index, jass_query.terms(), segment_order.get(), record.terms_found, highest_possible_score);
+
+			/*
+				Apply the anytime stopping rule up-front so that the segments can be shared
+			*/
+			size_t postings_processed = 0;
+			uint64_t *current;
+			for (current = segment_order.get(); current < current_segment; current++)
+				{
+				const JASS::deserialised_jass_v1::segment_header &header = *reinterpret_cast<const JASS::deserialised_jass_v1::segment_header *>(index.postings() + *current);
+				if (postings_processed + header.segment_frequency > postings_to_process)
+					break;
+				postings_processed += header.segment_frequency;
+				}
+
+			record.segments_processed = current - segment_order.get();
+			record.postings_processed = postings_processed;
+			batch->add(which, segment_order.get(), record.segments_processed);
+			}
+
+		batch->search(queries_in_batch);
+
+		/*
+			stop the timer
+		*/
+		size_t nanoseconds = JASS::timer::stop(batch_time).nanoseconds();
+
+		/*
+			Serialise the results lists (don't time this)
+		*/
+		for (size_t which = 0; which < queries_in_batch; which++)
+			{
+			records[which].search_time_in_ns = nanoseconds / queries_in_batch;
+			output.add(records[which]);
+			JASS::run_export(JASS::run_export::TREC, output.results_list, records[which].query_id.c_str(), (*batch)[which], "COMPILED", false);
+			}
+		}
+
+	output.segments_decoded = batch->get_segments_decoded();
+	}
+
+/*
+	ANYTIME_BATCH()
+	---------------
+*/
+/*!
+	@brief Search the queries in batches, with 16-bit accumulators unless one of the queries could overflow them.
+	@param output [out] The results of the search.
+	@param index [in] The index to search.
+	@param query_list [in] The queries.
+	@param postings_to_process [in] The maximum number of postings to process for each query.
+	@param top_k [in] The number of results to return.
+	@param huge_pages [in] Ask for the accumulators to be in huge pages.
+	@param batch_size [in] The number of queries in each batch.
+	@param wide [in] Use 32-bit accumulators (see highest_possible_score()).
+*/
+template <typename DECODER, typename TOP_K_STRATEGY>
+void anytime_batch(JASS_anytime_thread_result &output, const JASS::deserialised_jass_v1 &index, std::vector<JASS_anytime_query> &query_list, size_t postings_to_process, size_t top_k, bool huge_pages, size_t batch_size, bool wide)
+	{
+	if (wide)
+		anytime_batch<DECODER, uint32_t, TOP_K_STRATEGY>(output, index, query_list, postings_to_process, top_k, huge_pages, batch_size);
+	else
+		anytime_batch<DECODER, uint16_t, TOP_K_STRATEGY>(output, index, query_list, postings_to_process, top_k, huge_pages, batch_size);
 	}
 
 /*
@@ -263,7 +1317,7 @@ int main(int argc, const char *argv[])
 	if (parameter_help)
 		exit(usage(argv[0]));
 
-	if (parameter_top_k > MAX_TOP_K)
+	if (parameter_top_k + (parameter_early_termination ? 1 : 0) > MAX_TOP_K)
 		{
 		std::cout << "top-k specified (" << parameter_top_k << ") is larger than maximum TOP-K (" << MAX_TOP_K << "), change MAX_TOP_K in " << __FILE__  << " and recompile.\n";
 		exit(1);
@@ -274,18 +1328,60 @@ int main(int argc, const char *argv[])
 	*/
 	JASS_anytime_stats stats;
 	stats.threads = parameter_threads;
+	stats.threads_per_query = parameter_intra_query_threads;
 
 	/*
 		Read the index
 	*/
-	JASS::deserialised_jass_v1 index(true);
-	index.read_index();
-
-	if (index.document_count() > MAX_DOCUMENTS)
+	bool numa = parameter_numa.size() != 0 && parameter_server.size() == 0 && parameter_intra_query_threads <= 1;
+	if (numa && parameter_numa != "pin" && parameter_numa != "interleave" && parameter_numa != "replicate")
+		{
+		std::cout << "Unknown NUMA policy (" << parameter_numa << "), use pin, interleave, or replicate\n";
+		exit(1);
+		}
+	if (numa && parameter_numa == "replicate" && (parameter_memory_map || parameter_populate))
 		{
-		std::cout << "There are " << index.document_count() << " documents in this index which is larger than MAX_DOCUMENTS (" << MAX_DOCUMENTS << "), change MAX_DOCUMENTS in " << __FILE__ << " and recompile.\n";
+		std::cout << "A memory mapped index can't be replicated on each NUMA node, use interleave instead\n";
 		exit(1);
 		}
+	std::vector<std::vector<size_t>> numa_nodes = JASS::numa_topology::nodes();
+	if (!numa)
+		numa_nodes.resize(1);
+
+	int map_hints = parameter_populate ? JASS::file_map::populate : JASS::file_map::none;
+	JASS::deserialised_jass_v1 index(true, parameter_memory_map || parameter_populate, map_hints);
+	std::vector<std::unique_ptr<JASS::deserialised_jass_v1>> replicas;
+	std::vector<const JASS::deserialised_jass_v1 *> node_index(numa_nodes.size(), &index);
+	if (numa && parameter_numa == "interleave")
+		{
+		/*
+			Spread the pages of the index over the nodes so that no one node's memory (or memory bus) is the bottleneck
+		*/
+		if (!JASS::numa_topology::interleave_allocations(true))
+			std::cout << "Can't interleave the index over the NUMA nodes\n";
+		index.read_index();
+		JASS::numa_topology::interleave_allocations(false);
+		}
+	else if (numa && parameter_numa == "replicate")
+		{
+		/*
+			Load a copy of the index on each node, each by a thread pinned to that node so that (first-touch) its pages are node-local
+		*/
+		for (size_t node = 0; node < numa_nodes.size(); node++)
+			{
+			JASS::deserialised_jass_v1 *replica = &index;
+			if (node != 0)
+				{
+				replicas.push_back(std::unique_ptr<JASS::deserialised_jass_v1>(new JASS::deserialised_jass_v1(false)));
+				replica = replicas.back().get();
+				}
+			node_index[node] = replica;
+			JASS::thread loader(JASS::thread::affinity(numa_nodes[node]), [replica](){ replica->read_index(); });
+			loader.join();
+			}
+		}
+	else
+		index.read_index();
 
 	/*
 		Set the Anytime stopping criteria
@@ -300,6 +1396,50 @@ int main(int argc, const char *argv[])
 
 std::cout << "Postings to process:" << postings_to_process << "\n";
 
+	/*
+		Set the deadline stopping criteria, calibrating the cost model against this index on this machine
+	*/
+	JASS_anytime_deadline deadline(parameter_deadline_us * 1000);
+	if (deadline.enabled())
+		{
+		std::string codex_name;
+		index.codex(codex_name);
+		if (codex_name == "None")
+			calibrate<JASS::decoder_d0>(deadline, index, parameter_top_k);
+		else
+			calibrate<JASS::decoder_d1>(deadline, index, parameter_top_k);
+		std::cout << deadline << "\n";
+		}
+
+	/*
+		Allocate the results cache and the decoded segment cache (shared by all the search threads)
+	*/
+	std::unique_ptr<JASS_anytime_result_cache> cache;
+	if (parameter_cache_mb != 0)
+		cache.reset(new JASS_anytime_result_cache(parameter_cache_mb * 1024 * 1024));
+
+	std::unique_ptr<JASS_anytime_segment_cache> segment_cache;
+	if (parameter_segment_cache_mb != 0)
+		segment_cache.reset(new JASS_anytime_segment_cache(parameter_segment_cache_mb * 1024 * 1024));
+
+	/*
+		If we're a server then we don't read a query file, we answer queries from clients until told to stop
+	*/
+	if (parameter_server.size() != 0)
+		{
+		std::string codex_name;
+		index.codex(codex_name);
+
+		if (codex_name == "None")
+			(parameter_heapless ? anytime_server<JASS::decoder_d0, JASS::query_top_k_scan> : anytime_server<JASS::decoder_d0, JASS::query_top_k_heap>)(stats, index, parameter_server, postings_to_process, deadline, parameter_top_k, parameter_huge_pages, cache.get(), segment_cache.get(), parameter_pipeline, parameter_early_termination, parameter_threads);
+		else
+			(parameter_heapless ? anytime_server<JASS::decoder_d1, JASS::query_top_k_scan> : anytime_server<JASS::decoder_d1, JASS::query_top_k_heap>)(stats, index, parameter_server, postings_to_process, deadline, parameter_top_k, parameter_huge_pages, cache.get(), segment_cache.get(), parameter_pipeline, parameter_early_termination, parameter_threads);
+
+		stats.set_cache(cache.get(), segment_cache.get());
+		std::cout << stats;
+		return 0;
+		}
+
 	/*
 		Read from the query file into a list of queries array.
 	*/
@@ -332,40 +1472,85 @@ std::cout << "Postings to process:" << postings_to_process << "\n";
 	index.codex(codex_name);
 	uint32_t d_ness = codex_name == "None" ? 0 : 1;
 
+	/*
+		Choose the search function once (decoder and top-k strategy) rather than for each thread
+	*/
+	void (*search)(JASS_anytime_thread_result &output, const JASS::deserialised_jass_v1 &index, std::vector<JASS_anytime_query> &query_list, size_t postings_to_process, const JASS_anytime_deadline &deadline, size_t top_k, bool huge_pages, JASS_anytime_result_cache *cache, JASS_anytime_segment_cache *segment_cache, size_t pipeline, bool segment_timing, bool early_termination);
+	if (d_ness == 0)
+		search = parameter_heapless ? anytime<JASS::decoder_d0, JASS::query_top_k_scan> : anytime<JASS::decoder_d0, JASS::query_top_k_heap>;
+	else
+		search = parameter_heapless ? anytime<JASS::decoder_d1, JASS::query_top_k_scan> : anytime<JASS::decoder_d1, JASS::query_top_k_heap>;
+
+	/*
+		Batches don't use the caches or the deadline.  When batching, choose the accumulator width once for all the queries (so every thread uses the same)
+	*/
+	bool batched = parameter_batch_size > 1 && parameter_intra_query_threads <= 1 && !cache && !segment_cache && !deadline.enabled();
+	bool wide_batches = batched && highest_possible_score(index, query_list) > (std::numeric_limits<uint16_t>::max)();
+	stats.early_termination = parameter_early_termination && !parameter_heapless && !batched && parameter_intra_query_threads <= 1;
+
+	/*
+		Where each search thread runs (round-robin over the NUMA nodes), and the copy of the index it searches
+	*/
+	auto node_of = [&](size_t which) { return which % numa_nodes.size(); };
+	auto placement = [&](size_t which) { return JASS::thread::affinity(numa ? numa_nodes[node_of(which)] : std::vector<size_t>()); };
+
 	/*
 		Start the work
 	*/
 	auto total_search_time = JASS::timer::start();
-	if (parameter_threads == 1)
+	if (parameter_intra_query_threads > 1)
 		{
 		/*
-			We have only 1 thread so don't bother to start a thread to do the work
+			Multiple threads co-operate on each query, and each query is done in turn
 		*/
+		stats.threads = 1;
+		output.resize(1);
 		switch (d_ness)
 			{
 			case 0:
-					anytime<JASS::decoder_d0>(output[0], index, query_list, postings_to_process, parameter_top_k);
+					anytime_intra_query<JASS::decoder_d0>(output[0], index, query_list, postings_to_process, parameter_top_k, parameter_huge_pages, parameter_intra_query_threads);
 				break;
 			default:
-					anytime<JASS::decoder_d1>(output[0], index, query_list, postings_to_process, parameter_top_k);
+					anytime_intra_query<JASS::decoder_d1>(output[0], index, query_list, postings_to_process, parameter_top_k, parameter_huge_pages, parameter_intra_query_threads);
 				break;
 			}
 		}
+	else if (batched)
+		{
+		/*
+			Each thread searches its queries a batch at a time, sharing the decoding of segments between the queries of a batch
+		*/
+		stats.batch_size = parameter_batch_size;
+		void (*batch_search)(JASS_anytime_thread_result &output, const JASS::deserialised_jass_v1 &index, std::vector<JASS_anytime_query> &query_list, size_t postings_to_process, size_t top_k, bool huge_pages, size_t batch_size, bool wide);
+		if (d_ness == 0)
+			batch_search = parameter_heapless ? anytime_batch<JASS::decoder_d0, JASS::query_top_k_scan> : anytime_batch<JASS::decoder_d0, JASS::query_top_k_heap>;
+		else
+			batch_search = parameter_heapless ? anytime_batch<JASS::decoder_d1, JASS::query_top_k_scan> : anytime_batch<JASS::decoder_d1, JASS::query_top_k_heap>;
+
+		if (parameter_threads == 1 && !numa)
+			batch_search(output[0], index, query_list, postings_to_process, parameter_top_k, parameter_huge_pages, parameter_batch_size, wide_batches);
+		else
+			{
+			for (size_t which = 0; which < parameter_threads ; which++)
+				thread_pool.push_back(JASS::thread(placement(which), batch_search, std::ref(output[which]), std::cref(*node_index[node_of(which)]), std::ref(query_list), postings_to_process, parameter_top_k, parameter_huge_pages, parameter_batch_size, wide_batches));
+			for (auto &thread : thread_pool)
+				thread.join();
+			}
+		}
+	else if (parameter_threads == 1 && !numa)
+		{
+		/*
+			We have only 1 thread (and it need not be pinned) so don't bother to start a thread to do the work
+		*/
+		search(output[0], index, query_list, postings_to_process, deadline, parameter_top_k, parameter_huge_pages, cache.get(), segment_cache.get(), parameter_pipeline, parameter_segment_timing, parameter_early_termination);
+		}
 	else
 		{
 		/*
 			Multiple threads, so start each worker
 		*/
 		for (size_t which = 0; which < parameter_threads ; which++)
-			switch (d_ness)
-				{
-				case 0:
-						thread_pool.push_back(JASS::thread(anytime<JASS::decoder_d0>, std::ref(output[which]), std::ref(index), std::ref(query_list), postings_to_process, parameter_top_k));
-					break;
-				default:
-						thread_pool.push_back(JASS::thread(anytime<JASS::decoder_d1>, std::ref(output[which]), std::ref(index), std::ref(query_list), postings_to_process, parameter_top_k));
-					break;
-				}
+			thread_pool.push_back(JASS::thread(placement(which), search, std::ref(output[which]), std::cref(*node_index[node_of(which)]), std::ref(query_list), postings_to_process, std::cref(deadline), parameter_top_k, parameter_huge_pages, cache.get(), segment_cache.get(), parameter_pipeline, parameter_segment_timing, parameter_early_termination));
 		/*
 			Wait until they're all done (blocking on the completion of each thread in turn)
 		*/
@@ -378,8 +1563,46 @@ std::cout << "Postings to process:" << postings_to_process << "\n";
 	/*
 		Compute the per-thread stats
 	*/
-	for (size_t which = 0; which < parameter_threads ; which++)
+	for (size_t which = 0; which < output.size() ; which++)
+		{
 		stats.sum_of_CPU_time_in_ns += output[which].search_time_in_ns;
+		stats.latencies.merge(output[which].latencies);
+		stats.segments_processed += output[which].segments_processed;
+		stats.segments_decoded += output[which].segments_decoded;
+		stats.decode_time_in_ns += output[which].decode_time_in_ns;
+		stats.process_time_in_ns += output[which].process_time_in_ns;
+		stats.postings_timed += output[which].postings_timed;
+		stats.postings_processed += output[which].postings_processed;
+		stats.postings_saved += output[which].postings_saved;
+		}
+
+	/*
+		Compute the per-node stats
+	*/
+	if (numa)
+		{
+		stats.queries_per_node.resize(numa_nodes.size());
+		for (size_t which = 0; which < output.size() ; which++)
+			stats.queries_per_node[node_of(which)] += output[which].queries_executed;
+		}
+	stats.set_cache(cache.get(), segment_cache.get());
+
+	/*
+		Dump the per-query statistics (in the order of the query file)
+	*/
+	if (parameter_csv_filename.size() != 0)
+		{
+		std::vector<JASS_anytime_query_record> records;
+		for (const auto &result : output)
+			records.insert(records.end(), result.query_records.begin(), result.query_records.end());
+		std::sort(records.begin(), records.end());
+
+		std::ostringstream csv;
+		csv << "query_id,terms_found,segments_processed,postings_processed,postings_saved,search_time_ns\n";
+		for (const auto &record : records)
+			csv << record.query_id << ',' << record.terms_found << ',' << record.segments_processed << ',' << record.postings_processed << ',' << record.postings_saved << ',' << record.search_time_in_ns << '\n';
+		JASS::file::write_entire_file(parameter_csv_filename, csv.str());
+		}
 
 	/*
 		Dump the answer
@@ -0,0 +1,208 @@
+/*
+	JASS_ANYTIME_BATCH.H
+	--------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief Batched multi-query Score-at-a-Time search for the Anytime engine, decoding each impact segment once per batch.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include "query.h"
+#include "compress_integer.h"
+#include "deserialised_jass_v1.h"
+
+/*
+	CLASS JASS_ANYTIME_BATCH
+	------------------------
+*/
+/*!
+	@brief A set of query objects that are resolved together, sharing the decoding of the impact segments they have in common.
+	@details Each query in the batch is parsed into its own query object, and the segments it will process (after the anytime stopping
+	rule has been applied) are added to the batch with add().  search() then sorts the union of the segments highest impact first (so
+	that, as with a single query, the top-k heaps fill early and low impact postings rarely change them), decodes each distinct segment
+	once, and adds it to the accumulators of every query that wants it.  Because the accumulators only ever increase, and the top-k heap
+	orders on rsv then document id, the order in which a query sees its segments does not change its results list, so each query gets
+	the same results it would have got if it had been searched on its own.
+	@tparam DECODER The decoder (decoder_d0 or decoder_d1) used to decode the postings.
+	@tparam ACCUMULATOR_TYPE The type of the accumulators.
+	@tparam MAX_DOCUMENTS The maximum number of documents (0 to size the accumulators at run time).
+	@tparam MAX_TOP_K The maximum top-k.
+	@tparam TOP_K_STRATEGY How the query objects find the top-k (JASS::query_top_k_heap or JASS::query_top_k_scan).
+*/
+template <typename DECODER, typename ACCUMULATOR_TYPE, size_t MAX_DOCUMENTS, size_t MAX_TOP_K, typename TOP_K_STRATEGY = JASS::query_top_k_heap>
+class JASS_anytime_batch
+	{
+	public:
+		typedef JASS::query<ACCUMULATOR_TYPE, MAX_DOCUMENTS, MAX_TOP_K, TOP_K_STRATEGY> query_type;		///< The type of the per-query query objects
+
+	private:
+		/*
+			CLASS JASS_ANYTIME_BATCH::WORK
+			------------------------------
+		*/
+		/*!
+			@brief A segment and the query in the batch that wants it.
+		*/
+		class work
+			{
+			public:
+				uint16_t impact;				///< The impact score of the segment
+				uint64_t segment;				///< The offset of the segment in the postings
+				size_t query;					///< The query (in the batch) that wants the segment
+
+			public:
+				/*
+					JASS_ANYTIME_BATCH::WORK::OPERATOR<()
+					-------------------------------------
+				*/
+				/*!
+					@brief Order highest impact first then on segment and query, so that the owners of a segment are adjacent.
+					@param other [in] The work to compare to.
+					@return true if this work comes first.
+				*/
+				bool operator<(const work &other) const
+					{
+					if (impact != other.impact)
+						return impact > other.impact;
+					else if (segment != other.segment)
+						return segment < other.segment;
+					else
+						return query < other.query;
+					}
+			};
+
+	private:
+		const JASS::deserialised_jass_v1 &index;										///< The index being searched
+		JASS::compress_integer &decompressor;											///< The codex used to decompress the postings
+		DECODER decoder;																		///< The decoder
+		std::vector<std::unique_ptr<query_type>> queries;							///< The query object of each query in the batch
+		std::vector<work> work_list;														///< The segments each query in the batch wants
+		size_t segments_decoded;															///< The number of segments decoded by search() (since construction)
+
+	public:
+		/*
+			JASS_ANYTIME_BATCH::JASS_ANYTIME_BATCH()
+			----------------------------------------
+		*/
+		/*!
+			@brief Constructor.  Allocates a query object (and its accumulators) for each query in the batch.
+			@param index [in] The index to search.
+			@param decompressor [in] The codex used to decompress the postings.
+			@param batch_size [in] The largest number of queries in a batch.
+			@param top_k [in] The number of results to return.
+			@param huge_pages [in] Ask for the accumulators to be in huge pages.
+		*/
+		JASS_anytime_batch(const JASS::deserialised_jass_v1 &index, JASS::compress_integer &decompressor, size_t batch_size, size_t top_k, bool huge_pages = false) :
+			index(index),
+			decompressor(decompressor),
+			decoder(index.document_count() + 4096),				// Some decoders write past the end of the output buffer (e.g. GroupVarInt) so we allocate enough space for the overflow
+			segments_decoded(0)
+			{
+			for (size_t which = 0; which < batch_size; which++)
+				queries.push_back(std::unique_ptr<query_type>(new query_type(index.primary_keys(), index.document_count(), top_k, huge_pages)));
+			}
+
+		/*
+			JASS_ANYTIME_BATCH::SIZE()
+			--------------------------
+		*/
+		/*!
+			@brief Return the largest number of queries in a batch.
+			@return The batch size.
+		*/
+		size_t size(void) const
+			{
+			return queries.size();
+			}
+
+		/*
+			JASS_ANYTIME_BATCH::OPERATOR[]()
+			--------------------------------
+		*/
+		/*!
+			@brief Return the query object of a query in the batch (to parse the query into before search(), and to get the results list from after it).
+			@param which [in] The query in the batch.
+			@return The query object.
+		*/
+		query_type &operator[](size_t which)
+			{
+			return *queries[which];
+			}
+
+		/*
+			JASS_ANYTIME_BATCH::ADD()
+			-------------------------
+		*/
+		/*!
+			@brief Add the segments a query in the batch should process.
+			@param which [in] The query in the batch.
+			@param segment_order [in] The segments (as offsets into the postings).
+			@param segments [in] The number of segments.
+		*/
+		void add(size_t which, const uint64_t *segment_order, size_t segments)
+			{
+			for (const uint64_t *current = segment_order; current < segment_order + segments; current++)
+				{
+				const JASS::deserialised_jass_v1::segment_header &header = *reinterpret_cast<const JASS::deserialised_jass_v1::segment_header *>(index.postings() + *current);
+				work_list.push_back(work{header.impact, *current, which});
+				}
+			}
+
+		/*
+			JASS_ANYTIME_BATCH::SEARCH()
+			----------------------------
+		*/
+		/*!
+			@brief Process the segments of the first queries_in_batch queries (decoding each distinct segment once) and compute the top-k of each.
+			@details The terms of the queries parsed into the query objects are invalid after this call.
+			@param queries_in_batch [in] The number of queries in this batch.
+		*/
+		void search(size_t queries_in_batch)
+			{
+			for (size_t which = 0; which < queries_in_batch; which++)
+				queries[which]->rewind();
+
+			std::sort(work_list.begin(), work_list.end());
+
+			for (auto current = work_list.begin(); current != work_list.end();)
+				{
+				const JASS::deserialised_jass_v1::segment_header &header = *reinterpret_cast<const JASS::deserialised_jass_v1::segment_header *>(index.postings() + current->segment);
+				decoder.decode(decompressor, header.segment_frequency, index.postings() + header.offset, header.end - header.offset);
+				segments_decoded++;
+
+				/*
+					Scatter into each query that wants this segment (the decoded segment is still in cache)
+				*/
+				uint64_t segment = current->segment;
+				for (; current != work_list.end() && current->segment == segment; ++current)
+					decoder.process(header.impact, *queries[current->query]);
+				}
+
+			for (size_t which = 0; which < queries_in_batch; which++)
+				queries[which]->sort();
+
+			work_list.clear();
+			}
+
+		/*
+			JASS_ANYTIME_BATCH::GET_SEGMENTS_DECODED()
+			------------------------------------------
+		*/
+		/*!
+			@brief Return the number of segments decoded (since construction).
+			@return The number of segments decoded.
+		*/
+		size_t get_segments_decoded(void) const
+			{
+			return segments_decoded;
+			}
+	};
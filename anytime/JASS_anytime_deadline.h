@@ -0,0 +1,239 @@
+/*
+	JASS_ANYTIME_DEADLINE.H
+	-----------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief A wall-clock deadline stopping rule for the anytime search engine, and the cost model it uses.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <math.h>
+
+#include <iostream>
+
+#include "deserialised_jass_v1.h"
+
+/*
+	CLASS JASS_ANYTIME_DEADLINE
+	---------------------------
+*/
+/*!
+	@brief A per-query time budget for anytime search.
+	@details The segments of a query are processed in order until the predicted cost of decoding and processing the next segment
+	would take the search past the deadline.  The cost of a segment is predicted using a linear model of its segment frequency (number
+	of postings) and its compressed length (in bytes): cost = fixed + per_posting * postings + per_byte * bytes.  The model is fitted
+	(using least squares) to timings of a sample of segments from the index, made at startup (see add_observation() and fit()).
+*/
+class JASS_anytime_deadline
+	{
+	private:
+		size_t deadline_in_ns;					///< The time budget of each query (0 means no deadline)
+
+		double fixed_ns;							///< The cost of processing a segment regardless of its size
+		double per_posting_ns;					///< The cost of each posting in a segment
+		double per_byte_ns;						///< The cost of each byte of compressed postings in a segment
+
+		/*
+			The sums needed to solve the least squares normal equations.
+		*/
+		double observations;						///< The number of observations
+		double sum_p;								///< Sum of postings
+		double sum_b;								///< Sum of bytes
+		double sum_pp;								///< Sum of postings * postings
+		double sum_pb;								///< Sum of postings * bytes
+		double sum_bb;								///< Sum of bytes * bytes
+		double sum_t;								///< Sum of times
+		double sum_pt;								///< Sum of postings * times
+		double sum_bt;								///< Sum of bytes * times
+
+	private:
+		/*
+			JASS_ANYTIME_DEADLINE::DETERMINANT()
+			------------------------------------
+		*/
+		/*!
+			@brief Compute the determinant of a 3x3 matrix given by rows.
+			@return The determinant.
+		*/
+		static double determinant(double a, double b, double c, double d, double e, double f, double g, double h, double i)
+			{
+			return a * (e * i - f * h) - b * (d * i - f * g) + c * (d * h - e * g);
+			}
+
+	public:
+		/*
+			JASS_ANYTIME_DEADLINE::JASS_ANYTIME_DEADLINE()
+			----------------------------------------------
+		*/
+		/*!
+			@brief Constructor
+			@param deadline_in_ns [in] The time budget of each query in nanoseconds (0 means no deadline).
+		*/
+		explicit JASS_anytime_deadline(size_t deadline_in_ns = 0) :
+			deadline_in_ns(deadline_in_ns),
+			fixed_ns(0),
+			per_posting_ns(0),
+			per_byte_ns(0),
+			observations(0),
+			sum_p(0),
+			sum_b(0),
+			sum_pp(0),
+			sum_pb(0),
+			sum_bb(0),
+			sum_t(0),
+			sum_pt(0),
+			sum_bt(0)
+			{
+			/* Nothing */
+			}
+
+		/*
+			JASS_ANYTIME_DEADLINE::ENABLED()
+			--------------------------------
+		*/
+		/*!
+			@brief Is there a deadline?
+			@return true if there is a deadline, else false.
+		*/
+		bool enabled(void) const
+			{
+			return deadline_in_ns != 0;
+			}
+
+		/*
+			JASS_ANYTIME_DEADLINE::ADD_OBSERVATION()
+			----------------------------------------
+		*/
+		/*!
+			@brief Add the measured cost of a segment to the calibration data.
+			@param postings [in] The segment frequency of the segment.
+			@param bytes [in] The compressed length of the segment.
+			@param nanoseconds [in] The time it took to decode and process the segment.
+		*/
+		void add_observation(size_t postings, size_t bytes, size_t nanoseconds)
+			{
+			double p = static_cast<double>(postings);
+			double b = static_cast<double>(bytes);
+			double t = static_cast<double>(nanoseconds);
+
+			observations++;
+			sum_p += p;
+			sum_b += b;
+			sum_pp += p * p;
+			sum_pb += p * b;
+			sum_bb += b * b;
+			sum_t += t;
+			sum_pt += p * t;
+			sum_bt += b * t;
+			}
+
+		/*
+			JASS_ANYTIME_DEADLINE::FIT()
+			----------------------------
+		*/
+		/*!
+			@brief Fit the cost model to the observations.
+			@details If the least squares solution is degenerate or has a negative coefficient (which happens when the compressed length
+			is near-proportional to the number of postings) then the compressed length is dropped from the model, and if that also fails
+			then the cost is modelled as proportional to the number of postings.
+		*/
+		void fit(void)
+			{
+			if (observations == 0)
+				return;
+
+			double det = determinant(observations, sum_p, sum_b, sum_p, sum_pp, sum_pb, sum_b, sum_pb, sum_bb);
+			if (fabs(det) > 1e-9)
+				{
+				fixed_ns = determinant(sum_t, sum_p, sum_b, sum_pt, sum_pp, sum_pb, sum_bt, sum_pb, sum_bb) / det;
+				per_posting_ns = determinant(observations, sum_t, sum_b, sum_p, sum_pt, sum_pb, sum_b, sum_bt, sum_bb) / det;
+				per_byte_ns = determinant(observations, sum_p, sum_t, sum_p, sum_pp, sum_pt, sum_b, sum_pb, sum_bt) / det;
+				}
+
+			if (fabs(det) <= 1e-9 || fixed_ns < 0 || per_posting_ns < 0 || per_byte_ns < 0)
+				{
+				/*
+					cost = fixed + per_posting * postings
+				*/
+				per_byte_ns = 0;
+				det = observations * sum_pp - sum_p * sum_p;
+				if (fabs(det) > 1e-9)
+					{
+					per_posting_ns = (observations * sum_pt - sum_p * sum_t) / det;
+					fixed_ns = (sum_t - per_posting_ns * sum_p) / observations;
+					}
+
+				if (fabs(det) <= 1e-9 || fixed_ns < 0 || per_posting_ns < 0)
+					{
+					/*
+						cost = per_posting * postings
+					*/
+					fixed_ns = 0;
+					per_posting_ns = sum_p == 0 ? 0 : sum_t / sum_p;
+					}
+				}
+			}
+
+		/*
+			JASS_ANYTIME_DEADLINE::PREDICT()
+			--------------------------------
+		*/
+		/*!
+			@brief Predict the time it will take to decode and process a segment.
+			@param header [in] The segment.
+			@return The predicted cost in nanoseconds.
+		*/
+		double predict(const JASS::deserialised_jass_v1::segment_header &header) const
+			{
+			return fixed_ns + per_posting_ns * header.segment_frequency + per_byte_ns * (header.end - header.offset);
+			}
+
+		/*
+			JASS_ANYTIME_DEADLINE::EXCEEDED()
+			---------------------------------
+		*/
+		/*!
+			@brief Would processing the next segment take the query past its deadline?
+			@param elapsed_in_ns [in] The time spent on the query so far.
+			@param header [in] The next segment.
+			@return true if the segment should not be processed, else false.
+		*/
+		bool exceeded(size_t elapsed_in_ns, const JASS::deserialised_jass_v1::segment_header &header) const
+			{
+			return static_cast<double>(elapsed_in_ns) + predict(header) > static_cast<double>(deadline_in_ns);
+			}
+
+		/*
+			JASS_ANYTIME_DEADLINE::TEXT_RENDER()
+			------------------------------------
+		*/
+		/*!
+			@brief Dump a human readable version of the cost model down an output stream.
+			@param stream [in] The stream to write to.
+		*/
+		void text_render(std::ostream &stream) const
+			{
+			stream << "Deadline:" << deadline_in_ns << " ns (cost per segment:" << fixed_ns << " ns + " << per_posting_ns << " ns per posting + " << per_byte_ns << " ns per byte from " << observations << " segments)";
+			}
+	};
+
+/*
+	OPERATOR<<()
+	------------
+*/
+/*!
+	@brief Dump a human readable version of the data down an output stream.
+	@param stream [in] The stream to write to.
+	@param data [in] The data to write.
+	@return The stream once the data has been written.
+*/
+inline std::ostream &operator<<(std::ostream &stream, const JASS_anytime_deadline &data)
+	{
+	data.text_render(stream);
+	return stream;
+	}
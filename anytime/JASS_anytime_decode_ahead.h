@@ -0,0 +1,241 @@
+/*
+	JASS_ANYTIME_DECODE_AHEAD.H
+	---------------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief A helper thread that decodes the next impact segment while the search thread processes the current one.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <condition_variable>
+
+#include "threads.h"
+#include "compress_integer.h"
+#include "deserialised_jass_v1.h"
+
+/*
+	CLASS JASS_ANYTIME_DECODE_AHEAD
+	-------------------------------
+*/
+/*!
+	@brief A persistent helper thread with two decoders (slots) that decodes segments on request, so that decoding segment i + 1
+	overlaps with the processing of segment i.
+	@details The search thread asks for a segment to be decoded into a slot with request(), collects the decoded segment with wait(), and
+	hands the slot back with release() once it has processed it.  The slots are used alternately.  The threads hand over through an
+	atomic state per slot and spin (yielding) while they wait, so this only helps when there is a spare core for the helper.  The helper
+	only spins for the short waits within a query; if no segment is requested for a while (between queries, or when the searcher is idle)
+	it parks on a condition variable until the next request() wakes it.
+	@tparam DECODER The decoder (decoder_d0 or decoder_d1) used to decode the postings.
+*/
+template <typename DECODER>
+class JASS_anytime_decode_ahead
+	{
+	private:
+		static constexpr size_t slots = 2;				///< The number of segments that can be in flight (the one being processed and the one being decoded)
+		static constexpr size_t spins_before_parking = 256;		///< The number of times the helper yields waiting for a request before it parks
+
+		/*
+			The state of a slot
+		*/
+		static constexpr uint32_t idle = 0;				///< The slot is not in use
+		static constexpr uint32_t requested = 1;		///< The search thread has asked for a segment to be decoded into the slot
+		static constexpr uint32_t ready = 2;			///< The helper has decoded the segment
+		static constexpr uint32_t stop = 3;				///< The helper should stop
+
+		/*
+			CLASS JASS_ANYTIME_DECODE_AHEAD::SLOT
+			-------------------------------------
+		*/
+		/*!
+			@brief A decoder and the segment it is to decode.
+		*/
+		class slot
+			{
+			public:
+				std::unique_ptr<DECODER> decoder;														///< The decoder
+				const JASS::deserialised_jass_v1::segment_header *header;						///< The segment to decode
+				std::atomic<uint32_t> state;															///< Where the slot is in the hand-over
+			};
+
+	private:
+		const JASS::deserialised_jass_v1 &index;			///< The index being searched
+		JASS::compress_integer &decompressor;				///< The codex used to decompress the postings
+		slot slot_list[slots];									///< The slots
+		size_t next_request;										///< The slot to use for the next request (the helper decodes the slots in the same order)
+		std::mutex lock;											///< Held by the helper while it parks, and by a thread waking it
+		std::condition_variable wake;							///< Signalled when a segment is requested (or the helper should stop) while the helper is parked
+		std::atomic<bool> parked;								///< Is the helper parked (or about to park)?
+		std::unique_ptr<JASS::thread> helper;				///< The helper thread
+
+	private:
+		/*
+			JASS_ANYTIME_DECODE_AHEAD::PARK()
+			---------------------------------
+		*/
+		/*!
+			@brief Block the helper until a segment is requested into the given slot (or the helper should stop).
+			@details parked and the slot state are both sequentially consistent so that either request() sees that the helper is parked
+			(and wakes it), or the helper sees the request before it waits.
+			@param current [in] The slot the helper is waiting on.
+		*/
+		void park(slot &current)
+			{
+			std::unique_lock<std::mutex> guard(lock);
+			parked = true;
+			wake.wait(guard, [&current]()
+				{
+				uint32_t state = current.state.load();
+				return state == requested || state == stop;
+				});
+			parked = false;
+			}
+
+		/*
+			JASS_ANYTIME_DECODE_AHEAD::UNPARK()
+			-----------------------------------
+		*/
+		/*!
+			@brief Wake the helper if it is parked (call this after changing the state of a slot).
+		*/
+		void unpark(void)
+			{
+			if (parked)
+				{
+				std::lock_guard<std::mutex> guard(lock);
+				wake.notify_one();
+				}
+			}
+
+		/*
+			JASS_ANYTIME_DECODE_AHEAD::WORK()
+			---------------------------------
+		*/
+		/*!
+			@brief The main loop of the helper thread - decode each slot in turn as it is requested.
+			@param ahead [in] The object that owns the helper.
+		*/
+		static void work(JASS_anytime_decode_ahead &ahead)
+			{
+			for (size_t which = 0; true; which = (which + 1) % slots)
+				{
+				slot &current = ahead.slot_list[which];
+				uint32_t state;
+				for (size_t spins = 0; (state = current.state.load(std::memory_order_acquire)) != requested; spins++)
+					if (state == stop)
+						return;
+					else if (spins < spins_before_parking)
+						std::this_thread::yield();
+					else
+						{
+						ahead.park(current);
+						spins = 0;
+						}
+
+				const JASS::deserialised_jass_v1::segment_header &header = *current.header;
+				current.decoder->decode(ahead.decompressor, header.segment_frequency, ahead.index.postings() + header.offset, header.end - header.offset);
+				current.state.store(ready, std::memory_order_release);
+				}
+			}
+
+	public:
+		/*
+			JASS_ANYTIME_DECODE_AHEAD::JASS_ANYTIME_DECODE_AHEAD()
+			------------------------------------------------------
+		*/
+		/*!
+			@brief Constructor.  Allocates the decoders and starts the helper thread.
+			@param index [in] The index to search.
+			@param decompressor [in] The codex used to decompress the postings.
+		*/
+		JASS_anytime_decode_ahead(const JASS::deserialised_jass_v1 &index, JASS::compress_integer &decompressor) :
+			index(index),
+			decompressor(decompressor),
+			next_request(0),
+			parked(false)
+			{
+			for (auto &current : slot_list)
+				{
+				current.decoder.reset(new DECODER(index.document_count() + 4096));			// Some decoders write past the end of the output buffer (e.g. GroupVarInt)
+				current.header = nullptr;
+				current.state = idle;
+				}
+
+			helper.reset(new JASS::thread(work, std::ref(*this)));
+			}
+
+		/*
+			JASS_ANYTIME_DECODE_AHEAD::~JASS_ANYTIME_DECODE_AHEAD()
+			-------------------------------------------------------
+		*/
+		/*!
+			@brief Destructor.  Stop the helper thread (every requested slot must have been waited for before this is called).
+		*/
+		~JASS_anytime_decode_ahead()
+			{
+			for (auto &current : slot_list)
+				current.state.store(stop);
+			unpark();
+			helper->join();
+			}
+
+		/*
+			JASS_ANYTIME_DECODE_AHEAD::REQUEST()
+			------------------------------------
+		*/
+		/*!
+			@brief Ask the helper to decode a segment (at most two segments can be requested and not yet released).
+			@param header [in] The segment to decode.
+			@return The slot the segment will be decoded into.
+		*/
+		size_t request(const JASS::deserialised_jass_v1::segment_header &header)
+			{
+			size_t which = next_request;
+			next_request = (next_request + 1) % slots;
+
+			slot &current = slot_list[which];
+			current.header = &header;
+			current.state.store(requested);
+			unpark();
+			return which;
+			}
+
+		/*
+			JASS_ANYTIME_DECODE_AHEAD::WAIT()
+			---------------------------------
+		*/
+		/*!
+			@brief Wait for the helper to finish decoding the segment in a slot.
+			@param which [in] The slot (which must have been requested).
+			@return The decoder holding the decoded segment (valid until release()).
+		*/
+		const DECODER &wait(size_t which)
+			{
+			slot &current = slot_list[which];
+			while (current.state.load(std::memory_order_acquire) != ready)
+				std::this_thread::yield();
+
+			return *current.decoder;
+			}
+
+		/*
+			JASS_ANYTIME_DECODE_AHEAD::RELEASE()
+			------------------------------------
+		*/
+		/*!
+			@brief Hand a slot back once the segment in it has been processed.
+			@param which [in] The slot.
+		*/
+		void release(size_t which)
+			{
+			slot_list[which].state.store(idle, std::memory_order_release);
+			}
+	};
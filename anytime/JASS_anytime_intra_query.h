@@ -0,0 +1,460 @@
+/*
+	JASS_ANYTIME_INTRA_QUERY.H
+	--------------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief Intra-query parallel Score-at-a-Time search for the Anytime engine.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include "query.h"
+#include "barrier.h"
+#include "threads.h"
+#include "compress_integer.h"
+#include "deserialised_jass_v1.h"
+
+/*
+	CLASS JASS_ANYTIME_INTRA_QUERY
+	------------------------------
+*/
+/*!
+	@brief A team of threads that co-operate to resolve a single query.
+	@details The document-id space is partitioned into as many contiguous ranges as there are threads, and each thread owns the
+	accumulators and the top-k heap of its range.  Each query is resolved in two phases.  In the first phase the threads grab
+	impact segments (in impact order) and decode them into a shared buffer of document ids.  In the second phase each thread walks
+	all of the decoded segments in impact order, but only adds to the accumulators of the documents in its own range (which it finds
+	by binary search as each segment is in increasing document id order).  Finally the per-partition top-k lists are merged.
+
+	As each partition sees its postings in the same order as a single-threaded search would, and because the partitions are contiguous
+	ranges of document ids, the final results list is identical to that of the single-threaded search (including tie breaks).
+
+	The thread that constructs this object becomes the first member of the team and the remaining threads are persistent (they are
+	started by the constructor and stopped by the destructor) so there is no thread start-up cost on each query.
+	@tparam DECODER The decoder (decoder_d0 or decoder_d1) used to decode the postings.
+	@tparam ACCUMULATOR_TYPE The type of the accumulators.
+	@tparam MAX_DOCUMENTS The maximum number of documents in a partition (0 to size the accumulators of each partition at run time).
+	@tparam MAX_TOP_K The maximum top-k.
+*/
+template <typename DECODER, typename ACCUMULATOR_TYPE, size_t MAX_DOCUMENTS, size_t MAX_TOP_K>
+class JASS_anytime_intra_query
+	{
+	public:
+		typedef JASS::query<ACCUMULATOR_TYPE, MAX_DOCUMENTS, MAX_TOP_K> query_type;		///< The type of the per-partition query objects
+
+	private:
+		/*
+			CLASS JASS_ANYTIME_INTRA_QUERY::GATHER
+			--------------------------------------
+		*/
+		/*!
+			@brief Passed to DECODER::process() in place of a query object, this copies the document ids into a buffer.
+		*/
+		class gather
+			{
+			public:
+				uint32_t *into;				///< Where to put the next document id
+
+			public:
+				/*
+					JASS_ANYTIME_INTRA_QUERY::GATHER::GATHER()
+					------------------------------------------
+				*/
+				/*!
+					@brief Constructor
+					@param into [in] Where to put the first document id.
+				*/
+				explicit gather(uint32_t *into) :
+					into(into)
+					{
+					/* Nothing */
+					}
+
+				/*
+					JASS_ANYTIME_INTRA_QUERY::GATHER::ADD_RSV()
+					-------------------------------------------
+				*/
+				/*!
+					@brief Store the document id (and ignore the score)
+					@param document_id [in] The document id.
+					@param score [in] Ignored.
+				*/
+				forceinline void add_rsv(size_t document_id, ACCUMULATOR_TYPE score)
+					{
+					*into++ = static_cast<uint32_t>(document_id);
+					}
+			};
+
+	public:
+		/*
+			CLASS JASS_ANYTIME_INTRA_QUERY::ITERATOR
+			----------------------------------------
+		*/
+		/*!
+			@brief Iterate over the merged top-k
+		*/
+		class iterator
+			{
+			public:
+				/*
+					CLASS JASS_ANYTIME_INTRA_QUERY::ITERATOR::DOCID_RSV_PAIR
+					--------------------------------------------------------
+				*/
+				/*!
+					@brief Literally a <document_id, rsv> ordered pair.
+				*/
+				class docid_rsv_pair
+					{
+					public:
+						size_t document_id;							///< The document identifier
+						const std::string &primary_key;			///< The external identifier of the document (the primary key)
+						ACCUMULATOR_TYPE rsv;						///< The rsv (Retrieval Status Value) relevance score
+
+					public:
+						/*
+							JASS_ANYTIME_INTRA_QUERY::ITERATOR::DOCID_RSV_PAIR::DOCID_RSV_PAIR()
+							--------------------------------------------------------------------
+						*/
+						/*!
+							@brief Constructor.
+							@param document_id [in] The document Identifier.
+							@param key [in] The external identifier of the document (the primary key).
+							@param rsv [in] The rsv (Retrieval Status Value) relevance score.
+						*/
+						docid_rsv_pair(size_t document_id, const std::string &key, ACCUMULATOR_TYPE rsv) :
+							document_id(document_id),
+							primary_key(key),
+							rsv(rsv)
+							{
+							/* Nothing */
+							}
+					};
+
+			private:
+				const JASS_anytime_intra_query &parent;			///< The object being iterated over
+				size_t where;												///< Where in the results list we are
+
+			public:
+				/*
+					JASS_ANYTIME_INTRA_QUERY::ITERATOR::ITERATOR()
+					----------------------------------------------
+				*/
+				/*!
+					@brief Constructor
+					@param parent [in] The object we are iterating over
+					@param where [in] Where in the results list this iterator starts
+				*/
+				iterator(const JASS_anytime_intra_query &parent, size_t where) :
+					parent(parent),
+					where(where)
+					{
+					/* Nothing */
+					}
+
+				/*
+					JASS_ANYTIME_INTRA_QUERY::ITERATOR::OPERATOR!=()
+					------------------------------------------------
+				*/
+				/*!
+					@brief Compare two iterator objects for non-equality.
+					@param with [in] The iterator object to compare to.
+					@return true if they differ, else false.
+				*/
+				bool operator!=(const iterator &with) const
+					{
+					return with.where != where;
+					}
+
+				/*
+					JASS_ANYTIME_INTRA_QUERY::ITERATOR::OPERATOR++()
+					------------------------------------------------
+				*/
+				/*!
+					@brief Increment this iterator.
+				*/
+				iterator &operator++(void)
+					{
+					where++;
+					return *this;
+					}
+
+				/*
+					JASS_ANYTIME_INTRA_QUERY::ITERATOR::OPERATOR*()
+					-----------------------------------------------
+				*/
+				/*!
+					@brief Return the <document_id,rsv> pair at the current location.
+					@return The current object.
+				*/
+				docid_rsv_pair operator*() const
+					{
+					const auto &answer = parent.results[where];
+					return docid_rsv_pair(answer.first, parent.primary_keys[answer.first], answer.second);
+					}
+			};
+
+	private:
+		const JASS::deserialised_jass_v1 &index;										///< The index being searched
+		const std::vector<std::string> &primary_keys;								///< The primary keys of the documents in the index
+		JASS::compress_integer &decompressor;											///< The codex used to decompress the postings
+		size_t top_k;																			///< The number of results to return
+		size_t partitions;																	///< The number of partitions of the document-id space (and the number of threads)
+		std::vector<size_t> partition_start;											///< Partition p holds the documents [partition_start[p], partition_start[p + 1])
+		std::vector<std::unique_ptr<DECODER>> decoders;								///< A decoder for each thread
+		std::vector<std::unique_ptr<query_type>> accumulators;					///< The accumulators and top-k heap of each partition
+		std::vector<JASS::thread> team;													///< The threads (other than the caller) in the team
+		JASS::barrier gate;																	///< The threads meet here between phases
+		bool finished;																			///< Set when the team should stop (read after the barrier)
+
+		const uint64_t *segment_order;													///< The segments to process (in impact order)
+		size_t segments;																		///< The number of segments to process
+		std::atomic<size_t> next_segment;												///< The next segment to decode (during the decode phase)
+		std::vector<size_t> segment_start;												///< The decoded segment s is in document_ids[segment_start[s], segment_start[s + 1])
+		std::vector<uint32_t> document_ids;												///< The decoded segments
+		std::vector<std::pair<size_t, ACCUMULATOR_TYPE>> results;				///< The merged top-k <document_id, rsv> pairs
+
+	private:
+		/*
+			JASS_ANYTIME_INTRA_QUERY::HEADER()
+			----------------------------------
+		*/
+		/*!
+			@brief Return the header of the given segment.
+			@param segment [in] The index (into segment_order) of the segment.
+			@return A reference to the segment header.
+		*/
+		const JASS::deserialised_jass_v1::segment_header &header(size_t segment) const
+			{
+			return *reinterpret_cast<const JASS::deserialised_jass_v1::segment_header *>(index.postings() + segment_order[segment]);
+			}
+
+		/*
+			JASS_ANYTIME_INTRA_QUERY::DECODE()
+			----------------------------------
+		*/
+		/*!
+			@brief The decode phase - grab segments from the shared list and decode them into the shared buffer.
+			@param member [in] Which member of the team this is.
+		*/
+		void decode(size_t member)
+			{
+			DECODER &decoder = *decoders[member];
+
+			for (size_t segment = next_segment++; segment < segments; segment = next_segment++)
+				{
+				const auto &details = header(segment);
+				gather into(&document_ids[segment_start[segment]]);
+
+				decoder.decode(decompressor, details.segment_frequency, index.postings() + details.offset, details.end - details.offset);
+				decoder.process(details.impact, into);
+				}
+			}
+
+		/*
+			JASS_ANYTIME_INTRA_QUERY::ACCUMULATE()
+			--------------------------------------
+		*/
+		/*!
+			@brief The accumulate phase - add each decoded segment that falls in this partition to the partition's accumulators.
+			@param member [in] Which member of the team this is (and so which partition).
+		*/
+		void accumulate(size_t member)
+			{
+			query_type &partition = *accumulators[member];
+			uint32_t low = static_cast<uint32_t>(partition_start[member]);
+			uint32_t high = static_cast<uint32_t>(partition_start[member + 1]);
+
+			partition.rewind();
+			for (size_t segment = 0; segment < segments; segment++)
+				{
+				ACCUMULATOR_TYPE impact = header(segment).impact;
+				const uint32_t *start = document_ids.data() + segment_start[segment];
+				const uint32_t *end = document_ids.data() + segment_start[segment + 1];
+				const uint32_t *current = std::lower_bound(start, end, low);
+
+				for (; current < end && *current < high; current++)
+					partition.add_rsv(*current - low, impact);
+				}
+			}
+
+		/*
+			JASS_ANYTIME_INTRA_QUERY::WORK()
+			--------------------------------
+		*/
+		/*!
+			@brief The main loop of the team members other than the first.
+			@param team [in] The team.
+			@param member [in] Which member of the team this is.
+		*/
+		static void work(JASS_anytime_intra_query &team, size_t member)
+			{
+			while (true)
+				{
+				team.gate.wait();
+				if (team.finished)
+					return;
+				team.decode(member);
+				team.gate.wait();
+				team.accumulate(member);
+				team.gate.wait();
+				}
+			}
+
+	public:
+		/*
+			JASS_ANYTIME_INTRA_QUERY::JASS_ANYTIME_INTRA_QUERY()
+			----------------------------------------------------
+		*/
+		/*!
+			@brief Constructor.  Allocates the per-partition accumulators and starts the team.
+			@details Can throw std::bad_array_new_length if a partition is larger than MAX_DOCUMENTS (when it is not 0).
+			@param index [in] The index to search.
+			@param decompressor [in] The codex used to decompress the postings.
+			@param threads [in] The number of threads in the team (including the caller).
+			@param top_k [in] The number of results to return.
+			@param huge_pages [in] Ask for the accumulators to be in huge pages.
+		*/
+		JASS_anytime_intra_query(const JASS::deserialised_jass_v1 &index, JASS::compress_integer &decompressor, size_t threads, size_t top_k, bool huge_pages = false) :
+			index(index),
+			primary_keys(index.primary_keys()),
+			decompressor(decompressor),
+			top_k(top_k),
+			partitions((std::max)(static_cast<size_t>(1), (std::min)(threads, static_cast<size_t>(index.document_count())))),
+			gate(partitions),
+			finished(false),
+			segment_order(nullptr),
+			segments(0),
+			next_segment(0)
+			{
+			for (size_t partition = 0; partition <= partitions; partition++)
+				partition_start.push_back(index.document_count() * partition / partitions);
+
+			for (size_t partition = 0; partition < partitions; partition++)
+				{
+				decoders.push_back(std::unique_ptr<DECODER>(new DECODER(index.document_count() + 4096)));			// Some decoders write past the end of the output buffer (e.g. GroupVarInt)
+				accumulators.push_back(std::unique_ptr<query_type>(new query_type(primary_keys, partition_start[partition + 1] - partition_start[partition], top_k, huge_pages)));
+				}
+
+			for (size_t member = 1; member < partitions; member++)
+				team.push_back(JASS::thread(work, std::ref(*this), member));
+			}
+
+		/*
+			JASS_ANYTIME_INTRA_QUERY::~JASS_ANYTIME_INTRA_QUERY()
+			-----------------------------------------------------
+		*/
+		/*!
+			@brief Destructor.  Stop the team.
+		*/
+		~JASS_anytime_intra_query()
+			{
+			finished = true;
+			gate.wait();
+			for (auto &member : team)
+				member.join();
+			}
+
+		/*
+			JASS_ANYTIME_INTRA_QUERY::PARSER()
+			----------------------------------
+		*/
+		/*!
+			@brief Return a query object that can be used to parse the query (it is re-used as the accumulators of the first partition).
+			@return A query object.
+		*/
+		query_type &parser(void)
+			{
+			return *accumulators[0];
+			}
+
+		/*
+			JASS_ANYTIME_INTRA_QUERY::SEARCH()
+			----------------------------------
+		*/
+		/*!
+			@brief Process the given segments and compute the top-k.
+			@details The terms of the query parsed with parser() are invalid after this call.
+			@param segment_order [in] The segments to process, in the order they should be processed.
+			@param segments [in] The number of segments to process.
+		*/
+		void search(const uint64_t *segment_order, size_t segments)
+			{
+			/*
+				Work out where in the shared buffer each segment goes
+			*/
+			this->segment_order = segment_order;
+			this->segments = segments;
+			segment_start.resize(segments + 1);
+			segment_start[0] = 0;
+			for (size_t segment = 0; segment < segments; segment++)
+				segment_start[segment + 1] = segment_start[segment] + header(segment).segment_frequency;
+			if (document_ids.size() < segment_start[segments] + 1)
+				document_ids.resize(segment_start[segments] + 1);
+			next_segment = 0;
+
+			/*
+				Decode then accumulate (the caller does its share of the work)
+			*/
+			gate.wait();
+			decode(0);
+			gate.wait();
+			accumulate(0);
+			gate.wait();
+
+			/*
+				Merge the per-partition top-k lists, ordering on rsv then document id (as JASS::query does)
+			*/
+			results.clear();
+			for (size_t partition = 0; partition < partitions; partition++)
+				for (const auto &answer : *accumulators[partition])
+					results.push_back(std::make_pair(partition_start[partition] + answer.document_id, answer.rsv));
+
+			size_t returned = (std::min)(results.size(), top_k);
+			std::partial_sort
+				(
+				results.begin(),
+				results.begin() + returned,
+				results.end(),
+				[](const std::pair<size_t, ACCUMULATOR_TYPE> &first, const std::pair<size_t, ACCUMULATOR_TYPE> &second)
+					{
+					return first.second > second.second || (first.second == second.second && first.first > second.first);
+					}
+				);
+			results.resize(returned);
+			}
+
+		/*
+			JASS_ANYTIME_INTRA_QUERY::BEGIN()
+			---------------------------------
+		*/
+		/*!
+			@brief Return an iterator pointing to start of the top-k
+			@return Iterator pointing to start of the top-k
+		*/
+		iterator begin(void) const
+			{
+			return iterator(*this, 0);
+			}
+
+		/*
+			JASS_ANYTIME_INTRA_QUERY::END()
+			-------------------------------
+		*/
+		/*!
+			@brief Return an iterator pointing to end of the top-k
+			@return Iterator pointing to the end of the top-k
+		*/
+		iterator end(void) const
+			{
+			return iterator(*this, results.size());
+			}
+	};
@@ -0,0 +1,184 @@
+/*
+	JASS_ANYTIME_LATENCY_HISTOGRAM.H
+	--------------------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief A histogram of query latencies from which percentiles can be read.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#include <array>
+#include <algorithm>
+
+#include "maths.h"
+
+/*
+	CLASS JASS_ANYTIME_LATENCY_HISTOGRAM
+	------------------------------------
+*/
+/*!
+	@brief A log-linear (HDR-style) histogram of latencies (in nanoseconds).
+	@details Values below sub_buckets are counted exactly.  Above that, each power of 2 is divided into sub_buckets / 2 equal sized
+	buckets, so any value is recorded with a relative error of less than 2 / sub_buckets (under 2%) no matter how large it is, in a
+	fixed amount of memory.  Histograms can be merged, so each thread keeps its own (without locking) and they are merged at the end.
+*/
+class JASS_anytime_latency_histogram
+	{
+	private:
+		static constexpr size_t sub_bucket_bits = 7;																			///< log2 of sub_buckets
+		static constexpr size_t sub_buckets = 1 << sub_bucket_bits;														///< Values less than this are recorded exactly
+		static constexpr size_t half_sub_buckets = sub_buckets / 2;														///< The number of buckets per power of 2 (above sub_buckets)
+		static constexpr size_t number_of_buckets = sub_buckets + (64 - sub_bucket_bits) * half_sub_buckets;	///< Enough buckets for any uint64_t
+
+	private:
+		std::array<uint64_t, number_of_buckets> counts;			///< The number of values seen in each bucket
+		uint64_t total;													///< The number of values seen
+		uint64_t largest;													///< The largest value seen
+
+	private:
+		/*
+			JASS_ANYTIME_LATENCY_HISTOGRAM::BUCKET()
+			----------------------------------------
+		*/
+		/*!
+			@brief Return the bucket that a value falls into.
+			@param value [in] The value.
+			@return The index of the bucket.
+		*/
+		static size_t bucket(uint64_t value)
+			{
+			if (value < sub_buckets)
+				return static_cast<size_t>(value);
+
+			size_t shift = JASS::maths::floor_log2(value) - sub_bucket_bits + 1;
+			return sub_buckets + (shift - 1) * half_sub_buckets + static_cast<size_t>((value >> shift) - half_sub_buckets);
+			}
+
+		/*
+			JASS_ANYTIME_LATENCY_HISTOGRAM::HIGHEST_VALUE()
+			-----------------------------------------------
+		*/
+		/*!
+			@brief Return the largest value that falls into the given bucket.
+			@param index [in] The bucket.
+			@return The largest value that falls into the bucket.
+		*/
+		static uint64_t highest_value(size_t index)
+			{
+			if (index < sub_buckets)
+				return index;
+
+			size_t shift = (index - sub_buckets) / half_sub_buckets + 1;
+			uint64_t sub_bucket = (index - sub_buckets) % half_sub_buckets + half_sub_buckets;
+			return ((sub_bucket + 1) << shift) - 1;
+			}
+
+	public:
+		/*
+			JASS_ANYTIME_LATENCY_HISTOGRAM::JASS_ANYTIME_LATENCY_HISTOGRAM()
+			----------------------------------------------------------------
+		*/
+		/*!
+			@brief Constructor
+		*/
+		JASS_anytime_latency_histogram() :
+			total(0),
+			largest(0)
+			{
+			counts.fill(0);
+			}
+
+		/*
+			JASS_ANYTIME_LATENCY_HISTOGRAM::ADD()
+			-------------------------------------
+		*/
+		/*!
+			@brief Record a value.
+			@param value [in] The value (in nanoseconds).
+		*/
+		void add(uint64_t value)
+			{
+			counts[bucket(value)]++;
+			total++;
+			largest = (std::max)(largest, value);
+			}
+
+		/*
+			JASS_ANYTIME_LATENCY_HISTOGRAM::MERGE()
+			---------------------------------------
+		*/
+		/*!
+			@brief Add the values recorded in another histogram to this one.
+			@param other [in] The histogram to merge into this one.
+		*/
+		void merge(const JASS_anytime_latency_histogram &other)
+			{
+			for (size_t which = 0; which < number_of_buckets; which++)
+				counts[which] += other.counts[which];
+			total += other.total;
+			largest = (std::max)(largest, other.largest);
+			}
+
+		/*
+			JASS_ANYTIME_LATENCY_HISTOGRAM::SIZE()
+			--------------------------------------
+		*/
+		/*!
+			@brief Return the number of values recorded.
+			@return The number of values recorded.
+		*/
+		uint64_t size(void) const
+			{
+			return total;
+			}
+
+		/*
+			JASS_ANYTIME_LATENCY_HISTOGRAM::MAXIMUM()
+			-----------------------------------------
+		*/
+		/*!
+			@brief Return the largest value recorded.
+			@return The largest value recorded (0 if there are none).
+		*/
+		uint64_t maximum(void) const
+			{
+			return largest;
+			}
+
+		/*
+			JASS_ANYTIME_LATENCY_HISTOGRAM::PERCENTILE()
+			--------------------------------------------
+		*/
+		/*!
+			@brief Return the value at the given percentile (the smallest value that at least percent of the recorded values are no larger than).
+			@details The answer is the top of the bucket the percentile falls in, so it may over-state the value by the precision of the histogram.
+			@param percent [in] The percentile (e.g. 99.9).
+			@return The value at the percentile (0 if no values have been recorded).
+		*/
+		uint64_t percentile(double percent) const
+			{
+			if (total == 0)
+				return 0;
+
+			uint64_t wanted = static_cast<uint64_t>(ceil(percent / 100.0 * total));
+			wanted = (std::max)(wanted, static_cast<uint64_t>(1));
+
+			uint64_t seen = 0;
+			for (size_t which = 0; which < number_of_buckets; which++)
+				{
+				seen += counts[which];
+				if (seen >= wanted)
+					return (std::min)(highest_value(which), largest);
+				}
+
+			return largest;
+			}
+	};
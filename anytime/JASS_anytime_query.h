@@ -15,6 +15,8 @@
 #include <stdint.h>
 
 #include <atomic>
+#include <string>
+#include <vector>
 
 /*
 	CLASS JASS_ANYTIME_QUERY
@@ -22,12 +24,43 @@
 */
 /*!
 	@brief A query within the anytime parallel search system.
+	@details The query-id is split off the query when the query is loaded, so that the search threads can search the (preloaded)
+	query in place rather than copying it.
 */
 class JASS_anytime_query
 	{
 	public:
 		std::atomic<uint8_t> taken;				///< Has this query been "taken" by a thread and processed
-		std::string query;							///< The query.
+		std::string query_id;						///< The query-id.
+		std::string query;							///< The query (without the query-id).
+
+	public:
+		/*
+			JASS_ANYTIME_QUERY::EXTRACT_QUERY_ID()
+			--------------------------------------
+		*/
+		/*!
+			@brief Split the query-id off the front of the query.
+			@param query [in/out] The query, on return the query without the query-id.
+			@param query_id [out] The query-id (or "" if there isn't one).
+		*/
+		static void extract_query_id(std::string &query, std::string &query_id)
+			{
+			static const std::string seperators_between_id_and_query = " \t:";
+
+			auto end_of_id = query.find_first_of(seperators_between_id_and_query);
+			if (end_of_id == std::string::npos)
+				query_id = "";
+			else
+				{
+				query_id = query.substr(0, end_of_id);
+				auto start_of_query = query.substr(end_of_id, std::string::npos).find_first_not_of(seperators_between_id_and_query);
+				if (start_of_query == std::string::npos)
+					query = query.substr(end_of_id, std::string::npos);
+				else
+					query = query.substr(end_of_id + start_of_query, std::string::npos);
+				}
+			}
 
 	public:
 		/*
@@ -45,13 +78,13 @@ class JASS_anytime_query
 		*/
 		/*!
 			@brief Constructor
-			@param query [in] this node represents this query (which is copied)
+			@param query [in] this node represents this query, prefixed with the query-id (which is copied)
 		*/
 		JASS_anytime_query(const std::string &query) :
 			taken(false),
 			query(query)
 				{
-				/* Nothing */
+				extract_query_id(this->query, query_id);
 				}
 
 		/*
@@ -64,11 +97,13 @@ class JASS_anytime_query
 		*/
 		JASS_anytime_query(JASS_anytime_query &&original) :
 			taken(original.taken.load()),
-			query(original.query)
+			query_id(std::move(original.query_id)),
+			query(std::move(original.query))
 				{
 				/*
 					Invalidate the original object.
 				*/
+				original.query_id = "";
 				original.query = "";
 				original.taken = true;
 				}
@@ -81,9 +116,9 @@ class JASS_anytime_query
 			@brief Given a list of queries, return the next un-taken query
 			@param list [in] The list to search in
 			@param starging_from [in/out] Where to start searching (should initially be 0, updated to the current node)
-			@return A copy of the string representing the query
+			@return The query (which is not copied), or nullptr if there are no more queries
 		*/
-		static std::string get_next_query(std::vector<JASS_anytime_query>&list, size_t &starting_from)
+		static const JASS_anytime_query *get_next_query(std::vector<JASS_anytime_query>&list, size_t &starting_from)
 			{
 			auto total_queries = list.size();
 			while (starting_from < total_queries)
@@ -92,11 +127,11 @@ class JASS_anytime_query
 					{
 					uint8_t expected = false;
 					if (list[starting_from].taken.compare_exchange_strong(expected, true))
-						return list[starting_from].query;
+						return &list[starting_from];
 					}
 				starting_from++;
 				}
 
-			return std::string();
+			return nullptr;
 			}
 	};
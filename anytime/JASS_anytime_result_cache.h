@@ -0,0 +1,424 @@
+/*
+	JASS_ANYTIME_RESULT_CACHE.H
+	---------------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief A concurrent cache of results lists, so that repeated queries need not be searched again.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+#include "query_term_list.h"
+
+/*
+	CLASS JASS_ANYTIME_RESULT_CACHE
+	-------------------------------
+*/
+/*!
+	@brief A sharded, byte-bounded, least recently used cache of results lists.
+	@details The key is the parsed query (so queries that differ only in case or punctuation share an entry), the top-k, and the maximum
+	number of postings to process, because any of these can change the results list.  The cache is broken into shards, each with its own
+	lock and its own share of the memory budget, so that threads looking up different queries rarely contend.  When a shard is over budget
+	the least recently used entries are evicted.
+*/
+class JASS_anytime_result_cache
+	{
+	public:
+		/*
+			CLASS JASS_ANYTIME_RESULT_CACHE::RESULT
+			---------------------------------------
+		*/
+		/*!
+			@brief A <document_id, rsv> pair in a cached results list.
+		*/
+		class result
+			{
+			public:
+				uint32_t document_id;					///< The internal document identifier
+				uint32_t rsv;								///< The rsv (Retrieval Status Value) relevance score
+			};
+
+		/*
+			CLASS JASS_ANYTIME_RESULT_CACHE::RESULTS_LIST
+			---------------------------------------------
+		*/
+		/*!
+			@brief A cached results list that can be iterated over like a JASS::query (so that it can be passed to JASS::run_export).
+		*/
+		class results_list
+			{
+			public:
+				/*
+					CLASS JASS_ANYTIME_RESULT_CACHE::RESULTS_LIST::DOCID_RSV_PAIR
+					-------------------------------------------------------------
+				*/
+				/*!
+					@brief Literally a <document_id, rsv> ordered pair.
+				*/
+				class docid_rsv_pair
+					{
+					public:
+						size_t document_id;							///< The document identifier
+						const std::string &primary_key;			///< The external identifier of the document (the primary key)
+						uint32_t rsv;									///< The rsv (Retrieval Status Value) relevance score
+
+					public:
+						/*
+							JASS_ANYTIME_RESULT_CACHE::RESULTS_LIST::DOCID_RSV_PAIR::DOCID_RSV_PAIR()
+							-------------------------------------------------------------------------
+						*/
+						/*!
+							@brief Constructor.
+							@param document_id [in] The document Identifier.
+							@param key [in] The external identifier of the document (the primary key).
+							@param rsv [in] The rsv (Retrieval Status Value) relevance score.
+						*/
+						docid_rsv_pair(size_t document_id, const std::string &key, uint32_t rsv) :
+							document_id(document_id),
+							primary_key(key),
+							rsv(rsv)
+							{
+							/* Nothing */
+							}
+					};
+
+				/*
+					CLASS JASS_ANYTIME_RESULT_CACHE::RESULTS_LIST::ITERATOR
+					-------------------------------------------------------
+				*/
+				/*!
+					@brief Iterate over the results list.
+				*/
+				class iterator
+					{
+					public:
+						const results_list &parent;						///< The results list being iterated over
+						size_t where;										///< Where in the results list we are
+
+					public:
+						/*
+							JASS_ANYTIME_RESULT_CACHE::RESULTS_LIST::ITERATOR::ITERATOR()
+							-------------------------------------------------------------
+						*/
+						/*!
+							@brief Constructor
+							@param parent [in] The object we are iterating over
+							@param where [in] Where in the results list this iterator starts
+						*/
+						iterator(const results_list &parent, size_t where) :
+							parent(parent),
+							where(where)
+							{
+							/* Nothing */
+							}
+
+						/*
+							JASS_ANYTIME_RESULT_CACHE::RESULTS_LIST::ITERATOR::OPERATOR!=()
+							---------------------------------------------------------------
+						*/
+						/*!
+							@brief Compare two iterator objects for non-equality.
+							@param with [in] The iterator object to compare to.
+							@return true if they differ, else false.
+						*/
+						bool operator!=(const iterator &with) const
+							{
+							return with.where != where;
+							}
+
+						/*
+							JASS_ANYTIME_RESULT_CACHE::RESULTS_LIST::ITERATOR::OPERATOR++()
+							---------------------------------------------------------------
+						*/
+						/*!
+							@brief Increment this iterator.
+						*/
+						iterator &operator++(void)
+							{
+							where++;
+							return *this;
+							}
+
+						/*
+							JASS_ANYTIME_RESULT_CACHE::RESULTS_LIST::ITERATOR::OPERATOR*()
+							--------------------------------------------------------------
+						*/
+						/*!
+							@brief Return the <document_id,rsv> pair at the current location.
+							@return The current object.
+						*/
+						docid_rsv_pair operator*() const
+							{
+							const auto &answer = parent.results[where];
+							return docid_rsv_pair(answer.document_id, parent.primary_keys[answer.document_id], answer.rsv);
+							}
+					};
+
+			public:
+				const std::vector<std::string> &primary_keys;		///< The primary keys of the documents in the index
+				std::vector<result> results;							///< The results, highest rsv first
+
+			public:
+				/*
+					JASS_ANYTIME_RESULT_CACHE::RESULTS_LIST::RESULTS_LIST()
+					-------------------------------------------------------
+				*/
+				/*!
+					@brief Constructor
+					@param primary_keys [in] The primary keys of the documents in the index.
+				*/
+				explicit results_list(const std::vector<std::string> &primary_keys) :
+					primary_keys(primary_keys)
+					{
+					/* Nothing */
+					}
+
+				/*
+					JASS_ANYTIME_RESULT_CACHE::RESULTS_LIST::BEGIN()
+					------------------------------------------------
+				*/
+				/*!
+					@brief Return an iterator pointing to start of the results list.
+					@return Iterator pointing to start of the results list.
+				*/
+				iterator begin(void) const
+					{
+					return iterator(*this, 0);
+					}
+
+				/*
+					JASS_ANYTIME_RESULT_CACHE::RESULTS_LIST::END()
+					----------------------------------------------
+				*/
+				/*!
+					@brief Return an iterator pointing to end of the results list.
+					@return Iterator pointing to the end of the results list.
+				*/
+				iterator end(void) const
+					{
+					return iterator(*this, results.size());
+					}
+			};
+
+	private:
+		/*
+			CLASS JASS_ANYTIME_RESULT_CACHE::ENTRY
+			--------------------------------------
+		*/
+		/*!
+			@brief A cached results list and its key.
+		*/
+		class entry
+			{
+			public:
+				std::string key;								///< The key (see make_key())
+				size_t terms_found;							///< The number of query terms that were in the vocabulary
+				std::vector<result> results;				///< The results list
+				size_t bytes;									///< The memory charged to the cache for this entry
+			};
+
+		/*
+			CLASS JASS_ANYTIME_RESULT_CACHE::SHARD
+			--------------------------------------
+		*/
+		/*!
+			@brief A part of the cache with its own lock, its own least recently used list, and its own share of the memory budget.
+		*/
+		class shard
+			{
+			public:
+				std::mutex lock;																			///< Held while the shard is being used
+				std::list<entry> recently_used;														///< The entries, most recently used first
+				std::unordered_map<std::string, std::list<entry>::iterator> lookup;		///< The entries keyed on their key
+				size_t bytes;																				///< The memory charged to the entries in this shard
+
+			public:
+				/*
+					JASS_ANYTIME_RESULT_CACHE::SHARD::SHARD()
+					-----------------------------------------
+				*/
+				/*!
+					@brief Constructor
+				*/
+				shard() :
+					bytes(0)
+					{
+					/* Nothing */
+					}
+			};
+
+	private:
+		static constexpr size_t overhead_per_entry = 128;			///< An estimate of the memory used by the list node, the hash table node, and the vectors of an entry
+
+	private:
+		size_t shards;											///< The number of shards
+		std::unique_ptr<shard []> shard_list;			///< The shards
+		size_t bytes_per_shard;								///< The memory budget of each shard
+		std::atomic<size_t> hits;							///< The number of times find() found the key
+		std::atomic<size_t> misses;						///< The number of times find() did not find the key
+
+	private:
+		/*
+			JASS_ANYTIME_RESULT_CACHE::GET_SHARD()
+			--------------------------------------
+		*/
+		/*!
+			@brief Return the shard responsible for the given key.
+			@param key [in] The key.
+			@return The shard.
+		*/
+		shard &get_shard(const std::string &key)
+			{
+			return shard_list[std::hash<std::string>()(key) % shards];
+			}
+
+	public:
+		/*
+			JASS_ANYTIME_RESULT_CACHE::JASS_ANYTIME_RESULT_CACHE()
+			------------------------------------------------------
+		*/
+		/*!
+			@brief Constructor
+			@param bytes [in] The memory budget of the cache (in bytes).
+			@param shards [in] The number of shards (default = 64).
+		*/
+		explicit JASS_anytime_result_cache(size_t bytes, size_t shards = 64) :
+			shards((std::max)(shards, static_cast<size_t>(1))),
+			shard_list(new shard[this->shards]),
+			bytes_per_shard(bytes / this->shards),
+			hits(0),
+			misses(0)
+			{
+			/* Nothing */
+			}
+
+		/*
+			JASS_ANYTIME_RESULT_CACHE::MAKE_KEY()
+			-------------------------------------
+		*/
+		/*!
+			@brief Construct the cache key of a query.
+			@param key [out] The key.
+			@param terms [in] The parsed query.
+			@param top_k [in] The number of results to return.
+			@param postings_to_process [in] The maximum number of postings to process.
+		*/
+		static void make_key(std::string &key, JASS::query_term_list &terms, size_t top_k, size_t postings_to_process)
+			{
+			key.assign(reinterpret_cast<const char *>(&top_k), sizeof(top_k));
+			key.append(reinterpret_cast<const char *>(&postings_to_process), sizeof(postings_to_process));
+			for (const auto &term : terms)
+				{
+				key.push_back(' ');
+				key.append(reinterpret_cast<const char *>(term.token().address()), term.token().size());
+				}
+			}
+
+		/*
+			JASS_ANYTIME_RESULT_CACHE::FIND()
+			---------------------------------
+		*/
+		/*!
+			@brief Look up a key and, if it is in the cache, copy out its results list (and mark it as the most recently used).
+			@param key [in] The key (see make_key()).
+			@param answer [out] The results list.
+			@param terms_found [out] The number of query terms that were in the vocabulary.
+			@return true if the key was found, else false.
+		*/
+		bool find(const std::string &key, results_list &answer, size_t &terms_found)
+			{
+			shard &where = get_shard(key);
+			std::lock_guard<std::mutex> guard(where.lock);
+
+			auto found = where.lookup.find(key);
+			if (found == where.lookup.end())
+				{
+				misses++;
+				return false;
+				}
+
+			hits++;
+			where.recently_used.splice(where.recently_used.begin(), where.recently_used, found->second);
+			answer.results = found->second->results;
+			terms_found = found->second->terms_found;
+			return true;
+			}
+
+		/*
+			JASS_ANYTIME_RESULT_CACHE::INSERT()
+			-----------------------------------
+		*/
+		/*!
+			@brief Add a results list to the cache, evicting the least recently used entries of the shard if it is over budget.
+			@details A results list that is larger than the budget of a shard is not cached.
+			@param key [in] The key (see make_key()).
+			@param results [in] The results list.
+			@param terms_found [in] The number of query terms that were in the vocabulary.
+		*/
+		void insert(const std::string &key, const std::vector<result> &results, size_t terms_found)
+			{
+			size_t bytes = overhead_per_entry + 2 * key.size() + results.size() * sizeof(result);
+			if (bytes > bytes_per_shard)
+				return;
+
+			shard &where = get_shard(key);
+			std::lock_guard<std::mutex> guard(where.lock);
+
+			/*
+				Another thread might have added this query since we looked
+			*/
+			if (where.lookup.find(key) != where.lookup.end())
+				return;
+
+			where.recently_used.push_front(entry{key, terms_found, results, bytes});
+			where.lookup[key] = where.recently_used.begin();
+			where.bytes += bytes;
+
+			while (where.bytes > bytes_per_shard)
+				{
+				entry &victim = where.recently_used.back();
+				where.bytes -= victim.bytes;
+				where.lookup.erase(victim.key);
+				where.recently_used.pop_back();
+				}
+			}
+
+		/*
+			JASS_ANYTIME_RESULT_CACHE::GET_HITS()
+			-------------------------------------
+		*/
+		/*!
+			@brief Return the number of lookups that found their key.
+			@return The number of cache hits.
+		*/
+		size_t get_hits(void) const
+			{
+			return hits;
+			}
+
+		/*
+			JASS_ANYTIME_RESULT_CACHE::GET_MISSES()
+			---------------------------------------
+		*/
+		/*!
+			@brief Return the number of lookups that did not find their key.
+			@return The number of cache misses.
+		*/
+		size_t get_misses(void) const
+			{
+			return misses;
+			}
+	};
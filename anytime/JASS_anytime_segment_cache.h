@@ -0,0 +1,368 @@
+/*
+	JASS_ANYTIME_SEGMENT_CACHE.H
+	----------------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief A concurrent cache of decoded impact segments, so that hot segments need not be decompressed for each query.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "forceinline.h"
+
+/*
+	CLASS JASS_ANYTIME_SEGMENT_CACHE
+	--------------------------------
+*/
+/*!
+	@brief A cache, shared by all the search threads, of the document ids of decoded (and D1 decoded) impact segments.
+	@details Segments are keyed on their offset in the postings.  A segment is admitted to the cache once the postings decoded for
+	it (its segment frequency times the number of times it has been decoded) reaches a threshold, so large segments are admitted on
+	first use and small segments (which are cheap to decode) only if they are very popular.  Once the memory budget is used up no more
+	segments are admitted.  Segments are never evicted, so a segment found in the cache can be used without holding a lock.
+	Looking up a segment takes no lock either: each cached segment is published in an open-addressed table of atomic slots, and
+	the shard locks are only taken (on a miss) to count the decodes of a segment and to add it to the cache.
+*/
+class JASS_anytime_segment_cache
+	{
+	private:
+		/*
+			CLASS JASS_ANYTIME_SEGMENT_CACHE::SHARD
+			---------------------------------------
+		*/
+		/*!
+			@brief A part of the cache with its own lock (held while counting decodes and adding segments, but not for lookups).
+		*/
+		class shard
+			{
+			public:
+				std::mutex lock;																	///< Held while the shard is being changed
+				std::vector<std::unique_ptr<std::vector<uint32_t>>> segments;			///< The decoded segments this shard added to the cache
+				std::unordered_map<uint64_t, size_t> decoded;								///< The postings decoded for each segment not (yet) in the cache
+			};
+
+		/*
+			CLASS JASS_ANYTIME_SEGMENT_CACHE::SLOT
+			--------------------------------------
+		*/
+		/*!
+			@brief A slot in the open-addressed table the cached segments are published through.
+		*/
+		class slot
+			{
+			public:
+				std::atomic<uint64_t> key;															///< The offset of the segment plus 1 (0 means the slot is empty)
+				std::atomic<const std::vector<uint32_t> *> document_ids;					///< The decoded segment (nullptr until it has been published)
+			};
+
+		/*
+			CLASS JASS_ANYTIME_SEGMENT_CACHE::COUNTER
+			-----------------------------------------
+		*/
+		/*!
+			@brief The hits and misses of the threads that use a counter, padded to two cache lines so that no two counters share a line wherever the array starts.
+		*/
+		class counter
+			{
+			public:
+				std::atomic<size_t> hits;																	///< The number of times find() found the segment
+				std::atomic<size_t> misses;																///< The number of times find() did not find the segment
+				uint8_t padding[128 - 2 * sizeof(std::atomic<size_t>)];							///< Keep the next counter off this counter's cache line
+			};
+
+	private:
+		static constexpr size_t shards = 64;							///< The number of shards
+		static constexpr size_t most_candidates = 4096;				///< The number of candidates tracked per shard before the candidate counts are reset
+		static constexpr size_t counters = 64;							///< The number of hit and miss counters (each thread uses one)
+		static constexpr size_t bytes_per_slot = 1024;				///< Allocate a slot per this many bytes of the memory budget (cached segments are mostly long, as short ones are rarely admitted)
+
+	private:
+		std::unique_ptr<shard []> shard_list;						///< The shards
+		std::unique_ptr<slot []> slot_list;							///< The table the cached segments are published through
+		size_t slot_bits;													///< The table has 2^slot_bits slots
+		std::atomic<size_t> slots_used;								///< The number of slots that have been used (no more segments are admitted once half are)
+		std::unique_ptr<counter []> counter_list;					///< The hit and miss counters
+		size_t admission_postings;										///< Admit a segment once this many of its postings have been decoded
+		size_t bytes_budget;												///< The maximum size of the decoded segments (in bytes)
+		std::atomic<size_t> bytes_used;								///< The size of the decoded segments in the cache (in bytes)
+
+	private:
+		/*
+			JASS_ANYTIME_SEGMENT_CACHE::GET_SHARD()
+			---------------------------------------
+		*/
+		/*!
+			@brief Return the shard responsible for the given segment.
+			@param offset [in] The offset of the segment in the postings.
+			@return The shard.
+		*/
+		shard &get_shard(uint64_t offset)
+			{
+			return shard_list[(offset >> 3) % shards];
+			}
+
+		/*
+			JASS_ANYTIME_SEGMENT_CACHE::GET_COUNTER()
+			-----------------------------------------
+		*/
+		/*!
+			@brief Return the hit and miss counter for the calling thread (each thread is given one, in turn, the first time it asks).
+			@return The counter.
+		*/
+		counter &get_counter(void)
+			{
+			static std::atomic<size_t> threads(0);
+			static thread_local size_t which = threads.fetch_add(1, std::memory_order_relaxed) % counters;
+
+			return counter_list[which];
+			}
+
+		/*
+			JASS_ANYTIME_SEGMENT_CACHE::FIRST_SLOT()
+			----------------------------------------
+		*/
+		/*!
+			@brief Return the slot at which to start looking for a segment (a multiplicative hash of its offset).
+			@param offset [in] The offset of the segment in the postings.
+			@return The index of the slot.
+		*/
+		size_t first_slot(uint64_t offset) const
+			{
+			return static_cast<size_t>((offset * 0x9E3779B97F4A7C15ULL) >> (64 - slot_bits));
+			}
+
+		/*
+			JASS_ANYTIME_SEGMENT_CACHE::LOOKUP()
+			------------------------------------
+		*/
+		/*!
+			@brief Look up a segment in the table of published segments (without taking a lock).
+			@param offset [in] The offset of the segment in the postings.
+			@return The document ids in the segment, or nullptr if the segment has not been published.
+		*/
+		const std::vector<uint32_t> *lookup(uint64_t offset) const
+			{
+			size_t mask = (static_cast<size_t>(1) << slot_bits) - 1;
+			for (size_t which = first_slot(offset); true; which = (which + 1) & mask)
+				{
+				uint64_t key = slot_list[which].key.load(std::memory_order_acquire);
+				if (key == offset + 1)
+					return slot_list[which].document_ids.load(std::memory_order_acquire);
+				if (key == 0)
+					return nullptr;
+				}
+			}
+
+		/*
+			JASS_ANYTIME_SEGMENT_CACHE::PUBLISH()
+			-------------------------------------
+		*/
+		/*!
+			@brief Publish a decoded segment so that lookup() will find it (the caller holds the segment's shard lock and has reserved a slot).
+			@param offset [in] The offset of the segment in the postings.
+			@param document_ids [in] The decoded segment.
+		*/
+		void publish(uint64_t offset, const std::vector<uint32_t> *document_ids)
+			{
+			size_t mask = (static_cast<size_t>(1) << slot_bits) - 1;
+			for (size_t which = first_slot(offset); true; which = (which + 1) & mask)
+				{
+				uint64_t empty = 0;
+				if (slot_list[which].key.compare_exchange_strong(empty, offset + 1, std::memory_order_acq_rel))
+					{
+					slot_list[which].document_ids.store(document_ids, std::memory_order_release);
+					return;
+					}
+				}
+			}
+
+	public:
+		/*
+			JASS_ANYTIME_SEGMENT_CACHE::JASS_ANYTIME_SEGMENT_CACHE()
+			--------------------------------------------------------
+		*/
+		/*!
+			@brief Constructor
+			@param bytes [in] The memory budget of the cache (in bytes).
+			@param admission_postings [in] Admit a segment once this many of its postings have been decoded (default = 16384).
+		*/
+		explicit JASS_anytime_segment_cache(size_t bytes, size_t admission_postings = 16384) :
+			shard_list(new shard[shards]),
+			slot_bits(10),
+			slots_used(0),
+			counter_list(new counter[counters]),
+			admission_postings(admission_postings),
+			bytes_budget(bytes),
+			bytes_used(0)
+			{
+			while ((static_cast<size_t>(1) << slot_bits) < 2 * (bytes / bytes_per_slot))
+				slot_bits++;
+
+			slot_list.reset(new slot[static_cast<size_t>(1) << slot_bits]);
+			for (size_t which = 0; which < (static_cast<size_t>(1) << slot_bits); which++)
+				{
+				slot_list[which].key = 0;
+				slot_list[which].document_ids = nullptr;
+				}
+
+			for (size_t which = 0; which < counters; which++)
+				{
+				counter_list[which].hits = 0;
+				counter_list[which].misses = 0;
+				}
+			}
+
+		/*
+			JASS_ANYTIME_SEGMENT_CACHE::FIND()
+			----------------------------------
+		*/
+		/*!
+			@brief Look up a segment (without taking a lock).
+			@param offset [in] The offset of the segment in the postings.
+			@return The document ids in the segment, or nullptr if the segment is not in the cache.
+		*/
+		const std::vector<uint32_t> *find(uint64_t offset)
+			{
+			const std::vector<uint32_t> *found = lookup(offset);
+			counter &count = get_counter();
+
+			if (found == nullptr)
+				count.misses.fetch_add(1, std::memory_order_relaxed);
+			else
+				count.hits.fetch_add(1, std::memory_order_relaxed);
+
+			return found;
+			}
+
+		/*
+			JASS_ANYTIME_SEGMENT_CACHE::DECODED()
+			-------------------------------------
+		*/
+		/*!
+			@brief Tell the cache that a segment not in the cache was decoded, and add it to the cache if it is now worth caching.
+			@param offset [in] The offset of the segment in the postings.
+			@param decoder [in] The decoder holding the decoded segment (it must provide begin() and end() over the document ids).
+			@param segment_frequency [in] The number of postings in the segment.
+		*/
+		template <typename DECODER>
+		void decoded(uint64_t offset, const DECODER &decoder, size_t segment_frequency)
+			{
+			size_t bytes = segment_frequency * sizeof(uint32_t);
+			if (bytes_used + bytes > bytes_budget || 2 * slots_used >= (static_cast<size_t>(1) << slot_bits))
+				return;
+
+			shard &where = get_shard(offset);
+			std::lock_guard<std::mutex> guard(where.lock);
+
+			/*
+				Count the work done decoding this segment, and only admit it once the work reaches the threshold
+			*/
+			if (where.decoded.size() >= most_candidates)
+				where.decoded.clear();
+			size_t &work = where.decoded[offset];
+			work += segment_frequency;
+			if (work < admission_postings)
+				return;
+			where.decoded.erase(offset);
+
+			/*
+				Another thread might have added this segment since we looked, and another shard might have used the budget or the slots
+			*/
+			if (lookup(offset) != nullptr)
+				return;
+			if ((bytes_used += bytes) > bytes_budget)
+				{
+				bytes_used -= bytes;
+				return;
+				}
+			if (2 * ++slots_used > (static_cast<size_t>(1) << slot_bits))
+				{
+				slots_used--;
+				bytes_used -= bytes;
+				return;
+				}
+
+			std::unique_ptr<std::vector<uint32_t>> document_ids(new std::vector<uint32_t>);
+			document_ids->reserve(segment_frequency);
+			auto end = decoder.end();
+			for (auto current = decoder.begin(); current != end; ++current)
+				document_ids->push_back(*current);
+
+			publish(offset, document_ids.get());
+			where.segments.push_back(std::move(document_ids));
+			}
+
+		/*
+			JASS_ANYTIME_SEGMENT_CACHE::PROCESS()
+			-------------------------------------
+		*/
+		/*!
+			@brief Add the impact score to the accumulator of each document in a cached segment.
+			@param document_ids [in] The cached segment (from find()).
+			@param impact [in] The impact score to add for each document id in the segment.
+			@param accumulators [in] The accumulators to add to.
+		*/
+		template <typename QUERY_T>
+		static forceinline void process(const std::vector<uint32_t> &document_ids, uint16_t impact, QUERY_T &accumulators)
+			{
+			for (const auto document : document_ids)
+				accumulators.add_rsv(document, impact);
+			}
+
+		/*
+			JASS_ANYTIME_SEGMENT_CACHE::GET_HITS()
+			--------------------------------------
+		*/
+		/*!
+			@brief Return the number of segments found in the cache.
+			@return The number of cache hits.
+		*/
+		size_t get_hits(void) const
+			{
+			size_t total = 0;
+			for (size_t which = 0; which < counters; which++)
+				total += counter_list[which].hits.load(std::memory_order_relaxed);
+
+			return total;
+			}
+
+		/*
+			JASS_ANYTIME_SEGMENT_CACHE::GET_MISSES()
+			----------------------------------------
+		*/
+		/*!
+			@brief Return the number of segments not found in the cache.
+			@return The number of cache misses.
+		*/
+		size_t get_misses(void) const
+			{
+			size_t total = 0;
+			for (size_t which = 0; which < counters; which++)
+				total += counter_list[which].misses.load(std::memory_order_relaxed);
+
+			return total;
+			}
+
+		/*
+			JASS_ANYTIME_SEGMENT_CACHE::GET_BYTES_USED()
+			--------------------------------------------
+		*/
+		/*!
+			@brief Return the size of the decoded segments in the cache.
+			@return The size (in bytes).
+		*/
+		size_t get_bytes_used(void) const
+			{
+			return bytes_used;
+			}
+	};
@@ -0,0 +1,287 @@
+/*
+	JASS_ANYTIME_SERVER.H
+	---------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief A long-lived query server for the Anytime engine.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+
+#include "timer.h"
+#include "threads.h"
+#include "socket_listener.h"
+#include "channel_connection.h"
+#include "JASS_anytime_stats.h"
+#include "thread_pool_work_stealing.h"
+
+/*
+	CLASS JASS_ANYTIME_SERVER
+	-------------------------
+*/
+/*!
+	@brief A long-lived query server that loads the index once and then answers queries from clients over sockets.
+	@details Clients connect (over TCP or a Unix domain socket) and send one query per line, in the same format as a query file (i.e. prefixed
+	with the query-id).  Each query is a task in a work-stealing thread pool, and each worker thread owns a pre-allocated SEARCHER
+	(query object, decoder, etc.) so no allocation of search structures happens per query.  The answer to each query is a TREC run
+	followed by a blank line.  A client may send many queries without waiting for the answers (pipelining), in which case the answers can
+	be returned out of order (each line of the answer contains the query-id).
+
+	There are two commands.  ".stats" returns the server statistics (followed by a blank line), and ".quit" shuts down the server once all
+	the queries that have been received have been answered.
+	@tparam SEARCHER The per-worker search engine.  It must have a method search(std::string &query, std::ostream &results) that answers the
+	query (including the query-id), writes the answer to results, and returns the time spent searching (in nanoseconds).
+*/
+template <typename SEARCHER>
+class JASS_anytime_server
+	{
+	private:
+		/*
+			CLASS JASS_ANYTIME_SERVER::CONNECTION
+			-------------------------------------
+		*/
+		/*!
+			@brief A client connection and the thread that reads queries from it.
+		*/
+		class connection
+			{
+			public:
+				std::shared_ptr<JASS::channel_connection> channel;				///< The connection (shared with the tasks answering queries from it)
+				std::atomic<bool> finished;												///< Set by the reader thread when the client has disconnected
+				JASS::thread reader;															///< The thread reading queries from the client
+
+			public:
+				/*
+					JASS_ANYTIME_SERVER::CONNECTION::CONNECTION()
+					---------------------------------------------
+				*/
+				/*!
+					@brief Constructor.  Starts the reader thread.
+					@param server [in] The server.
+					@param descriptor [in] The socket the client is connected to.
+				*/
+				connection(JASS_anytime_server &server, intptr_t descriptor) :
+					channel(new JASS::channel_connection(descriptor)),
+					finished(false),
+					reader(read_queries, std::ref(server), std::ref(*this))
+					{
+					/* Nothing */
+					}
+
+				/*
+					JASS_ANYTIME_SERVER::CONNECTION::~CONNECTION()
+					----------------------------------------------
+				*/
+				/*!
+					@brief Destructor.  Waits for the reader thread to finish.
+				*/
+				~connection()
+					{
+					reader.join();
+					}
+			};
+
+	private:
+		std::vector<std::unique_ptr<SEARCHER>> &searchers;		///< The pre-allocated search engines, one per worker
+		JASS::socket_listener listener;								///< Where clients connect
+		std::mutex listener_lock;										///< Stops the listener being closed while stop() is waking it
+		std::atomic<bool> stopping;									///< Set when a client asks the server to quit
+		std::mutex connections_lock;									///< Protects connections
+		std::vector<std::unique_ptr<connection>> connections;	///< The current client connections
+		decltype(JASS::timer::start()) started;					///< When the server started serving
+		std::atomic<size_t> queries_executed;						///< The number of queries answered
+		std::atomic<size_t> search_time_in_ns;						///< The sum of the time spent searching (over all workers)
+		std::mutex latencies_lock;										///< Protects latencies
+		JASS_anytime_latency_histogram latencies;					///< The search time of each query
+		JASS::thread_pool_work_stealing pool;						///< The workers (declared last so that they stop before the members their tasks use are destroyed)
+
+	private:
+		/*
+			JASS_ANYTIME_SERVER::READ_QUERIES()
+			-----------------------------------
+		*/
+		/*!
+			@brief The main loop of the thread reading from a client.  Each query becomes a task in the pool.
+			@param server [in] The server.
+			@param client [in] The client connection.
+		*/
+		static void read_queries(JASS_anytime_server &server, connection &client)
+			{
+			std::shared_ptr<JASS::channel_connection> channel = client.channel;
+			std::string query;
+
+			for (channel->gets(query); query.size() != 0; channel->gets(query))
+				{
+				/*
+					Remove the line ending (which might be "\r\n")
+				*/
+				while (query.size() != 0 && (query.back() == '\n' || query.back() == '\r'))
+					query.pop_back();
+
+				if (query.size() == 0)
+					continue;
+				else if (query == ".quit")
+					{
+					server.stop();
+					break;
+					}
+				else if (query == ".stats")
+					{
+					std::ostringstream answer;
+					JASS_anytime_stats stats;
+					server.get_stats(stats);
+					answer << stats << '\n';
+					channel->write(answer.str());
+					}
+				else
+					server.pool.submit
+						(
+						[&server, channel, query](size_t worker)
+							{
+							std::string text = query;
+							std::ostringstream answer;
+
+							size_t nanoseconds = server.searchers[worker]->search(text, answer);
+							server.search_time_in_ns += nanoseconds;
+							server.queries_executed++;
+							{
+							std::unique_lock<std::mutex> guard(server.latencies_lock);
+							server.latencies.add(nanoseconds);
+							}
+							answer << '\n';
+							channel->write(answer.str());
+							}
+						);
+				}
+
+			client.finished = true;
+			}
+
+		/*
+			JASS_ANYTIME_SERVER::REAP()
+			---------------------------
+		*/
+		/*!
+			@brief Clean up after clients that have disconnected.
+		*/
+		void reap(void)
+			{
+			std::unique_lock<std::mutex> guard(connections_lock);
+
+			connections.erase(std::remove_if(connections.begin(), connections.end(), [](const std::unique_ptr<connection> &client){ return client->finished.load(); }), connections.end());
+			}
+
+	public:
+		/*
+			JASS_ANYTIME_SERVER::JASS_ANYTIME_SERVER()
+			------------------------------------------
+		*/
+		/*!
+			@brief Constructor.
+			@param searchers [in] The pre-allocated search engines, one per worker thread (so this also sets the number of workers).
+		*/
+		explicit JASS_anytime_server(std::vector<std::unique_ptr<SEARCHER>> &searchers) :
+			searchers(searchers),
+			stopping(false),
+			started(JASS::timer::start()),
+			queries_executed(0),
+			search_time_in_ns(0),
+			pool(searchers.size())
+			{
+			/* Nothing */
+			}
+
+		/*
+			JASS_ANYTIME_SERVER::SERVE()
+			----------------------------
+		*/
+		/*!
+			@brief Accept clients and answer their queries until one of them asks the server to quit.
+			@param address [in] The address to listen on (see JASS::socket_listener::listen()).
+			@return false if the server cannot listen on address, else true once the server has stopped.
+		*/
+		bool serve(const std::string &address)
+			{
+			if (!listener.listen(address))
+				return false;
+
+			started = JASS::timer::start();
+			while (!stopping)
+				{
+				intptr_t client = listener.accept();
+				if (client == -1)
+					continue;
+
+				reap();
+				std::unique_lock<std::mutex> guard(connections_lock);
+				connections.push_back(std::unique_ptr<connection>(new connection(*this, client)));
+				}
+
+			/*
+				The listener is closed on this thread (stop() only wakes it) so that it is not changed while we are in accept()
+			*/
+			{
+			std::unique_lock<std::mutex> guard(listener_lock);
+			listener.close();
+			}
+
+			/*
+				Stop reading from the clients (but answer what they've already asked), wait for the reader threads to finish (they submit
+				the queries they have already buffered), then wait for the work to finish
+			*/
+			{
+			std::unique_lock<std::mutex> guard(connections_lock);
+			for (auto &client : connections)
+				client->channel->shutdown_read();
+			connections.clear();
+			}
+			pool.wait();
+
+			return true;
+			}
+
+		/*
+			JASS_ANYTIME_SERVER::STOP()
+			---------------------------
+		*/
+		/*!
+			@brief Ask the server to stop (can be called from any thread).
+		*/
+		void stop(void)
+			{
+			std::unique_lock<std::mutex> guard(listener_lock);
+			if (!stopping.exchange(true))
+				listener.wake();
+			}
+
+		/*
+			JASS_ANYTIME_SERVER::GET_STATS()
+			--------------------------------
+		*/
+		/*!
+			@brief Get the statistics of the server so far.
+			@param stats [out] The statistics.
+		*/
+		void get_stats(JASS_anytime_stats &stats)
+			{
+			stats.threads = pool.workers();
+			stats.number_of_queries = queries_executed;
+			stats.wall_time_in_ns = JASS::timer::stop(started).nanoseconds();
+			stats.sum_of_CPU_time_in_ns = search_time_in_ns;
+
+			std::unique_lock<std::mutex> guard(latencies_lock);
+			stats.latencies = latencies;
+			}
+	};
@@ -12,6 +12,13 @@
 */
 #pragma once
 
+#include <vector>
+#include <iostream>
+
+#include "JASS_anytime_result_cache.h"
+#include "JASS_anytime_segment_cache.h"
+#include "JASS_anytime_latency_histogram.h"
+
 /*
 	CLASS JASS_ANYTIME_STATS
 	------------------------
@@ -23,9 +30,28 @@ class JASS_anytime_stats
 	{
 	public:
 		size_t threads;								///< The number of threads (mean queries per thread = number_of_queries/threads)
+		size_t threads_per_query;					///< The number of threads co-operating on each query (intra-query parallelism)
+		size_t batch_size;							///< The number of queries searched together (sharing segment decodes) by each thread
 		size_t number_of_queries;					///< The number of queries that have been processed
 		size_t wall_time_in_ns;						///< Total wall time to do all the search (in nanoseconds)
 		size_t sum_of_CPU_time_in_ns;				///< Sum of the indivivual thread total timers (multi-threaded can be larger than wall_time_in_ns)
+		JASS_anytime_latency_histogram latencies;	///< The search time of each query
+		size_t segments_processed;					///< The number of impact segments processed (summed over the queries)
+		size_t segments_decoded;					///< The number of impact segments decoded (only counted when queries are batched)
+		size_t decode_time_in_ns;					///< The time spent decoding (or waiting for a decode of) the timed segments
+		size_t process_time_in_ns;					///< The time spent processing the timed segments
+		size_t postings_timed;						///< The number of postings in the timed segments (0 unless segments are timed)
+		bool early_termination;					///< Did the queries stop once their top-k could no longer change?
+		size_t postings_processed;					///< The number of postings processed (summed over the queries)
+		size_t postings_saved;						///< The number of postings not processed because the top-k could no longer change (summed over the queries)
+		std::vector<size_t> queries_per_node;	///< The number of queries searched by the threads on each NUMA node (empty unless the threads are placed on nodes)
+		bool cached;										///< Was there a results cache?
+		size_t cache_hits;								///< The number of queries answered from the results cache
+		size_t cache_misses;								///< The number of queries that were not in the results cache
+		bool segment_cached;								///< Was there a decoded segment cache?
+		size_t segment_cache_hits;						///< The number of segments found in the decoded segment cache
+		size_t segment_cache_misses;					///< The number of segments that were not in the decoded segment cache
+		size_t segment_cache_bytes;					///< The size of the decoded segment cache once searching was done
 
 	public:
 		/*
@@ -37,12 +63,56 @@ class JASS_anytime_stats
 		*/
 		JASS_anytime_stats() :
 			threads(0),
+			threads_per_query(1),
+			batch_size(1),
 			number_of_queries(0),
 			wall_time_in_ns(0),
-			sum_of_CPU_time_in_ns(0)
+			sum_of_CPU_time_in_ns(0),
+			segments_processed(0),
+			segments_decoded(0),
+			decode_time_in_ns(0),
+			process_time_in_ns(0),
+			postings_timed(0),
+			early_termination(false),
+			postings_processed(0),
+			postings_saved(0),
+			cached(false),
+			cache_hits(0),
+			cache_misses(0),
+			segment_cached(false),
+			segment_cache_hits(0),
+			segment_cache_misses(0),
+			segment_cache_bytes(0)
 			{
 			/* Nothing */
 			}
+
+		/*
+			JASS_ANYTIME_STATS::SET_CACHE()
+			-------------------------------
+		*/
+		/*!
+			@brief Copy the hit and miss counts out of the results cache and the decoded segment cache.
+			@param cache [in] The results cache (or nullptr if there isn't one).
+			@param segment_cache [in] The decoded segment cache (or nullptr if there isn't one).
+		*/
+		void set_cache(const JASS_anytime_result_cache *cache, const JASS_anytime_segment_cache *segment_cache)
+			{
+			cached = cache != nullptr;
+			if (cached)
+				{
+				cache_hits = cache->get_hits();
+				cache_misses = cache->get_misses();
+				}
+
+			segment_cached = segment_cache != nullptr;
+			if (segment_cached)
+				{
+				segment_cache_hits = segment_cache->get_hits();
+				segment_cache_misses = segment_cache->get_misses();
+				segment_cache_bytes = segment_cache->get_bytes_used();
+				}
+			}
 	};
 
 /*
@@ -59,10 +129,50 @@ std::ostream &operator<<(std::ostream &output, JASS_anytime_stats &data)
 	{
 	output << "-------------------\n";
 	output << "Threads                                : " << data.threads << '\n';
+	output << "Threads per query                      : " << data.threads_per_query << '\n';
+	if (data.batch_size > 1)
+		output << "Queries per batch                      : " << data.batch_size << '\n';
 	output << "Queries                                : " << data.number_of_queries << '\n';
 	output << "Total wall time                        : " << data.wall_time_in_ns << " ns\n";
 	output << "Total CPU wall time searching          : " << data.sum_of_CPU_time_in_ns << " ns\n";
 	output << "Total time excluding I/O (per query)   : " << data.sum_of_CPU_time_in_ns / ((data.number_of_queries == 0) ? 1 : data.number_of_queries) << " ns\n";
+	output << "Throughput                             : " << (data.wall_time_in_ns == 0 ? 0 : data.number_of_queries * 1'000'000'000 / data.wall_time_in_ns) << " queries per second\n";
+	if (data.latencies.size() != 0)
+		{
+		output << "Search time p50                        : " << data.latencies.percentile(50) << " ns\n";
+		output << "Search time p95                        : " << data.latencies.percentile(95) << " ns\n";
+		output << "Search time p99                        : " << data.latencies.percentile(99) << " ns\n";
+		output << "Search time p99.9                      : " << data.latencies.percentile(99.9) << " ns\n";
+		output << "Search time max                        : " << data.latencies.maximum() << " ns\n";
+		}
+	for (size_t node = 0; node < data.queries_per_node.size(); node++)
+		output << "NUMA node " << node << " queries                    : " << data.queries_per_node[node] << " (" << (data.wall_time_in_ns == 0 ? 0 : data.queries_per_node[node] * 1'000'000'000 / data.wall_time_in_ns) << " queries per second)\n";
+	if (data.batch_size > 1)
+		{
+		output << "Segments processed                     : " << data.segments_processed << '\n';
+		output << "Segments decoded                       : " << data.segments_decoded << '\n';
+		}
+	if (data.early_termination)
+		{
+		output << "Postings processed                     : " << data.postings_processed << '\n';
+		output << "Postings saved by early termination    : " << data.postings_saved << " (" << (data.postings_processed + data.postings_saved == 0 ? 0.0 : 100.0 * data.postings_saved / (data.postings_processed + data.postings_saved)) << "% of exhaustive)\n";
+		}
+	if (data.postings_timed != 0)
+		{
+		output << "Decode (or wait) time per posting      : " << static_cast<double>(data.decode_time_in_ns) / data.postings_timed << " ns\n";
+		output << "Process time per posting               : " << static_cast<double>(data.process_time_in_ns) / data.postings_timed << " ns\n";
+		}
+	if (data.cached)
+		{
+		output << "Results cache hits                     : " << data.cache_hits << '\n';
+		output << "Results cache misses                   : " << data.cache_misses << '\n';
+		}
+	if (data.segment_cached)
+		{
+		output << "Segment cache hits                     : " << data.segment_cache_hits << '\n';
+		output << "Segment cache misses                   : " << data.segment_cache_misses << '\n';
+		output << "Segment cache size                     : " << data.segment_cache_bytes << " bytes\n";
+		}
 	output << "-------------------\n";
 	return output;
 	}
@@ -12,6 +12,61 @@
 */
 #pragma once
 
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include "JASS_anytime_latency_histogram.h"
+
+/*
+	CLASS JASS_ANYTIME_QUERY_RECORD
+	-------------------------------
+*/
+/*!
+	@brief What happened when a single query was run.
+*/
+class JASS_anytime_query_record
+	{
+	public:
+		size_t position;									///< The position of the query in the query list (so the records can be put back in order)
+		std::string query_id;							///< The query-id
+		size_t terms_found;								///< The number of query terms that were in the vocabulary
+		size_t segments_processed;						///< The number of impact segments processed
+		size_t postings_processed;						///< The number of postings processed
+		size_t postings_saved;							///< The number of postings not processed because the top-k could no longer change (compared to processing them all)
+		size_t search_time_in_ns;						///< The time spent searching (not including writing the results list)
+
+	public:
+		/*
+			JASS_ANYTIME_QUERY_RECORD::JASS_ANYTIME_QUERY_RECORD()
+			------------------------------------------------------
+		*/
+		JASS_anytime_query_record() :
+			position(0),
+			terms_found(0),
+			segments_processed(0),
+			postings_processed(0),
+			postings_saved(0),
+			search_time_in_ns(0)
+			{
+			/* Nothing */
+			}
+
+		/*
+			JASS_ANYTIME_QUERY_RECORD::OPERATOR<()
+			--------------------------------------
+		*/
+		/*!
+			@brief Order records by their position in the query list.
+			@param other [in] The record to compare to.
+			@return true if this record's query came first.
+		*/
+		bool operator<(const JASS_anytime_query_record &other) const
+			{
+			return position < other.position;
+			}
+	};
+
 /*
 	CLASS JASS_ANYTIME_THREAD_RESULT
 	--------------------------------
@@ -25,6 +80,15 @@ class JASS_anytime_thread_result
 		std::ostringstream results_list;				///< The results lists from this thread
 		size_t queries_executed;						///< The number of queries that this thread executed
 		size_t search_time_in_ns;						///< The total time this thread spent searching
+		size_t segments_processed;						///< The number of impact segments the queries this thread ran processed
+		size_t segments_decoded;						///< The number of impact segments this thread decoded (fewer than processed when queries are batched)
+		size_t postings_processed;						///< The number of postings the queries this thread ran processed
+		size_t postings_saved;							///< The number of postings the queries this thread ran did not process because their top-k could no longer change
+		size_t decode_time_in_ns;						///< The time spent decoding (or waiting for a decode of) the timed segments
+		size_t process_time_in_ns;						///< The time spent processing the timed segments
+		size_t postings_timed;							///< The number of postings in the timed segments (0 unless segments are timed)
+		std::vector<JASS_anytime_query_record> query_records;	///< What happened with each query this thread ran
+		JASS_anytime_latency_histogram latencies;					///< The search time of each query this thread ran
 		
 	public:
 		/*
@@ -33,8 +97,34 @@ class JASS_anytime_thread_result
 		*/
 		JASS_anytime_thread_result() :
 			queries_executed(0),
-			search_time_in_ns(0)
+			search_time_in_ns(0),
+			segments_processed(0),
+			segments_decoded(0),
+			postings_processed(0),
+			postings_saved(0),
+			decode_time_in_ns(0),
+			process_time_in_ns(0),
+			postings_timed(0)
 			{
 			/* Nothing */
 			}
+
+		/*
+			JASS_anytime_thread_result::ADD()
+			---------------------------------
+		*/
+		/*!
+			@brief Account for a query that this thread has run.
+			@param record [in] What happened when the query was run.
+		*/
+		void add(const JASS_anytime_query_record &record)
+			{
+			queries_executed++;
+			search_time_in_ns += record.search_time_in_ns;
+			segments_processed += record.segments_processed;
+			postings_processed += record.postings_processed;
+			postings_saved += record.postings_saved;
+			latencies.add(record.search_time_in_ns);
+			query_records.push_back(record);
+			}
 	};
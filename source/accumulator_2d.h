@@ -12,8 +12,6 @@
 */
 #pragma once
 
-//#define DYNAMIC_ALLOCATION
-
 #include <new>
 #include <vector>
 #include <numeric>
@@ -21,12 +19,168 @@
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _MSC_VER
+	#include <sys/mman.h>
+#endif
 
 #include "maths.h"
 #include "forceinline.h"
 
 namespace JASS
 	{
+	/*
+		CLASS ACCUMULATOR_2D_STORAGE
+		----------------------------
+	*/
+	/*!
+		@brief The memory behind an accumulator_2d whose maximum size is known at compile time.
+		@details The clean flags and the accumulators are in-object arrays.  So, its necessary to work out the maxumum sizes of the two
+		arrays at compile time and then check at construction that no overflow is happening.
+		@tparam ELEMENT The type of accumulator being used.
+		@tparam NUMBER_OF_ACCUMULATORS The maximum number of accumulators.
+	*/
+	template <typename ELEMENT, size_t NUMBER_OF_ACCUMULATORS>
+	class accumulator_2d_storage
+		{
+		protected:
+			static constexpr size_t maximum_shift = maths::floor_log2(maths::sqrt_compiletime(NUMBER_OF_ACCUMULATORS));					///< The amount to shift to get the right clean flag
+			static constexpr size_t maximum_width = 1 << maximum_shift;																					///< Each clean flag represents this number of accumulators in a "row"
+			static constexpr size_t maximum_number_of_clean_flags = (NUMBER_OF_ACCUMULATORS + maximum_width - 1) / maximum_width;	///< The number of "rows" (i.e. clean flags).
+			static constexpr size_t maximum_number_of_accumulators_allocated = maximum_width * maximum_number_of_clean_flags;			///< The numner of accumulators that were actually allocated (recall that this is a 2D array)
+
+		protected:
+			uint8_t clean_flag[maximum_number_of_clean_flags];								///< The clean flags are kept as bytes for faster lookup
+			ELEMENT accumulator[maximum_number_of_accumulators_allocated];				///< The accumulators are kept in an array
+
+		protected:
+			/*
+				ACCUMULATOR_2D_STORAGE::ALLOCATE()
+				----------------------------------
+			*/
+			/*!
+				@brief Make sure there is space for the given number of clean flags and accumulators.
+				@details Throws std::bad_array_new_length if the arrays are too small.
+				@param number_of_clean_flags [in] The number of clean flags needed.
+				@param number_of_accumulators [in] The number of accumulators needed.
+				@param huge_pages [in] Ignored (the arrays are part of the object).
+			*/
+			void allocate(size_t number_of_clean_flags, size_t number_of_accumulators, bool huge_pages)
+				{
+				if (number_of_clean_flags > maximum_number_of_clean_flags || number_of_accumulators > maximum_number_of_accumulators_allocated)
+					throw std::bad_array_new_length();
+				}
+		};
+
+	/*
+		CLASS ACCUMULATOR_2D_STORAGE<ELEMENT, 0>
+		----------------------------------------
+	*/
+	/*!
+		@brief The memory behind an accumulator_2d whose size is only known at run time (NUMBER_OF_ACCUMULATORS == 0).
+		@details The clean flags are allocated with new.  The accumulators are allocated directly from the operating system (so they start
+		on a page boundary) and can, optionally, be backed by (transparent) huge pages to reduce the TLB misses that come from touching
+		accumulators scattered all over a large array.
+		@tparam ELEMENT The type of accumulator being used.
+	*/
+	template <typename ELEMENT>
+	class accumulator_2d_storage<ELEMENT, 0>
+		{
+		private:
+			static constexpr size_t huge_page_size = 2 * 1024 * 1024;		///< The size of a huge page (2MB on x86-64 and AArch64)
+
+		protected:
+			uint8_t *clean_flag;								///< The clean flags are kept as bytes for faster lookup
+			ELEMENT *accumulator;							///< The accumulators are kept in an array
+			void *allocation;									///< The memory that was allocated for the accumulators (accumulator is within this)
+			size_t allocation_size;							///< The size of allocation (in bytes)
+
+		protected:
+			/*
+				ACCUMULATOR_2D_STORAGE::ACCUMULATOR_2D_STORAGE()
+				------------------------------------------------
+			*/
+			/*!
+				@brief Constructor
+			*/
+			accumulator_2d_storage() :
+				clean_flag(nullptr),
+				accumulator(nullptr),
+				allocation(nullptr),
+				allocation_size(0)
+				{
+				/* Nothing */
+				}
+
+			/*
+				ACCUMULATOR_2D_STORAGE::~ACCUMULATOR_2D_STORAGE()
+				-------------------------------------------------
+			*/
+			/*!
+				@brief Destructor
+			*/
+			~accumulator_2d_storage()
+				{
+				delete [] clean_flag;
+				#ifdef _MSC_VER
+					::free(allocation);
+				#else
+					if (allocation != nullptr)
+						::munmap(allocation, allocation_size);
+				#endif
+				}
+
+			/*
+				ACCUMULATOR_2D_STORAGE::ALLOCATE()
+				----------------------------------
+			*/
+			/*!
+				@brief Allocate space for the given number of clean flags and accumulators.
+				@details Throws std::bad_alloc if the memory cannot be allocated.  Failure to get huge pages is not an error, the
+				accumulators are then in normal pages.
+				@param number_of_clean_flags [in] The number of clean flags needed.
+				@param number_of_accumulators [in] The number of accumulators needed.
+				@param huge_pages [in] Ask the operating system to back the accumulators with huge pages.
+			*/
+			void allocate(size_t number_of_clean_flags, size_t number_of_accumulators, bool huge_pages)
+				{
+				clean_flag = new uint8_t[number_of_clean_flags];
+				size_t bytes = (std::max)(number_of_accumulators, static_cast<size_t>(1)) * sizeof(ELEMENT);
+
+				#ifdef _MSC_VER
+					/*
+						Large pages on Windows need a special privilege so they are not used.
+					*/
+					allocation_size = bytes;
+					allocation = ::malloc(bytes);
+					if (allocation == nullptr)
+						throw std::bad_alloc();
+					accumulator = reinterpret_cast<ELEMENT *>(allocation);
+				#else
+					/*
+						A huge page is only used if the virtual address is aligned on a huge page boundary, so over-allocate and align.
+					*/
+					allocation_size = huge_pages ? (bytes + huge_page_size - 1) / huge_page_size * huge_page_size + huge_page_size : bytes;
+					allocation = ::mmap(nullptr, allocation_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+					if (allocation == MAP_FAILED)
+						{
+						allocation = nullptr;
+						throw std::bad_alloc();
+						}
+					accumulator = reinterpret_cast<ELEMENT *>(allocation);
+
+					if (huge_pages)
+						{
+						accumulator = reinterpret_cast<ELEMENT *>((reinterpret_cast<uintptr_t>(allocation) + huge_page_size - 1) / huge_page_size * huge_page_size);
+						#ifdef MADV_HUGEPAGE
+							(void)::madvise(accumulator, allocation_size - huge_page_size, MADV_HUGEPAGE);
+						#endif
+						}
+				#endif
+				}
+		};
+
 	/*
 		CLASS ACCUMULATOR_2D
 		--------------------
@@ -40,9 +194,10 @@ namespace JASS
 		This implementation differs from that implenentation is so far as the size of the page is alwaya a whole power of 2 and thus the clean flag can
 		be found wiht a bit shit rather than a mod.
 		@tparam ELEMENT The type of accumulator being used (default is uint16_t)
+		@tparam NUMBER_OF_ACCUMULATORS The maximum number of accumulators (the arrays are in-object), or 0 to size (and allocate) the arrays at run time.
 	*/
 	template <typename ELEMENT, size_t NUMBER_OF_ACCUMULATORS, typename = typename std::enable_if<std::is_arithmetic<ELEMENT>::value, ELEMENT>::type>
-	class accumulator_2d
+	class accumulator_2d : public accumulator_2d_storage<ELEMENT, NUMBER_OF_ACCUMULATORS>
 		{
 		/*
 			This somewhat bizar line is so that unittest() can see the private members of another instance of the class.
@@ -51,22 +206,10 @@ namespace JASS
 		template<typename A, size_t B, typename C> friend class accumulator_2d;
 
 		private:
-			/*
-				This class is templated so as to put the array and the clean flags in-object rather than pointers.  So, its necessary
-				to work out the maxumum sizes of the two arrays at compile time and the check at construction that no overflow
-				is happening. This code works out the maximums and allocates the arrays.
-			*/
-			static constexpr size_t maximum_shift = maths::floor_log2(maths::sqrt_compiletime(NUMBER_OF_ACCUMULATORS));					///< The amount to shift to get the right clean flag
-			static constexpr size_t maximum_width = 1 << maximum_shift;																					///< Each clean flag represents this number of accumulators in a "row"
-			static constexpr size_t maximum_number_of_clean_flags = (NUMBER_OF_ACCUMULATORS + maximum_width - 1) / maximum_width;	///< The number of "rows" (i.e. clean flags).
-			static constexpr size_t maximum_number_of_accumulators_allocated = maximum_width * maximum_number_of_clean_flags;			///< The numner of accumulators that were actually allocated (recall that this is a 2D array)
-#ifdef DYNAMIC_ALLOCATION
-			uint8_t *clean_flag;
-			ELEMENT *accumulator;
-#else
-			uint8_t clean_flag[maximum_number_of_clean_flags];																								///< The clean flags are kept as bytes for faster lookup
-			ELEMENT accumulator[maximum_number_of_accumulators_allocated];																				///< The accumulators are kept in an array
-#endif
+			using accumulator_2d_storage<ELEMENT, NUMBER_OF_ACCUMULATORS>::clean_flag;
+			using accumulator_2d_storage<ELEMENT, NUMBER_OF_ACCUMULATORS>::accumulator;
+
+		private:
 			/*
 				At run-time we use these parameters
 			*/
@@ -84,8 +227,9 @@ namespace JASS
 			/*!
 				@brief Constructor.
 				@param number_of_accumulators [in] The numnber of elements in the array being managed.
+				@param huge_pages [in] If the array is allocated at run time then ask for it to be in huge pages (default is false).
 			*/
-			accumulator_2d(size_t number_of_accumulators) :
+			accumulator_2d(size_t number_of_accumulators, bool huge_pages = false) :
 				number_of_accumulators(number_of_accumulators)
 				{
 				/*
@@ -112,18 +256,9 @@ namespace JASS
 				number_of_accumulators_allocated = width * number_of_clean_flags;
 
 				/*
-					Check we've not gone past the end of the arrays
+					Allocate the arrays (or, if they are in-object, check we've not gone past the end of them)
 				*/
-				if (number_of_clean_flags > maximum_number_of_clean_flags || number_of_accumulators_allocated > maximum_number_of_accumulators_allocated)
-					throw std::bad_array_new_length();
-
-#ifdef DYNAMIC_ALLOCATION
-				/*
-					Allocate the clean flags and the accumulators using new
-				*/
-				clean_flag = new uint8_t[number_of_clean_flags];
-				accumulator = new ELEMENT[number_of_accumulators_allocated];
-#endif
+				this->allocate(number_of_clean_flags, number_of_accumulators_allocated, huge_pages);
 
 				/*
 					Clear the clean flags ready for use.
@@ -180,6 +315,63 @@ namespace JASS
 				std::fill(clean_flag, clean_flag + number_of_clean_flags, false);
 				}
 
+			/*
+				ACCUMULATOR_2D::NUMBER_OF_ROWS()
+				--------------------------------
+			*/
+			/*!
+				@brief Return the number of rows (i.e. clean flags) in the array.
+				@return The number of rows.
+			*/
+			size_t number_of_rows(void) const
+				{
+				return number_of_clean_flags;
+				}
+
+			/*
+				ACCUMULATOR_2D::ROW_WIDTH()
+				---------------------------
+			*/
+			/*!
+				@brief Return the number of accumulators in each row.
+				@return The width of a row.
+			*/
+			size_t row_width(void) const
+				{
+				return width;
+				}
+
+			/*
+				ACCUMULATOR_2D::ROW_IN_USE()
+				----------------------------
+			*/
+			/*!
+				@brief Has the given row been initialised since the last rewind()?
+				@details Rows that are not in use are all (logically) zero, so a scan for non-zero accumulators need only look at the rows in use.
+				@param row [in] The row to check.
+				@return true if the row has been initialised, else false.
+			*/
+			bool row_in_use(size_t row) const
+				{
+				return clean_flag[row];
+				}
+
+			/*
+				ACCUMULATOR_2D::ROW()
+				---------------------
+			*/
+			/*!
+				@brief Return a pointer to the first accumulator in the given row.
+				@details The row is not initialised, so the contents are only valid if row_in_use(row) is true.  Accumulators in the last row past
+				size() are valid (and zero) but do not belong to any document.
+				@param row [in] The row.
+				@return A pointer to row_width() accumulators.
+			*/
+			ELEMENT *row(size_t row)
+				{
+				return &accumulator[row * width];
+				}
+
 			/*
 				ACCUMULATOR_2D::UNITTEST_EXAMPLE()
 				----------------------------------
@@ -233,6 +425,18 @@ namespace JASS
 
 				unittest_example(array);
 
+				/*
+					Check the row interface matches element access
+				*/
+				JASS_assert(array.number_of_rows() == 8);
+				JASS_assert(array.row_width() == 8);
+				JASS_assert(array.row(3)[2] == 3 * 8 + 2);
+				array.rewind();
+				JASS_assert(!array.row_in_use(3));
+				array[3 * 8 + 1] = 1;
+				JASS_assert(array.row_in_use(3));
+				JASS_assert(!array.row_in_use(4));
+
 				/*
 					Make sure it all works right when there is a single accumulator in the last row
 				*/
@@ -263,6 +467,35 @@ namespace JASS
 
 				unittest_example(array_one);
 
+				/*
+					Make sure the run-time sized arrays work the same way as the in-object arrays
+				*/
+				accumulator_2d<size_t, 0> array_dynamic(65);
+				JASS_assert(array_dynamic.width == 8);
+				JASS_assert(array_dynamic.shift == 3);
+				JASS_assert(array_dynamic.number_of_clean_flags == 9);
+
+				unittest_example(array_dynamic);
+
+				accumulator_2d<uint16_t, 0> array_huge(1000, true);
+				unittest_example(array_huge);
+				array_huge.rewind();
+				JASS_assert(array_huge[999] == 0);
+
+				/*
+					Make sure an in-object array that is too small is caught
+				*/
+				bool thrown = false;
+				try
+					{
+					accumulator_2d<size_t, 64> too_small(65);
+					}
+				catch (std::bad_array_new_length &)
+					{
+					thrown = true;
+					}
+				JASS_assert(thrown);
+
 				puts("accumulator_2d::PASSED");
 				}
 		};
@@ -192,6 +192,39 @@ namespace JASS
 #endif
 		}
 
+	/*
+		ALLOCATOR_POOL::RECYCLE()
+		-------------------------
+	*/
+	void allocator_pool::recycle(void)
+		{
+#ifdef USE_CRT_MALLOC
+		rewind();
+#else
+		chunk *keep = current_chunk;
+		if (keep == nullptr)
+			return;
+
+		/*
+			Free all memory blocks except the most recent
+		*/
+		chunk *killer;
+		for (chunk *chain = keep->next_chunk; chain != nullptr; chain = killer)
+			{
+			killer = chain->next_chunk;
+			dealloc(chain);
+			}
+
+		/*
+			The kept block is now empty
+		*/
+		keep->next_chunk = nullptr;
+		keep->chunk_at = keep->data;
+		used = 0;
+		allocated = keep->chunk_size;
+#endif
+		}
+
 	/*
 		ALLOCATOR_POOL::UNITTEST_THREAD()
 		---------------------------------
@@ -252,6 +285,16 @@ namespace JASS
 		JASS_assert(memory == memory);
 		JASS_assert(memory != second);
 
+		/*
+			recycle the memory and check the next allocation comes from the same chunk
+		*/
+		size_t capacity = memory.capacity();
+		memory.recycle();
+		JASS_assert(memory.size() == 0);
+		JASS_assert(memory.capacity() == capacity);
+		JASS_assert(memory.malloc(431) == block);
+		JASS_assert(memory.size() == 431);
+
 		/*
 			free up all the memory
 		*/
@@ -284,6 +284,17 @@ namespace JASS
 			*/
 			virtual void rewind(void);
 
+			/*
+				ALLOCATOR_POOL::RECYCLE()
+				-------------------------
+			*/
+			/*!
+				@brief Throw away (without calling delete) all objects allocated in the memory space of this object, but keep the most recent large allocation for re-use.
+				@details Unlike rewind(), the next allocations come from the kept chunk rather than the C++ free store, so an object that is re-used
+				many times (such as a query) can reset its memory on each use without calling malloc() or free().  This method is not thread-safe.
+			*/
+			void recycle(void);
+
 			/*
 				ALLOCATOR_POOL::UNITTEST_THREAD()
 				---------------------------------
@@ -0,0 +1,135 @@
+/*
+	BARRIER.H
+	---------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief A reusable thread barrier.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <stdio.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "asserts.h"
+#include "threads.h"
+
+namespace JASS
+	{
+	/*
+		CLASS BARRIER
+		-------------
+	*/
+	/*!
+		@brief A reusable (sense reversing) thread barrier.
+		@details A barrier is used to stop a team of threads until all members of the team have reached the same point in the code.
+		Once the last thread arrives all threads are released and the barrier is ready to be used again.  This barrier spins (with
+		a yield) rather than sleeping as it is used between the phases of a single query where the wait is expected to be very short
+		and the cost of waking a sleeping thread is comparable to the cost of the phase itself.
+	*/
+	class barrier
+		{
+		private:
+			size_t members;							///< The number of threads that must arrive before the barrier opens.
+			std::atomic<size_t> waiting;			///< The number of threads that have arrived at the barrier.
+			std::atomic<size_t> generation;		///< Incremented each time the barrier opens, this is what the waiting threads spin on.
+
+		public:
+			/*
+				BARRIER::BARRIER()
+				------------------
+			*/
+			/*!
+				@brief Constructor.
+				@param members [in] The number of threads in the team (i.e. that must call wait() before the barrier opens).
+			*/
+			explicit barrier(size_t members) :
+				members(members),
+				waiting(0),
+				generation(0)
+				{
+				/* Nothing */
+				}
+
+			/*
+				BARRIER::WAIT()
+				---------------
+			*/
+			/*!
+				@brief Block until all members of the team have called wait().
+			*/
+			void wait(void)
+				{
+				size_t current_generation = generation.load();
+
+				if (waiting.fetch_add(1) + 1 == members)
+					{
+					/*
+						We're the last to arrive so reset for next time and open the barrier.
+					*/
+					waiting = 0;
+					generation++;
+					}
+				else
+					while (generation.load() == current_generation)
+						std::this_thread::yield();
+				}
+
+			/*
+				BARRIER::UNITTEST_THREAD()
+				--------------------------
+			*/
+			/*!
+				@brief Unit test this class - the work done by each thread.
+				@param gate [in] The barrier being tested.
+				@param arrivals [in/out] The number of threads that have passed each phase.
+				@param failures [out] The number of times a thread saw a phase that was not complete.
+				@param members [in] The number of threads in the team.
+			*/
+			static void unittest_thread(barrier &gate, std::atomic<size_t> &arrivals, std::atomic<size_t> &failures, size_t members)
+				{
+				for (size_t phase = 1; phase <= 100; phase++)
+					{
+					arrivals++;
+					gate.wait();
+					if (arrivals.load() < phase * members)
+						failures++;
+					gate.wait();
+					}
+				}
+
+			/*
+				BARRIER::UNITTEST()
+				-------------------
+			*/
+			/*!
+				@brief Unit test this class.
+			*/
+			static void unittest(void)
+				{
+				const size_t members = 4;
+				barrier gate(members);
+				std::atomic<size_t> arrivals(0);
+				std::atomic<size_t> failures(0);
+				std::vector<thread> team;
+
+				for (size_t which = 0; which < members; which++)
+					team.push_back(thread(unittest_thread, std::ref(gate), std::ref(arrivals), std::ref(failures), members));
+
+				for (auto &member : team)
+					member.join();
+
+				JASS_assert(arrivals == 100 * members);
+				JASS_assert(failures == 0);
+
+				puts("barrier::PASSED");
+				}
+		};
+	}
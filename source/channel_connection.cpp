@@ -0,0 +1,238 @@
+/*
+	CHANNEL_CONNECTION.CPP
+	----------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+	#include <winsock2.h>
+#else
+	#include <unistd.h>
+	#include <sys/types.h>
+	#include <sys/socket.h>
+#endif
+
+#include <algorithm>
+
+#include "file.h"
+#include "asserts.h"
+#include "threads.h"
+#include "socket_listener.h"
+#include "channel_connection.h"
+
+#ifndef MSG_NOSIGNAL
+	#define MSG_NOSIGNAL 0
+#endif
+
+namespace JASS
+	{
+	/*
+		CHANNEL_CONNECTION::CHANNEL_CONNECTION()
+		----------------------------------------
+	*/
+	channel_connection::channel_connection(intptr_t descriptor) :
+		descriptor(descriptor),
+		buffer_start(0),
+		buffer_end(0)
+		{
+		/* Nothing */
+		}
+
+	/*
+		CHANNEL_CONNECTION::CHANNEL_CONNECTION()
+		----------------------------------------
+	*/
+	channel_connection::channel_connection(const std::string &address) :
+		descriptor(socket_listener::connect(address)),
+		buffer_start(0),
+		buffer_end(0)
+		{
+		/* Nothing */
+		}
+
+	/*
+		CHANNEL_CONNECTION::~CHANNEL_CONNECTION()
+		-----------------------------------------
+	*/
+	channel_connection::~channel_connection()
+		{
+		if (descriptor != -1)
+			#ifdef _MSC_VER
+				::closesocket(descriptor);
+			#else
+				::close(descriptor);
+			#endif
+		}
+
+	/*
+		CHANNEL_CONNECTION::BLOCK_WRITE()
+		---------------------------------
+	*/
+	size_t channel_connection::block_write(const void *buffer, size_t length)
+		{
+		const char *from = reinterpret_cast<const char *>(buffer);
+		size_t written = 0;
+
+		if (descriptor == -1)
+			return 0;
+
+		/*
+			send() can return before everything is sent so keep going until it is all gone (or there is an error).  MSG_NOSIGNAL stops a closed connection killing the server with SIGPIPE.
+		*/
+		while (written < length)
+			{
+			auto sent = ::send(descriptor, from + written, static_cast<int>(length - written), MSG_NOSIGNAL);
+			if (sent <= 0)
+				break;
+			written += sent;
+			}
+
+		return written;
+		}
+
+	/*
+		CHANNEL_CONNECTION::BLOCK_READ()
+		--------------------------------
+	*/
+	size_t channel_connection::block_read(void *into, size_t length)
+		{
+		char *to = reinterpret_cast<char *>(into);
+		size_t got = 0;
+
+		if (descriptor == -1)
+			return 0;
+
+		while (got < length)
+			{
+			/*
+				If the buffer is empty then re-fill it (and stop at end of file or error)
+			*/
+			if (buffer_start == buffer_end)
+				{
+				auto received = ::recv(descriptor, buffer, buffer_size, 0);
+				if (received <= 0)
+					break;
+				buffer_start = 0;
+				buffer_end = received;
+				}
+
+			size_t available = (std::min)(buffer_end - buffer_start, length - got);
+			memcpy(to + got, buffer + buffer_start, available);
+			buffer_start += available;
+			got += available;
+			}
+
+		return got;
+		}
+
+	/*
+		CHANNEL_CONNECTION::WRITE()
+		---------------------------
+	*/
+	bool channel_connection::write(const std::string &data)
+		{
+		std::unique_lock<std::mutex> guard(write_lock);
+
+		return block_write(data.c_str(), data.size()) == data.size();
+		}
+
+	/*
+		CHANNEL_CONNECTION::SHUTDOWN_READ()
+		-----------------------------------
+	*/
+	void channel_connection::shutdown_read(void)
+		{
+		if (descriptor != -1)
+			#ifdef _MSC_VER
+				::shutdown(descriptor, SD_RECEIVE);
+			#else
+				::shutdown(descriptor, SHUT_RD);
+			#endif
+		}
+
+	/*
+		CHANNEL_CONNECTION::SHUTDOWN_WRITE()
+		------------------------------------
+	*/
+	void channel_connection::shutdown_write(void)
+		{
+		if (descriptor != -1)
+			#ifdef _MSC_VER
+				::shutdown(descriptor, SD_SEND);
+			#else
+				::shutdown(descriptor, SHUT_WR);
+			#endif
+		}
+
+	/*
+		CHANNEL_CONNECTION_UNITTEST_SERVER()
+		------------------------------------
+	*/
+	/*!
+		@brief The server half of the unit test - echo each line back in upper case.
+		@param listener [in] The listening socket.
+	*/
+	static void channel_connection_unittest_server(socket_listener &listener)
+		{
+		channel_connection server(listener.accept());
+		std::string line;
+
+		for (server.gets(line); line.size() != 0; server.gets(line))
+			{
+			for (auto &character : line)
+				character = static_cast<char>(toupper(character));
+			server.write(line);
+			}
+		}
+
+	/*
+		CHANNEL_CONNECTION::UNITTEST()
+		------------------------------
+	*/
+	void channel_connection::unittest(void)
+		{
+		#ifndef _MSC_VER
+			/*
+				Use a Unix domain socket in the current directory so that we don't need a free TCP port
+			*/
+			std::string address = "unix:" + file::mkstemp("jass");
+
+			socket_listener listener;
+			JASS_assert(listener.listen(address));
+			thread server(channel_connection_unittest_server, std::ref(listener));
+
+			/*
+				Send two lines (in one write) and check both come back.  The second line is long enough to cross the read buffer.
+			*/
+			channel_connection client(address);
+			JASS_assert(client.connected());
+
+			std::string long_line(buffer_size + 100, 'x');
+			JASS_assert(client.write("hello\n" + long_line + "\n"));
+			client.shutdown_write();
+
+			std::string answer;
+			client.gets(answer);
+			JASS_assert(answer == "HELLO\n");
+			client.gets(answer);
+			JASS_assert(answer == std::string(buffer_size + 100, 'X') + "\n");
+			client.gets(answer);
+			JASS_assert(answer.size() == 0);				// end of file
+
+			server.join();
+			listener.close();
+
+			/*
+				Connecting to a socket no-one is listening on must fail
+			*/
+			channel_connection nowhere(address);
+			JASS_assert(!nowhere.connected());
+		#endif
+
+		::puts("channel_connection::PASSED");
+		}
+	}
@@ -0,0 +1,172 @@
+/*
+	CHANNEL_CONNECTION.H
+	--------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief Input and output channel over a connected (TCP or Unix domain) socket.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+
+#include "channel.h"
+
+namespace JASS
+	{
+	/*
+		CLASS CHANNEL_CONNECTION
+		------------------------
+	*/
+	/*!
+		@brief Input and output channel over a connected (TCP or Unix domain) socket.
+		@details The server side of the connection is usually the result of socket_listener::accept(), the client side is created by connecting
+		to an address (see socket_listener::listen() for the format of the address).  Reads are buffered so that channel::gets() doesn't result in
+		one system call per byte.  Writes are not buffered, and each call to write() is atomic with respect to other calls to write() so that
+		several threads can answer down the same connection.
+	*/
+	class channel_connection : public channel
+		{
+		private:
+			static constexpr size_t buffer_size = 16 * 1024;		///< The size of the read buffer.
+
+		private:
+			intptr_t descriptor;							///< The socket (or -1 if not connected).
+			char buffer[buffer_size];					///< Data read from the socket but not yet consumed.
+			size_t buffer_start;							///< The first unconsumed byte in buffer.
+			size_t buffer_end;							///< One past the last unconsumed byte in buffer.
+			std::mutex write_lock;						///< Serialises calls to write().
+
+		private:
+			/*
+				CHANNEL_CONNECTION::CHANNEL_CONNECTION()
+				----------------------------------------
+			*/
+			/*!
+				@brief Private copy constructor prevents object copying.
+			*/
+			channel_connection(const channel_connection &) = delete;
+
+			/*
+				CHANNEL_CONNECTION::OPERATOR=()
+				-------------------------------
+			*/
+			/*!
+				@brief Private assignment operator prevents assigning to this object.
+			*/
+			channel_connection &operator=(const channel_connection &) = delete;
+
+		protected:
+			/*
+				CHANNEL_CONNECTION::BLOCK_WRITE()
+				---------------------------------
+			*/
+			/*!
+				@brief All output happens via the block_write method.
+				@param buffer [in] write length number of bytes from buffer
+				@param length [in] The number of bytes go write.
+				@return The number of bytes written (usually equal to length).
+			*/
+			virtual size_t block_write(const void *buffer, size_t length);
+
+			/*
+				CHANNEL_CONNECTION::BLOCK_READ()
+				--------------------------------
+			*/
+			/*!
+				@brief All input happens via the block_read method.
+				@param into [out] length number of bytes are written into here
+				@param length [in] The number of bytes go write.
+				@return The number of buyes read (usually equal to length, less at end of file).
+			*/
+			virtual size_t block_read(void *into, size_t length);
+
+		public:
+			/*
+				CHANNEL_CONNECTION::CHANNEL_CONNECTION()
+				----------------------------------------
+			*/
+			/*!
+				@brief Constructor using an already connected socket (the channel takes ownership and closes it on destruction).
+				@param descriptor [in] The connected socket, such as that returned by socket_listener::accept().
+			*/
+			explicit channel_connection(intptr_t descriptor);
+
+			/*
+				CHANNEL_CONNECTION::CHANNEL_CONNECTION()
+				----------------------------------------
+			*/
+			/*!
+				@brief Constructor that connects to the given address.  Use connected() to check for success.
+				@param address [in] Either "[host:]port" for TCP (host defaults to localhost), or "unix:path" for a Unix domain socket.
+			*/
+			explicit channel_connection(const std::string &address);
+
+			/*
+				CHANNEL_CONNECTION::~CHANNEL_CONNECTION()
+				-----------------------------------------
+			*/
+			/*!
+				@brief Destructor.  Closes the socket.
+			*/
+			virtual ~channel_connection();
+
+			/*
+				CHANNEL_CONNECTION::CONNECTED()
+				-------------------------------
+			*/
+			/*!
+				@brief Is there a connection?
+				@return true if there is a socket, else false.
+			*/
+			bool connected(void) const
+				{
+				return descriptor != -1;
+				}
+
+			/*
+				CHANNEL_CONNECTION::WRITE()
+				---------------------------
+			*/
+			/*!
+				@brief Write the whole of the given string as a single atomic write (with respect to other calls to write()).
+				@param data [in] The data to write.
+				@return true on success, false on failure.
+			*/
+			bool write(const std::string &data);
+
+			/*
+				CHANNEL_CONNECTION::SHUTDOWN_READ()
+				-----------------------------------
+			*/
+			/*!
+				@brief Stop reading from the connection (any blocked read returns end of file), but allow writing to continue.
+			*/
+			void shutdown_read(void);
+
+			/*
+				CHANNEL_CONNECTION::SHUTDOWN_WRITE()
+				------------------------------------
+			*/
+			/*!
+				@brief Tell the other end that there is no more to write (it sees end of file), but allow reading to continue.
+			*/
+			void shutdown_write(void);
+
+			/*
+				CHANNEL_CONNECTION::UNITTEST()
+				------------------------------
+			*/
+			/*!
+				@brief Unit test this class (and socket_listener).
+			*/
+			static void unittest(void);
+		};
+	}
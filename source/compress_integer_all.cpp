@@ -72,11 +72,11 @@ namespace JASS
 			{
 			{"-cc",    "--compress_carryover_12", "Carryover-12", &carryover_12},
 			{"-cC",    "--compress_carry_8b", "Carry-8b", &carry_8b},
-			{"-cd",    "--compress_elias_delta", "Elias delta", &elias_delta},
+			{"-cd",    "--compress_elias_delta", "Elias delta", &elias_delta, hardware_support::simd::avx2},
 			{"-cD",    "--compress_elias_delta_bitwise", "Elias delta with bit instuctions (slow)", &elias_delta_bitwise},
 			{"-ce",    "--compress_elias_delta_SIMD", "Group Elias Delta SIMD", &elias_delta_simd},
 			{"-cE",    "--compress_elias_gamma_SIMD", "Group Elias Gamma SIMD", &elias_gamma_simd},
-			{"-cg",    "--compress_elias_gamma", "Elias gamma", &elias_gamma},
+			{"-cg",    "--compress_elias_gamma", "Elias gamma", &elias_gamma, hardware_support::simd::avx2},
 			{"-cG",    "--compress_elias_gamma_bitwise", "Elias gamma with bit instuctions (slow)", &elias_gamma_bitwise},
 			{"-cn",    "--compress_none", "None", &none},
 			{"-cp",    "--compress_simple_9_packed", "Optimal Packed Simple-9", &simple_9_packed},
@@ -92,7 +92,7 @@ namespace JASS
 			{"-cx",    "--compress_qmx_original", "QMX Original", &qmx_original},
 			{"-cZ",    "--compress_qmx_jass_v1", "QMX JASS v1", &qmx_jass_v1},
 			{"-c128",  "--compress_128", "Binpack into 128-bit SIMD integers", &bitpack_128},
-			{"-c256",  "--compress_256", "Binpack into 256-bit SIMD integers", &bitpack_256},
+			{"-c256",  "--compress_256", "Binpack into 256-bit SIMD integers", &bitpack_256, hardware_support::simd::avx2},
 			{"-c32r",  "--compress_32", "Binpack into 32-bit integers with 8 selectors", &bitpack_32_reduced},
 			{"-c64",   "--compress_64", "Binpack into 64-bit integers", &bitpack_64},
 			}
@@ -141,6 +141,7 @@ namespace JASS
 		JASS_assert(parameters[1] == true);
 		JASS_assert(name(parameters) == compressors[1].description);
 		JASS_assert(&compressor(parameters) == compressors[1].codex);
+		JASS_assert(supported(parameters));
 
 		/*
 			Check what happens if we don't have any parameters.
@@ -157,6 +158,19 @@ namespace JASS
 		JASS_assert(name(parameters) == "None");
 		JASS_assert(&compressor(parameters) == compressors[default_compressor].codex);
 
+		/*
+			Check that a compressor that needs AVX2 cannot be used once the instruction set is limited
+		*/
+		hardware_support::simd original = hardware_support::instruction_set();
+		parameters = {};
+		const char *argv256[] = {"program", "-c256"};
+		success = commandline::parse(2, argv256, parameter_list, errors);
+		JASS_assert(success == true);
+		hardware_support::limit(hardware_support::simd::sse41);
+		JASS_assert(!supported(parameters));
+		hardware_support::limit(original);
+		JASS_assert(supported(parameters) == (original >= hardware_support::simd::avx2));
+
 		puts("compress_integer_all::PASSED");
 		}
 	}
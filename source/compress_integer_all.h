@@ -18,6 +18,7 @@
 
 #include "commandline.h"
 #include "compress_integer.h"
+#include "hardware_support.h"
 
 namespace JASS
 	{
@@ -51,6 +52,7 @@ namespace JASS
 					const char *longname;					///< The long command line parameter.
 					const char *description;				///< The name of the scheme, in command line use other stuff is wrapped around this.
 					compress_integer *codex;				///< An instance of the compressor.
+					hardware_support::simd instructions = hardware_support::simd::sse41;		///< The least instruction set the compressor needs (see hardware_support::instruction_set()).
 				};
 
 		private:
@@ -138,6 +140,24 @@ namespace JASS
 				return compressors[default_compressor].description;
 				}
 
+			/*
+				COMPRESS_INTEGER_ALL::SUPPORTED()
+				---------------------------------
+			*/
+			/*!
+				@brief Can the first selected compressor (according to option) be used on this CPU (some need AVX2 or BMI and have no fallback)?
+				@param option [in] An array (one per compressor) with (preferably) one set to true.
+				@return true if the compressor can be used, else false.
+			*/
+			static bool supported(const std::array<bool, compressors_size> &option)
+				{
+				for (size_t which = 0; which < compressors_size; which++)
+					if (option[which])
+						return compressors[which].instructions <= hardware_support::instruction_set();
+
+				return compressors[default_compressor].instructions <= hardware_support::instruction_set();
+				}
+
 			/*
 				COMPRESS_INTEGER_ALL::GET_BY_NAME()
 				-----------------------------------
@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "maths.h"
+#include "hardware_support.h"
 #include "asserts.h"
 #include "compress_integer_bitpack_256.h"
 
@@ -29,7 +30,7 @@ namespace JASS
 		COMPRESS_INTEGER_BITPACK_256::DECODE()
 		--------------------------------------
 	*/
-	void compress_integer_bitpack_256::decode(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
+	JASS_TARGET_AVX2 void compress_integer_bitpack_256::decode(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
 		{
 		__m256i *into = (__m256i *)decoded;
 		__m256i data;
@@ -62,6 +62,7 @@ namespace JASS
 			*/
 			/*!
 				@brief Decode a sequence of integers encoded with this codex.
+				@details This uses BMI so it can only be called if hardware_support::instruction_set() is at least simd::avx2.
 				@param decoded [out] The sequence of decoded integers.
 				@param integers_to_decode [in] The minimum number of integers to decode (it may decode more).
 				@param source [in] The encoded integers.
@@ -14,6 +14,7 @@
 #include <iostream>
 
 #include "maths.h"
+#include "hardware_support.h"
 #include "compress_integer_elias_delta_simd.h"
 
 #define WORD_WIDTH 32
@@ -297,12 +298,12 @@ namespace JASS
  		/*
  			get the width
  		*/
- 		uint8_t unary = (uint8_t)_tzcnt_u64(accumulated_selector);
+ 		uint8_t unary = (uint8_t)(find_first_set_bit(accumulated_selector) - 1);
 
  		/*
  			get the zig-zag encoded binary, unzig-zag it and store it
  		*/
- 		uint8_t decoded = (uint8_t)((_bextr_u64(accumulated_selector, unary, unary + 1) >> 1)) | (1UL << unary);
+ 		uint8_t decoded = (uint8_t)((((accumulated_selector >> unary) & ((1ULL << (unary + 1)) - 1)) >> 1)) | (1UL << unary);
 
  		/*
  			Remember how much we've already used
@@ -313,12 +314,12 @@ namespace JASS
  		return decoded;
  		}
 
-#ifdef __AVX512F__
 	/*
-		COMPRESS_INTEGER_ELIAS_DELTA_SIMD::DECODE()
-		-------------------------------------------
+		COMPRESS_INTEGER_ELIAS_DELTA_SIMD::DECODE_AVX512()
+		--------------------------------------------------
+		As with Elias gamma, the shifts use the maskz forms so that GCC does not warn about an undefined source register.
 	*/
-	void compress_integer_elias_delta_simd::decode(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
+	JASS_TARGET_AVX512 void compress_integer_elias_delta_simd::decode_avx512(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
 		{
 		uint32_t used = 0;
 		__m512i *into = reinterpret_cast<__m512i *>(decoded);
@@ -346,7 +347,7 @@ namespace JASS
 				{
 				const __m512i mask = _mm512_loadu_si512(reinterpret_cast<const __m512i *>(mask_set[width]));
 				_mm512_storeu_si512(into, _mm512_and_si512(payload, mask));
-				payload = _mm512_srli_epi32(payload, width);
+				payload = _mm512_maskz_srli_epi32(0xFFFF, payload, width);
 
 				used += width;
 				into++;
@@ -356,7 +357,7 @@ namespace JASS
 				/*
 					Save the remaining bits
 				*/
-				__m512i high_bits = _mm512_slli_epi32(payload, width - (32 - used));
+				__m512i high_bits = _mm512_maskz_slli_epi32(0xFFFF, payload, width - (32 - used));
 
 				/*
 					move on to the next word
@@ -369,19 +370,19 @@ namespace JASS
 				*/
 				__m512i mask = _mm512_loadu_si512(reinterpret_cast<const __m512i *>(mask_set[used + width - 32]));		// the remaining bits in the AVX word
 				_mm512_storeu_si512(into, _mm512_or_si512(_mm512_and_si512(payload, mask), high_bits));
-				payload = _mm512_srli_epi32(payload, used + width - 32);
+				payload = _mm512_maskz_srli_epi32(0xFFFF, payload, used + width - 32);
 
 				used = used + width - 32;
 				into++;;
 				}
 		}
 	}
-#elif defined(__AVX2__)
+
 	/*
-		COMPRESS_INTEGER_ELIAS_DELTA_SIMD::DECODE()
-		-------------------------------------------
+		COMPRESS_INTEGER_ELIAS_DELTA_SIMD::DECODE_AVX2()
+		------------------------------------------------
 	*/
-	void compress_integer_elias_delta_simd::decode(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
+	JASS_TARGET_AVX2 void compress_integer_elias_delta_simd::decode_avx2(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
 		{
 		uint32_t used = 0;
 		__m256i *into = reinterpret_cast<__m256i *>(decoded);
@@ -446,9 +447,111 @@ namespace JASS
 				}
 		}
 	}
-#else
-	#error "Must have either AVX2 or AVX512"
-#endif
+
+	/*
+		COMPRESS_INTEGER_ELIAS_DELTA_SIMD::DECODE_SSE41()
+		-------------------------------------------------
+	*/
+	void compress_integer_elias_delta_simd::decode_sse41(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
+		{
+		uint32_t used = 0;
+		__m128i *into = reinterpret_cast<__m128i *>(decoded);
+		__m128i *end_of_output = reinterpret_cast<__m128i *>(decoded + integers_to_decode);
+
+		/*
+			Set up the initial selector
+		*/
+		uint64_t accumulated_selector = 0;
+		uint32_t selector_bits_used = 64;
+		const uint32_t *selector = reinterpret_cast<const uint32_t *>(reinterpret_cast<const uint8_t *>(source_as_void) + source_length) - 1;
+
+		/*
+			Set up the initial payload
+		*/
+		const uint32_t *source = reinterpret_cast<const uint32_t *>(source_as_void);
+		__m128i payload1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source));
+		__m128i payload2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 4));
+		__m128i payload3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 8));
+		__m128i payload4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 12));
+		source += 16;
+
+		while (into < end_of_output)
+			{
+			uint32_t width = decode_selector(selector, selector_bits_used, accumulated_selector);
+
+			if (used + width <= 32)
+				{
+				const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mask_set[width]));
+				_mm_storeu_si128(into, _mm_and_si128(payload1, mask));
+				_mm_storeu_si128(into + 1, _mm_and_si128(payload2, mask));
+				_mm_storeu_si128(into + 2, _mm_and_si128(payload3, mask));
+				_mm_storeu_si128(into + 3, _mm_and_si128(payload4, mask));
+				payload1 = _mm_srli_epi32(payload1, width);
+				payload2 = _mm_srli_epi32(payload2, width);
+				payload3 = _mm_srli_epi32(payload3, width);
+				payload4 = _mm_srli_epi32(payload4, width);
+
+				used += width;
+				into += 4;
+				}
+			else
+				{
+				/*
+					Save the remaining bits
+				*/
+				__m128i high_bits1 = _mm_slli_epi32(payload1, width - (32 - used));
+				__m128i high_bits2 = _mm_slli_epi32(payload2, width - (32 - used));
+				__m128i high_bits3 = _mm_slli_epi32(payload3, width - (32 - used));
+				__m128i high_bits4 = _mm_slli_epi32(payload4, width - (32 - used));
+
+				/*
+					move on to the next word
+				*/
+				payload1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source));
+				payload2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 4));
+				payload3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 8));
+				payload4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + 12));
+				source += 16;
+
+				/*
+					Decode and write to memory
+				*/
+				__m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mask_set[used + width - 32]));		// the remaining bits in the SIMD word
+				_mm_storeu_si128(into, _mm_or_si128(_mm_and_si128(payload1, mask), high_bits1));
+				_mm_storeu_si128(into + 1, _mm_or_si128(_mm_and_si128(payload2, mask), high_bits2));
+				_mm_storeu_si128(into + 2, _mm_or_si128(_mm_and_si128(payload3, mask), high_bits3));
+				_mm_storeu_si128(into + 3, _mm_or_si128(_mm_and_si128(payload4, mask), high_bits4));
+				payload1 = _mm_srli_epi32(payload1, used + width - 32);
+				payload2 = _mm_srli_epi32(payload2, used + width - 32);
+				payload3 = _mm_srli_epi32(payload3, used + width - 32);
+				payload4 = _mm_srli_epi32(payload4, used + width - 32);
+
+				used = used + width - 32;
+				into += 4;
+				}
+			}
+		}
+
+	/*
+		COMPRESS_INTEGER_ELIAS_DELTA_SIMD::DECODE()
+		-------------------------------------------
+	*/
+	void compress_integer_elias_delta_simd::decode(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
+		{
+		switch (hardware_support::instruction_set())
+			{
+			case hardware_support::simd::avx512:
+				decode_avx512(decoded, integers_to_decode, source_as_void, source_length);
+				break;
+			case hardware_support::simd::avx2:
+				decode_avx2(decoded, integers_to_decode, source_as_void, source_length);
+				break;
+			default:
+				decode_sse41(decoded, integers_to_decode, source_as_void, source_length);
+				break;
+			}
+		}
+
 	/*
 		COMPRESS_INTEGER_ELIAS_DELTA_SIMD::UNITTEST()
 		---------------------------------------------
@@ -457,8 +560,6 @@ namespace JASS
 		{
 		compress_integer_elias_delta_simd compressor;
 
-		compress_integer::unittest(compress_integer_elias_delta_simd(), 1);
-
 		std::vector<uint32_t> broken_sequence =
 			{
 			6,10,2,1,2,1,1,1,1,2,2,1,1,14,1,1,		// 4 bits
@@ -490,8 +591,6 @@ namespace JASS
 			25,9,6,9,6,3,41,17,15,11,33,8,1,1,1,1			// 6 bits
 			};
 
-		unittest_one(compressor, broken_sequence);
-
 		std::vector<uint32_t> second_broken_sequence =
 			{
 			1, 1, 1, 793, 1, 1, 1, 1, 2, 1, 5, 3, 2, 1, 5, 63,		// 10 bits
@@ -504,7 +603,18 @@ namespace JASS
 			6, 2, 2, 1															// 3 bits
 			};
 
-		unittest_one(compressor, second_broken_sequence);
+		/*
+			Check each decoder (up to the fastest this CPU can run)
+		*/
+		hardware_support::simd original = hardware_support::instruction_set();
+		for (auto instructions : {hardware_support::simd::sse41, hardware_support::simd::avx2, hardware_support::simd::avx512})
+			{
+			hardware_support::limit(instructions);
+			compress_integer::unittest(compress_integer_elias_delta_simd(), 1);
+			unittest_one(compressor, broken_sequence);
+			unittest_one(compressor, second_broken_sequence);
+			}
+		hardware_support::limit(original);
 
 		puts("compress_integer_elias_delta_simd::PASSED");
 		}
@@ -8,6 +8,7 @@
 #include <immintrin.h>
 
 #include "maths.h"
+#include "hardware_support.h"
 #include "compress_integer_elias_gamma.h"
 
 namespace JASS
@@ -66,7 +67,7 @@ namespace JASS
 		COMPRESS_INTEGER_ELIAS_GAMMA::DECODE()
 		--------------------------------------
 	*/
-	void compress_integer_elias_gamma::decode(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
+	JASS_TARGET_AVX2 void compress_integer_elias_gamma::decode(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
 		{
 		const uint64_t *source = reinterpret_cast<const uint64_t *>(source_as_void);
 		uint64_t value = 0;
@@ -12,6 +12,7 @@
 #include <iostream>
 
 #include "maths.h"
+#include "hardware_support.h"
 #include "compress_integer_elias_gamma_simd.h"
 
 #define WORD_WIDTH 32
@@ -242,12 +243,12 @@ namespace JASS
 		};
 
 
-#ifdef __AVX512F__
 		/*
-			COMPRESS_INTEGER_ELIAS_GAMMA_SIMD::DECODE()
-			-------------------------------------------
+			COMPRESS_INTEGER_ELIAS_GAMMA_SIMD::DECODE_AVX512()
+			--------------------------------------------------
+			The shifts are the zero-masking (maskz) forms as GCC warns that the plain AVX-512 shifts read an undefined register.
 		*/
-		void compress_integer_elias_gamma_simd::decode(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
+		JASS_TARGET_AVX512 void compress_integer_elias_gamma_simd::decode_avx512(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
 			{
 			__m512i mask;
 			const uint8_t *source = (const uint8_t *)source_as_void;
@@ -263,7 +264,7 @@ namespace JASS
 				uint32_t width = (uint32_t)find_first_set_bit(selector);
 				mask = _mm512_loadu_si512((__m512i *)mask_set[width]);
 				_mm512_storeu_si512(into, _mm512_and_si512(payload, mask));
-				payload = _mm512_srli_epi32(payload, width);
+				payload = _mm512_maskz_srli_epi32(0xFFFF, payload, width);
 
 				into++;
 				selector >>= width;
@@ -290,11 +291,11 @@ namespace JASS
 					*/
 					width = (uint32_t)find_first_set_bit(selector);
 
-					high_bits = _mm512_slli_epi32(high_bits, width);
+					high_bits = _mm512_maskz_slli_epi32(0xFFFF, high_bits, width);
 
 					mask = _mm512_loadu_si512((__m512i *)mask_set[width]);
 					_mm512_storeu_si512(into, _mm512_or_si512(_mm512_and_si512(payload, mask), high_bits));
-					payload = _mm512_srli_epi32(payload, width);
+					payload = _mm512_maskz_srli_epi32(0xFFFF, payload, width);
 
 					/*
 						move on to the next slector
@@ -304,12 +305,11 @@ namespace JASS
 					}
 			}
 		}
-#elif defined(__AVX2__)
 	/*
-		COMPRESS_INTEGER_ELIAS_GAMMA_SIMD::DECODE()
-		-------------------------------------------
+		COMPRESS_INTEGER_ELIAS_GAMMA_SIMD::DECODE_AVX2()
+		------------------------------------------------
 	*/
-	void compress_integer_elias_gamma_simd::decode(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
+	JASS_TARGET_AVX2 void compress_integer_elias_gamma_simd::decode_avx2(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
 		{
 		__m256i mask;
 		const uint8_t *source = (const uint8_t *)source_as_void;
@@ -374,9 +374,111 @@ namespace JASS
 				}
 			}
 		}
-#else
-	#error "Must have either AVX2 or AVX512"
-#endif
+	/*
+		COMPRESS_INTEGER_ELIAS_GAMMA_SIMD::DECODE_SSE41()
+		-------------------------------------------------
+	*/
+	void compress_integer_elias_gamma_simd::decode_sse41(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
+		{
+		__m128i mask;
+		const uint8_t *source = (const uint8_t *)source_as_void;
+		const uint8_t *end_of_source = source + source_length;
+		__m128i *into = (__m128i *)decoded;
+
+		uint64_t selector = *(uint32_t *)source;
+		__m128i payload1 = _mm_loadu_si128((__m128i *)(source + 4));
+		__m128i payload2 = _mm_loadu_si128((__m128i *)(source + 20));
+		__m128i payload3 = _mm_loadu_si128((__m128i *)(source + 36));
+		__m128i payload4 = _mm_loadu_si128((__m128i *)(source + 52));
+		source += 68;
+
+		while (1)
+			{
+			uint32_t width = (uint32_t)find_first_set_bit(selector);
+			mask = _mm_loadu_si128((__m128i *)mask_set[width]);
+			_mm_storeu_si128(into, _mm_and_si128(payload1, mask));
+			_mm_storeu_si128(into + 1, _mm_and_si128(payload2, mask));
+			_mm_storeu_si128(into + 2, _mm_and_si128(payload3, mask));
+			_mm_storeu_si128(into + 3, _mm_and_si128(payload4, mask));
+			payload1 = _mm_srli_epi32(payload1, width);
+			payload2 = _mm_srli_epi32(payload2, width);
+			payload3 = _mm_srli_epi32(payload3, width);
+			payload4 = _mm_srli_epi32(payload4, width);
+
+			into += 4;
+			selector >>= width;
+
+			while (selector == 0)
+				{
+				if (source >= end_of_source)
+					return;
+
+				/*
+					Save the remaining bits
+				*/
+				__m128i high_bits1 = payload1;
+				__m128i high_bits2 = payload2;
+				__m128i high_bits3 = payload3;
+				__m128i high_bits4 = payload4;
+
+				/*
+					move on to the next word
+				*/
+				selector = *(uint32_t *)source;
+				payload1 = _mm_loadu_si128((__m128i *)(source + 4));
+				payload2 = _mm_loadu_si128((__m128i *)(source + 20));
+				payload3 = _mm_loadu_si128((__m128i *)(source + 36));
+				payload4 = _mm_loadu_si128((__m128i *)(source + 52));
+				source += 68;
+
+				/*
+					get the low bits and write to memory
+				*/
+				width = (uint32_t)find_first_set_bit(selector);
+
+				high_bits1 = _mm_slli_epi32(high_bits1, width);
+				high_bits2 = _mm_slli_epi32(high_bits2, width);
+				high_bits3 = _mm_slli_epi32(high_bits3, width);
+				high_bits4 = _mm_slli_epi32(high_bits4, width);
+
+				mask = _mm_loadu_si128((__m128i *)mask_set[width]);
+				_mm_storeu_si128(into, _mm_or_si128(_mm_and_si128(payload1, mask), high_bits1));
+				_mm_storeu_si128(into + 1, _mm_or_si128(_mm_and_si128(payload2, mask), high_bits2));
+				_mm_storeu_si128(into + 2, _mm_or_si128(_mm_and_si128(payload3, mask), high_bits3));
+				_mm_storeu_si128(into + 3, _mm_or_si128(_mm_and_si128(payload4, mask), high_bits4));
+				payload1 = _mm_srli_epi32(payload1, width);
+				payload2 = _mm_srli_epi32(payload2, width);
+				payload3 = _mm_srli_epi32(payload3, width);
+				payload4 = _mm_srli_epi32(payload4, width);
+
+				/*
+					move on to the next slector
+				*/
+				into += 4;
+				selector >>= width;
+				}
+			}
+		}
+
+	/*
+		COMPRESS_INTEGER_ELIAS_GAMMA_SIMD::DECODE()
+		-------------------------------------------
+	*/
+	void compress_integer_elias_gamma_simd::decode(integer *decoded, size_t integers_to_decode, const void *source_as_void, size_t source_length)
+		{
+		switch (hardware_support::instruction_set())
+			{
+			case hardware_support::simd::avx512:
+				decode_avx512(decoded, integers_to_decode, source_as_void, source_length);
+				break;
+			case hardware_support::simd::avx2:
+				decode_avx2(decoded, integers_to_decode, source_as_void, source_length);
+				break;
+			default:
+				decode_sse41(decoded, integers_to_decode, source_as_void, source_length);
+				break;
+			}
+		}
 
 	/*
 		COMPRESS_INTEGER_ELIAS_GAMMA_SIMD::UNITTEST()
@@ -386,8 +488,6 @@ namespace JASS
 		{
 		compress_integer_elias_gamma_simd compressor;
 
-		compress_integer::unittest(compress_integer_elias_gamma_simd());
-
 		std::vector<uint32_t> broken_sequence =
 			{
 			6,10,2,1,2,1,1,1,1,2,2,1,1,14,1,1,		// 4 bits
@@ -419,8 +519,6 @@ namespace JASS
 			25,9,6,9,6,3,41,17,15,11,33,8,1,1,1,1			// 6 bits
 			};
 
-		unittest_one(compressor, broken_sequence);
-
 		std::vector<uint32_t> second_broken_sequence =
 			{
 			1, 1, 1, 793, 1, 1, 1, 1, 2, 1, 5, 3, 2, 1, 5, 63,		// 10 bits
@@ -432,7 +530,19 @@ namespace JASS
 			6, 2, 1, 1, 3, 3, 7, 3, 2, 1, 2, 4, 3, 1, 2, 1,			// 3 bits <31 bits>, carryover 1 from next line
 			6, 2, 2, 1															// 3 bits
 			};
-		unittest_one(compressor, second_broken_sequence);
+
+		/*
+			Check each decoder (up to the fastest this CPU can run)
+		*/
+		hardware_support::simd original = hardware_support::instruction_set();
+		for (auto instructions : {hardware_support::simd::sse41, hardware_support::simd::avx2, hardware_support::simd::avx512})
+			{
+			hardware_support::limit(instructions);
+			compress_integer::unittest(compress_integer_elias_gamma_simd());
+			unittest_one(compressor, broken_sequence);
+			unittest_one(compressor, second_broken_sequence);
+			}
+		hardware_support::limit(original);
 
 		puts("compress_integer_elias_gamma_simd::PASSED");
 		}
@@ -16,7 +16,9 @@
 #include <string.h>
 #include <immintrin.h>
 
-
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
 
 #include "forceinline.h"
 #include "compress_integer.h"
@@ -50,14 +52,60 @@ namespace JASS
 			*/
 			/*!
 				@brief return the position of the least significant set bit (using a single machine code instruction)
-				@param [in] value the integer to check.
-				@return The position of the lowest set bit (or 0 if no bits are set)
+				@details This does not need BMI so it can be called from the decoders for every instruction set.
+				@param [in] value the integer to check (which must not be 0).
+				@return The position of the lowest set bit (counting from 1)
 			*/
 			static forceinline uint64_t find_first_set_bit(uint64_t value)
 				{
-				return _tzcnt_u64(value) + 1;
+				#ifdef _MSC_VER
+					unsigned long position;
+					_BitScanForward64(&position, value);
+					return position + 1;
+				#else
+					return __builtin_ctzll(value) + 1;
+				#endif
 				}
 
+			/*
+				COMPRESS_INTEGER_ELIAS_GAMMA_SIMD::DECODE_SSE41()
+				-------------------------------------------------
+			*/
+			/*!
+				@brief Decode a sequence of integers encoded with this codex using SSE4.1 (four 128-bit words per 512-bit block).
+				@param decoded [out] The sequence of decoded integers.
+				@param integers_to_decode [in] The minimum number of integers to decode (it may decode more).
+				@param source [in] The encoded integers.
+				@param source_length [in] The length (in bytes) of the source buffer.
+			*/
+			void decode_sse41(integer *decoded, size_t integers_to_decode, const void *source, size_t source_length);
+
+			/*
+				COMPRESS_INTEGER_ELIAS_GAMMA_SIMD::DECODE_AVX2()
+				------------------------------------------------
+			*/
+			/*!
+				@brief Decode a sequence of integers encoded with this codex using AVX2 (two 256-bit words per 512-bit block).
+				@param decoded [out] The sequence of decoded integers.
+				@param integers_to_decode [in] The minimum number of integers to decode (it may decode more).
+				@param source [in] The encoded integers.
+				@param source_length [in] The length (in bytes) of the source buffer.
+			*/
+			void decode_avx2(integer *decoded, size_t integers_to_decode, const void *source, size_t source_length);
+
+			/*
+				COMPRESS_INTEGER_ELIAS_GAMMA_SIMD::DECODE_AVX512()
+				--------------------------------------------------
+			*/
+			/*!
+				@brief Decode a sequence of integers encoded with this codex using AVX-512.
+				@param decoded [out] The sequence of decoded integers.
+				@param integers_to_decode [in] The minimum number of integers to decode (it may decode more).
+				@param source [in] The encoded integers.
+				@param source_length [in] The length (in bytes) of the source buffer.
+			*/
+			void decode_avx512(integer *decoded, size_t integers_to_decode, const void *source, size_t source_length);
+
 		public:
 			/*
 				COMPRESS_INTEGER_ELIAS_GAMMA_SIMD::ENCODE()
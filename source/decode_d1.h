@@ -12,7 +12,14 @@
 */
 #pragma once
 
+#include <immintrin.h>
+
+#include <limits>
+#include <random>
+
 #include "query.h"
+#include "forceinline.h"
+#include "hardware_support.h"
 #include "compress_integer_none.h"
 
 namespace JASS
@@ -29,9 +36,14 @@ namespace JASS
 	*/
 	class decoder_d1
 		{
+		public:
+			static constexpr size_t default_simd_from = (std::numeric_limits<size_t>::max)();		///< By default D1 decode with the scalar loop at every length (test_integer_compress -i found no length at which the SIMD prefix sum was faster end to end)
+
 		private:
 			size_t integers;													///< The number of integers in the decompress buffer.
 			std::vector<uint32_t> decompress_buffer;					///< The delta-encoded decopressed integer sequence.
+			size_t simd_from;													///< D1 decode with SIMD only segments of at least this many integers.
+			hardware_support::simd instructions;						///< The widest SIMD the CPU supports (chosen once, at construction).
 
 		private:
 			/*
@@ -105,6 +117,131 @@ namespace JASS
 						}
 				};
 
+		private:
+			/*
+				DECODER_D1::PROCESS_SCALAR()
+				----------------------------
+			*/
+			/*!
+				@brief D1 decode one d-gap at a time and add each document id to the accumulators (used for short segments and the integers left over after the SIMD loops).
+				@param current [in] The first d-gap to decode.
+				@param end [in] The end of the d-gaps.
+				@param cumulative [in] The document id before current (the sum of the d-gaps already decoded).
+				@param impact [in] The impact score to add for each document id.
+				@param accumulators [in] The accumulators to add to.
+			*/
+			template <typename QUERY_T>
+			static forceinline void process_scalar(const uint32_t *current, const uint32_t *end, uint32_t cumulative, uint16_t impact, QUERY_T &accumulators)
+				{
+				for (; current < end; current++)
+					{
+					cumulative += *current;
+					accumulators.add_rsv(cumulative, impact);
+					}
+				}
+
+			/*
+				DECODER_D1::PROCESS_SSE41()
+				---------------------------
+			*/
+			/*!
+				@brief D1 decode four d-gaps at a time in a register using SSE (the baseline all JASS builds require) and add the document ids to the accumulators.
+				@param current [in] The first d-gap to decode.
+				@param end [in] The end of the d-gaps.
+				@param impact [in] The impact score to add for each document id.
+				@param accumulators [in] The accumulators to add to.
+			*/
+			template <typename QUERY_T>
+			static void process_sse41(const uint32_t *current, const uint32_t *end, uint16_t impact, QUERY_T &accumulators)
+				{
+				alignas(16) uint32_t document_ids[4];
+				__m128i carry = _mm_setzero_si128();
+				for (; current + 4 <= end; current += 4)
+					{
+					__m128i sum = _mm_loadu_si128(reinterpret_cast<const __m128i *>(current));
+					sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 4));						// shift left 1 integer and add
+					sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 8));						// shift left 2 integers and add
+					sum = _mm_add_epi32(sum, carry);
+					carry = _mm_shuffle_epi32(sum, 0xFF);										// broadcast the last document id
+					_mm_store_si128(reinterpret_cast<__m128i *>(document_ids), sum);
+
+					for (const auto document : document_ids)
+						accumulators.add_rsv(document, impact);
+					}
+
+				process_scalar(current, end, static_cast<uint32_t>(_mm_cvtsi128_si32(carry)), impact, accumulators);
+				}
+
+			/*
+				DECODER_D1::PROCESS_AVX2()
+				--------------------------
+			*/
+			/*!
+				@brief D1 decode eight d-gaps at a time in a register using AVX2 and add the document ids to the accumulators.
+				@param current [in] The first d-gap to decode.
+				@param end [in] The end of the d-gaps.
+				@param impact [in] The impact score to add for each document id.
+				@param accumulators [in] The accumulators to add to.
+			*/
+			template <typename QUERY_T>
+			JASS_TARGET_AVX2 static void process_avx2(const uint32_t *current, const uint32_t *end, uint16_t impact, QUERY_T &accumulators)
+				{
+				alignas(32) uint32_t document_ids[8];
+				__m256i carry = _mm256_setzero_si256();
+				for (; current + 8 <= end; current += 8)
+					{
+					__m256i sum = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(current));
+					sum = _mm256_add_epi32(sum, _mm256_slli_si256(sum, 4));						// shift left 1 integer (within each 128-bit lane) and add
+					sum = _mm256_add_epi32(sum, _mm256_slli_si256(sum, 8));						// shift left 2 integers (within each 128-bit lane) and add
+					__m256i low_lane_total = _mm256_shuffle_epi32(sum, 0xFF);					// broadcast the last integer of each lane
+					sum = _mm256_add_epi32(sum, _mm256_permute2x128_si256(low_lane_total, low_lane_total, 0x08));		// add the low lane's total to the high lane
+					sum = _mm256_add_epi32(sum, carry);
+					carry = _mm256_permutevar8x32_epi32(sum, _mm256_set1_epi32(7));		// broadcast the last document id
+					_mm256_store_si256(reinterpret_cast<__m256i *>(document_ids), sum);
+
+					for (const auto document : document_ids)
+						accumulators.add_rsv(document, impact);
+					}
+
+				process_scalar(current, end, static_cast<uint32_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(carry))), impact, accumulators);
+				}
+
+			/*
+				DECODER_D1::PROCESS_AVX512()
+				----------------------------
+			*/
+			/*!
+				@brief D1 decode sixteen d-gaps at a time in a register using AVX-512 and add the document ids to the accumulators.
+				@details Each shift is a rotate with the integers that wrap around zeroed by the mask, so no source register is left undefined.
+				@param current [in] The first d-gap to decode.
+				@param end [in] The end of the d-gaps.
+				@param impact [in] The impact score to add for each document id.
+				@param accumulators [in] The accumulators to add to.
+			*/
+			template <typename QUERY_T>
+			JASS_TARGET_AVX512 static void process_avx512(const uint32_t *current, const uint32_t *end, uint16_t impact, QUERY_T &accumulators)
+				{
+				alignas(64) uint32_t document_ids[16];
+				const __m512i last = _mm512_set1_epi32(15);
+				__m512i carry = _mm512_setzero_si512();
+				for (; current + 16 <= end; current += 16)
+					{
+					__m512i sum = _mm512_loadu_si512(current);
+					sum = _mm512_add_epi32(sum, _mm512_maskz_alignr_epi32(0xFFFE, sum, sum, 15));		// shift left 1 integer and add
+					sum = _mm512_add_epi32(sum, _mm512_maskz_alignr_epi32(0xFFFC, sum, sum, 14));		// shift left 2 integers and add
+					sum = _mm512_add_epi32(sum, _mm512_maskz_alignr_epi32(0xFFF0, sum, sum, 12));		// shift left 4 integers and add
+					sum = _mm512_add_epi32(sum, _mm512_maskz_alignr_epi32(0xFF00, sum, sum, 8));			// shift left 8 integers and add
+					sum = _mm512_add_epi32(sum, carry);
+					carry = _mm512_maskz_permutexvar_epi32(0xFFFF, last, sum);								// broadcast the last document id
+					_mm512_store_si512(document_ids, sum);
+
+					for (const auto document : document_ids)
+						accumulators.add_rsv(document, impact);
+					}
+
+				process_scalar(current, end, static_cast<uint32_t>(_mm512_cvtsi512_si32(carry)), impact, accumulators);
+				}
+
 		public:
 			/*
 				DECODER_D1::DECODER_D1()
@@ -122,10 +259,13 @@ namespace JASS
 			/*!
 				@brief Constructor
 				@param max_integers [in] The maximum number of integers that will ever need to be decoded using this object (i.e. the number of documents in the collection + overflow).
+				@param simd_from [in] D1 decode with SIMD only segments of at least this many integers (default = default_simd_from).
 			*/
-			explicit decoder_d1(size_t max_integers) :
+			explicit decoder_d1(size_t max_integers, size_t simd_from = default_simd_from) :
 				integers(0),
-				decompress_buffer(max_integers, 0)
+				decompress_buffer(max_integers, 0),
+				simd_from(simd_from),
+				instructions(hardware_support::instruction_set())
 				{
 				/* Nothing */
 				}
@@ -161,7 +301,7 @@ namespace JASS
 				--------------------
 			*/
 			/*!
-				@brief Given the integer decoder, the number of integes to decode, and the compressed sequence, decompress (but do not process).
+				@brief Given the integer decoder, the number of integes to decode, and the compressed sequence, decompress (but do not process).
 				@param decoder [in] The codex to use to decompress into the D1 sequence.
 				@param integers [in] The number of integers that are compressed.
 				@param compressed [in] The compressed sequence.
@@ -180,14 +320,26 @@ namespace JASS
 			*/
 			/*!
 				@brief Process the integer sequence as a D1 impact-ordered sequence into the accumulators
+				@details The d-gaps are read once, straight after the codex has written them.  Segments shorter than simd_from are D1 decoded with
+				the scalar cumulative sum.  Longer segments are D1 decoded a SIMD register at a time with an in-register prefix sum (which removes the
+				serial dependency of the cumulative sum) and the document ids are added to the accumulators from there, so they are never written back.
 				@param impact [in] The impact score to add for each document id in the list.
 				@param accumulators [in] The accumulators to add to
 			*/
 			template <typename QUERY_T>
-			void process(uint16_t impact, QUERY_T &accumulators) const
+			forceinline void process(uint16_t impact, QUERY_T &accumulators) const
 				{
-				for (auto document : *this)
-					accumulators.add_rsv(document, impact);
+				const uint32_t *current = decompress_buffer.data();
+				const uint32_t *end = current + integers;
+
+				if (integers < simd_from)
+					process_scalar(current, end, 0, impact, accumulators);
+				else if (instructions == hardware_support::simd::avx512)
+					process_avx512(current, end, impact, accumulators);
+				else if (instructions == hardware_support::simd::avx2)
+					process_avx2(current, end, impact, accumulators);
+				else
+					process_sse41(current, end, impact, accumulators);
 				}
 
 			/*
@@ -212,6 +364,52 @@ namespace JASS
 					result << answer.document_id << " ";
 
 				JASS_assert(result.str() == "19 17 13 11 7 ");
+
+				/*
+					Check the SIMD prefix sums (each that this CPU can run, used for all lengths and only for long segments) against a scalar prefix sum over lengths that are not a multiple of the SIMD width.
+				*/
+				class collect
+					{
+					public:
+						std::vector<uint32_t> documents;
+						void add_rsv(size_t document_id, uint16_t score) { documents.push_back(static_cast<uint32_t>(document_id)); }
+					};
+
+				hardware_support::simd original = hardware_support::instruction_set();
+				for (auto instructions : {hardware_support::simd::sse41, hardware_support::simd::avx2, hardware_support::simd::avx512})
+					{
+					hardware_support::limit(instructions);
+					std::mt19937 random(17);
+					for (size_t length : {0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 1000})
+						{
+						std::vector<uint32_t> gaps(length);
+						std::vector<uint32_t> expected(length);
+						uint32_t sum = 0;
+						for (size_t which = 0; which < length; which++)
+							{
+							gaps[which] = 1 + random() % 1000;
+							sum += gaps[which];
+							expected[which] = sum;
+							}
+
+						for (size_t simd_from : {static_cast<size_t>(0), static_cast<size_t>(32), default_simd_from})
+							{
+							decoder_d1 long_decoder(length + 1, simd_from);
+							collect collector;
+							long_decoder.decode(identity, length, gaps.data(), sizeof(gaps[0]) * length);
+							long_decoder.process(1, collector);
+							JASS_assert(collector.documents == expected);
+
+							std::vector<uint32_t> iterated;
+							auto end = long_decoder.end();
+							for (auto current = long_decoder.begin(); current != end; ++current)
+								iterated.push_back(*current);
+							JASS_assert(iterated == expected);
+							}
+						}
+					}
+				hardware_support::limit(original);
+
 				puts("decoder_d1::PASSED");
 				}
 		};
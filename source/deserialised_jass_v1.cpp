@@ -4,6 +4,7 @@
 	Copyright (c) 2017 Andrew Trotman
 	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
 */
+#include <limits>
 #include <algorithm>
 
 #include "file.h"
@@ -31,26 +32,21 @@ namespace JASS
 		/*
 			Read the disk file
 		*/
-		auto bytes = file::read_entire_file(filename, primary_key_memory);
+		auto bytes = load(filename, primary_key_memory, primary_key_map, primary_key_start);
 		if (bytes == 0)
 			return 0;					// failed to read the file.
+		primary_key_length = bytes;
 
 		/*
 			Numnber of documents is stored at the end of the file (as a uint64_t)
 		*/
-		documents = *reinterpret_cast<uint64_t *>(&primary_key_memory[bytes] - sizeof(uint64_t));
-		primary_key_list.reserve(documents);
+		documents = *reinterpret_cast<const uint64_t *>(primary_key_start + bytes - sizeof(uint64_t));
 
 		/*
-			The file is in 2 parts, the first is the primary key the second is the poiters to the primary keys
+			Unless we're memory mapped, build the list of primary keys now (otherwise its done on first use)
 		*/
-		uint64_t *offset_base = (uint64_t *) (&primary_key_memory[0] + bytes - (documents * sizeof(uint64_t) + sizeof(uint64_t)));
-
-		/*
-			Now work through each primary key adding it to the list of primary keys
-		*/
-		for (size_t id = 0; id < documents; id++)
-			primary_key_list.push_back(&primary_key_memory[0] + offset_base[id]);
+		if (!memory_mapped)
+			primary_keys();
 
 		/*
 			This can take some time so make some noise when we're finished
@@ -67,6 +63,29 @@ namespace JASS
 		return documents;
 		}
 
+	/*
+		DESERIALISED_JASS_V1::BUILD_PRIMARY_KEY_LIST()
+		----------------------------------------------
+	*/
+	void deserialised_jass_v1::build_primary_key_list(void) const
+		{
+		if (primary_key_start == nullptr)
+			return;
+
+		primary_key_list.reserve(documents);
+
+		/*
+			The file is in 2 parts, the first is the primary key the second is the poiters to the primary keys
+		*/
+		const uint64_t *offset_base = reinterpret_cast<const uint64_t *>(primary_key_start + primary_key_length - (documents * sizeof(uint64_t) + sizeof(uint64_t)));
+
+		/*
+			Now work through each primary key adding it to the list of primary keys
+		*/
+		for (size_t id = 0; id < documents; id++)
+			primary_key_list.push_back(reinterpret_cast<const char *>(primary_key_start) + offset_base[id]);
+		}
+
 	/*
 		DESERIALISED_JASS_V1::READ_VOCABULARY()
 		---------------------------------------
@@ -84,30 +103,29 @@ namespace JASS
 		/*
 			Read the file of tripples that are the pointers to the terms (and the postings too)
 		*/
-		auto length = file::read_entire_file(vocab_filename, vocabulary_memory);
+		const uint8_t *vocab;
+		auto length = load(vocab_filename, vocabulary_memory, vocabulary_map, vocab);
 		if (length == 0)
 			return 0;
-		char *vocab = &vocabulary_memory[0];
+		vocabulary_triples = reinterpret_cast<const uint64_t *>(vocab);
 
 		/*
 			Read the file of strings that is the vocabulary
 		*/
-		auto bytes = file::read_entire_file(terms_filename, vocabulary_terms_memory);
+		const uint8_t *vocab_terms;
+		auto bytes = load(terms_filename, vocabulary_terms_memory, vocabulary_terms_map, vocab_terms);
 		if (bytes == 0)
 			return 0;
 		terms = length / (sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint64_t));
-		char *vocab_terms = &vocabulary_terms_memory[0];
+		vocabulary_strings = reinterpret_cast<const char *>(vocab_terms);
 
 		/*
-			Build the vocabulary
+			Build the vocabulary (if memory mapped then we search CIvocab.bin in place and only build this if the caller iterates over the vocabulary)
 		*/
-		vocabulary_list.reserve(terms);
-		const char *postings_base = &postings_memory[0];
-		for (size_t term = 0; term < terms; term++)
+		if (!memory_mapped)
 			{
-			uint64_t *base = reinterpret_cast<uint64_t *>(vocab + (3 * sizeof(uint64_t)) * term);
-
-			vocabulary_list.push_back(metadata(slice(vocab_terms + base[0]), postings_base + base[1], base[2]));
+			std::call_once(vocabulary_list_built, &deserialised_jass_v1::build_vocabulary_list, this);
+			build_vocabulary_lookup();
 			}
 
 		/*
@@ -125,6 +143,33 @@ namespace JASS
 		return terms;
 		}
 
+	/*
+		DESERIALISED_JASS_V1::BUILD_VOCABULARY_LIST()
+		---------------------------------------------
+	*/
+	void deserialised_jass_v1::build_vocabulary_list(void)
+		{
+		vocabulary_list.clear();
+		vocabulary_list.reserve(terms);
+		for (size_t term = 0; term < terms; term++)
+			vocabulary_list.push_back(term_at(term));
+		}
+
+	/*
+		DESERIALISED_JASS_V1::BUILD_VOCABULARY_LOOKUP()
+		-----------------------------------------------
+	*/
+	void deserialised_jass_v1::build_vocabulary_lookup(void)
+		{
+		/*
+			The hash table stores 32-bit term numbers, so for (absurdly) large vocabularies we fall back to binary search
+		*/
+		if (terms >= (std::numeric_limits<uint32_t>::max)())
+			return;
+
+		vocabulary_lookup.build(terms, [this](size_t which){ return slice(vocabulary_strings + vocabulary_triples[3 * which]); });
+		}
+
 	/*
 		DESERIALISED_JASS_V1::READ_POSTINGS()
 		-------------------------------------
@@ -142,9 +187,10 @@ namespace JASS
 		/*
 			Read the postings
 		*/
-		auto bytes = file::read_entire_file(filename, postings_memory);
+		auto bytes = load(filename, postings_memory, postings_map, postings_start);
 		if (bytes == 0)
 			return 0;
+		postings_length = bytes;
 
 		/*
 			This can take some time so make some noise when we're finished
@@ -161,6 +207,28 @@ namespace JASS
 		return bytes;
 		}
 
+	/*
+		DESERIALISED_JASS_V1::LOAD()
+		----------------------------
+	*/
+	size_t deserialised_jass_v1::load(const std::string &filename, std::string &into, file_map &mapping, const uint8_t *&start)
+		{
+		size_t bytes;
+
+		if (memory_mapped)
+			{
+			bytes = mapping.open(filename, map_hints);
+			start = mapping.data();
+			}
+		else
+			{
+			bytes = file::read_entire_file(filename, into);
+			start = reinterpret_cast<const uint8_t *>(&into[0]);
+			}
+
+		return bytes;
+		}
+
 	/*
 		DESERIALISED_JASS_V1::READ_INDEX()
 		----------------------------------
@@ -181,13 +249,13 @@ namespace JASS
 	*/
 	compress_integer &deserialised_jass_v1::codex(std::string &name) const
 		{
-		if (postings_memory.size() == 0)
+		if (postings_length == 0)
 			{
 			name = "None";
 			return compress_integer_all::get_by_name("None");
 			}
 		else
-			switch (postings_memory[0])
+			switch (postings_start[0])
 				{
 				case 's':
 					name = "None";
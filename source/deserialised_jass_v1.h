@@ -14,11 +14,15 @@
 
 #include "string.h"
 
+#include <mutex>
 #include <string>
 #include <vector>
+#include <algorithm>
 
 #include "slice.h"
+#include "file_map.h"
 #include "query_term.h"
+#include "vocabulary_hash.h"
 #include "compress_integer.h"
 
 namespace JASS
@@ -119,17 +123,32 @@ namespace JASS
 
 		private:
 			bool verbose;											///< Should this class produce diagnostics on stdout?
+			bool memory_mapped;									///< Should the index files be memory mapped rather than read into memory?
+			int map_hints;											///< The file_map::hint values to use when memory mapping the index.
 
 			uint64_t documents;									///< The number of documents in the collection
 			std::string primary_key_memory;					///< Memory used to store the primary key strings
-			std::vector<std::string> primary_key_list;			///< The array of primary keys
+			file_map primary_key_map;							///< The memory mapped primary key file (when memory_mapped)
+			const uint8_t *primary_key_start;				///< Pointer to the start of the primary key file (read or mapped)
+			size_t primary_key_length;							///< The length of the primary key file (in bytes)
+			mutable std::once_flag primary_key_list_built;	///< Used to build primary_key_list exactly once (and lazily)
+			mutable std::vector<std::string> primary_key_list;	///< The array of primary keys
 
 			uint64_t terms;										///< The numner of terms in the collection
 			std::string vocabulary_memory;					///< Memory used to store the vocabulary pointers
 			std::string vocabulary_terms_memory;			///< Memory used to store the vocabulary strings
+			file_map vocabulary_map;							///< The memory mapped vocabulary pointers (when memory_mapped)
+			file_map vocabulary_terms_map;					///< The memory mapped vocabulary strings (when memory_mapped)
+			const uint64_t *vocabulary_triples;				///< Pointer to the (term, offset, impacts) triples (read or mapped)
+			const char *vocabulary_strings;					///< Pointer to the vocabulary strings (read or mapped)
+			std::once_flag vocabulary_list_built;			///< Used to build vocabulary_list exactly once (and, when memory mapped, lazily)
 			std::vector<metadata> vocabulary_list;			///< The (sorted in alphabetical order) array of vocbulary terms
+			vocabulary_hash vocabulary_lookup;				///< Hash table used to find terms in the vocabulary (when not memory mapped)
 
 			std::string postings_memory;						///< Memory used to store the postings
+			file_map postings_map;								///< The memory mapped postings (when memory_mapped)
+			const uint8_t *postings_start;					///< Pointer to the start of the postings (read or mapped)
+			size_t postings_length;								///< The length of the postings (in bytes)
 
 		protected:
 			/*
@@ -166,6 +185,47 @@ namespace JASS
 			*/
 			size_t read_postings(const std::string &postings_filename = "CIpostings.bin");
 
+			/*
+				DESERIALISED_JASS_V1::LOAD()
+				----------------------------
+			*/
+			/*!
+				@brief Get the contents of a file into memory, either by reading it into a string or by memory mapping it.
+				@param filename [in] The name of the file to load.
+				@param into [out] If not memory mapping, the file is read into this string.
+				@param mapping [out] If memory mapping, the file is mapped using this object.
+				@param start [out] A pointer to the start of the file's contents in memory.
+				@return The size of the file (in bytes) or 0 on failure.
+			*/
+			size_t load(const std::string &filename, std::string &into, file_map &mapping, const uint8_t *&start);
+
+			/*
+				DESERIALISED_JASS_V1::BUILD_PRIMARY_KEY_LIST()
+				----------------------------------------------
+			*/
+			/*!
+				@brief Convert the primary key file into a std::vector<std::string> of primary keys (this is called (once) on first use).
+			*/
+			void build_primary_key_list(void) const;
+
+			/*
+				DESERIALISED_JASS_V1::BUILD_VOCABULARY_LIST()
+				---------------------------------------------
+			*/
+			/*!
+				@brief Convert the vocabulary files into a std::vector<metadata> (this is called (once) by read_index(), or on first iteration when memory mapped).
+			*/
+			void build_vocabulary_list(void);
+
+			/*
+				DESERIALISED_JASS_V1::BUILD_VOCABULARY_LOOKUP()
+				-----------------------------------------------
+			*/
+			/*!
+				@brief Build the hash table used by postings_details() to find terms (this is called at load time unless memory mapped).
+			*/
+			void build_vocabulary_lookup(void);
+
 		public:
 			/*
 				DESERIALISED_JASS_V1::ANYTIME_INDEX()
@@ -173,12 +233,25 @@ namespace JASS
 			*/
 			/*!
 				@brief Constructor
+				@details When memory_mapped is true the index files are mapped into memory rather than read.  This makes loading the
+				index near instantaneous and allows all processes using the same index to share the Operating System's page cache.  In this
+				mode the vocabulary is searched in place and the primary key list is built the first time it is asked for.
 				@param verbose [in] Should the index reading methods produce messages on stdout?
+				@param memory_mapped [in] Should the index be memory mapped rather than read into memory (default = false)?
+				@param map_hints [in] A bitwise or of file_map::hint values used when memory mapping (default = file_map::none).
 			*/
-			explicit deserialised_jass_v1(bool verbose = false) :
+			explicit deserialised_jass_v1(bool verbose = false, bool memory_mapped = false, int map_hints = file_map::none) :
 				verbose(verbose),
+				memory_mapped(memory_mapped),
+				map_hints(map_hints),
 				documents(0),
-				terms(0)
+				primary_key_start(nullptr),
+				primary_key_length(0),
+				terms(0),
+				vocabulary_triples(nullptr),
+				vocabulary_strings(nullptr),
+				postings_start(nullptr),
+				postings_length(0)
 				{
 				/* Nothing */
 				}
@@ -217,6 +290,7 @@ namespace JASS
 			*/
 			const std::vector<std::string> &primary_keys(void) const
 				{
+				std::call_once(primary_key_list_built, &deserialised_jass_v1::build_primary_key_list, this);
 				return primary_key_list;
 				}
 
@@ -230,7 +304,7 @@ namespace JASS
 			*/
 			const uint8_t *postings(void) const
 				{
-				return reinterpret_cast<const uint8_t *>(&postings_memory[0]);
+				return postings_start;
 				}
 
 			/*
@@ -246,6 +320,34 @@ namespace JASS
 				return documents;
 				}
 
+			/*
+				DESERIALISED_JASS_V1::TERM_COUNT()
+				----------------------------------
+			*/
+			/*!
+				@brief Return the number of unique terms in the collection (the size of the vocabulary)
+				@return the number of unique terms in the collection
+			*/
+			size_t term_count(void) const
+				{
+				return terms;
+				}
+
+			/*
+				DESERIALISED_JASS_V1::TERM_AT()
+				-------------------------------
+			*/
+			/*!
+				@brief Return the metadata for the term at the given position in the (sorted) vocabulary.
+				@param which [in] The position of the term in CIvocab.bin.
+				@return The metadata of the term.
+			*/
+			metadata term_at(size_t which) const
+				{
+				const uint64_t *base = vocabulary_triples + 3 * which;
+				return metadata(slice(vocabulary_strings + base[0]), postings_start + base[1], base[2]);
+				}
+
 			/*
 				DESERIALISED_JASS_V1::POSTINGS_DETAILS()
 				----------------------------------------
@@ -258,20 +360,43 @@ namespace JASS
 			*/
 			bool postings_details(metadata &metadata, const query_term &term) const
 				{
-				auto found = std::lower_bound(vocabulary_list.begin(), vocabulary_list.end(), term.token());
+				if (vocabulary_lookup.built())
+					{
+					/*
+						Hash the term and compare against the term string in CIvocab_terms.bin only if the fingerprint matches
+					*/
+					const slice token = term.token();
+					size_t found = vocabulary_lookup.find(token, [&](size_t which)
+						{
+						const char *candidate = vocabulary_strings + vocabulary_triples[3 * which];
+						return memcmp(candidate, token.address(), token.size()) == 0 && candidate[token.size()] == '\0';
+						});
 
-				/*
-					Term not in the dictionary and we've walked off the end.
-				*/
-				if (found == vocabulary_list.end())
-					return false;
+					if (found == vocabulary_hash::npos)
+						return false;
+
+					metadata = term_at(found);
+					return true;
+					}
 
 				/*
-					Term might be in the dictionary, better check
+					There's no hash table (we're memory mapped) so binary search the CIvocab.bin triples in place.  This never looks at
+					vocabulary_list as begin() might be building it on another thread.
 				*/
-				if (term.token() == found->term)
+				size_t low = 0;
+				size_t high = terms;
+				while (low < high)
+					{
+					size_t mid = low + (high - low) / 2;
+					if (slice::strict_weak_order_less_than(slice(vocabulary_strings + vocabulary_triples[3 * mid]), term.token()))
+						low = mid + 1;
+					else
+						high = mid;
+					}
+
+				if (low < terms && term.token() == slice(vocabulary_strings + vocabulary_triples[3 * low]))
 					{
-					metadata = *found;
+					metadata = term_at(low);
 					return true;
 					}
 
@@ -291,6 +416,7 @@ namespace JASS
 			*/
 			auto begin(void)
 				{
+				std::call_once(vocabulary_list_built, &deserialised_jass_v1::build_vocabulary_list, this);
 				return vocabulary_list.begin();
 				}
 
@@ -304,6 +430,7 @@ namespace JASS
 			*/
 			auto end(void)
 				{
+				std::call_once(vocabulary_list_built, &deserialised_jass_v1::build_vocabulary_list, this);
 				return vocabulary_list.end();
 				}
 		};
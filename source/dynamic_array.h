@@ -201,7 +201,7 @@ namespace JASS
 				/*
 					Allocate space for the first write
 				*/
-				head = tail = new (pool.malloc(sizeof(node))) node(pool, initial_size);
+				head = tail = new (pool.malloc(sizeof(node), sizeof(void *))) node(pool, initial_size);
 				}
 			
 			/*
@@ -289,7 +289,7 @@ namespace JASS
 							We've walked past the end so we allocate space for a new node (and elements in that node) and add it to the list.
 						*/
 						last->used = last->allocated;
-						node *another = new (pool.malloc(sizeof(node))) node(pool, (size_t)(last->allocated * growth_factor));
+						node *another = new (pool.malloc(sizeof(node), sizeof(void *))) node(pool, (size_t)(last->allocated * growth_factor));
 						/*
 							Atomicly make it the tail and if we succeed than make the previous node in the list point to this one.
 							If we fail then the pool allocator won't take the memory back so ignore and re-try
@@ -0,0 +1,183 @@
+/*
+	FILE_MAP.CPP
+	------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <sys/types.h>
+#endif
+
+#include <string>
+
+#include "file.h"
+#include "asserts.h"
+#include "file_map.h"
+
+namespace JASS
+	{
+	/*
+		FILE_MAP::OPEN()
+		----------------
+	*/
+	size_t file_map::open(const std::string &filename, int hints)
+		{
+		close();
+
+		#ifdef _MSC_VER
+			/*
+				Win32 does not have MAP_POPULATE or madvise(), so the hints are ignored.
+			*/
+			file_handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (file_handle == INVALID_HANDLE_VALUE)
+				{
+				file_handle = nullptr;
+				return 0;
+				}
+
+			LARGE_INTEGER file_size;
+			if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0)
+				{
+				close();
+				return 0;
+				}
+
+			mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping_handle == nullptr)
+				{
+				close();
+				return 0;
+				}
+
+			address = reinterpret_cast<const uint8_t *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+			if (address == nullptr)
+				{
+				close();
+				return 0;
+				}
+			length = static_cast<size_t>(file_size.QuadPart);
+		#else
+			int file_descriptor = ::open(filename.c_str(), O_RDONLY);
+			if (file_descriptor < 0)
+				return 0;
+
+			/*
+				Get the length of the file, the mapping is the same size as the file.
+			*/
+			struct stat details;
+			if (fstat(file_descriptor, &details) != 0 || details.st_size == 0)
+				{
+				::close(file_descriptor);
+				return 0;
+				}
+
+			int flags = MAP_SHARED;
+			#ifdef MAP_POPULATE
+				if (hints & populate)
+					flags |= MAP_POPULATE;
+			#endif
+
+			void *got = ::mmap(nullptr, details.st_size, PROT_READ, flags, file_descriptor, 0);
+
+			/*
+				The mapping holds its own reference to the file so we can close the descriptor now.
+			*/
+			::close(file_descriptor);
+			if (got == MAP_FAILED)
+				return 0;
+
+			address = reinterpret_cast<const uint8_t *>(got);
+			length = details.st_size;
+
+			/*
+				Pass on any hints about how the memory is going to be used.  Failure here is not an error, it just means the OS ignored us.
+			*/
+			if (hints & sequential)
+				(void)::madvise(got, length, MADV_SEQUENTIAL);
+			if (hints & random)
+				(void)::madvise(got, length, MADV_RANDOM);
+			if (hints & will_need)
+				(void)::madvise(got, length, MADV_WILLNEED);
+		#endif
+
+		return length;
+		}
+
+	/*
+		FILE_MAP::CLOSE()
+		-----------------
+	*/
+	void file_map::close(void)
+		{
+		#ifdef _MSC_VER
+			if (address != nullptr)
+				UnmapViewOfFile(address);
+			if (mapping_handle != nullptr)
+				CloseHandle(mapping_handle);
+			if (file_handle != nullptr)
+				CloseHandle(file_handle);
+			mapping_handle = nullptr;
+			file_handle = nullptr;
+		#else
+			if (address != nullptr)
+				::munmap(const_cast<uint8_t *>(address), length);
+		#endif
+
+		address = nullptr;
+		length = 0;
+		}
+
+	/*
+		FILE_MAP::UNITTEST()
+		--------------------
+	*/
+	void file_map::unittest(void)
+		{
+		std::string example_file = "text for example file";
+
+		/*
+			Write a file then map it back and check we got what we wrote.
+		*/
+		auto filename = file::mkstemp("jass");
+		file::write_entire_file(filename, example_file);
+
+		{
+		file_map mapping;
+		auto bytes = mapping.open(filename, file_map::populate | file_map::random);
+		JASS_assert(bytes == example_file.size());
+		JASS_assert(mapping.size() == example_file.size());
+		JASS_assert(memcmp(mapping.data(), example_file.c_str(), bytes) == 0);
+
+		/*
+			Re-opening should replace the old mapping.
+		*/
+		bytes = mapping.open(filename, file_map::sequential | file_map::will_need);
+		JASS_assert(bytes == example_file.size());
+		JASS_assert(memcmp(mapping.data(), example_file.c_str(), bytes) == 0);
+
+		mapping.close();
+		JASS_assert(mapping.data() == nullptr);
+		JASS_assert(mapping.size() == 0);
+		}
+
+		/*
+			Files that don't exist can't be mapped
+		*/
+		file_map missing;
+		JASS_assert(missing.open(".JASS.") == 0);
+		JASS_assert(missing.data() == nullptr);
+
+		(void)remove(filename.c_str());
+
+		puts("file_map::PASSED");
+		}
+	}
@@ -0,0 +1,167 @@
+/*
+	FILE_MAP.H
+	----------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief Read-only memory mapped files.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+
+namespace JASS
+	{
+	/*
+		CLASS FILE_MAP
+		--------------
+	*/
+	/*!
+		@brief A read-only memory mapped file.
+		@details file::read_entire_file() copies the contents of the file into a std::string, which for a large index means that loading takes
+		as long as reading the whole file from disk, and each process that loads the index has its own private copy.  This class instead asks the
+		Operating System to map the file into the address space of the process.  Pages are loaded on first touch (or up-front when asked for),
+		and the pages are shared through the page cache by all processes that map the same file.
+
+		This class is based on Resource Allocation Is Initialisation (RAII).  That is, the mapping is undone when the object is destroyed.
+	*/
+	class file_map
+		{
+		public:
+			/*!
+				@enum hint
+				@brief Hints given to the Operating System about how the mapped memory will be used.  These can be or'd together.
+			*/
+			enum hint
+				{
+				none = 0,						///< No hints, pages are loaded on first touch.
+				populate = 1,					///< Pre-fault the entire file into memory while mapping (MAP_POPULATE on Linux).
+				sequential = 2,				///< The file will be read sequentially, so read-ahead aggressively (MADV_SEQUENTIAL).
+				random = 4,						///< The file will be read randomly, so don't read-ahead (MADV_RANDOM).
+				will_need = 8					///< Start loading the file in the background as it will be needed soon (MADV_WILLNEED).
+				};
+
+		private:
+			const uint8_t *address;			///< The start of the mapped file (or nullptr if not mapped).
+			size_t length;						///< The length of the mapped file (in bytes).
+			#ifdef _MSC_VER
+				void *file_handle;			///< The Win32 handle of the file that is mapped.
+				void *mapping_handle;		///< The Win32 handle of the mapping.
+			#endif
+
+		private:
+			/*
+				FILE_MAP::FILE_MAP()
+				--------------------
+			*/
+			/*!
+				@brief Private copy constructor prevents object copying (the mapping cannot be shared).
+			*/
+			file_map(const file_map &) = delete;
+
+			/*
+				FILE_MAP::OPERATOR=()
+				---------------------
+			*/
+			/*!
+				@brief Private assignment operator prevents assigning to this object (the mapping cannot be shared).
+			*/
+			file_map &operator=(const file_map &) = delete;
+
+		public:
+			/*
+				FILE_MAP::FILE_MAP()
+				--------------------
+			*/
+			/*!
+				@brief Constructor.  The object does not map anything until open() is called.
+			*/
+			file_map() :
+				address(nullptr),
+				length(0)
+				#ifdef _MSC_VER
+					,
+					file_handle(nullptr),
+					mapping_handle(nullptr)
+				#endif
+				{
+				/* Nothing */
+				}
+
+			/*
+				FILE_MAP::~FILE_MAP()
+				---------------------
+			*/
+			/*!
+				@brief Destructor.  Unmaps the file.
+			*/
+			~file_map()
+				{
+				close();
+				}
+
+			/*
+				FILE_MAP::OPEN()
+				----------------
+			*/
+			/*!
+				@brief Map the given file into memory (read-only).
+				@details If this object already has a file mapped then that file is unmapped first.  Zero length files cannot be mapped.
+				@param filename [in] The path of the file to map.
+				@param hints [in] A bitwise or of file_map::hint values that describe the expected use of the mapping (default = none).
+				@return The size of the file in bytes, or 0 on failure.
+			*/
+			size_t open(const std::string &filename, int hints = none);
+
+			/*
+				FILE_MAP::CLOSE()
+				-----------------
+			*/
+			/*!
+				@brief Unmap the file (if one is mapped).
+			*/
+			void close(void);
+
+			/*
+				FILE_MAP::DATA()
+				----------------
+			*/
+			/*!
+				@brief Return a pointer to the start of the mapped file.
+				@return A pointer to the start of the mapped file, or nullptr if there is no mapping.
+			*/
+			const uint8_t *data(void) const
+				{
+				return address;
+				}
+
+			/*
+				FILE_MAP::SIZE()
+				----------------
+			*/
+			/*!
+				@brief Return the length of the mapped file.
+				@return The length (in bytes) of the mapped file, 0 if there is no mapping.
+			*/
+			size_t size(void) const
+				{
+				return length;
+				}
+
+			/*
+				FILE_MAP::UNITTEST()
+				--------------------
+			*/
+			/*!
+				@brief Unit test this class
+			*/
+			static void unittest(void);
+		};
+	}
@@ -15,15 +15,16 @@
 /*!
 	@var replace
 	@brief If replace is true then the global new and delete operators are overridden with versions that abort() when called.
+	@details This is per-thread so that one thread can check it does not allocate while others (for example, writing results) do.
 */
-static bool replace = false;
+static thread_local bool replace = false;
 
 /*
 	GLOBAL_NEW_DELETE_REPLACE()
 	---------------------------
 */
 /*!
-	@brief Replace the global new and delete operators with versions that cause the program to terminate.
+	@brief Replace the global new and delete operators with versions that cause the program to terminate (when called by this thread).
 */
 void global_new_delete_replace(void)
 	{
@@ -35,7 +36,7 @@ void global_new_delete_replace(void)
 	--------------------------
 */
 /*!
-	@brief Return to using the global new and delete operators from the standard C++ library.
+	@brief Return to using the global new and delete operators from the standard C++ library (in this thread).
 */
 void global_new_delete_return(void)
 	{
@@ -75,6 +76,23 @@ void operator delete(void *pointer) throw()
 		free(pointer);
 	}
 
+/*
+	OPERATOR DELETE()
+	-----------------
+*/
+/*!
+	@brief Replacement verison of the (C++14) sized delete, which would otherwise free memory from the replacement new with the standard library's delete.
+	@param pointer [in] Pointer to memory to free up.
+	@param bytes [in] The size of the allocation (unused).
+*/
+void operator delete(void *pointer, size_t bytes) throw()
+	{
+	if (replace)
+		abort();
+	else
+		free(pointer);
+	}
+
 /*
 	OPERATOR NEW[]()
 	----------------
@@ -107,3 +125,20 @@ void operator delete[](void *pointer) throw()
 	else
 		free(pointer);
 	}
+
+/*
+	OPERATOR DELETE[]()
+	-------------------
+*/
+/*!
+	@brief Replacement verison of the (C++14) sized delete [].
+	@param pointer [in] Pointer to memory to free up.
+	@param bytes [in] The size of the allocation (unused).
+*/
+void operator delete[](void *pointer, size_t bytes) throw()
+	{
+	if (replace)
+		abort();
+	else
+		free(pointer);
+	}
@@ -18,9 +18,29 @@
 	#include <cpuid.h>
 #endif
 
+#include <stdint.h>
+
+#include <string>
 #include <sstream>
 #include <iostream>
 
+/*!
+	@brief Compile a function for AVX2 (and BMI1 and BMI2) whatever the compiler flags, so that it can be selected at run time (see hardware_support::instruction_set()).
+*/
+#if defined(__GNUC__) || defined(__clang__)
+	#define JASS_TARGET_AVX2 __attribute__((target("avx2,bmi,bmi2")))
+#else
+	#define JASS_TARGET_AVX2
+#endif
+
+/*!
+	@brief Compile a function for AVX-512 (and AVX2, BMI1, and BMI2) whatever the compiler flags, so that it can be selected at run time (see hardware_support::instruction_set()).
+*/
+#if defined(__GNUC__) || defined(__clang__)
+	#define JASS_TARGET_AVX512 __attribute__((target("avx512f,avx2,bmi,bmi2")))
+#else
+	#define JASS_TARGET_AVX512
+#endif
 
 namespace JASS
 	{
@@ -40,6 +60,18 @@ namespace JASS
 	*/
 	class hardware_support
 		{
+		public:
+			/*!
+				@enum simd
+				@brief The instruction sets that the SIMD codexes and kernels are compiled for, slowest first.
+			*/
+			enum class simd
+				{
+				sse41,			///< SSE 4.1 (the least that JASS runs on)
+				avx2,				///< AVX2, BMI1, and BMI2
+				avx512			///< AVX-512 Foundation, AVX2, BMI1, and BMI2
+				};
+
 		public:
 			//  Misc.
 			bool MMX;		///< MMX instructions
@@ -50,6 +82,8 @@ namespace JASS
 			bool BMI2;		///< Bit manipulation instructions 2
 			bool ADX;		///< Multi-precision add-carry instruction extensions
 			bool PREFETCHWT1;	///< Prefetch instructions
+			bool OS_AVX;		///< The operating system saves the AVX registers on a context switch
+			bool OS_AVX512;	///< The operating system saves the AVX-512 registers on a context switch
 
 			//  SIMD: 128-bit
 			bool SSE;		///< SSE instructions
@@ -100,6 +134,40 @@ namespace JASS
 				#endif
 				}
 
+			/*
+				HARDWARE_SUPPORT::XGETBV()
+				--------------------------
+			*/
+			/*!
+				@brief Read the XCR0 register (which register sets the operating system saves on a context switch).  Only valid if CPUID reports OSXSAVE.
+				@return The contents of XCR0.
+			*/
+			static uint64_t xgetbv(void)
+				{
+				#ifdef _MSC_VER
+					return _xgetbv(0);
+				#else
+					uint32_t low;
+					uint32_t high;
+					__asm__ __volatile__ ("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+					return (static_cast<uint64_t>(high) << 32) | low;
+				#endif
+				}
+
+			/*
+				HARDWARE_SUPPORT::SELECTED()
+				----------------------------
+			*/
+			/*!
+				@brief The instruction set selected for the SIMD codexes and kernels.  Initialised, on first use, to the fastest this CPU supports.
+				@return A reference to the selection.
+			*/
+			static simd &selected(void)
+				{
+				static simd selection = hardware_support().fastest();
+				return selection;
+				}
+
 		public:
 			/*
 				HARDWARE_SUPPORT::HARDWARE_SUPPORT()
@@ -117,6 +185,8 @@ namespace JASS
 				BMI2(false),
 				ADX(false),
 				PREFETCHWT1(false),
+				OS_AVX(false),
+				OS_AVX512(false),
 				SSE(false),
 				SSE2(false),
 				SSE3(false),
@@ -166,6 +236,16 @@ namespace JASS
 					FMA3   = (info[2] & ((int)1 << 12)) != 0;
 
 					RDRAND = (info[2] & ((int)1 << 30)) != 0;
+
+					/*
+						The CPU might support AVX and AVX-512 but the operating system must also save the registers (XMM, YMM, then opmask and ZMM)
+					*/
+					if ((info[2] & ((int)1 << 27)) != 0)
+						{
+						uint64_t xcr0 = xgetbv();
+						OS_AVX = (xcr0 & 0x06) == 0x06;
+						OS_AVX512 = (xcr0 & 0xE6) == 0xE6;
+						}
 					}
 				if (nIds >= 0x00000007)
 					{
@@ -199,6 +279,67 @@ namespace JASS
 					}
 				}
 
+			/*
+				HARDWARE_SUPPORT::FASTEST()
+				---------------------------
+			*/
+			/*!
+				@brief Return the fastest instruction set (of those the SIMD codexes and kernels are compiled for) that this CPU and operating system support.
+				@return The instruction set.
+			*/
+			simd fastest(void) const
+				{
+				if (AVX512F && AVX2 && BMI1 && BMI2 && OS_AVX512)
+					return simd::avx512;
+				else if (AVX2 && BMI1 && BMI2 && OS_AVX)
+					return simd::avx2;
+				else
+					return simd::sse41;
+				}
+
+			/*
+				HARDWARE_SUPPORT::INSTRUCTION_SET()
+				-----------------------------------
+			*/
+			/*!
+				@brief Return the instruction set the SIMD codexes and kernels use.  This is the fastest the CPU supports unless limit() has been called.
+				@return The instruction set.
+			*/
+			static simd instruction_set(void)
+				{
+				return selected();
+				}
+
+			/*
+				HARDWARE_SUPPORT::LIMIT()
+				-------------------------
+			*/
+			/*!
+				@brief Stop the SIMD codexes and kernels from using an instruction set faster than most (which must not be called while they are in use).
+				@details This can be used to test the slower implementations on a fast CPU, or to avoid AVX-512 on CPUs that slow their clock to run it.
+				It cannot select an instruction set the CPU does not support.
+				@param most [in] The fastest instruction set that may be used.
+			*/
+			static void limit(simd most)
+				{
+				simd supported = hardware_support().fastest();
+				selected() = most < supported ? most : supported;
+				}
+
+			/*
+				HARDWARE_SUPPORT::NAME()
+				------------------------
+			*/
+			/*!
+				@brief Return the name of an instruction set.
+				@param instructions [in] The instruction set.
+				@return The name.
+			*/
+			static const char *name(simd instructions)
+				{
+				return instructions == simd::avx512 ? "AVX-512" : instructions == simd::avx2 ? "AVX2" : "SSE4.1";
+				}
+
 
 			/*
 				HARDWARE_SUPPORT::UNITTEST()
@@ -215,6 +356,18 @@ namespace JASS
 				data << hardware;
 								   
 				JASS_assert(hardware.x64 == true);
+
+				/*
+					The selection can be limited, but never above what the CPU supports
+				*/
+				simd was = instruction_set();
+				JASS_assert(was <= hardware.fastest());
+				limit(simd::sse41);
+				JASS_assert(instruction_set() == simd::sse41);
+				limit(simd::avx512);
+				JASS_assert(instruction_set() == hardware.fastest());
+				limit(was);
+				JASS_assert(std::string(name(simd::avx2)) == "AVX2");
 				puts("hardware_support::PASSED");
 				}
 		};
@@ -238,6 +391,8 @@ namespace JASS
 		stream << "BMI2       :" << data.BMI2 << "\n";
 		stream << "ADX        :" << data.ADX << "\n";
 		stream << "PREFETCHWT1:" << data.PREFETCHWT1 << "\n";
+		stream << "OS_AVX     :" << data.OS_AVX << "\n";
+		stream << "OS_AVX512  :" << data.OS_AVX512 << "\n";
 
 		stream << "SSE        :" << data.SSE << "\n";
 		stream << "SSE2       :" << data.SSE2 << "\n";
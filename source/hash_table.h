@@ -235,6 +235,38 @@ namespace JASS
 				{
 				return iterator(*this, size(BITS));
 				}
+
+			/*
+				HASH_TABLE::BEGIN()
+				-------------------
+			*/
+			/*!
+				@brief Return an iterator pointing to the smallest element in one part of the hash table (for dividing the work of iterating between threads).
+				@details The hash table is divided into parts contiguous ranges of nodes, iterating from begin(part, parts) to end(part, parts) for each part
+				visits each element exactly once, and in the same order as begin() to end().
+				@param part [in] The part to iterate over (counting from 0).
+				@param parts [in] The number of parts the hash table is divided into.
+				@return Iterator pointing to smallest element in the part.
+			*/
+			iterator begin(size_t part, size_t parts) const
+				{
+				return iterator(*this, size(BITS) / parts * part);
+				}
+
+			/*
+				HASH_TABLE::END()
+				-----------------
+			*/
+			/*!
+				@brief Return an iterator pointing past the end of one part of the hash table (see begin(part, parts)).
+				@param part [in] The part to iterate over (counting from 0).
+				@param parts [in] The number of parts the hash table is divided into.
+				@return Iterator pointing past the end of the part.
+			*/
+			iterator end(size_t part, size_t parts) const
+				{
+				return part + 1 == parts ? end() : iterator(*this, size(BITS) / parts * (part + 1));
+				}
 			
 			/*
 				HASH_TABLE::TEXT_RENDER()
@@ -319,6 +351,15 @@ namespace JASS
 				for (const auto &element : map)
 					output << element.first;
 				JASS_assert(output.str() == "0614538729");
+
+				/*
+					Check the partitioned iterator visits the same elements in the same order
+				*/
+				std::ostringstream partitioned;
+				for (size_t part = 0; part < 3; part++)
+					for (auto element = map.begin(part, 3); element != map.end(part, 3); ++element)
+						partitioned << (*element).first;
+				JASS_assert(partitioned.str() == "0614538729");
 	
 				puts("hash_table::PASSED");
 				}
@@ -12,6 +12,8 @@
 */
 #pragma once
 
+#include <vector>
+
 #include "parser.h"
 #include "string_cpp.h"
 #include "index_postings.h"
@@ -246,6 +248,24 @@ namespace JASS
 				callback(slice(), postings, 0, nullptr, nullptr);
 				callback(0, slice());
 				}
+
+			/*
+				INDEX_MANAGER::ITERATE()
+				------------------------
+			*/
+			/*!
+				@brief Iterate over the index in parallel, one thread per callback.
+				@details Each postings list is passed to exactly one of the callbacks, and each callback is called from its own thread (so a callback
+				need not be thread-safe, but must not share state with the others).  The order in which the postings lists are given to a callback
+				is undefined.  The primary keys are passed to callbacks[0] once all postings lists have been seen.  This default implementation is
+				single threaded, it passes everything to callbacks[0].
+				@param callbacks [in] The callbacks to call, one per thread.
+			*/
+			virtual void iterate(std::vector<delegate *> &callbacks)
+				{
+				iterate(*callbacks[0]);
+				}
+
 			/*
 				INDEX_MANAGER_SEQUENTIAL::ITERATE()
 				-----------------------------------
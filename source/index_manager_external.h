@@ -0,0 +1,522 @@
+/*
+	INDEX_MANAGER_EXTERNAL.H
+	------------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief Non-thread-Safe indexer object that uses a bounded amount of memory by spilling postings to disk.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+
+#include "file.h"
+#include "parser.h"
+#include "hash_table.h"
+#include "dynamic_array.h"
+#include "index_manager.h"
+#include "unittest_data.h"
+#include "allocator_pool.h"
+#include "index_postings.h"
+#include "index_manager_sequential.h"
+
+namespace JASS
+	{
+	/*
+		CLASS INDEX_MANAGER_EXTERNAL
+		----------------------------
+	*/
+	/*!
+		@brief Non-thread-Safe indexer object that uses a bounded amount of memory by spilling postings to disk.
+		@details Postings are accumulated in memory exactly as index_manager_sequential does.  At the end of a document, if the postings
+		use more than the memory budget, they are written to disk as a "run" (in term order) and the memory is freed.  As each run holds
+		a contiguous range of documents, a term's postings list is the concatenation (in run order) of its postings in each run.  iterate()
+		k-way merges the runs term by term, so only one postings list is ever in memory (plus the vocabulary and the primary keys).  The
+		runs are deleted when this object is destroyed.
+	*/
+	class index_manager_external : public index_manager
+		{
+		private:
+			/*
+				CLASS INDEX_MANAGER_EXTERNAL::RUN_READER
+				----------------------------------------
+			*/
+			/*!
+				@brief Read a run from disk one term at a time.
+			*/
+			class run_reader
+				{
+				public:
+					file source;											///< The run file.
+					size_t run;												///< The number of this run (runs are in document order).
+					bool finished;											///< Has the end of the run been reached?
+					std::string term;										///< The current term.
+					compress_integer::integer document_frequency;	///< The document frequency of term in this run.
+
+				public:
+					/*
+						INDEX_MANAGER_EXTERNAL::RUN_READER::RUN_READER()
+						------------------------------------------------
+					*/
+					/*!
+						@brief Constructor.  Open the run and read the first term.
+						@param filename [in] The name of the run file.
+						@param run [in] The number of this run.
+					*/
+					run_reader(const std::string &filename, size_t run) :
+						source(filename, "rb"),
+						run(run),
+						finished(false),
+						document_frequency(0)
+						{
+						next();
+						}
+
+					/*
+						INDEX_MANAGER_EXTERNAL::RUN_READER::NEXT()
+						------------------------------------------
+					*/
+					/*!
+						@brief Move on to the next term (the postings of the current term must have been read).
+					*/
+					void next(void)
+						{
+						uint32_t length;
+
+						if (source.read(&length, sizeof(length)) != sizeof(length))
+							{
+							finished = true;
+							return;
+							}
+						term.resize(length);
+						source.read(&term[0], length);
+						source.read(&document_frequency, sizeof(document_frequency));
+						}
+
+					/*
+						INDEX_MANAGER_EXTERNAL::RUN_READER::READ_POSTINGS()
+						---------------------------------------------------
+					*/
+					/*!
+						@brief Read the postings of the current term.
+						@param document_ids [out] The document ids are written here.
+						@param term_frequencies [out] The term frequencies are written here.
+					*/
+					void read_postings(compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies)
+						{
+						source.read(document_ids, document_frequency * sizeof(*document_ids));
+						source.read(term_frequencies, document_frequency * sizeof(*term_frequencies));
+						}
+				};
+
+			/*
+				CLASS INDEX_MANAGER_EXTERNAL::RUN_READER_GREATER
+				------------------------------------------------
+			*/
+			/*!
+				@brief Order run readers on term then run so that std::make_heap() builds a min-heap.
+			*/
+			class run_reader_greater
+				{
+				public:
+					/*
+						INDEX_MANAGER_EXTERNAL::RUN_READER_GREATER::OPERATOR()()
+						--------------------------------------------------------
+					*/
+					/*!
+						@brief Compare two run readers.
+						@param first [in] The first reader.
+						@param second [in] The second reader.
+						@return true if first should come after second.
+					*/
+					bool operator()(const run_reader *first, const run_reader *second) const
+						{
+						int cmp = first->term.compare(second->term);
+						return cmp > 0 || (cmp == 0 && first->run > second->run);
+						}
+				};
+
+		private:
+			size_t memory_budget;															///< Spill to disk when the postings use more than this many bytes.
+			std::string run_prefix;															///< Run files are created with this prefix.
+			std::unique_ptr<allocator_pool> memory;									///< The postings are allocated from here (freed on each spill).
+			std::unique_ptr<hash_table<slice, index_postings, 24>> index;		///< The in-memory postings (nullptr when there are none).
+			size_t empty_size;																///< The memory used by the index when it contains no postings.
+			allocator_pool primary_key_memory;											///< The primary keys are allocated from here.
+			dynamic_array<slice> primary_key;											///< The list of primary keys (i.e. external document identifiers).
+			std::vector<std::string> runs;												///< The names of the run files, in document order.
+			allocator_pool vocabulary_memory;											///< The terms passed to iterate() callbacks are allocated from here.
+			std::vector<slice> vocabulary;												///< The terms, in the order iterate() gives them.
+
+			/*
+				Each of these buffers is re-used in the spill and merge process
+			*/
+			std::vector<compress_integer::integer> document_ids;					///< The re-used buffer storing decoded document ids.
+			std::vector<index_postings_impact::impact_type> term_frequencies;	///< The re-used buffer storing the term frequencies.
+			std::vector<uint8_t> temporary;												///< Temporary buffer used by index_postings::linearize().
+
+		private:
+			/*
+				INDEX_MANAGER_EXTERNAL::MAKE_SPACE()
+				------------------------------------
+			*/
+			/*!
+				@brief Make sure the buffers are large enough for the longest possible postings list.
+			*/
+			void make_space(void)
+				{
+				size_t documents = get_highest_document_id() + 1;
+
+				if (document_ids.size() < documents)
+					{
+					document_ids.resize(documents);
+					term_frequencies.resize(documents);
+					temporary.resize(documents * 5);						// 5 bytes is the worst case for a variable byte encoded 32-bit integer
+					}
+				}
+
+			/*
+				INDEX_MANAGER_EXTERNAL::SPILL()
+				-------------------------------
+			*/
+			/*!
+				@brief Write the in-memory postings to disk as a run (in term order) then free the memory they used.
+			*/
+			void spill(void)
+				{
+				if (index == nullptr)
+					return;
+
+				/*
+					Sort the terms into memcmp() order (which is the order std::string uses when the runs are merged)
+				*/
+				std::vector<std::pair<slice, const index_postings *>> terms;
+				for (const auto &listing : *index)
+					terms.push_back(std::make_pair(listing.first, &listing.second));
+				std::sort(terms.begin(), terms.end(), [](const std::pair<slice, const index_postings *> &first, const std::pair<slice, const index_postings *> &second){ return slice::strict_weak_order_less_than(first.first, second.first); });
+
+				/*
+					Write the run
+				*/
+				make_space();
+				runs.push_back(file::mkstemp(run_prefix));
+				{
+				file run(runs.back(), "wb");
+				for (const auto &term : terms)
+					{
+					uint32_t length = static_cast<uint32_t>(term.first.size());
+					compress_integer::integer document_frequency = term.second->linearize(&temporary[0], temporary.size(), &document_ids[0], &term_frequencies[0], document_ids.size());
+
+					run.write(&length, sizeof(length));
+					run.write(term.first.address(), length);
+					run.write(&document_frequency, sizeof(document_frequency));
+					run.write(&document_ids[0], document_frequency * sizeof(document_ids[0]));
+					run.write(&term_frequencies[0], document_frequency * sizeof(term_frequencies[0]));
+					}
+				}
+
+				/*
+					Free the memory (the hash table must go before the memory it is allocated from)
+				*/
+				index.reset();
+				memory.reset();
+				}
+
+			/*
+				INDEX_MANAGER_EXTERNAL::MERGE()
+				-------------------------------
+			*/
+			/*!
+				@brief Spill what is in memory then k-way merge the runs, calling callback with each term's postings list (in term order).
+				@param callback [in] Called as callback(term, postings, document_frequency, document_ids, term_frequencies) with the same
+				parameters as index_manager::delegate::operator()().
+			*/
+			template <typename CALLBACK>
+			void merge(CALLBACK callback)
+				{
+				spill();
+				make_space();
+
+				/*
+					The postings parameter of the callback is not used by the serialisers (they use document_ids and term_frequencies), so an empty one is passed
+				*/
+				allocator_pool pool;
+				index_postings postings(pool);
+
+				/*
+					Open each run and put it in a min-heap ordered on term then run
+				*/
+				std::vector<std::unique_ptr<run_reader>> readers;
+				std::vector<run_reader *> heap;
+				run_reader_greater greater;
+				for (size_t which = 0; which < runs.size(); which++)
+					{
+					readers.push_back(std::unique_ptr<run_reader>(new run_reader(runs[which], which)));
+					if (!readers.back()->finished)
+						heap.push_back(readers.back().get());
+					}
+				std::make_heap(heap.begin(), heap.end(), greater);
+
+				size_t term_number = 0;
+				std::string term;
+				while (heap.size() != 0)
+					{
+					/*
+						Concatenate the postings of the smallest term from each run it is in (the heap gives them to us in run order)
+					*/
+					term = heap.front()->term;
+					compress_integer::integer document_frequency = 0;
+					while (heap.size() != 0 && heap.front()->term == term)
+						{
+						std::pop_heap(heap.begin(), heap.end(), greater);
+						run_reader *current = heap.back();
+
+						current->read_postings(&document_ids[document_frequency], &term_frequencies[document_frequency]);
+						document_frequency += current->document_frequency;
+
+						current->next();
+						if (current->finished)
+							heap.pop_back();
+						else
+							std::push_heap(heap.begin(), heap.end(), greater);
+						}
+
+					/*
+						The serialisers keep the term (until they are destroyed) so it must stay in memory.  As the order of the terms is the same
+						each time, each term is only copied the first time.
+					*/
+					if (term_number == vocabulary.size())
+						vocabulary.push_back(slice(vocabulary_memory, term.c_str(), term.c_str() + term.size()));
+
+					callback(vocabulary[term_number], postings, document_frequency, &document_ids[0], &term_frequencies[0]);
+					term_number++;
+					}
+				}
+
+		public:
+			/*
+				INDEX_MANAGER_EXTERNAL::INDEX_MANAGER_EXTERNAL()
+				------------------------------------------------
+			*/
+			/*!
+				@brief Constructor
+				@param memory_budget [in] Spill the postings to disk when they use more than this number of bytes (checked at the end of each document).
+				@param run_prefix [in] The run files are created with this prefix (which can include a path).
+			*/
+			explicit index_manager_external(size_t memory_budget, const std::string &run_prefix = "JASS_run_") :
+				index_manager(),
+				memory_budget(memory_budget),
+				run_prefix(run_prefix),
+				empty_size(0),
+				primary_key(primary_key_memory, 1000, 1.5)
+				{
+				/* Nothing */
+				}
+
+			/*
+				INDEX_MANAGER_EXTERNAL::~INDEX_MANAGER_EXTERNAL()
+				-------------------------------------------------
+			*/
+			/*!
+				@brief Destructor.  Deletes the runs.
+			*/
+			virtual ~index_manager_external()
+				{
+				for (const auto &filename : runs)
+					(void)::remove(filename.c_str());
+				}
+
+			/*
+				INDEX_MANAGER_EXTERNAL::BEGIN_DOCUMENT()
+				----------------------------------------
+			*/
+			/*!
+				@brief Tell this object that you're about to start indexing a new object.
+				@param external_id [in] The document's primary key (or external document identifier).
+			*/
+			virtual void begin_document(const slice &external_id)
+				{
+				index_manager::begin_document(external_id);
+				primary_key.push_back(slice(primary_key_memory, external_id));
+
+				/*
+					If the postings were spilled at the end of the last document then start again
+				*/
+				if (index == nullptr)
+					{
+					memory.reset(new allocator_pool);
+					index.reset(new hash_table<slice, index_postings, 24>(*memory));
+					empty_size = memory->size();
+					}
+				}
+
+			/*
+				INDEX_MANAGER_EXTERNAL::TERM()
+				------------------------------
+			*/
+			/*!
+				@brief Hand a new term from the token stream to this object.
+				@param term [in] The term from the token stream.
+			*/
+			virtual void term(const parser::token &term)
+				{
+				(*index)[term.lexeme].push_back(get_highest_document_id());
+				}
+
+			/*
+				INDEX_MANAGER_EXTERNAL::END_DOCUMENT()
+				--------------------------------------
+			*/
+			/*!
+				@brief Tell this object that you've finished with the current document, and spill to disk if over the memory budget.
+				@param document_length [in] The length of the document (measured in terms).
+			*/
+			virtual void end_document(compress_integer::integer document_length)
+				{
+				index_manager::end_document(document_length);
+
+				if (memory->size() - empty_size > memory_budget)
+					spill();
+				}
+
+			/*
+				INDEX_MANAGER_EXTERNAL::GET_NUMBER_OF_RUNS()
+				--------------------------------------------
+			*/
+			/*!
+				@brief Return the number of runs that have been written to disk so far.
+				@return The number of runs.
+			*/
+			size_t get_number_of_runs(void) const
+				{
+				return runs.size();
+				}
+
+			/*
+				INDEX_MANAGER_EXTERNAL::ITERATE()
+				---------------------------------
+			*/
+			/*!
+				@brief Iterate over the index calling callback.operator() with each postings list.
+				@param callback [in] The callback to call.
+			*/
+			virtual void iterate(index_manager::delegate &callback)
+				{
+				merge([&callback](const slice &term, const index_postings &postings, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies)
+					{
+					callback(term, postings, document_frequency, document_ids, term_frequencies);
+					});
+
+				/*
+					Note that the search engine counts documents from 1, not from 0.
+				*/
+				size_t instance = 0;
+				callback(instance, slice("-"));
+				for (const auto &term : primary_key)
+					callback(++instance, term);
+				}
+
+			/*
+				INDEX_MANAGER_EXTERNAL::ITERATE()
+				---------------------------------
+			*/
+			/*!
+				@brief Iterate over the index calling callback.operator() with each postings list.
+				@param quantizer [in] The quantizer that will quantize then call the serialiser callback.
+				@param callback [in] The callback that the quantizer should call.
+			*/
+			virtual void iterate(index_manager::quantizing_delegate &quantizer, index_manager::delegate &callback)
+				{
+				merge([&quantizer, &callback](const slice &term, const index_postings &postings, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies)
+					{
+					quantizer(callback, term, postings, document_frequency, document_ids, term_frequencies);
+					});
+
+				size_t instance = 0;
+				quantizer(callback, instance, slice("-"));
+				for (const auto &term : primary_key)
+					quantizer(callback, ++instance, term);
+				}
+
+			/*
+				INDEX_MANAGER_EXTERNAL::UNITTEST()
+				----------------------------------
+			*/
+			/*!
+				@brief Unit test this class.
+			*/
+			static void unittest(void)
+				{
+				/*
+					Collect the postings in a std::map as the order of iteration is different from index_manager_sequential.
+				*/
+				class collect : public index_manager::delegate
+					{
+					public:
+						std::map<std::string, std::string> postings;
+						std::ostringstream primary_keys;
+
+					public:
+						virtual void operator()(const slice &term, const index_postings &postings_list, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies)
+							{
+							std::ostringstream list;
+							for (compress_integer::integer which = 0; which < document_frequency; which++)
+								list << '<' << document_ids[which] << ',' << (size_t)term_frequencies[which] << '>';
+							postings[std::string(reinterpret_cast<char *>(term.address()), term.size())] = list.str();
+							}
+
+						virtual void operator()(size_t document_id, const slice &primary_key)
+							{
+							primary_keys << document_id << "->" << primary_key << '\n';
+							}
+					};
+
+				/*
+					Build the standard 10 document collection in memory
+				*/
+				index_manager_sequential sequential;
+				index_manager_sequential::unittest_build_index(sequential, unittest_data::ten_documents);
+				collect expected;
+				sequential.iterate(expected);
+
+				/*
+					Build it with a budget of 0 (so there is a run for every document) and with a budget large enough that there is only one run
+				*/
+				for (size_t budget : {0, 1024 * 1024})
+					{
+					index_manager_external external(budget, "jass_run_");
+					index_manager_sequential::unittest_build_index(external, unittest_data::ten_documents);
+					JASS_assert(external.get_number_of_runs() == (budget == 0 ? 10 : 0));
+
+					/*
+						Iterate twice, as quantization then serialisation does
+					*/
+					for (size_t pass = 0; pass < 2; pass++)
+						{
+						collect got;
+						external.iterate(got);
+						JASS_assert(got.postings == expected.postings);
+						JASS_assert(got.primary_keys.str() == expected.primary_keys.str());
+						}
+					JASS_assert(external.get_document_length_vector() == sequential.get_document_length_vector());
+					}
+
+				/*
+					Done
+				*/
+				puts("index_manager_external::PASSED");
+				}
+		};
+	}
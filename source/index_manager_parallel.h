@@ -0,0 +1,405 @@
+/*
+	INDEX_MANAGER_PARALLEL.H
+	------------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief Indexer object that parses documents on several threads then merges the result.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <mutex>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <sstream>
+
+#include "parser.h"
+#include "threads.h"
+#include "document.h"
+#include "hash_table.h"
+#include "unittest_data.h"
+#include "index_postings.h"
+#include "instream_memory.h"
+#include "instream_document_trec.h"
+#include "index_manager_sequential.h"
+
+namespace JASS
+	{
+	/*
+		CLASS INDEX_MANAGER_PARALLEL
+		----------------------------
+	*/
+	/*!
+		@brief Indexer object that parses documents on several threads then merges the result.
+		@details Each thread takes the next document from a shared instream (assigning it the next document id), parses it, and adds it to its
+		own private shard (with its own allocator_pool and hash table) so there is no locking during parsing.  Once the instream is exhausted the
+		shards are merged into this object.  The postings of each term are merged from the shards in document id order, and the primary keys and
+		document lengths are added in document id order, so the result is the same as if the documents had been indexed with an
+		index_manager_sequential.  From then on this object is used exactly as an index_manager_sequential is used (iterate(), etc.).
+	*/
+	class index_manager_parallel : public index_manager_sequential
+		{
+		public:
+			/*
+				CLASS INDEX_MANAGER_PARALLEL::SHARD
+				-----------------------------------
+			*/
+			/*!
+				@brief The private index of a single thread.
+				@details Documents arrive in increasing (but not consecutive) document id order, so each postings list is in document id order.
+			*/
+			class shard : public index_manager
+				{
+				friend class index_manager_parallel;
+
+				private:
+					allocator_pool memory;											///< All memory is allocated from this allocator.
+					hash_table<slice, index_postings, 24> index;				///< The index is a hash table of index_postings keyed on the term (a slice).
+					compress_integer::integer document_id;						///< The (global) document id of the current document.
+					std::vector<compress_integer::integer> document_ids;	///< The (global) document id of each document in this shard.
+					std::vector<slice> primary_keys;								///< The primary key of each document in this shard (parallel to document_ids).
+
+				public:
+					/*
+						INDEX_MANAGER_PARALLEL::SHARD::SHARD()
+						--------------------------------------
+					*/
+					/*!
+						@brief Constructor
+					*/
+					shard() :
+						index(memory),
+						document_id(0)
+						{
+						/* Nothing */
+						}
+
+					/*
+						INDEX_MANAGER_PARALLEL::SHARD::BEGIN_DOCUMENT()
+						-----------------------------------------------
+					*/
+					/*!
+						@brief Tell this object that you're about to start indexing a new object.
+						@param document_id [in] The (global) document id of this document, which must be larger than that of any earlier document.
+						@param external_id [in] The document's primary key (or external document identifier).
+					*/
+					void begin_document(compress_integer::integer document_id, const slice &external_id)
+						{
+						index_manager::begin_document(external_id);
+						this->document_id = document_id;
+						document_ids.push_back(document_id);
+						primary_keys.push_back(slice(memory, external_id));
+						}
+
+					/*
+						INDEX_MANAGER_PARALLEL::SHARD::TERM()
+						-------------------------------------
+					*/
+					/*!
+						@brief Hand a new term from the token stream to this object.
+						@param term [in] The term from the token stream.
+					*/
+					virtual void term(const parser::token &term)
+						{
+						index[term.lexeme].push_back(document_id);
+						}
+				};
+
+		private:
+			/*
+				CLASS INDEX_MANAGER_PARALLEL::MERGE_SOURCE
+				------------------------------------------
+			*/
+			/*!
+				@brief A linearized postings list from one shard during the merge.
+			*/
+			class merge_source
+				{
+				public:
+					std::unique_ptr<compress_integer::integer []> document_ids;						///< The document ids of the postings list.
+					std::unique_ptr<index_postings_impact::impact_type []> term_frequencies;	///< The term frequencies of the postings list.
+					std::unique_ptr<uint8_t []> temporary;													///< Scratch space used by index_postings::linearize().
+					size_t capacity;																				///< The length of document_ids and term_frequencies.
+					size_t temporary_size;																		///< The length of temporary.
+					size_t length;																					///< The document frequency of the current postings list.
+					size_t current;																				///< The next posting to merge.
+
+				public:
+					/*
+						INDEX_MANAGER_PARALLEL::MERGE_SOURCE::MERGE_SOURCE()
+						----------------------------------------------------
+					*/
+					/*!
+						@brief Constructor
+						@param documents [in] The number of documents in the shard (the longest possible postings list).
+					*/
+					explicit merge_source(size_t documents) :
+						document_ids(new compress_integer::integer [documents + 1]),
+						term_frequencies(new index_postings_impact::impact_type [documents + 1]),
+						temporary(new uint8_t [(documents + 1) * 5]),			// 5 bytes is the worst case for a variable byte encoded 32-bit integer
+						capacity(documents + 1),
+						temporary_size((documents + 1) * 5),
+						length(0),
+						current(0)
+						{
+						/* Nothing */
+						}
+
+					/*
+						INDEX_MANAGER_PARALLEL::MERGE_SOURCE::LOAD()
+						--------------------------------------------
+					*/
+					/*!
+						@brief Linearize a postings list ready for merging.
+						@param postings [in] The postings list.
+					*/
+					void load(const index_postings &postings)
+						{
+						length = postings.linearize(temporary.get(), temporary_size, document_ids.get(), term_frequencies.get(), capacity);
+						current = 0;
+						}
+				};
+
+		private:
+			size_t threads;													///< The number of threads to parse with.
+			std::vector<std::unique_ptr<shard>> shards;				///< The per-thread indexes (only valid during index_stream()).
+			std::mutex source_lock;											///< Serialises reading from the instream.
+			compress_integer::integer documents_read;					///< The number of documents read from the instream (the last document id issued).
+
+		private:
+			/*
+				INDEX_MANAGER_PARALLEL::WORKER()
+				--------------------------------
+			*/
+			/*!
+				@brief The main loop of each thread: read a document, give it the next document id, and index it into the thread's shard.
+				@param manager [in] The manager.
+				@param source [in] The instream to read documents from.
+				@param into [in] This thread's shard.
+				@param index_document [in] The function that parses a document into the shard (see index_stream()).
+			*/
+			template <typename INDEX_DOCUMENT>
+			static void worker(index_manager_parallel &manager, instream &source, shard &into, INDEX_DOCUMENT &index_document)
+				{
+				class parser parser;
+				document document;
+
+				while (true)
+					{
+					compress_integer::integer document_id;
+
+					/*
+						Reading from the instream is sequential, and it decides the document id, so it's done under a lock
+					*/
+					document.rewind();
+					{
+					std::unique_lock<std::mutex> guard(manager.source_lock);
+					source.read(document);
+					if (document.isempty())
+						break;
+					document_id = ++manager.documents_read;
+					}
+
+					into.begin_document(document_id, document.primary_key);
+					into.end_document(index_document(parser, document, into));
+					}
+				}
+
+			/*
+				INDEX_MANAGER_PARALLEL::MERGE()
+				-------------------------------
+			*/
+			/*!
+				@brief Merge the shards into this object, in document id order.
+			*/
+			void merge(void)
+				{
+				/*
+					Gather the primary keys and document lengths into document id order then add them as the sequential indexer would
+				*/
+				std::vector<slice> primary_keys(documents_read + 1);
+				std::vector<compress_integer::integer> lengths(documents_read + 1);
+				for (const auto &part : shards)
+					for (size_t which = 0; which < part->document_ids.size(); which++)
+						{
+						primary_keys[part->document_ids[which]] = part->primary_keys[which];
+						lengths[part->document_ids[which]] = part->get_document_length_vector()[which + 1];
+						}
+
+				for (compress_integer::integer document_id = 1; document_id <= documents_read; document_id++)
+					{
+					index_manager_sequential::begin_document(primary_keys[document_id]);
+					index_manager_sequential::end_document(lengths[document_id]);
+					}
+
+				/*
+					Merge the postings.  A term is merged the first time it is seen (in the lowest numbered shard it occurs in), at which time it is
+					looked up in each later shard.
+				*/
+				std::vector<merge_source> sources;
+				for (const auto &part : shards)
+					sources.emplace_back(part->get_highest_document_id());
+
+				for (size_t from = 0; from < shards.size(); from++)
+					for (const auto &listing : shards[from]->index)
+						{
+						index_postings &postings = index[listing.first];
+						if (!postings.isempty())
+							continue;			// already merged from an earlier shard
+
+						sources[from].load(listing.second);
+						for (size_t which = from + 1; which < shards.size(); which++)
+							sources[which].load(shards[which]->index[listing.first]);
+
+						/*
+							k-way merge on document id (the number of shards is small so a linear search for the smallest is fast enough)
+						*/
+						while (true)
+							{
+							merge_source *smallest = nullptr;
+							compress_integer::integer smallest_id = (std::numeric_limits<compress_integer::integer>::max)();
+							for (size_t which = from; which < shards.size(); which++)
+								{
+								merge_source &current = sources[which];
+								if (current.current < current.length && current.document_ids[current.current] < smallest_id)
+									{
+									smallest = &current;
+									smallest_id = current.document_ids[current.current];
+									}
+								}
+
+							if (smallest == nullptr)
+								break;
+
+							postings.push_back(smallest_id, smallest->term_frequencies[smallest->current]);
+							smallest->current++;
+							}
+						}
+				}
+
+		public:
+			/*
+				INDEX_MANAGER_PARALLEL::INDEX_MANAGER_PARALLEL()
+				------------------------------------------------
+			*/
+			/*!
+				@brief Constructor
+				@param threads [in] The number of threads to parse with.
+			*/
+			explicit index_manager_parallel(size_t threads) :
+				threads(threads == 0 ? 1 : threads),
+				documents_read(0)
+				{
+				/* Nothing */
+				}
+
+			/*
+				INDEX_MANAGER_PARALLEL::~INDEX_MANAGER_PARALLEL()
+				-------------------------------------------------
+			*/
+			/*!
+				@brief Destructor
+			*/
+			virtual ~index_manager_parallel()
+				{
+				/* Nothing */
+				}
+
+			/*
+				INDEX_MANAGER_PARALLEL::INDEX_STREAM()
+				--------------------------------------
+			*/
+			/*!
+				@brief Index every document in the instream using several threads, then merge the result into this object.
+				@param source [in] The instream of documents (such as an instream_document_trec).
+				@param index_document [in] A function (or lambda) compress_integer::integer index_document(parser &parser, document &document, shard &index)
+				that parses the document and calls index.term() for each term, returning the document's length (which is passed to end_document()).
+				It is called concurrently from each thread (each with its own parser and shard).
+			*/
+			template <typename INDEX_DOCUMENT>
+			void index_stream(instream &source, INDEX_DOCUMENT index_document)
+				{
+				for (size_t which = 0; which < threads; which++)
+					shards.push_back(std::unique_ptr<shard>(new shard));
+
+				std::vector<thread> team;
+				for (size_t which = 0; which < threads; which++)
+					team.push_back(thread(worker<INDEX_DOCUMENT>, std::ref(*this), std::ref(source), std::ref(*shards[which]), std::ref(index_document)));
+				for (auto &member : team)
+					member.join();
+
+				merge();
+				shards.clear();
+				}
+
+			/*
+				INDEX_MANAGER_PARALLEL::UNITTEST()
+				----------------------------------
+			*/
+			/*!
+				@brief Unit test this class.
+			*/
+			static void unittest(void)
+				{
+				/*
+					Build the index of the standard 10 document collection sequentially
+				*/
+				index_manager_sequential sequential;
+				index_manager_sequential::unittest_build_index(sequential, unittest_data::ten_documents);
+
+				/*
+					Build it in parallel (with more threads than it needs, and with one thread)
+				*/
+				for (size_t threads : {3, 1})
+					{
+					std::shared_ptr<instream> file(new instream_memory(unittest_data::ten_documents.c_str(), unittest_data::ten_documents.size()));
+					instream_document_trec source(file);
+					index_manager_parallel parallel(threads);
+
+					parallel.index_stream(source, [](class parser &parser, document &document, shard &index)
+						{
+						compress_integer::integer document_length = 0;
+
+						parser.set_document(document);
+						for (const auto *token = &parser.get_next_token(); token->type != parser::token::eof; token = &parser.get_next_token())
+							if (token->type == parser::token::alpha || token->type == parser::token::numeric)
+								{
+								document_length++;
+								index.term(*token);
+								}
+
+						return document_length + 1;				// unittest_build_index() counts the eof token
+						});
+
+					/*
+						It must be the same as the sequential index
+					*/
+					JASS_assert(parallel.get_highest_document_id() == sequential.get_highest_document_id());
+					JASS_assert(parallel.get_document_length_vector() == sequential.get_document_length_vector());
+
+					std::ostringstream sequential_postings;
+					std::ostringstream sequential_primary_keys;
+					index_manager_sequential::delegate sequential_callback(sequential_postings, sequential_primary_keys);
+					sequential.iterate(sequential_callback);
+
+					std::ostringstream parallel_postings;
+					std::ostringstream parallel_primary_keys;
+					index_manager_sequential::delegate parallel_callback(parallel_postings, parallel_primary_keys);
+					parallel.iterate(parallel_callback);
+
+					JASS_assert(parallel_postings.str() == sequential_postings.str());
+					JASS_assert(parallel_primary_keys.str() == sequential_primary_keys.str());
+					}
+
+				/*
+					Done
+				*/
+				puts("index_manager_parallel::PASSED");
+				}
+		};
+	}
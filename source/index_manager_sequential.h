@@ -16,6 +16,7 @@
 #include <sstream>
 
 #include "parser.h"
+#include "threads.h"
 #include "hash_table.h"
 #include "index_manager.h"
 #include "unittest_data.h"
@@ -36,7 +37,7 @@ namespace JASS
 	*/
 	class index_manager_sequential : public index_manager
 		{
-		private:
+		protected:
 			allocator_pool memory;														///< All memory in allocatged from this allocator.
 			hash_table<slice, index_postings, 24> index;							///< The index is a hash table of index_postings keyed on the term (a slice).
 			dynamic_array<slice> primary_key;										///< The list of primary keys (i.e. external document identifiers) allocated in memory.
@@ -149,6 +150,36 @@ namespace JASS
 					}
 				}
 
+			/*
+				INDEX_MANAGER_SEQUENTIAL::ITERATE_PART()
+				----------------------------------------
+			*/
+			/*!
+				@brief The main loop of each thread of the parallel iterate(): linearize each postings list in one part of the hash table and pass it to the callback.
+				@param manager [in] The index being iterated over.
+				@param callback [in] This thread's callback.
+				@param part [in] The part of the hash table this thread iterates over.
+				@param parts [in] The number of parts (threads).
+			*/
+			static void iterate_part(index_manager_sequential &manager, index_manager::delegate &callback, size_t part, size_t parts)
+				{
+				/*
+					Each thread has its own buffers to linearize into.
+				*/
+				size_t documents = manager.get_highest_document_id();
+				size_t buffer_size = documents * (sizeof(compress_integer::integer) / 7 + 1);
+				std::unique_ptr<compress_integer::integer []> ids(new compress_integer::integer [documents]);
+				std::unique_ptr<index_postings_impact::impact_type []> frequencies(new index_postings_impact::impact_type [documents]);
+				std::unique_ptr<uint8_t []> buffer(new uint8_t [buffer_size]);
+
+				auto end = manager.index.end(part, parts);
+				for (auto listing = manager.index.begin(part, parts); listing != end; ++listing)
+					{
+					auto document_frequency = (*listing).second.linearize(buffer.get(), buffer_size, ids.get(), frequencies.get(), documents);
+					callback((*listing).first, (*listing).second, document_frequency, ids.get(), frequencies.get());
+					}
+				}
+
 		public:
 			/*
 				INDEX_MANAGER_SEQUENTIAL::INDEX_MANAGER_SEQUENTIAL()
@@ -294,6 +325,42 @@ namespace JASS
 					quantizer(callback, ++instance, term);
 				}
 
+			/*
+				INDEX_MANAGER_SEQUENTIAL::ITERATE()
+				-----------------------------------
+			*/
+			/*!
+				@brief Iterate over the index in parallel, one thread per callback (see index_manager::iterate()).
+				@details The hash table is divided into callbacks.size() parts and each part is iterated over by its own thread, with its own buffers.
+				@param callbacks [in] The callbacks to call, one per thread.
+			*/
+			virtual void iterate(std::vector<index_manager::delegate *> &callbacks)
+				{
+				if (callbacks.size() <= 1)
+					{
+					iterate(*callbacks[0]);
+					return;
+					}
+
+				/*
+					Iterate over the hash table, one part per thread.
+				*/
+				std::vector<thread> team;
+				for (size_t part = 0; part < callbacks.size(); part++)
+					team.push_back(thread(iterate_part, std::ref(*this), std::ref(*callbacks[part]), part, callbacks.size()));
+				for (auto &member : team)
+					member.join();
+
+				/*
+					Iterate over the primary keys calling the first callback function with each docid->key pair.
+					Note that the search engine counts documents from 1, not from 0.
+				*/
+				size_t instance = 0;
+				(*callbacks[0])(instance, slice("-"));
+				for (const auto &term : primary_key)
+					(*callbacks[0])(++instance, term);
+				}
+
 			/*
 				INDEX_MANAGER_SEQUENTIAL::UNITTEST_BUILD_INDEX()
 				------------------------------------------------
@@ -304,7 +371,7 @@ namespace JASS
 				@param index [out] The index once built.
 				@param document_collection [in] The documents to index.
 			*/
-			static void unittest_build_index(index_manager_sequential &index, const std::string &document_collection)
+			static void unittest_build_index(index_manager &index, const std::string &document_collection)
 				{
 				class parser parser;								// We need a parser
 				document document;						// That creates documents
@@ -451,6 +518,21 @@ namespace JASS
 				JASS_assert(postings_result.str() == answer);
 				JASS_assert(primary_key_result.str() == primary_key_answer);
 
+				/*
+					Test the parallel iterating callback mechanism (each thread iterates over the next part of the hash table so the parts, concatenated, are in order)
+				*/
+				std::ostringstream part_postings_result[3];
+				std::ostringstream part_primary_key_result[3];
+				delegate part_0(part_postings_result[0], part_primary_key_result[0]);
+				delegate part_1(part_postings_result[1], part_primary_key_result[1]);
+				delegate part_2(part_postings_result[2], part_primary_key_result[2]);
+				std::vector<index_manager::delegate *> callbacks = {&part_0, &part_1, &part_2};
+				index.iterate(callbacks);
+
+				JASS_assert(part_postings_result[0].str() + part_postings_result[1].str() + part_postings_result[2].str() == answer);
+				JASS_assert(part_primary_key_result[0].str() == primary_key_answer);
+				JASS_assert(part_primary_key_result[1].str().size() == 0 && part_primary_key_result[2].str().size() == 0);
+
 				/*
 					Done
 				*/
@@ -133,6 +133,42 @@ namespace JASS
 					}
 				}
 
+			/*
+				INDEX_POSTINGS::PUSH_BACK()
+				---------------------------
+			*/
+			/*!
+				@brief Add a document with a known term frequency to the end of the postings list (used when merging postings lists).
+				@param document_id [in] The document id, which must be larger than any already in the postings list.
+				@param term_frequency [in] The number of times the term occurs in the document.
+			*/
+			void push_back(JASS::compress_integer::integer document_id, index_postings_impact::impact_type term_frequency)
+				{
+				uint8_t space[10];				// worst case for a 64-bit integer (70 bits  / 7 bits per byte = 10 bytes)
+				uint8_t *ending = space;		// write into here;
+
+				compress_integer_variable_byte::compress_into(ending, document_id - highest_document);
+
+				for (uint8_t *byte = space; byte < ending; byte++)
+					document_ids.push_back(*byte);
+				term_frequencies.push_back(term_frequency);
+
+				highest_document = document_id;
+				}
+
+			/*
+				INDEX_POSTINGS::ISEMPTY()
+				-------------------------
+			*/
+			/*!
+				@brief Is this postings list empty?
+				@return true if no documents have been added, else false.
+			*/
+			bool isempty(void) const
+				{
+				return highest_document == 0;
+				}
+
 			/*
 				INDEX_POSTINGS::LINEARIZE()
 				---------------------------
@@ -211,7 +247,7 @@ namespace JASS
 				@param document_ids [in] The list of document ids.
 				@param term_frequencies [in] The list of term frequencies.
 			*/
-			void impact_order(index_postings_impact &postings_list, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies) const
+			static void impact_order(index_postings_impact &postings_list, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies)
 				{
 				std::array<compress_integer::integer, 0x100> frequencies = {};
 				size_t number_of_postings = 0;
@@ -342,6 +378,20 @@ namespace JASS
 
 				JASS_assert(strcmp(result.str().c_str(), "<1,2><2,1><173252,1>") == 0);
 
+				/*
+					Add with known term frequencies and check it's the same as adding one occurrence at a time
+				*/
+				index_postings merged(pool);
+				JASS_assert(merged.isempty());
+				merged.push_back(1, 2);
+				merged.push_back(2, 1);
+				merged.push_back(173252, 1);
+				JASS_assert(!merged.isempty());
+
+				std::ostringstream merged_result;
+				merged.text_render(merged_result);
+				JASS_assert(merged_result.str() == result.str());
+
 				puts("index_postings::PASSED");
 				}
 		};
@@ -0,0 +1,167 @@
+/*
+	NUMA_TOPOLOGY.CPP
+	-----------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+	#include <unistd.h>
+	#include <sys/syscall.h>
+#endif
+
+#include <thread>
+#include <algorithm>
+
+#include "asserts.h"
+#include "numa_topology.h"
+
+namespace JASS
+	{
+	/*
+		NUMA_TOPOLOGY::READ_LINE()
+		--------------------------
+	*/
+	std::string numa_topology::read_line(const std::string &filename)
+		{
+		char buffer[1024];
+		FILE *fp = fopen(filename.c_str(), "rb");
+		if (fp == nullptr)
+			return std::string();
+
+		std::string answer;
+		if (fgets(buffer, sizeof(buffer), fp) != nullptr)
+			answer = buffer;
+		fclose(fp);
+
+		return answer;
+		}
+
+	/*
+		NUMA_TOPOLOGY::PARSE_LIST()
+		---------------------------
+	*/
+	std::vector<size_t> numa_topology::parse_list(const std::string &list)
+		{
+		std::vector<size_t> answer;
+		const char *current = list.c_str();
+
+		while (*current != '\0')
+			{
+			char *end;
+			size_t from = strtoull(current, &end, 10);
+			if (end == current)
+				break;
+
+			size_t to = from;
+			if (*end == '-')
+				{
+				current = end + 1;
+				to = strtoull(current, &end, 10);
+				}
+
+			for (size_t number = from; number <= to; number++)
+				answer.push_back(number);
+
+			current = end;
+			while (*current == ',' || *current == '\n' || *current == ' ')
+				current++;
+			}
+
+		return answer;
+		}
+
+	/*
+		NUMA_TOPOLOGY::NODES()
+		----------------------
+	*/
+	std::vector<std::vector<size_t>> numa_topology::nodes(void)
+		{
+		std::vector<std::vector<size_t>> answer;
+
+		#ifdef __linux__
+			for (const auto node : parse_list(read_line("/sys/devices/system/node/online")))
+				{
+				std::vector<size_t> cpu_list = parse_list(read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+				if (cpu_list.size() != 0)
+					answer.push_back(cpu_list);
+				}
+		#endif
+
+		/*
+			Not NUMA (or we can't tell) so we're one node with all the CPUs
+		*/
+		if (answer.size() == 0)
+			{
+			std::vector<size_t> cpu_list;
+			for (size_t cpu = 0; cpu < (std::max)(std::thread::hardware_concurrency(), 1U); cpu++)
+				cpu_list.push_back(cpu);
+			answer.push_back(cpu_list);
+			}
+
+		return answer;
+		}
+
+	/*
+		NUMA_TOPOLOGY::INTERLEAVE_ALLOCATIONS()
+		---------------------------------------
+	*/
+	bool numa_topology::interleave_allocations(bool interleave)
+		{
+		#if defined(__linux__) && defined(SYS_set_mempolicy)
+			constexpr int MPOL_DEFAULT = 0;			// from <numaif.h>, which might not be installed
+			constexpr int MPOL_INTERLEAVE = 3;
+
+			if (!interleave)
+				return syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0) == 0;
+
+			/*
+				Interleave over every node with memory
+			*/
+			std::vector<size_t> node_list = parse_list(read_line("/sys/devices/system/node/has_memory"));
+			if (node_list.size() == 0)
+				return false;
+
+			constexpr size_t bits_per_word = sizeof(unsigned long) * 8;
+			std::vector<unsigned long> mask(node_list.back() / bits_per_word + 1, 0);
+			for (const auto node : node_list)
+				mask[node / bits_per_word] |= 1UL << (node % bits_per_word);
+
+			return syscall(SYS_set_mempolicy, MPOL_INTERLEAVE, mask.data(), mask.size() * bits_per_word) == 0;
+		#else
+			return !interleave;
+		#endif
+		}
+
+	/*
+		NUMA_TOPOLOGY::UNITTEST()
+		-------------------------
+	*/
+	void numa_topology::unittest(void)
+		{
+		/*
+			Check the list parser
+		*/
+		std::vector<size_t> expected = {0, 1, 2, 3, 8, 10, 11};
+		JASS_assert(parse_list("0-3,8,10-11\n") == expected);
+		JASS_assert(parse_list("") == std::vector<size_t>());
+		JASS_assert(parse_list("5") == std::vector<size_t>{5});
+
+		/*
+			There is always at least one node and every node has at least one CPU
+		*/
+		auto node_list = nodes();
+		JASS_assert(node_list.size() >= 1);
+		for (const auto &node : node_list)
+			JASS_assert(node.size() >= 1);
+
+		/*
+			Going back to the default policy always works
+		*/
+		JASS_assert(interleave_allocations(false));
+
+		puts("numa_topology::PASSED");
+		}
+	}
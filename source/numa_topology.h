@@ -0,0 +1,87 @@
+/*
+	NUMA_TOPOLOGY.H
+	---------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief The NUMA nodes of the machine, the CPUs on each, and control over where memory is allocated.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace JASS
+	{
+	/*
+		CLASS NUMA_TOPOLOGY
+		-------------------
+	*/
+	/*!
+		@brief The NUMA nodes of the machine, the CPUs on each, and control over where memory is allocated.
+		@details The topology is read from /sys/devices/system/node and the memory policy is set with the set_mempolicy() system call, so
+		libnuma is not needed.  On other operating systems (and Linux machines without NUMA) the machine is reported as a single node
+		holding all the CPUs, and the memory policy cannot be changed.
+	*/
+	class numa_topology
+		{
+		private:
+			/*
+				NUMA_TOPOLOGY::READ_LINE()
+				--------------------------
+			*/
+			/*!
+				@brief Read the first line of a (sysfs) file.
+				@details file::read_entire_file() can't be used because sysfs reports the size of every file as a page.
+				@param filename [in] The name of the file.
+				@return The line (or the empty string on error).
+			*/
+			static std::string read_line(const std::string &filename);
+
+		public:
+			/*
+				NUMA_TOPOLOGY::PARSE_LIST()
+				---------------------------
+			*/
+			/*!
+				@brief Parse a Linux list format string (such as "0-3,8,10-11") into the list of numbers it represents.
+				@param list [in] The string.
+				@return The numbers (in the order they appear in the string).
+			*/
+			static std::vector<size_t> parse_list(const std::string &list);
+
+			/*
+				NUMA_TOPOLOGY::NODES()
+				----------------------
+			*/
+			/*!
+				@brief Return the CPUs of each NUMA node that has CPUs.
+				@return One list of CPUs for each node (there is always at least one node).
+			*/
+			static std::vector<std::vector<size_t>> nodes(void);
+
+			/*
+				NUMA_TOPOLOGY::INTERLEAVE_ALLOCATIONS()
+				---------------------------------------
+			*/
+			/*!
+				@brief Set the memory policy of the calling thread so that the pages it allocates are spread across all the nodes (or put it back to the default of node-local).
+				@param interleave [in] true to interleave, false for the default policy.
+				@return true on success, false if the policy could not be set.
+			*/
+			static bool interleave_allocations(bool interleave);
+
+			/*
+				NUMA_TOPOLOGY::UNITTEST()
+				-------------------------
+			*/
+			/*!
+				@brief Unit test this class.
+			*/
+			static void unittest(void);
+		};
+	}
@@ -0,0 +1,80 @@
+/*
+	PREFETCH.H
+	----------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief Operating system and compiler independant software prefetch.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
+#include "forceinline.h"
+
+namespace JASS
+	{
+	/*
+		CLASS PREFETCH
+		--------------
+	*/
+	/*!
+		@brief Hint to the CPU that memory is about to be read, so that it can be loaded into cache while the CPU does something else.
+		@details Prefetches are only hints, they never fault (so prefetching past the end of an array is safe) and they can be ignored.
+	*/
+	class prefetch
+		{
+		public:
+			static constexpr size_t cache_line_size = 64;			///< The size of a cache line on the CPUs we care about
+
+		public:
+			/*
+				PREFETCH::READ()
+				----------------
+			*/
+			/*!
+				@brief Prefetch the cache line containing address.
+				@param address [in] The address that will be read.
+			*/
+			static forceinline void read(const void *address)
+				{
+				#if defined(__GNUC__) || defined(__clang__)
+					__builtin_prefetch(address, 0, 3);
+				#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+					_mm_prefetch(reinterpret_cast<const char *>(address), _MM_HINT_T0);
+				#else
+					(void)address;
+				#endif
+				}
+
+			/*
+				PREFETCH::READ()
+				----------------
+			*/
+			/*!
+				@brief Prefetch the cache lines holding the first bytes (up to most_lines cache lines) of a block of memory.
+				@details Once the first few lines of a sequential read are in cache the hardware prefetcher takes over, so there
+				is rarely any point in prefetching more than a few lines.
+				@param address [in] The start of the block of memory that will be read.
+				@param bytes [in] The length of the block of memory.
+				@param most_lines [in] The largest number of cache lines to prefetch (default = 4).
+			*/
+			static forceinline void read(const void *address, size_t bytes, size_t most_lines = 4)
+				{
+				const uint8_t *from = reinterpret_cast<const uint8_t *>(address);
+				const uint8_t *end = from + (bytes < most_lines * cache_line_size ? bytes : most_lines * cache_line_size);
+
+				for (; from < end; from += cache_line_size)
+					read(from);
+				}
+		};
+	}
@@ -14,6 +14,8 @@
 
 #include <math.h>
 
+#include <vector>
+#include <memory>
 #include <iostream>
 
 #include "index_manager.h"
@@ -48,6 +50,180 @@ namespace JASS
 			compress_integer::integer documents_in_collection;		///< The number of documents in the collection.
 			static constexpr double impact_range = index_postings_impact::largest_impact - index_postings_impact::smallest_impact; ///< The number of values in the impact ordering range (normally 255).
 
+		private:
+			/*
+				CLASS QUANTIZE::BOUNDS
+				----------------------
+			*/
+			/*!
+				@brief The first pass of the quantizer for one thread of a parallel iterate() - it keeps its own tally of the smallest and largest scores.
+				@details Each thread has its own copy of the ranker as the ranker keeps state (such as the IDF) between calls.
+			*/
+			class bounds : public index_manager::delegate
+				{
+				public:
+					RANKER ranker;															///< This thread's ranker.
+					compress_integer::integer documents_in_collection;		///< The number of documents in the collection.
+					double largest_rsv;													///< The largest score this thread has seen.
+					double smallest_rsv;													///< The smallest score this thread has seen.
+
+				public:
+					/*
+						QUANTIZE::BOUNDS::BOUNDS()
+						--------------------------
+					*/
+					/*!
+						@brief Constructor
+						@param ranker [in] The ranker to copy.
+						@param documents [in] The number of documents in the collection.
+					*/
+					bounds(const RANKER &ranker, compress_integer::integer documents) :
+						ranker(ranker),
+						documents_in_collection(documents),
+						largest_rsv(std::numeric_limits<decltype(largest_rsv)>::min()),
+						smallest_rsv(std::numeric_limits<decltype(smallest_rsv)>::max())
+						{
+						/* Nothing. */
+						}
+
+					/*
+						QUANTIZE::BOUNDS::OPERATOR()()
+						------------------------------
+					*/
+					/*!
+						@brief Keep a tally of the smallest and largest scores in this postings list.
+						@param term [in] The term name.
+						@param postings [in] The postings list.
+						@param document_frequency [in] The document frequency of the term
+						@param document_ids [in] An array (of length document_frequency) of document ids.
+						@param term_frequencies [in] An array (of length document_frequency) of term frequencies (corresponding to document_ids).
+					*/
+					virtual void operator()(const slice &term, const index_postings &postings, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies)
+						{
+						tally(ranker, documents_in_collection, document_frequency, document_ids, term_frequencies, smallest_rsv, largest_rsv);
+						}
+
+					/*
+						QUANTIZE::BOUNDS::OPERATOR()()
+						------------------------------
+					*/
+					/*!
+						@brief The callback function for primary keys (external document ids) is operator(). Not needed for quantization
+						@param document_id [in] The internal document identfier.
+						@param primary_key [in] This document's primary key (external document identifier).
+					*/
+					virtual void operator()(size_t document_id, const slice &primary_key)
+						{
+						/* Nothing. */
+						}
+				};
+
+			/*
+				CLASS QUANTIZE::SERIALISER_LIST
+				-------------------------------
+			*/
+			/*!
+				@brief Pass each quantized postings list to each of several serialisers so that the index is quantized (and linearized) only once.
+			*/
+			class serialiser_list : public index_manager::delegate
+				{
+				private:
+					std::vector<std::unique_ptr<index_manager::delegate>> &serialisers;		///< The serialisers to pass each postings list to.
+
+				public:
+					/*
+						QUANTIZE::SERIALISER_LIST::SERIALISER_LIST()
+						--------------------------------------------
+					*/
+					/*!
+						@brief Constructor
+						@param serialisers [in] The serialisers to pass each postings list to.
+					*/
+					serialiser_list(std::vector<std::unique_ptr<index_manager::delegate>> &serialisers) :
+						serialisers(serialisers)
+						{
+						/* Nothing. */
+						}
+
+					/*
+						QUANTIZE::SERIALISER_LIST::OPERATOR()()
+						---------------------------------------
+					*/
+					/*!
+						@brief Pass the (quantized) postings list to each serialiser.
+						@param term [in] The term name.
+						@param postings [in] The postings list.
+						@param document_frequency [in] The document frequency of the term
+						@param document_ids [in] An array (of length document_frequency) of document ids.
+						@param term_frequencies [in] An array (of length document_frequency) of impacts (corresponding to document_ids).
+					*/
+					virtual void operator()(const slice &term, const index_postings &postings, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies)
+						{
+						for (auto &outputter : serialisers)
+							(*outputter)(term, postings, document_frequency, document_ids, term_frequencies);
+						}
+
+					/*
+						QUANTIZE::SERIALISER_LIST::OPERATOR()()
+						---------------------------------------
+					*/
+					/*!
+						@brief Pass the primary key to each serialiser.
+						@param document_id [in] The internal document identfier.
+						@param primary_key [in] This document's primary key (external document identifier).
+					*/
+					virtual void operator()(size_t document_id, const slice &primary_key)
+						{
+						for (auto &outputter : serialisers)
+							(*outputter)(document_id, primary_key);
+						}
+				};
+
+		private:
+			/*
+				QUANTIZE::TALLY()
+				-----------------
+			*/
+			/*!
+				@brief Compute the score of each document in a postings list and keep a tally of the smallest and largest (for quantization).
+				@param ranker [in] The ranker to use.
+				@param documents_in_collection [in] The number of documents in the collection.
+				@param document_frequency [in] The document frequency of the term
+				@param document_ids [in] An array (of length document_frequency) of document ids.
+				@param term_frequencies [in] An array (of length document_frequency) of term frequencies (corresponding to document_ids).
+				@param smallest_rsv [in / out] The smallest score seen so far.
+				@param largest_rsv [in / out] The largest score seen so far.
+			*/
+			static void tally(RANKER &ranker, compress_integer::integer documents_in_collection, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies, double &smallest_rsv, double &largest_rsv)
+				{
+				/*
+					Compute the IDF component
+				*/
+				ranker.compute_idf_component(document_frequency, documents_in_collection);
+
+				/*
+					Compute the document / term score and keep a tally of the smallest and largest (for quantization)
+				*/
+				auto end = document_ids + document_frequency;
+				auto current_tf = term_frequencies;
+				for (compress_integer::integer *current_id = document_ids; current_id < end; current_id++, current_tf++)
+					{
+					/*
+						Compute the term / document score
+					*/
+					ranker.compute_tf_component(*current_tf);
+					auto score = ranker.compute_score(*current_id, *current_tf);
+
+					/*
+						Keep a running tally of the largest and smallest rsv we've seen so far
+					*/
+					if (score < smallest_rsv)
+						smallest_rsv = score;
+					if (score > largest_rsv)
+						largest_rsv = score;
+					}
+				}
+
 		public:
 			/*
 				QUANTIZE::QUANTIZE()
@@ -94,32 +270,7 @@ namespace JASS
 			*/
 			virtual void operator()(const slice &term, const index_postings &postings, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies)
 				{
-				/*
-					Compute the IDF component
-				*/
-				ranker->compute_idf_component(document_frequency, documents_in_collection);
-
-				/*
-					Compute the document / term score and keep a tally of the smallest and largest (for quantization)
-				*/
-				auto end = document_ids + document_frequency;
-				auto current_tf = term_frequencies;
-				for (compress_integer::integer *current_id = document_ids; current_id < end; current_id++, current_tf++)
-					{
-					/*
-						Compute the term / document score
-					*/
-					ranker->compute_tf_component(*current_tf);
-					auto score = ranker->compute_score(*current_id, *current_tf);
-
-					/*
-						Keep a running tally of the largest and smallest rsv we've seen so far
-					*/
-					if (score < smallest_rsv)
-						smallest_rsv = score;
-					if (score > largest_rsv)
-						largest_rsv = score;
-					}
+				tally(*ranker, documents_in_collection, document_frequency, document_ids, term_frequencies, smallest_rsv, largest_rsv);
 				}
 
 			/*
@@ -214,19 +365,58 @@ namespace JASS
 				largest = largest_rsv;
 				}
 
+			/*
+				QUANTIZE::COMPUTE_BOUNDS()
+				--------------------------
+			*/
+			/*!
+				@brief The first round of the quantizer, compute the smallest and largest term / document influence using several threads.
+				@details Each thread computes the bounds of a part of the vocabulary and the results are then combined, so the bounds are the same as those
+				computed by index.iterate(*this).
+				@param index [in] The index to compute the bounds of.
+				@param threads [in] The number of threads to use.
+			*/
+			void compute_bounds(index_manager &index, size_t threads)
+				{
+				if (threads <= 1)
+					{
+					index.iterate(*this);
+					return;
+					}
+
+				std::vector<std::unique_ptr<bounds>> team;
+				std::vector<index_manager::delegate *> callbacks;
+				for (size_t which = 0; which < threads; which++)
+					{
+					team.push_back(std::unique_ptr<bounds>(new bounds(*ranker, documents_in_collection)));
+					callbacks.push_back(team.back().get());
+					}
+
+				index.iterate(callbacks);
+
+				for (const auto &member : team)
+					{
+					if (member->smallest_rsv < smallest_rsv)
+						smallest_rsv = member->smallest_rsv;
+					if (member->largest_rsv > largest_rsv)
+						largest_rsv = member->largest_rsv;
+					}
+				}
+
 			/*
 				QUANTIZE::SERIALISE_INDEX()
 				---------------------------
 			*/
 			/*!
 				@brief Given the index and a serialiser, serialise the index to disk.
+				@details This is the second round of the quantizer.  The index is iterated over once, each postings list is quantized then passed to each serialiser in turn.
 				@param index [in] The index to serialise.
 				@param serialisers [in] The serialiser that writes out in the desired format.
 			*/
 			void serialise_index(index_manager &index, std::vector<std::unique_ptr<index_manager::delegate>> &serialisers)
 				{
-				for (auto &outputter : serialisers)
-					index.iterate(*this, *outputter);
+				serialiser_list outputters(serialisers);
+				index.iterate(*this, outputters);
 				}
 
 			/*
@@ -258,6 +448,19 @@ namespace JASS
 				JASS_assert(static_cast<int>(smallest) == 0);
 				JASS_assert(static_cast<int>(largest) == 2);
 
+				/*
+					Computing the bounds in parallel must give the same bounds.
+				*/
+				quantize<ranking_function_atire_bm25> parallel_quantizer(index.get_highest_document_id(), ranker);
+				parallel_quantizer.compute_bounds(index, 3);
+
+				double parallel_smallest;
+				double parallel_largest;
+				parallel_quantizer.get_bounds(parallel_smallest, parallel_largest);
+
+				JASS_assert(parallel_smallest == smallest);
+				JASS_assert(parallel_largest == largest);
+
 				puts("quantize::PASSED");
 				}
 		};
@@ -15,6 +15,8 @@
 //#define DONT_INLINE_ADD_RSV
 //#define JASSv1_ADD_RSV
 
+#include <type_traits>
+
 #include "heap.h"
 #include "top_k_qsort.h"
 #include "parser_query.h"
@@ -24,6 +26,33 @@
 
 namespace JASS
 	{
+	/*
+		CLASS QUERY_TOP_K_HEAP
+		----------------------
+	*/
+	/*!
+		@brief Top-k strategy for JASS::query: maintain a heap of the top-k documents as each posting is processed (the default).
+	*/
+	class query_top_k_heap
+		{
+		/* Nothing */
+		};
+
+	/*
+		CLASS QUERY_TOP_K_SCAN
+		----------------------
+	*/
+	/*!
+		@brief Top-k strategy for JASS::query: add to the accumulators without maintaining a heap, then find the top-k once processing
+		is complete by scanning the rows of the accumulator array that were used (the rows with their clean flag set).
+		@details This removes the heap comparison (and the frequent heap updates) from every posting, at the cost of a scan proportional
+		to the number of accumulator rows touched by the query.  It is a good choice for queries that process many postings (large rho).
+	*/
+	class query_top_k_scan
+		{
+		/* Nothing */
+		};
+
 	/*
 		CLASS QUERY
 		-----------
@@ -31,10 +60,11 @@ namespace JASS
 	/*!
 		@brief Everything necessary to process a query is encapsulated in an object of this type
 		@tparam ACCUMULATOR_TYPE The value-type for an accumulator (normally uint16_t or double).
-		@tparam MAX_DOCUMENTS The maximum number of documents that are ever going to exist in this collection
+		@tparam MAX_DOCUMENTS The maximum number of documents that are ever going to exist in this collection, or 0 to size the accumulators at run time
 		@tparam MAX_TOP_K The maximum top-k documents that are going to be asked for
+		@tparam TOP_K_STRATEGY How the top-k is computed, either query_top_k_heap (the default) or query_top_k_scan
 	*/
-	template <typename ACCUMULATOR_TYPE, size_t MAX_DOCUMENTS, size_t MAX_TOP_K>
+	template <typename ACCUMULATOR_TYPE, size_t MAX_DOCUMENTS, size_t MAX_TOP_K, typename TOP_K_STRATEGY = query_top_k_heap>
 	class query
 		{
 		public:
@@ -140,7 +170,7 @@ namespace JASS
 					};
 
 				public:
-					query<ACCUMULATOR_TYPE, MAX_DOCUMENTS, MAX_TOP_K> &parent;			///< The query object that this is iterating over
+					query &parent;																				///< The query object that this is iterating over
 					size_t where;																				///< Where in the results list we are
 
 				public:
@@ -153,7 +183,7 @@ namespace JASS
 						@param parent [in] The object we are iterating over
 						@param where [in] Where in the results list this iterator starts
 					*/
-					iterator(query<ACCUMULATOR_TYPE, MAX_DOCUMENTS, MAX_TOP_K> &parent, size_t where) :
+					iterator(query &parent, size_t where) :
 						parent(parent),
 						where(where)
 						{
@@ -219,6 +249,48 @@ namespace JASS
 
 			add_rsv_compare cmp;															///< Comparison during addition (used to order low to high a min heap)
 			sort_rsv_compare final_sort_cmp;											///< Comparison after search (used to order high to low)
+			bool top_k_selected;															///< When using query_top_k_scan, has the scan been done since rewind()?
+
+		private:
+			/*
+				QUERY::SELECT_TOP_K()
+				---------------------
+			*/
+			/*!
+				@brief Find the top-k by scanning the accumulators (used by query_top_k_scan).
+				@details Only rows of the accumulator array that have been used can contain non-zero accumulators, so only they are scanned.  Rows
+				are scanned in increasing address order, which is the order the heap uses to break ties, so the top-k is identical to that of
+				query_top_k_heap.
+			*/
+			void select_top_k(void)
+				{
+				accumulator_pointers[0] = &zero;
+				needed_for_top_k = top_k;
+
+				for (size_t row = 0; row < accumulators.number_of_rows(); row++)
+					{
+					if (!accumulators.row_in_use(row))
+						continue;
+
+					ACCUMULATOR_TYPE *end = accumulators.row(row) + accumulators.row_width();
+					for (ACCUMULATOR_TYPE *which = accumulators.row(row); which < end; which++)
+						{
+						if (*which == 0)
+							continue;
+
+						if (needed_for_top_k > 0)
+							{
+							accumulator_pointers[--needed_for_top_k] = which;
+							if (needed_for_top_k == 0)
+								top_results.make_heap();
+							}
+						else if (cmp(which, accumulator_pointers[0]) > 0)
+							top_results.push_back(which);
+						}
+					}
+
+				top_k_selected = true;
+				}
 
 		public:
 			/*
@@ -230,15 +302,17 @@ namespace JASS
 				@param primary_keys [in] Vector of the document primary keys used to convert from internal document ids to external primary keys.
 				@param documents [in] The number of documents in the collection.
 				@param top_k [in]	The top-k documents to return from the query once executed.
+				@param huge_pages [in] If the accumulators are sized at run time (MAX_DOCUMENTS == 0) then ask for them to be in huge pages.
 			*/
-			query(const std::vector<std::string> &primary_keys, size_t documents = 1024, size_t top_k = 10) :
+			query(const std::vector<std::string> &primary_keys, size_t documents = 1024, size_t top_k = 10, bool huge_pages = false) :
 				zero(0),
-				accumulators(documents),
+				accumulators(documents, huge_pages),
 				top_results(*accumulator_pointers, top_k),
 				parser(memory),
 				parsed_query(nullptr),
 				primary_keys(primary_keys),
-				top_k(top_k)
+				top_k(top_k),
+				top_k_selected(false)
 				{
 				rewind();
 				}
@@ -252,7 +326,7 @@ namespace JASS
 			*/
 			~query()
 				{
-				delete parsed_query;
+				/* Nothing (the parsed query is in memory) */
 				}
 
 			/*
@@ -316,14 +390,17 @@ namespace JASS
 			*/
 			/*!
 				@brief Clear this object after use and ready for re-use
+				@details The memory used by the parsed query is recycled rather than handed back to the C++ free store, so (after the
+				first call) neither this method nor parsing the next query calls malloc().
 			*/
 			void rewind(void)
 				{
 				accumulator_pointers[0] = &zero;
 				accumulators.rewind();
 				needed_for_top_k = top_k;
-				delete parsed_query;
-				parsed_query = new query_term_list(memory);
+				top_k_selected = false;
+				memory.recycle();
+				parsed_query = new (memory.malloc(sizeof(query_term_list))) query_term_list(memory);
 				}
 
 			/*
@@ -335,9 +412,41 @@ namespace JASS
 			*/
 			void sort(void)
 				{
+				if (std::is_same<TOP_K_STRATEGY, query_top_k_scan>::value && !top_k_selected)
+					select_top_k();
+
 				top_k_qsort::sort(accumulator_pointers + needed_for_top_k, top_k - needed_for_top_k, top_k, final_sort_cmp);
 				}
 
+			/*
+				QUERY::BOTTOM_OF_TOP_K()
+				------------------------
+			*/
+			/*!
+				@brief Return the two lowest rsvs in the top-k heap (the k-th and (k-1)-th highest rsvs so far).
+				@details Every document not in the top-k has an rsv no higher than the lowest, so a caller that asks for one more result than it
+				needs can use these to decide whether the documents it will return can still change.  The rsvs are only available while the heap is
+				maintained (query_top_k_heap), once it is full, and before sort() is called.
+				@param lowest [out] The lowest rsv in the top-k.
+				@param second_lowest [out] The second lowest rsv in the top-k.
+				@return true if the rsvs are available, else false.
+			*/
+			bool bottom_of_top_k(ACCUMULATOR_TYPE &lowest, ACCUMULATOR_TYPE &second_lowest) const
+				{
+				if (!std::is_same<TOP_K_STRATEGY, query_top_k_heap>::value || needed_for_top_k != 0 || top_k < 2)
+					return false;
+
+				/*
+					The heap is a min-heap rooted at accumulator_pointers[0] so the second lowest is one of its children
+				*/
+				lowest = *accumulator_pointers[0];
+				second_lowest = *accumulator_pointers[1];
+				if (top_k > 2 && *accumulator_pointers[2] < second_lowest)
+					second_lowest = *accumulator_pointers[2];
+
+				return true;
+				}
+
 #ifdef JASSv1_ADD_RSV
 class annotate
 {
@@ -425,6 +534,15 @@ public:
 #endif
 			void add_rsv(size_t document_id, ACCUMULATOR_TYPE score)
 				{
+				/*
+					Without a heap there's nothing to do other than add to the accumulator (the top-k is found in sort()).
+				*/
+				if (std::is_same<TOP_K_STRATEGY, query_top_k_scan>::value)
+					{
+					accumulators[document_id] += score;
+					return;
+					}
+
 				ACCUMULATOR_TYPE *which = &accumulators[document_id];			// This will create the accumulator if it doesn't already exist.
 
 				/*
@@ -488,6 +606,61 @@ public:
 					string << "<" << rsv.document_id << "," << rsv.rsv << ">";
 				JASS_assert(string.str() == "<3,20><1,15>");
 
+				/*
+					Check that selecting the top-k by scanning the accumulators gives the same answer as the heap (including the order of ties)
+				*/
+				query<uint16_t, 1024, 10, query_top_k_scan> scan_object(keys, 1024, 2);
+				scan_object.add_rsv(2, 10);
+				scan_object.add_rsv(3, 20);
+				scan_object.add_rsv(2, 2);
+				scan_object.add_rsv(1, 1);
+				scan_object.add_rsv(1, 14);
+				scan_object.add_rsv(1000, 15);
+
+				string.str("");
+				for (const auto &rsv : scan_object)
+					string << "<" << rsv.document_id << "," << rsv.rsv << ">";
+				JASS_assert(string.str() == "<3,20><1000,15>");
+
+				scan_object.rewind();
+				scan_object.add_rsv(7, 3);
+				string.str("");
+				for (const auto &rsv : scan_object)
+					string << "<" << rsv.document_id << "," << rsv.rsv << ">";
+				JASS_assert(string.str() == "<7,3>");
+
+				/*
+					Check that accumulators sized at run time give the same answer
+				*/
+				query<uint16_t, 0, 10> dynamic_object(keys, 1024, 2, true);
+				dynamic_object.add_rsv(2, 10);
+				dynamic_object.add_rsv(3, 20);
+				dynamic_object.add_rsv(2, 2);
+				dynamic_object.add_rsv(1, 1);
+				dynamic_object.add_rsv(1, 14);
+
+				string.str("");
+				for (const auto &rsv : dynamic_object)
+					string << "<" << rsv.document_id << "," << rsv.rsv << ">";
+				JASS_assert(string.str() == "<3,20><1,15>");
+
+				/*
+					Check the bottom of the top-k heap is tracked as documents enter and move within it
+				*/
+				query<uint16_t, 1024, 10> bottom_object(keys, 1024, 3);
+				uint16_t lowest;
+				uint16_t second_lowest;
+				bottom_object.add_rsv(1, 5);
+				bottom_object.add_rsv(2, 7);
+				JASS_assert(!bottom_object.bottom_of_top_k(lowest, second_lowest));
+				bottom_object.add_rsv(3, 9);
+				JASS_assert(bottom_object.bottom_of_top_k(lowest, second_lowest) && lowest == 5 && second_lowest == 7);
+				bottom_object.add_rsv(4, 6);
+				JASS_assert(bottom_object.bottom_of_top_k(lowest, second_lowest) && lowest == 6 && second_lowest == 7);
+				bottom_object.add_rsv(1, 10);
+				JASS_assert(bottom_object.bottom_of_top_k(lowest, second_lowest) && lowest == 7 && second_lowest == 9);
+				JASS_assert(!scan_object.bottom_of_top_k(lowest, second_lowest));
+
 				/*
 					Check the parser
 				*/
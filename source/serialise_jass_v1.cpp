@@ -11,6 +11,8 @@
 #include "allocator.h"
 #include "serialise_jass_v1.h"
 #include "compress_integer_none.h"
+#include "compress_integer_elias_delta_simd.h"
+#include "compress_integer_elias_gamma_simd.h"
 #include "index_manager_sequential.h"
 
 namespace JASS
@@ -21,6 +23,15 @@ namespace JASS
 	*/
 	serialise_jass_v1::~serialise_jass_v1()
 		{
+		/*
+			Finish off the postings being compressed by the compression threads (if there are any)
+		*/
+		if (pool != nullptr)
+			{
+			send_batch();
+			write_batches(0);
+			}
+
 		/*
 			Sort then serialise the contents of the CIvocab.bin file.
 		*/
@@ -46,25 +57,55 @@ namespace JASS
 		}
 
 	/*
-		SERIALISE_JASS_V1::WRITE_POSTINGS()
-		-----------------------------------
+		SERIALISE_JASS_V1::COMPRESS_POSTINGS()
+		--------------------------------------
 	*/
-	size_t serialise_jass_v1::write_postings(const index_postings &postings_list, size_t &number_of_impacts, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies)
+	size_t serialise_jass_v1::compress_postings(index_postings_impact &impact_ordered, compress_integer &encoder, std::vector<segment> &segments, uint8_t *compress_into, size_t compress_into_size, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies)
 		{
 		/*
-			Keep a track of where the postings are stored on disk.
+			Impact order the postings list.
 		*/
-		size_t postings_location = postings.tell();
+		index_postings::impact_order(impact_ordered, document_frequency, document_ids, term_frequencies);
 
 		/*
-			Impact order the postings list.
+			Compress each segment, highest impact first.
 		*/
-		postings_list.impact_order(impact_ordered, document_frequency, document_ids, term_frequencies);
+		size_t used = 0;
+		for (auto &header : reverse(impact_ordered))
+			{
+			/*
+				This is where compression happens.
+				First D1 encode, then use the encoder to compress.
+			*/
+			compress_integer::d1_encode(header.begin(), header.begin(), header.size());
+			*header.begin() -= 1;			// JASS v1 counts documents from 0.
+			auto took = encoder.encode(compress_into + used, compress_into_size - used, header.begin(), header.size());
+			if (took <= 0)
+				{
+				/*
+					Compression failed - exit
+				*/
+				std::cout <<  "Failed to compress postings list while serialising" << std::ends;
+				exit(1);
+				}
+
+			segments.push_back(segment{static_cast<uint16_t>(header.impact_score), static_cast<uint32_t>(header.size()), took});
+			used += took;
+			}
 
+		return used;
+		}
+
+	/*
+		SERIALISE_JASS_V1::WRITE_POSTINGS()
+		-----------------------------------
+	*/
+	size_t serialise_jass_v1::write_postings(const segment *segments, size_t number_of_impacts)
+		{
 		/*
-			Compute the number of impact headers we're going to see.
+			Keep a track of where the postings are stored on disk.
 		*/
-		number_of_impacts = impact_ordered.impact_size();
+		size_t postings_location = postings.tell();
 
 		/*
 			Write out each pointer to an impact header.
@@ -78,22 +119,20 @@ namespace JASS
 			}
 
 		/*
-			Write out each impact header, and compress as we go so we know where the data will be stored.
+			Write out each impact header, now that we know where the data will be stored.
 		*/
 		size_t start_of_postings = offset + impact_header_size;									// +1 because there's a 0 terminator at the end
 		auto wastage = allocator::realign(start_of_postings, alignment);						// Pad the start of the postings to be on a word boundary
 		start_of_postings += wastage;
 
-		uint8_t *compress_into = &compressed_buffer[0];
-		auto compress_into_size = compressed_buffer.size();
+		uint8_t *compressed = &compressed_buffer[0];
 		compressed_segments.clear();
-		for (auto &header : reverse(impact_ordered))
+		for (const segment *header = segments; header < segments + number_of_impacts; header++)
 			{
 			/*
 				Impact score (uint16_t).
 			*/
-			uint16_t score = static_cast<uint16_t>(header.impact_score);
-			postings.write(&score, sizeof(score));
+			postings.write(&header->impact_score, sizeof(header->impact_score));
 
 			/*
 				Start loction on disk (uint64_t).
@@ -102,33 +141,17 @@ namespace JASS
 
 			postings.write(&start_location, sizeof(start_location));
 
-			/*
-				This is where compression happens.
-				First D1 encode, then use the encoder to compress.
-			*/
-			compress_integer::d1_encode(header.begin(), header.begin(), header.size());
-			*header.begin() -= 1;			// JASS v1 counts documents from 0.
-			auto took = encoder->encode(compress_into, compress_into_size, header.begin(), header.size());
-			if (took <= 0)
-				{
-				/*
-					Compression failed - exit
-				*/
-				std::cout <<  "Failed to compress postings list while serialising" << std::ends;
-				exit(1);
-				}
-				
 			/*
 				Round up to the next word-aligned boundary
 			*/
+			auto took = header->size;
 			auto padding = allocator::realign(took, alignment);
 
 			/*
 				Store it for writing out later
 			*/
-			compressed_segments.push_back(slice(compress_into, took + padding));
-			compress_into += took;
-			compress_into_size -= took;
+			compressed_segments.push_back(slice(compressed, took + padding));
+			compressed += took;
 
 			/*
 				End location on disk (uint64_t).
@@ -139,8 +162,7 @@ namespace JASS
 			/*
 				The number of document ids with this impact score (length of the impact segment measured in doc_ids).
 			*/
-			uint32_t frequency = static_cast<uint32_t>(header.size());
-			postings.write(&frequency, sizeof(frequency));
+			postings.write(&header->frequency, sizeof(header->frequency));
 
 			start_of_postings = finish_location + padding;
 			}
@@ -169,19 +191,11 @@ namespace JASS
 		}
 
 	/*
-		SERIALISE_JASS_V1::OPERATOR()()
+		SERIALISE_JASS_V1::WRITE_TERM()
 		-------------------------------
 	*/
-	void serialise_jass_v1::operator()(const slice &term, const index_postings &postings, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies)
+	void serialise_jass_v1::write_term(const slice &term, size_t postings_location, size_t number_of_impacts)
 		{
-		/*
-			Write the postings list to disk and keep a track of where it is.
-		*/
-		size_t number_of_impact_scores;
-
-		size_t postings_location;
-		postings_location = write_postings(postings, number_of_impact_scores, document_frequency, document_ids, term_frequencies);
-
 		/*
 			Find out where we are in the vocabulary strings file - which will be the start of the term before we write it.
 		*/
@@ -196,7 +210,145 @@ namespace JASS
 		/*
 			Keep a copy of the term and the detals of the postings list for later sorting and writing to CIvocab.bin
 		*/
-		index_key.push_back(vocab_tripple(term, term_offset, postings_location, number_of_impact_scores));
+		index_key.push_back(vocab_tripple(term, term_offset, postings_location, number_of_impacts));
+		}
+
+	/*
+		SERIALISE_JASS_V1::MAKE_ENCODER()
+		---------------------------------
+	*/
+	std::unique_ptr<compress_integer> serialise_jass_v1::make_encoder(jass_v1_codex codex)
+		{
+		switch (codex)
+			{
+			case jass_v1_codex::uncompressed:
+				return std::unique_ptr<compress_integer>(new compress_integer_none);
+			case jass_v1_codex::qmx:
+				return std::unique_ptr<compress_integer>(new compress_integer_qmx_jass_v1);
+			case jass_v1_codex::elias_gamma_simd:
+				return std::unique_ptr<compress_integer>(new compress_integer_elias_gamma_simd);
+			case jass_v1_codex::elias_delta_simd:
+				return std::unique_ptr<compress_integer>(new compress_integer_elias_delta_simd);
+			default:
+				return nullptr;			// JASS can read, but not write, the ATIRE codexes
+			}
+		}
+
+	/*
+		SERIALISE_JASS_V1::COMPRESS_BATCH()
+		-----------------------------------
+	*/
+	void serialise_jass_v1::compress_batch(compressor &state, batch &job)
+		{
+		compress_integer::integer *document_ids = job.document_ids.data();
+		index_postings_impact::impact_type *impacts = job.impacts.data();
+		for (auto &term : job.terms)
+			{
+			/*
+				Compress into this thread's buffer then append to the batch
+			*/
+			term.first_segment = job.segments.size();
+			term.compressed_size = compress_postings(state.impact_ordered, *state.encoder, job.segments, state.compressed_buffer.data(), state.compressed_buffer.size(), term.document_frequency, document_ids, impacts);
+			term.number_of_segments = job.segments.size() - term.first_segment;
+			job.compressed.insert(job.compressed.end(), state.compressed_buffer.data(), state.compressed_buffer.data() + term.compressed_size);
+
+			document_ids += term.document_frequency;
+			impacts += term.document_frequency;
+			}
+
+		/*
+			Tell the writer this batch is ready
+		*/
+		std::unique_lock<std::mutex> guard(batch_lock);
+		job.finished = true;
+		batch_finished.notify_all();
+		}
+
+	/*
+		SERIALISE_JASS_V1::SEND_BATCH()
+		-------------------------------
+	*/
+	void serialise_jass_v1::send_batch(void)
+		{
+		if (filling->terms.size() == 0)
+			return;
+
+		batch *job = filling.get();
+		in_flight.push_back(std::move(filling));
+		filling.reset(new batch);
+		pool->submit([this, job](size_t worker)
+			{
+			compress_batch(*compressors[worker], *job);
+			});
+		}
+
+	/*
+		SERIALISE_JASS_V1::WRITE_BATCHES()
+		----------------------------------
+	*/
+	void serialise_jass_v1::write_batches(size_t most_in_flight)
+		{
+		while (in_flight.size() != 0)
+			{
+			batch &job = *in_flight.front();
+
+			{
+			std::unique_lock<std::mutex> guard(batch_lock);
+			if (!job.finished && in_flight.size() <= most_in_flight)
+				return;
+			batch_finished.wait(guard, [&job](){ return job.finished; });
+			}
+
+			/*
+				The batches are written in order, so the offsets (and so the index) are the same as if written single-threaded
+			*/
+			const uint8_t *compressed = job.compressed.data();
+			for (const auto &term : job.terms)
+				{
+				std::copy(compressed, compressed + term.compressed_size, compressed_buffer.begin());
+				compressed += term.compressed_size;
+
+				size_t postings_location = write_postings(&job.segments[term.first_segment], term.number_of_segments);
+				write_term(term.token, postings_location, term.number_of_segments);
+				}
+
+			in_flight.pop_front();
+			}
+		}
+
+	/*
+		SERIALISE_JASS_V1::OPERATOR()()
+		-------------------------------
+	*/
+	void serialise_jass_v1::operator()(const slice &term, const index_postings &postings, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies)
+		{
+		if (pool == nullptr)
+			{
+			/*
+				Compress then write the postings list to disk and keep a track of where it is.
+			*/
+			term_segments.clear();
+			compress_postings(impact_ordered, *encoder, term_segments, &compressed_buffer[0], compressed_buffer.size(), document_frequency, document_ids, term_frequencies);
+			size_t postings_location = write_postings(term_segments.data(), term_segments.size());
+			write_term(term, postings_location, term_segments.size());
+			return;
+			}
+
+		/*
+			Add the postings list to the batch being filled (the caller re-uses document_ids and term_frequencies so they must be copied).
+		*/
+		filling->terms.push_back(term_details{term, document_frequency, 0, 0, 0});
+		filling->document_ids.insert(filling->document_ids.end(), document_ids, document_ids + document_frequency);
+		filling->impacts.insert(filling->impacts.end(), term_frequencies, term_frequencies + document_frequency);
+
+		/*
+			Once full, send the batch for compression then write whatever is ready (waiting if the pipeline is full).
+		*/
+		if (filling->document_ids.size() + filling->terms.size() >= batch_size)
+			{
+			send_batch();
+			write_batches(batches_per_thread * compressors.size());
+			}
 		}
 
 	/*
@@ -245,6 +397,48 @@ namespace JASS
 		checksum = checksum::fletcher_16_file("CIdoclist.bin");
 		JASS_assert(checksum == 3045);
 
+		/*
+			Serialise the index using several compression threads, it must be the same.
+		*/
+		{
+		serialise_jass_v1 serialiser(index.get_highest_document_id(), std::make_shared<compress_integer_qmx_jass_v1>(), 16, 3);
+		index.iterate(serialiser);
+		}
+
+		JASS_assert(checksum::fletcher_16_file("CIvocab.bin") == 10231);
+		JASS_assert(checksum::fletcher_16_file("CIvocab_terms.bin") == 25057);
+		JASS_assert(checksum::fletcher_16_file("CIpostings.bin") == 43058);
+		JASS_assert(checksum::fletcher_16_file("CIdoclist.bin") == 3045);
+
+		/*
+			Each compression thread must use the requested codex (not QMX), so the index must be the same as the single-threaded one
+		*/
+		{
+		serialise_jass_v1 serialiser(index.get_highest_document_id(), std::make_shared<compress_integer_elias_gamma_simd>(), 16, 1, jass_v1_codex::elias_gamma_simd);
+		index.iterate(serialiser);
+		}
+		checksum = checksum::fletcher_16_file("CIpostings.bin");
+		{
+		serialise_jass_v1 serialiser(index.get_highest_document_id(), std::make_shared<compress_integer_elias_gamma_simd>(), 16, 3, jass_v1_codex::elias_gamma_simd);
+		index.iterate(serialiser);
+		}
+		JASS_assert(checksum::fletcher_16_file("CIpostings.bin") == checksum);
+		JASS_assert(checksum != 43058);
+
+		/*
+			A codex JASS cannot write cannot be used with more than one thread
+		*/
+		bool thrown = false;
+		try
+			{
+			serialise_jass_v1 serialiser(index.get_highest_document_id(), std::make_shared<compress_integer_qmx_jass_v1>(), 16, 3, jass_v1_codex::variable_byte);
+			}
+		catch (const std::invalid_argument &)
+			{
+			thrown = true;
+			}
+		JASS_assert(thrown);
+
 		puts("serialise_jass_v1::PASSED");
 		}
 	}
@@ -12,11 +12,19 @@
 */
 #pragma once
 
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+#include <condition_variable>
+
 #include "file.h"
 #include "slice.h"
 #include "allocator_cpp.h"
 #include "index_postings.h"
 #include "index_manager.h"
+#include "thread_pool_work_stealing.h"
 #include "compress_integer_qmx_jass_v1.h"
 
 namespace JASS
@@ -57,7 +65,8 @@ namespace JASS
 
 		CIpostings.bin: This file contains all the postings lists compressed using the same codex. This is different from 
 		ATIRE which allows each postings list to be encoded using a different codex. The first byte of this file specifies 
-		the codex where s=uncompressed, c=VarByte, 8=Simple8, q=QMX, Q=QMX4D, R=QMX0D. This is followed by the postings lists.
+		the codex where s=uncompressed, c=VarByte, 8=Simple8, q=QMX, Q=QMX4D, R=QMX0D, G=Group Elias Gamma SIMD, D=Group Elias Delta SIMD.
+		This is followed by the postings lists.
 		A postings list is: a list of 64-bit pointer to headers. Each header is (uint16_t impact_score, uint64_t start,
 		uint64_t end, uint32_t impact_frequency) where impact_score is the impact value, start and end are pointers to the
 		compressed docids, and impact_frequency is the number of dociment_ids in the list. The header is terminated with a 
@@ -68,7 +77,7 @@ namespace JASS
 	*/
 	class serialise_jass_v1 : public index_manager::delegate
 		{
-		private:
+		public:
 			/*
 				ENUM CLASS JASS_V1_CODEX
 				------------------------
@@ -83,9 +92,12 @@ namespace JASS
 				simple_8b = '8',					///< Postings are compressed using ATIRE's simple-8b encoding.
 				qmx = 'q',							///< Postings are compressed using JASS v1's variant of QMX (with difference (D1) encoding).
 				qmx_d4 = 'Q',						///< Postings are compressed using QMX with Lemire's D4 delta encoding.
-				qmx_d0 = 'R'						///< Postings are compressed using QMX without delta encoding.
+				qmx_d0 = 'R',						///< Postings are compressed using QMX without delta encoding.
+				elias_gamma_simd = 'G',			///< Postings are compressed using Group Elias Gamma SIMD (with difference (D1) encoding).
+				elias_delta_simd = 'D'			///< Postings are compressed using Group Elias Delta SIMD (with difference (D1) encoding).
 				};
 
+		private:
 			/*
 				CLASS SERIALISE_JASS_V1::VOCAB_TRIPPLE
 				--------------------------------------
@@ -137,6 +149,109 @@ namespace JASS
 						}
 				};
 			
+			/*
+				CLASS SERIALISE_JASS_V1::SEGMENT
+				--------------------------------
+			*/
+			/*!
+				@brief The details of one compressed impact segment, everything needed to write its impact header (except where it is on disk).
+			*/
+			class segment
+				{
+				public:
+					uint16_t impact_score;		///< The impact score of the segment.
+					uint32_t frequency;			///< The number of document ids in the segment.
+					size_t size;					///< The size (in bytes) of the compressed segment (before padding).
+				};
+
+			/*
+				CLASS SERIALISE_JASS_V1::TERM_DETAILS
+				-------------------------------------
+			*/
+			/*!
+				@brief A term in a batch of terms being compressed by the pipeline.
+			*/
+			class term_details
+				{
+				public:
+					slice token;														///< The term.
+					compress_integer::integer document_frequency;			///< The length of the term's postings list.
+					size_t first_segment;											///< The index (in batch::segments) of the term's first segment.
+					size_t number_of_segments;										///< The number of segments (impacts) the term has.
+					size_t compressed_size;											///< The number of bytes (in batch::compressed) of the term's compressed segments.
+				};
+
+			/*
+				CLASS SERIALISE_JASS_V1::BATCH
+				------------------------------
+			*/
+			/*!
+				@brief A batch of consecutive terms compressed as a single task by one of the compression threads.
+			*/
+			class batch
+				{
+				public:
+					std::vector<term_details> terms;										///< The terms in this batch (in serialisation order).
+					std::vector<compress_integer::integer> document_ids;			///< The concatenation of the postings lists' document ids.
+					std::vector<index_postings_impact::impact_type> impacts;		///< The concatenation of the postings lists' impacts.
+					std::vector<segment> segments;										///< (Output) The impact segments of each term.
+					std::vector<uint8_t> compressed;										///< (Output) The concatenation of each term's compressed segments.
+					bool finished;																///< (Output) True once the batch has been compressed.
+
+				public:
+					/*
+						SERIALISE_JASS_V1::BATCH::BATCH()
+						---------------------------------
+					*/
+					/*!
+						@brief Constructor
+					*/
+					batch() :
+						finished(false)
+						{
+						/* Nothing */
+						}
+				};
+
+			/*
+				CLASS SERIALISE_JASS_V1::COMPRESSOR
+				-----------------------------------
+			*/
+			/*!
+				@brief The private state of one compression thread.
+			*/
+			class compressor
+				{
+				public:
+					allocator_pool memory;										///< Memory used to store the impact-ordered postings list.
+					index_postings_impact impact_ordered;					///< The re-used impact ordered postings list.
+					std::unique_ptr<compress_integer> encoder;			///< This thread's encoder (encoders are not thread-safe).
+					std::vector<uint8_t> compressed_buffer;				///< The buffer a term is compressed into before being copied into the batch.
+
+				public:
+					/*
+						SERIALISE_JASS_V1::COMPRESSOR::COMPRESSOR()
+						-------------------------------------------
+					*/
+					/*!
+						@brief Constructor
+						@param documents [in] The number of documents in the collection.
+						@param encoder [in] This thread's encoder.
+					*/
+					compressor(size_t documents, std::unique_ptr<compress_integer> encoder) :
+						memory(1024 * 1024),
+						impact_ordered(documents, memory),
+						encoder(std::move(encoder)),
+						compressed_buffer((documents + 1024) * sizeof(compress_integer::integer))
+						{
+						/* Nothing */
+						}
+				};
+
+		private:
+			static constexpr size_t batch_size = 64 * 1024;			///< A batch is sent for compression once it holds this many postings plus terms.
+			static constexpr size_t batches_per_thread = 4;			///< The most batches in the pipeline (per compression thread) before the caller waits.
+
 		private:
 			file vocabulary_strings;							///< The concatination of UTS-8 encoded unique tokens in the collection.
 			file vocabulary;										///< Details about the term (including a pointer to the term, a pointer to the postings, and the quantum count.
@@ -151,22 +266,99 @@ namespace JASS
 			std::vector<uint8_t, allocator_cpp<uint8_t>> compressed_buffer;		///< The buffer used to compress postings into.
 			std::vector<slice, allocator_cpp<slice>> compressed_segments;			///< vector of pointers (and lengths) to the compressed postings.
 			uint8_t alignment;									///< Postings lists are padded to this alignment (used for codexes that require word alignment).
+			std::vector<segment> term_segments;				///< The re-used list of the segments of the term being written.
+
+			std::vector<std::unique_ptr<compressor>> compressors;		///< The state of each compression thread (empty if serialising single-threaded).
+			std::unique_ptr<batch> filling;										///< The batch currently being filled by operator().
+			std::deque<std::unique_ptr<batch>> in_flight;					///< The batches sent for compression, in serialisation order.
+			std::mutex batch_lock;													///< Guards batch::finished.
+			std::condition_variable batch_finished;							///< Signalled each time a batch has been compressed.
+			std::unique_ptr<thread_pool_work_stealing> pool;				///< The compression threads (nullptr if serialising single-threaded), declared last so they stop first.
 
 		private:
 			/*
-				SERIALISE_JASS_V1::WRITE_POSTINGS()
-				-----------------------------------
+				SERIALISE_JASS_V1::MAKE_ENCODER()
+				---------------------------------
+			*/
+			/*!
+				@brief Create an encoder for the given codex (each compression thread needs its own).
+				@param codex [in] The codex.
+				@return The encoder, or nullptr if JASS cannot write postings in that codex.
+			*/
+			static std::unique_ptr<compress_integer> make_encoder(jass_v1_codex codex);
+
+			/*
+				SERIALISE_JASS_V1::COMPRESS_POSTINGS()
+				--------------------------------------
 			*/
 			/*!
-				@brief Convert the postings list to the JASS v1 format and serialise it to disk.
-				@param postings [in] The postings list to serialise.
-				@param number_of_impacts [out] The number of distinct impact scores seen in the postings list.
+				@brief Impact order the postings list then D1 encode and compress each impact segment (one after the other) into a buffer.
+				@param impact_ordered [in] The re-used impact ordered postings list to use.
+				@param encoder [in] The encoder to use.
+				@param segments [out] The details of each segment are appended to this list.
+				@param compress_into [out] The buffer to compress into.
+				@param compress_into_size [in] The size (in bytes) of compress_into.
 				@param document_frequency [in] The document frequency of the term
 				@param document_ids [in] An array (of length document_frequency) of document ids.
 				@param term_frequencies [in] An array (of length document_frequency) of term frequencies (corresponding to document_ids).
+				@return The number of bytes of compress_into used.
+			*/
+			static size_t compress_postings(index_postings_impact &impact_ordered, compress_integer &encoder, std::vector<segment> &segments, uint8_t *compress_into, size_t compress_into_size, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies);
+
+			/*
+				SERIALISE_JASS_V1::WRITE_POSTINGS()
+				-----------------------------------
+			*/
+			/*!
+				@brief Serialise a compressed postings list (in the JASS v1 format) to disk.
+				@details The compressed segments must be in compressed_buffer, one after the other.
+				@param segments [in] The details of each impact segment.
+				@param number_of_impacts [in] The number of impact segments.
 				@return The location (in CIpostings.bin) of the start of the serialised postings list.
 			*/
-			size_t write_postings(const index_postings &postings, size_t &number_of_impacts, compress_integer::integer document_frequency, compress_integer::integer *document_ids, index_postings_impact::impact_type *term_frequencies);
+			size_t write_postings(const segment *segments, size_t number_of_impacts);
+
+			/*
+				SERIALISE_JASS_V1::WRITE_TERM()
+				-------------------------------
+			*/
+			/*!
+				@brief Write the term to CIvocab_terms.bin and remember where it and its (already serialised) postings list are.
+				@param term [in] The term.
+				@param postings_location [in] The location (in CIpostings.bin) of the postings list.
+				@param number_of_impacts [in] The number of impact segments in the postings list.
+			*/
+			void write_term(const slice &term, size_t postings_location, size_t number_of_impacts);
+
+			/*
+				SERIALISE_JASS_V1::COMPRESS_BATCH()
+				-----------------------------------
+			*/
+			/*!
+				@brief Compress each term in a batch (called by a compression thread).
+				@param state [in] The compression thread's private state.
+				@param job [in / out] The batch to compress.
+			*/
+			void compress_batch(compressor &state, batch &job);
+
+			/*
+				SERIALISE_JASS_V1::SEND_BATCH()
+				-------------------------------
+			*/
+			/*!
+				@brief Send the batch being filled to the compression threads.
+			*/
+			void send_batch(void);
+
+			/*
+				SERIALISE_JASS_V1::WRITE_BATCHES()
+				----------------------------------
+			*/
+			/*!
+				@brief Write the compressed batches to disk (in order), waiting for unfinished batches only while there are more than most_in_flight batches in the pipeline.
+				@param most_in_flight [in] The number of batches that may be left in the pipeline (0 to write everything).
+			*/
+			void write_batches(size_t most_in_flight);
 
 		public:
 			/*
@@ -178,8 +370,12 @@ namespace JASS
 				@param documents [in] The number of documents in the collection (used to allocate re-usable buffers).
 				@param encoder [in] An shared pointer to a codex responsible for performing the compression of postings lists (default = compress_integer_QMX_jass_v1()).
 				@param alignment [in] The start address of a postings list is padded to start on these boundaries (needed for compress_integer_QMX_jass_v1 (use 16), and others).  Default = 0.
+				@param threads [in] The number of threads to compress with (default = 1).  If more than one then the postings lists are compressed by a pool of threads, each
+				using its own encoder for codex, and written to disk (in order) by the caller, so the index is the same as if it were written single-threaded.
+				@param codex [in] The codex byte written at the start of CIpostings.bin, which must name encoder (default = jass_v1_codex::qmx).  With more than one thread
+				this must be uncompressed, qmx, elias_gamma_simd, or elias_delta_simd (else std::invalid_argument is thrown).
 			*/
-			serialise_jass_v1(size_t documents, std::shared_ptr<compress_integer> encoder = std::make_shared<compress_integer_qmx_jass_v1>(), int8_t alignment = 16) :
+			serialise_jass_v1(size_t documents, std::shared_ptr<compress_integer> encoder = std::make_shared<compress_integer_qmx_jass_v1>(), int8_t alignment = 16, size_t threads = 1, jass_v1_codex codex = jass_v1_codex::qmx) :
 				vocabulary_strings("CIvocab_terms.bin", "w+b"),
 				vocabulary("CIvocab.bin", "w+b"),
 				postings("CIpostings.bin", "w+b"),
@@ -198,12 +394,29 @@ namespace JASS
 				*/
 				compressed_buffer.resize((documents + 1024) * sizeof(compress_integer::integer));
 				compressed_segments.reserve(index_postings_impact::largest_impact);
+				term_segments.reserve(index_postings_impact::largest_impact);
+
+				/*
+					Start the compression threads
+				*/
+				if (threads > 1)
+					{
+					for (size_t which = 0; which < threads; which++)
+						{
+						std::unique_ptr<compress_integer> thread_encoder = make_encoder(codex);
+						if (thread_encoder == nullptr)
+							throw std::invalid_argument("serialise_jass_v1: this codex cannot be used with more than one compression thread");
+						compressors.push_back(std::unique_ptr<compressor>(new compressor(documents, std::move(thread_encoder))));
+						}
+					pool.reset(new thread_pool_work_stealing(threads));
+					filling.reset(new batch);
+					}
 
 				/*
-					Postings are compressed using compress_integer_qmx_jass_v1, the best that JASS v1 supported.
+					By default postings are compressed using compress_integer_qmx_jass_v1, the best that JASS v1 supported.
 				*/
-				uint8_t codex = static_cast<uint8_t>(jass_v1_codex::qmx);
-				postings.write(&codex, 1);
+				uint8_t codex_byte = static_cast<uint8_t>(codex);
+				postings.write(&codex_byte, 1);
 				}
 
 			/*
@@ -0,0 +1,286 @@
+/*
+	SOCKET_LISTENER.CPP
+	-------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+	#pragma comment(lib, "ws2_32.lib")
+#else
+	#include <netdb.h>
+	#include <unistd.h>
+	#include <sys/un.h>
+	#include <sys/types.h>
+	#include <sys/socket.h>
+#endif
+
+#include "file.h"
+#include "asserts.h"
+#include "threads.h"
+#include "socket_listener.h"
+
+namespace JASS
+	{
+	/*
+		SPLIT_ADDRESS()
+		---------------
+	*/
+	/*!
+		@brief Split an address into the Unix domain path or the TCP host and port.
+		@param address [in] The address.
+		@param unix_path [out] The path if it is a Unix domain address, else "".
+		@param host [out] The host if it is a TCP address, else "".
+		@param port [out] The port if it is a TCP address, else "".
+	*/
+	static void split_address(const std::string &address, std::string &unix_path, std::string &host, std::string &port)
+		{
+		static const std::string unix_prefix = "unix:";
+
+		unix_path = host = port = "";
+		if (address.compare(0, unix_prefix.size(), unix_prefix) == 0)
+			unix_path = address.substr(unix_prefix.size());
+		else
+			{
+			auto colon = address.rfind(':');
+			if (colon == std::string::npos)
+				port = address;
+			else
+				{
+				host = address.substr(0, colon);
+				port = address.substr(colon + 1);
+				}
+			}
+		}
+
+	/*
+		OPEN_SOCKET()
+		-------------
+	*/
+	/*!
+		@brief Create a socket and either bind it (server) or connect it (client).
+		@param address [in] The address.
+		@param server [in] true to bind (and listen), false to connect.
+		@return The socket, or -1 on failure.
+	*/
+	static intptr_t open_socket(const std::string &address, bool server)
+		{
+		std::string unix_path;
+		std::string host;
+		std::string port;
+
+		split_address(address, unix_path, host, port);
+
+		#ifdef _MSC_VER
+			static WSADATA winsock = {};
+			if (winsock.wVersion == 0)
+				WSAStartup(MAKEWORD(2, 2), &winsock);
+		#endif
+
+		if (unix_path.size() != 0)
+			{
+			#ifdef _MSC_VER
+				return -1;				// Unix domain sockets are not supported on Windows
+			#else
+				sockaddr_un location = {};
+				if (unix_path.size() >= sizeof(location.sun_path))
+					return -1;
+				location.sun_family = AF_UNIX;
+				strcpy(location.sun_path, unix_path.c_str());
+
+				intptr_t descriptor = ::socket(AF_UNIX, SOCK_STREAM, 0);
+				if (descriptor < 0)
+					return -1;
+
+				int success = server ? ::bind(descriptor, reinterpret_cast<sockaddr *>(&location), sizeof(location)) : ::connect(descriptor, reinterpret_cast<sockaddr *>(&location), sizeof(location));
+				if (success != 0)
+					{
+					::close(descriptor);
+					return -1;
+					}
+				return descriptor;
+			#endif
+			}
+
+		/*
+			TCP
+		*/
+		addrinfo hints = {};
+		addrinfo *found;
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = server ? AI_PASSIVE : 0;
+
+		if (::getaddrinfo(host.size() == 0 ? nullptr : host.c_str(), port.c_str(), &hints, &found) != 0)
+			return -1;
+
+		intptr_t descriptor = -1;
+		for (addrinfo *current = found; current != nullptr; current = current->ai_next)
+			{
+			descriptor = ::socket(current->ai_family, current->ai_socktype, current->ai_protocol);
+			if (descriptor < 0)
+				continue;
+
+			if (server)
+				{
+				int yes = 1;
+				(void)::setsockopt(descriptor, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&yes), sizeof(yes));
+				if (::bind(descriptor, current->ai_addr, static_cast<int>(current->ai_addrlen)) == 0)
+					break;
+				}
+			else if (::connect(descriptor, current->ai_addr, static_cast<int>(current->ai_addrlen)) == 0)
+				break;
+
+			#ifdef _MSC_VER
+				::closesocket(descriptor);
+			#else
+				::close(descriptor);
+			#endif
+			descriptor = -1;
+			}
+
+		::freeaddrinfo(found);
+		return descriptor;
+		}
+
+	/*
+		SOCKET_LISTENER::LISTEN()
+		-------------------------
+	*/
+	bool socket_listener::listen(const std::string &address)
+		{
+		std::string host;
+		std::string port;
+
+		close();
+		split_address(address, unix_path, host, port);
+
+		/*
+			A stale Unix domain socket (from a server that didn't shut down cleanly) would stop us binding, so remove it.
+		*/
+		if (unix_path.size() != 0)
+			(void)::remove(unix_path.c_str());
+
+		descriptor = open_socket(address, true);
+		if (descriptor == -1)
+			return false;
+
+		if (::listen(descriptor, SOMAXCONN) != 0)
+			{
+			close();
+			return false;
+			}
+
+		return true;
+		}
+
+	/*
+		SOCKET_LISTENER::ACCEPT()
+		-------------------------
+	*/
+	intptr_t socket_listener::accept(void)
+		{
+		if (descriptor == -1)
+			return -1;
+
+		intptr_t client = ::accept(descriptor, nullptr, nullptr);
+		return client < 0 ? -1 : client;
+		}
+
+	/*
+		SOCKET_LISTENER::WAKE()
+		-----------------------
+	*/
+	void socket_listener::wake(void)
+		{
+		/*
+			shutdown() wakes any thread blocked in accept(), but leaves the descriptor (and so this object) alone
+		*/
+		if (descriptor != -1)
+			#ifdef _MSC_VER
+				::shutdown(descriptor, SD_BOTH);
+			#else
+				::shutdown(descriptor, SHUT_RDWR);
+			#endif
+		}
+
+	/*
+		SOCKET_LISTENER::CLOSE()
+		------------------------
+	*/
+	void socket_listener::close(void)
+		{
+		if (descriptor != -1)
+			{
+			wake();
+			#ifdef _MSC_VER
+				::closesocket(descriptor);
+			#else
+				::close(descriptor);
+			#endif
+			descriptor = -1;
+			}
+
+		if (unix_path.size() != 0)
+			{
+			(void)::remove(unix_path.c_str());
+			unix_path = "";
+			}
+		}
+
+	/*
+		SOCKET_LISTENER::CONNECT()
+		--------------------------
+	*/
+	intptr_t socket_listener::connect(const std::string &address)
+		{
+		std::string unix_path;
+		std::string host;
+		std::string port;
+
+		split_address(address, unix_path, host, port);
+		if (unix_path.size() == 0 && host.size() == 0)
+			return open_socket("localhost:" + port, false);
+
+		return open_socket(address, false);
+		}
+
+	/*
+		SOCKET_LISTENER::UNITTEST()
+		---------------------------
+	*/
+	void socket_listener::unittest(void)
+		{
+		/*
+			Can't listen on a nonsense address
+		*/
+		socket_listener listener;
+		JASS_assert(!listener.listen("unix:/JASS/does/not/exist/socket"));
+		JASS_assert(listener.accept() == -1);
+		JASS_assert(socket_listener::connect("unix:/JASS/does/not/exist/socket") == -1);
+
+		/*
+			wake() must unblock a thread waiting in accept()
+		*/
+		#ifndef _MSC_VER
+			std::string address = "unix:" + file::mkstemp("jass");
+			JASS_assert(listener.listen(address));
+			intptr_t accepted = 0;
+			thread waiter([&listener, &accepted](){ accepted = listener.accept(); });
+			listener.wake();
+			waiter.join();
+			JASS_assert(accepted == -1);
+			listener.close();
+		#endif
+
+		/*
+			Listening, accepting, and connecting are tested in channel_connection::unittest() as they need a connection
+		*/
+
+		puts("socket_listener::PASSED");
+		}
+	}
@@ -0,0 +1,141 @@
+/*
+	SOCKET_LISTENER.H
+	-----------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief A socket that listens for (and accepts) incoming connections.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+namespace JASS
+	{
+	/*
+		CLASS SOCKET_LISTENER
+		---------------------
+	*/
+	/*!
+		@brief A socket that listens for (and accepts) incoming connections.
+		@details The address is either a TCP port ("8088" or "host:8088"), or a Unix domain socket ("unix:/path/to/socket").  A connection
+		returned by accept() is usually given to a channel_connection, which does the I/O.
+	*/
+	class socket_listener
+		{
+		private:
+			intptr_t descriptor;					///< The listening socket (or -1 if not listening).
+			std::string unix_path;				///< If this is a Unix domain socket then this is the path (which is removed on close()).
+
+		private:
+			/*
+				SOCKET_LISTENER::SOCKET_LISTENER()
+				----------------------------------
+			*/
+			/*!
+				@brief Private copy constructor prevents object copying.
+			*/
+			socket_listener(const socket_listener &) = delete;
+
+			/*
+				SOCKET_LISTENER::OPERATOR=()
+				----------------------------
+			*/
+			/*!
+				@brief Private assignment operator prevents assigning to this object.
+			*/
+			socket_listener &operator=(const socket_listener &) = delete;
+
+		public:
+			/*
+				SOCKET_LISTENER::SOCKET_LISTENER()
+				----------------------------------
+			*/
+			/*!
+				@brief Constructor.  The object does not listen until listen() is called.
+			*/
+			socket_listener() :
+				descriptor(-1)
+				{
+				/* Nothing */
+				}
+
+			/*
+				SOCKET_LISTENER::~SOCKET_LISTENER()
+				-----------------------------------
+			*/
+			/*!
+				@brief Destructor.  Stops listening.
+			*/
+			~socket_listener()
+				{
+				close();
+				}
+
+			/*
+				SOCKET_LISTENER::LISTEN()
+				-------------------------
+			*/
+			/*!
+				@brief Start listening on the given address.
+				@param address [in] Either "[host:]port" for TCP, or "unix:path" for a Unix domain socket.
+				@return true on success, false on failure.
+			*/
+			bool listen(const std::string &address);
+
+			/*
+				SOCKET_LISTENER::ACCEPT()
+				-------------------------
+			*/
+			/*!
+				@brief Block until a client connects.
+				@return The connected socket descriptor, or -1 on failure (including when another thread calls wake()).
+			*/
+			intptr_t accept(void);
+
+			/*
+				SOCKET_LISTENER::WAKE()
+				-----------------------
+			*/
+			/*!
+				@brief Wake a thread blocked in accept() (which then returns -1), without closing the socket.
+				@details This can be called from another thread as it does not change the object.  The thread that called accept() should then call close().
+			*/
+			void wake(void);
+
+			/*
+				SOCKET_LISTENER::CLOSE()
+				------------------------
+			*/
+			/*!
+				@brief Stop listening.  This must not be called while another thread is in accept(), use wake() to unblock it first.
+			*/
+			void close(void);
+
+			/*
+				SOCKET_LISTENER::CONNECT()
+				--------------------------
+			*/
+			/*!
+				@brief Connect to a listening socket (the client side of a connection).
+				@param address [in] The address in the same format as listen(), except that the host defaults to localhost.
+				@return The connected socket descriptor, or -1 on failure.
+			*/
+			static intptr_t connect(const std::string &address);
+
+			/*
+				SOCKET_LISTENER::UNITTEST()
+				---------------------------
+			*/
+			/*!
+				@brief Unit test this class.
+			*/
+			static void unittest(void);
+		};
+	}
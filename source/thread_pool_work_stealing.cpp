@@ -0,0 +1,215 @@
+/*
+	THREAD_POOL_WORK_STEALING.CPP
+	-----------------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+#include <stdio.h>
+
+#include "asserts.h"
+#include "thread_pool_work_stealing.h"
+
+namespace JASS
+	{
+	/*
+		THREAD_POOL_WORK_STEALING::THREAD_POOL_WORK_STEALING()
+		------------------------------------------------------
+	*/
+	thread_pool_work_stealing::thread_pool_work_stealing(size_t workers) :
+		next_queue(0),
+		queued(0),
+		pending(0),
+		stopping(false)
+		{
+		if (workers == 0)
+			workers = 1;
+
+		/*
+			All the queues must exist before any worker starts as the workers steal from each other
+		*/
+		for (size_t worker = 0; worker < workers; worker++)
+			queues.push_back(std::unique_ptr<work_queue>(new work_queue));
+
+		for (size_t worker = 0; worker < workers; worker++)
+			team.push_back(thread(work, std::ref(*this), worker));
+		}
+
+	/*
+		THREAD_POOL_WORK_STEALING::~THREAD_POOL_WORK_STEALING()
+		-------------------------------------------------------
+	*/
+	thread_pool_work_stealing::~thread_pool_work_stealing()
+		{
+		wait();
+
+		{
+		std::unique_lock<std::mutex> guard(sleep_lock);
+		stopping = true;
+		}
+		wake.notify_all();
+
+		for (auto &worker : team)
+			worker.join();
+		}
+
+	/*
+		THREAD_POOL_WORK_STEALING::ENQUEUE()
+		------------------------------------
+	*/
+	void thread_pool_work_stealing::enqueue(size_t queue, task job)
+		{
+		pending++;
+
+		{
+		std::unique_lock<std::mutex> guard(queues[queue]->lock);
+		queues[queue]->tasks.push_back(job);
+		}
+
+		/*
+			Taking the sleep lock before signalling ensures that a worker that has just checked for work (and found none) is waiting before we signal.
+		*/
+		{
+		std::unique_lock<std::mutex> guard(sleep_lock);
+		queued++;
+		}
+		wake.notify_one();
+		}
+
+	/*
+		THREAD_POOL_WORK_STEALING::GET_TASK()
+		-------------------------------------
+	*/
+	bool thread_pool_work_stealing::get_task(size_t worker, task &into)
+		{
+		/*
+			First look in our own queue (newest first)
+		*/
+		{
+		work_queue &mine = *queues[worker];
+		std::unique_lock<std::mutex> guard(mine.lock);
+		if (!mine.tasks.empty())
+			{
+			into = std::move(mine.tasks.back());
+			mine.tasks.pop_back();
+			queued--;
+			return true;
+			}
+		}
+
+		/*
+			Then steal from the others (oldest first), starting with our neighbour so that thieves spread out
+		*/
+		for (size_t offset = 1; offset < queues.size(); offset++)
+			{
+			work_queue &victim = *queues[(worker + offset) % queues.size()];
+			std::unique_lock<std::mutex> guard(victim.lock);
+			if (!victim.tasks.empty())
+				{
+				into = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				queued--;
+				return true;
+				}
+			}
+
+		return false;
+		}
+
+	/*
+		THREAD_POOL_WORK_STEALING::WORK()
+		---------------------------------
+	*/
+	void thread_pool_work_stealing::work(thread_pool_work_stealing &pool, size_t worker)
+		{
+		task job;
+
+		while (true)
+			{
+			if (pool.get_task(worker, job))
+				{
+				job(worker);
+				job = nullptr;
+
+				if (--pool.pending == 0)
+					{
+					std::unique_lock<std::mutex> guard(pool.sleep_lock);
+					pool.idle.notify_all();
+					}
+				continue;
+				}
+
+			/*
+				Nothing to do so sleep until there is
+			*/
+			std::unique_lock<std::mutex> guard(pool.sleep_lock);
+			pool.wake.wait(guard, [&pool](){ return pool.stopping || pool.queued > 0; });
+			if (pool.stopping && pool.queued == 0)
+				return;
+			}
+		}
+
+	/*
+		THREAD_POOL_WORK_STEALING::WAIT()
+		---------------------------------
+	*/
+	void thread_pool_work_stealing::wait(void)
+		{
+		std::unique_lock<std::mutex> guard(sleep_lock);
+		idle.wait(guard, [this](){ return pending == 0; });
+		}
+
+	/*
+		THREAD_POOL_WORK_STEALING::UNITTEST()
+		-------------------------------------
+	*/
+	void thread_pool_work_stealing::unittest(void)
+		{
+		const size_t workers = 4;
+		const size_t tasks = 1000;
+		std::atomic<size_t> done(0);
+		std::vector<size_t> done_by(workers, 0);
+
+		{
+		thread_pool_work_stealing pool(workers);
+		JASS_assert(pool.workers() == workers);
+
+		/*
+			Each task submits a second task to its own queue, and the per-worker counters are only ever touched by the owning worker.
+		*/
+		for (size_t which = 0; which < tasks; which++)
+			pool.submit
+				(
+				[&pool, &done, &done_by](size_t worker)
+					{
+					done_by[worker]++;
+					done++;
+					pool.submit(worker, [&done, &done_by](size_t worker)
+						{
+						done_by[worker]++;
+						done++;
+						});
+					}
+				);
+
+		pool.wait();
+		JASS_assert(done == 2 * tasks);
+
+		size_t total = 0;
+		for (const auto count : done_by)
+			total += count;
+		JASS_assert(total == 2 * tasks);
+
+		/*
+			The pool must be re-usable after a wait()
+		*/
+		pool.submit([&done](size_t worker){ done++; });
+		}
+
+		/*
+			The destructor must finish the outstanding work
+		*/
+		JASS_assert(done == 2 * tasks + 1);
+
+		puts("thread_pool_work_stealing::PASSED");
+		}
+	}
@@ -0,0 +1,202 @@
+/*
+	THREAD_POOL_WORK_STEALING.H
+	---------------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief A fixed size pool of worker threads that schedule tasks using work-stealing.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include "threads.h"
+
+namespace JASS
+	{
+	/*
+		CLASS THREAD_POOL_WORK_STEALING
+		-------------------------------
+	*/
+	/*!
+		@brief A fixed size pool of worker threads that schedule tasks using work-stealing.
+		@details Each worker has its own double ended queue of tasks.  A worker takes work from the back of its own queue (so the most recently
+		added, and most likely to be in cache, task is done first), and when its own queue is empty it steals from the front of the queues of the
+		other workers.  Tasks submitted from outside the pool are distributed round-robin over the workers' queues.  Each task is passed the id
+		of the worker that runs it (0 <= id < workers()) so that the caller can pre-allocate per-worker resources (e.g. query objects and decoders)
+		and index them by worker id without any locking.  Idle workers sleep rather than spin as the pool is intended for long-lived servers
+		that might see no work for long periods of time.
+	*/
+	class thread_pool_work_stealing
+		{
+		public:
+			typedef std::function<void(size_t worker)> task;			///< A task is passed the id of the worker that runs it
+
+		private:
+			/*
+				CLASS THREAD_POOL_WORK_STEALING::WORK_QUEUE
+				-------------------------------------------
+			*/
+			/*!
+				@brief The queue of tasks belonging to a single worker.
+			*/
+			class work_queue
+				{
+				public:
+					std::mutex lock;						///< Serialises access to the tasks (between the owner and thieves)
+					std::deque<task> tasks;				///< The tasks waiting to be done
+				};
+
+		private:
+			std::vector<std::unique_ptr<work_queue>> queues;		///< One queue per worker
+			std::vector<thread> team;										///< The worker threads
+			std::atomic<size_t> next_queue;								///< The queue that the next externally submitted task is added to (round-robin)
+			std::atomic<size_t> queued;									///< The number of tasks in the queues (not yet started)
+			std::atomic<size_t> pending;									///< The number of tasks submitted but not yet finished
+			std::mutex sleep_lock;											///< Protects the condition variables and stopping
+			std::condition_variable wake;									///< Signalled when there is new work (or the pool is stopping)
+			std::condition_variable idle;									///< Signalled when all submitted tasks are finished
+			bool stopping;														///< Set when the pool is being destroyed
+
+		private:
+			/*
+				THREAD_POOL_WORK_STEALING::THREAD_POOL_WORK_STEALING()
+				------------------------------------------------------
+			*/
+			/*!
+				@brief Private copy constructor prevents object copying.
+			*/
+			thread_pool_work_stealing(const thread_pool_work_stealing &) = delete;
+
+			/*
+				THREAD_POOL_WORK_STEALING::OPERATOR=()
+				--------------------------------------
+			*/
+			/*!
+				@brief Private assignment operator prevents assigning to this object.
+			*/
+			thread_pool_work_stealing &operator=(const thread_pool_work_stealing &) = delete;
+
+			/*
+				THREAD_POOL_WORK_STEALING::GET_TASK()
+				-------------------------------------
+			*/
+			/*!
+				@brief Get a task for the given worker, first from its own queue then by stealing from the other workers.
+				@param worker [in] The worker looking for work.
+				@param into [out] The task.
+				@return true if a task was found, else false.
+			*/
+			bool get_task(size_t worker, task &into);
+
+			/*
+				THREAD_POOL_WORK_STEALING::WORK()
+				---------------------------------
+			*/
+			/*!
+				@brief The main loop of each of the workers.
+				@param pool [in] The pool this worker belongs to.
+				@param worker [in] The id of this worker.
+			*/
+			static void work(thread_pool_work_stealing &pool, size_t worker);
+
+			/*
+				THREAD_POOL_WORK_STEALING::ENQUEUE()
+				------------------------------------
+			*/
+			/*!
+				@brief Add a task to the back of the given queue and wake a worker.
+				@param queue [in] The queue to add to.
+				@param job [in] The task.
+			*/
+			void enqueue(size_t queue, task job);
+
+		public:
+			/*
+				THREAD_POOL_WORK_STEALING::THREAD_POOL_WORK_STEALING()
+				------------------------------------------------------
+			*/
+			/*!
+				@brief Constructor.  Starts the workers.
+				@param workers [in] The number of worker threads (at least one worker is always started).
+			*/
+			explicit thread_pool_work_stealing(size_t workers);
+
+			/*
+				THREAD_POOL_WORK_STEALING::~THREAD_POOL_WORK_STEALING()
+				-------------------------------------------------------
+			*/
+			/*!
+				@brief Destructor.  Waits for all submitted work to finish then stops the workers.
+			*/
+			~thread_pool_work_stealing();
+
+			/*
+				THREAD_POOL_WORK_STEALING::WORKERS()
+				------------------------------------
+			*/
+			/*!
+				@brief Return the number of workers in the pool.
+				@return The number of workers.
+			*/
+			size_t workers(void) const
+				{
+				return queues.size();
+				}
+
+			/*
+				THREAD_POOL_WORK_STEALING::SUBMIT()
+				-----------------------------------
+			*/
+			/*!
+				@brief Submit a task to the pool (from outside the pool).
+				@param job [in] The task.
+			*/
+			void submit(task job)
+				{
+				enqueue(next_queue++ % queues.size(), job);
+				}
+
+			/*
+				THREAD_POOL_WORK_STEALING::SUBMIT()
+				-----------------------------------
+			*/
+			/*!
+				@brief Submit a task to the queue of a given worker (typically used by a task to add more work for itself).
+				@param worker [in] The worker whose queue the task is added to.
+				@param job [in] The task.
+			*/
+			void submit(size_t worker, task job)
+				{
+				enqueue(worker % queues.size(), job);
+				}
+
+			/*
+				THREAD_POOL_WORK_STEALING::WAIT()
+				---------------------------------
+			*/
+			/*!
+				@brief Block until all submitted tasks (including those submitted by tasks) are finished.
+			*/
+			void wait(void);
+
+			/*
+				THREAD_POOL_WORK_STEALING::UNITTEST()
+				-------------------------------------
+			*/
+			/*!
+				@brief Unit test this class.
+			*/
+			static void unittest(void);
+		};
+	}
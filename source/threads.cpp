@@ -121,6 +121,15 @@ namespace JASS
 
 		JASS_assert(param != 1);
 
+		/*
+			A pinned thread runs
+		*/
+		param = 1;
+		auto z = thread(affinity(std::vector<size_t>{0}), unittest_callback, std::ref(param));
+		z.join();
+
+		JASS_assert(param == 2);
+
 		puts("thread::PASSED");
 		}
 	}
@@ -23,6 +23,7 @@
 
 #include <stdio.h>
 
+#include <vector>
 #include <functional> 
 
 #include "asserts.h"
@@ -34,6 +35,36 @@ namespace JASS
 	*/
 	class thread
 		{
+		public:
+			/*
+				CLASS THREAD::AFFINITY
+				----------------------
+			*/
+			/*!
+				@brief The CPUs a thread may run on (passed to the constructor to pin the thread as it starts).
+				@details Pinning is only supported on Linux, elsewhere the thread may run on any CPU.
+			*/
+			class affinity
+				{
+				public:
+					std::vector<size_t> cpus;					///< The CPUs the thread may run on (an empty list means any CPU)
+
+				public:
+					/*
+						THREAD::AFFINITY::AFFINITY()
+						----------------------------
+					*/
+					/*!
+						@brief Constructor.
+						@param cpus [in] The CPUs the thread may run on (an empty list means any CPU).
+					*/
+					explicit affinity(const std::vector<size_t> &cpus = std::vector<size_t>()) :
+						cpus(cpus)
+						{
+						/* Nothing */
+						}
+				};
+
 		private:
 			#ifdef _MSC_VER
 				const unsigned int DEFAULT_STACK_SIZE = 8 * 1024 * 1024;			///< default tread stack size
@@ -91,6 +122,23 @@ namespace JASS
 			*/
 			template<typename FUNCTION, typename... PARAMETERS>
 			thread(FUNCTION function, PARAMETERS ... parameters):
+				thread(affinity(), function, parameters...)
+				{
+				/* Nothing */
+				}
+
+			/*
+				THREAD::THREAD()
+				----------------
+			*/
+			/*!
+				@brief Constructor for a thread pinned to a set of CPUs from the moment it starts (so memory it first touches is local to those CPUs).
+				@param where [in] The CPUs the thread may run on.
+				@param function [in] the function to call.
+				@param parameters [in] the parameters to that function.
+			*/
+			template<typename FUNCTION, typename... PARAMETERS>
+			thread(const affinity &where, FUNCTION function, PARAMETERS ... parameters):
 				thread_id()
 				{
 				/*
@@ -125,6 +173,21 @@ namespace JASS
 					if (pthread_attr_setstacksize(&attributes, DEFAULT_STACK_SIZE) != 0)
 						exit(printf("Can't start thread"));				// LCOV_EXCL_LINE		// can't test this line
 
+					/*
+						pin it (failure to pin is not an error, the thread then runs anywhere)
+					*/
+					#ifdef __linux__
+						if (where.cpus.size() != 0)
+							{
+							cpu_set_t cpus;
+							CPU_ZERO(&cpus);
+							for (const auto cpu : where.cpus)
+								if (cpu < CPU_SETSIZE)
+									CPU_SET(cpu, &cpus);
+							(void)pthread_attr_setaffinity_np(&attributes, sizeof(cpus), &cpus);
+							}
+					#endif
+
 					/*
 						start the thread
 					*/
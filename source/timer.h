@@ -15,6 +15,7 @@
 #include <chrono>
 #include <thread>
 
+#include <stdio.h>
 #include <stdint.h>
 
 #include "asserts.h"
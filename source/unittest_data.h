@@ -10,6 +10,7 @@
 	@author Andrew Trotman
 	@copyright 2016 Andrew Trotman
 */
+#pragma once
 
 #include <string>
 
@@ -0,0 +1,234 @@
+/*
+	VOCABULARY_HASH.H
+	-----------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@file
+	@brief A read-only, cache-friendly, hash table over the terms of a vocabulary.
+	@author Andrew Trotman
+	@copyright 2019 Andrew Trotman
+*/
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <limits>
+#include <vector>
+#include <string>
+
+#include "slice.h"
+#include "asserts.h"
+
+namespace JASS
+	{
+	/*
+		CLASS VOCABULARY_HASH
+		---------------------
+	*/
+	/*!
+		@brief A read-only open addressed (linear probing) hash table mapping a term to its position in a sorted vocabulary.
+		@details A binary search of a large vocabulary takes log2(terms) cache misses, each to a different part of the vocabulary
+		(and another for each term string compared to).  This table stores, in each 8-byte slot, a 32-bit fingerprint of the term and the
+		term's position in the vocabulary.  A lookup hashes the term, reads the slot (typically one cache miss), and compares the term
+		string only when the fingerprint matches (one more miss).  The table does not store the terms, so the caller provides a way to get
+		(or compare against) the term at a given position.  The table is at most half full, so it uses between 16 and 32 bytes per term.
+	*/
+	class vocabulary_hash
+		{
+		public:
+			static constexpr size_t npos = (std::numeric_limits<size_t>::max)();		///< Returned by find() when the term is not in the vocabulary
+
+		private:
+			/*
+				CLASS VOCABULARY_HASH::SLOT
+				---------------------------
+			*/
+			/*!
+				@brief An entry in the hash table.
+			*/
+			class slot
+				{
+				public:
+					uint32_t fingerprint;				///< The high 32 bits of the hash of the term
+					uint32_t term;							///< The position of the term in the vocabulary (or empty)
+				};
+
+		private:
+			static constexpr uint32_t empty = (std::numeric_limits<uint32_t>::max)();		///< The value of slot::term for an unused slot
+
+		private:
+			std::vector<slot> table;				///< The hash table
+			size_t mask;								///< The size of the table minus 1 (the table is a power of 2 in size)
+
+		public:
+			/*
+				VOCABULARY_HASH::HASH()
+				-----------------------
+			*/
+			/*!
+				@brief Compute a 64-bit hash of a string, 8 bytes at a time.
+				@param string [in] The string.
+				@param length [in] The length of the string (in bytes).
+				@return The hash value.
+			*/
+			static uint64_t hash(const void *string, size_t length)
+				{
+				const uint8_t *bytes = reinterpret_cast<const uint8_t *>(string);
+				uint64_t result = length * 0x9E3779B97F4A7C15;
+				uint64_t word;
+
+				for (; length >= sizeof(word); length -= sizeof(word), bytes += sizeof(word))
+					{
+					memcpy(&word, bytes, sizeof(word));
+					result = (result ^ word) * 0xFF51AFD7ED558CCD;
+					result ^= result >> 29;
+					}
+
+				if (length != 0)
+					{
+					word = 0;
+					memcpy(&word, bytes, length);
+					result = (result ^ word) * 0xFF51AFD7ED558CCD;
+					}
+
+				/*
+					Finalise so that every bit of the input affects both the slot and the fingerprint
+				*/
+				result ^= result >> 33;
+				result *= 0xC4CEB9FE1A85EC53;
+				result ^= result >> 33;
+				return result;
+				}
+
+		public:
+			/*
+				VOCABULARY_HASH::VOCABULARY_HASH()
+				----------------------------------
+			*/
+			/*!
+				@brief Constructor
+			*/
+			vocabulary_hash() :
+				mask(0)
+				{
+				/* Nothing */
+				}
+
+			/*
+				VOCABULARY_HASH::BUILD()
+				------------------------
+			*/
+			/*!
+				@brief Build the table over a vocabulary.
+				@details The vocabulary must not be larger than 2^32 - 1 terms.
+				@tparam TERM_AT A callable returning the term (as a slice) at a given position in the vocabulary.
+				@param terms [in] The number of terms in the vocabulary.
+				@param term_at [in] The callable used to get the terms.
+			*/
+			template <typename TERM_AT>
+			void build(size_t terms, TERM_AT term_at)
+				{
+				size_t size = 16;
+				while (size < terms * 2)
+					size *= 2;
+
+				table.assign(size, slot{0, empty});
+				mask = size - 1;
+
+				for (size_t term = 0; term < terms; term++)
+					{
+					slice token = term_at(term);
+					uint64_t hashed = hash(token.address(), token.size());
+					size_t where = hashed & mask;
+					while (table[where].term != empty)
+						where = (where + 1) & mask;
+					table[where].fingerprint = static_cast<uint32_t>(hashed >> 32);
+					table[where].term = static_cast<uint32_t>(term);
+					}
+				}
+
+			/*
+				VOCABULARY_HASH::BUILT()
+				------------------------
+			*/
+			/*!
+				@brief Has the table been built?
+				@return true if build() has been called, else false.
+			*/
+			bool built(void) const
+				{
+				return table.size() != 0;
+				}
+
+			/*
+				VOCABULARY_HASH::FIND()
+				-----------------------
+			*/
+			/*!
+				@brief Find the position of a term in the vocabulary.
+				@tparam MATCHES A callable that, given a position in the vocabulary, returns true if the term there is the term being looked for.
+				@param term [in] The term to look for.
+				@param matches [in] The callable used to check candidate terms.
+				@return The position of the term in the vocabulary, or npos if it is not there.
+			*/
+			template <typename MATCHES>
+			size_t find(const slice &term, MATCHES matches) const
+				{
+				uint64_t hashed = hash(term.address(), term.size());
+				uint32_t fingerprint = static_cast<uint32_t>(hashed >> 32);
+
+				for (size_t where = hashed & mask; table[where].term != empty; where = (where + 1) & mask)
+					if (table[where].fingerprint == fingerprint && matches(table[where].term))
+						return table[where].term;
+
+				return npos;
+				}
+
+			/*
+				VOCABULARY_HASH::UNITTEST()
+				---------------------------
+			*/
+			/*!
+				@brief Unit test this class
+			*/
+			static void unittest(void)
+				{
+				std::vector<std::string> vocabulary;
+				for (size_t term = 0; term < 1000; term++)
+					vocabulary.push_back("term" + std::to_string(term));
+				vocabulary.push_back("");
+				vocabulary.push_back("a much longer term that spans several words of the hash");
+
+				auto term_at = [&](size_t which){ return slice(vocabulary[which].c_str()); };
+				vocabulary_hash table;
+				JASS_assert(!table.built());
+				table.build(vocabulary.size(), term_at);
+				JASS_assert(table.built());
+
+				/*
+					Every term can be found
+				*/
+				for (size_t term = 0; term < vocabulary.size(); term++)
+					JASS_assert(table.find(slice(vocabulary[term].c_str()), [&](size_t which){ return vocabulary[which] == vocabulary[term]; }) == term);
+
+				/*
+					Terms not in the vocabulary are not found
+				*/
+				std::string missing = "term1000";
+				JASS_assert(table.find(slice(missing.c_str()), [&](size_t which){ return vocabulary[which] == missing; }) == npos);
+				missing = "erm1";
+				JASS_assert(table.find(slice(missing.c_str()), [&](size_t which){ return vocabulary[which] == missing; }) == npos);
+
+				/*
+					The hash depends on every byte
+				*/
+				JASS_assert(hash("abcdefghi", 9) != hash("abcdefghj", 9));
+				JASS_assert(hash("abcdefgh", 8) != hash("abcdefgh\0", 9));
+
+				puts("vocabulary_hash::PASSED");
+				}
+		};
+	}
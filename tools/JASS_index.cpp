@@ -12,6 +12,7 @@
 */
 #include <string.h>
 
+#include <atomic>
 #include <vector>
 
 #include "timer.h"
@@ -26,6 +27,8 @@
 #include "serialise_jass_v1.h"
 #include "serialise_integers.h"
 #include "instream_document_trec.h"
+#include "index_manager_external.h"
+#include "index_manager_parallel.h"
 #include "index_manager_sequential.h"
 #include "ranking_function_atire_bm25.h"
 
@@ -40,6 +43,8 @@ bool parameter_quiet = false;
 bool parameter_help = false;
 size_t parameter_report_every_n = (std::numeric_limits<size_t>::max)();
 bool parameter_atire_similar = false;
+size_t parameter_threads = 1;
+size_t parameter_memory_budget = 0;
 
 auto command_line_parameters = std::make_tuple
 	(
@@ -55,6 +60,10 @@ auto command_line_parameters = std::make_tuple
 	JASS::commandline::note("\nFILE HANDLING\n-------------"),
 	JASS::commandline::parameter("-f", "--filename", "<filename> Filename to index.", parameter_filename),
 
+	JASS::commandline::note("\nPERFORMANCE\n-----------"),
+	JASS::commandline::parameter("-t", "--threads", "<threadcount> Number of threads to parse, quantize, and compress with [default = -t1].", parameter_threads),
+	JASS::commandline::parameter("-B", "--memory-budget", "<megabytes> Spill the postings to disk each time they exceed <megabytes> (single threaded) [default = no limit].", parameter_memory_budget),
+
 	JASS::commandline::note("\nCOMPATIBILITY\n-------------"),
 	JASS::commandline::parameter("-A", "--atire", "ATIRE-like parsing (errors and all)", parameter_atire_similar),
 
@@ -74,6 +83,113 @@ uint8_t usage(const std::string &exename)
 	return 1;
 	}
 
+/*
+	INDEX_DOCUMENT()
+	----------------
+*/
+/*!
+	@brief Parse a document and add each term to the index.
+	@param parser [in] The parser to use.
+	@param document [in] The document to index.
+	@param index [in] The index to add the terms to (begin_document() and end_document() are the caller's responsibility).
+	@return The length of the document (measured in terms).
+*/
+template <typename INDEX>
+JASS::compress_integer::integer index_document(JASS::parser &parser, JASS::document &document, INDEX &index)
+	{
+	parser.set_document(document);
+
+	/*
+		Process each token
+	*/
+	bool finished = false;
+	JASS::compress_integer::integer document_length = 0;				// measured in terms
+	do
+		{
+		const auto &token = parser.get_next_token();
+		
+		switch (token.type)
+			{
+			case JASS::parser::token::eof:
+				finished = true;
+				break;
+			case JASS::parser::token::alpha:
+				document_length++;
+				index.term(token);
+				break;
+			case JASS::parser::token::numeric:
+				document_length++;
+				index.term(token);
+				break;
+			case JASS::parser::token::xml_start_tag:
+				break;
+			case JASS::parser::token::xml_end_tag:
+				break;
+			default:
+				break;
+			}
+		}
+	while (!finished);
+
+	return document_length;
+	}
+
+/*
+	INDEX_SEQUENTIALLY()
+	--------------------
+*/
+/*!
+	@brief Index each document in the instream, in turn.
+	@param source [in] The instream of documents.
+	@param index [in] The index to add the documents to.
+	@param timer [in] The time since the indexer started (for reporting).
+	@param total_documents [out] The number of documents indexed.
+	@return The length of the collection (measured in terms).
+*/
+template <typename INDEX>
+uint64_t index_sequentially(JASS::instream &source, INDEX &index, decltype(JASS::timer::start()) timer, size_t &total_documents)
+	{
+	JASS::parser parser;
+	JASS::document document;
+	uint64_t collection_length = 0;		// measured in terms
+
+	do
+		{
+		/*
+			Reuse memory from before
+		*/
+		document.rewind();
+
+		/*
+			get the next document
+		*/
+		source.read(document);
+		if (document.isempty())
+			break;
+		total_documents++;
+		if (total_documents % parameter_report_every_n == 0)
+			{
+			auto took = JASS::timer::stop(timer).nanoseconds();
+			std::cout << "Documents:" << total_documents << " in:" << took << " ns" << "\n";
+			}
+
+		/*
+			parse the current document
+		*/
+		index.begin_document(document.primary_key);
+		auto document_length = index_document(parser, document, index);
+		collection_length += document_length;
+
+		/*
+			ATIRE has a bug that results in the document length calculation being off by one (one too large in ATIRE)
+		*/
+		index.end_document(document_length + (parameter_atire_similar ? 1 : 0));
+		}
+	while (!document.isempty());
+
+	return collection_length;
+	}
+
 /*
 	MAIN()
 	------
@@ -114,11 +230,11 @@ int main(int argc, const char *argv[])
 	/*
 		Now call JASS
 	*/
-	JASS::parser parser;
-	JASS::document document;
 	std::shared_ptr<JASS::instream> file(new JASS::instream_file(parameter_filename));
 	std::shared_ptr<JASS::instream> source(new JASS::instream_document_trec(file));
-	JASS::index_manager_sequential index;
+	JASS::index_manager_parallel in_memory_index(parameter_threads);
+	JASS::index_manager_external external_index(parameter_memory_budget * 1024 * 1024);
+	JASS::index_manager &index = parameter_memory_budget != 0 ? static_cast<JASS::index_manager &>(external_index) : in_memory_index;
 
 	size_t total_documents = 0;
 
@@ -128,83 +244,52 @@ int main(int argc, const char *argv[])
 		Parse the instream to get document (which are then indexed)
 	*/
 	uint64_t collection_length = 0;		// measured in terms
-	do
+	if (parameter_threads > 1 && parameter_memory_budget == 0)
 		{
 		/*
-			Reuse memory from before
-		*/
-		document.rewind();
-
-		/*
-			get the next document
+			Each thread parses into its own index, then they are merged (in document order) so the index is the same as if it were built sequentially
 		*/
-		source->read(document);
-		if (document.isempty())
-			break;
-		total_documents++;
-		if (total_documents % parameter_report_every_n == 0)
+		std::atomic<size_t> documents_indexed(0);
+		std::atomic<uint64_t> terms_indexed(0);
+		in_memory_index.index_stream(*source, [&](JASS::parser &parser, JASS::document &document, JASS::index_manager_parallel::shard &shard)
 			{
-			auto took = JASS::timer::stop(timer).nanoseconds();
-			std::cout << "Documents:" << total_documents << " in:" << took << " ns" << "\n";
-			}
-
-		/*
-			parse the current document
-		*/
-		parser.set_document(document);
-		index.begin_document(document.primary_key);
+			auto document_length = index_document(parser, document, shard);
+			terms_indexed += document_length;
 
-		/*
-			Process each token
-		*/
-		bool finished = false;
-		JASS::compress_integer::integer document_length = 0;				// measured in terms
-		do
-			{
-			const auto &token = parser.get_next_token();
-			
-			switch (token.type)
+			size_t documents_so_far = ++documents_indexed;
+			if (documents_so_far % parameter_report_every_n == 0)
 				{
-				case JASS::parser::token::eof:
-					finished = true;
-					break;
-				case JASS::parser::token::alpha:
-					document_length++;
-					index.term(token);
-					break;
-				case JASS::parser::token::numeric:
-					document_length++;
-					index.term(token);
-					break;
-				case JASS::parser::token::xml_start_tag:
-					break;
-				case JASS::parser::token::xml_end_tag:
-					break;
-				default:
-					break;
+				std::ostringstream report;
+				report << "Documents:" << documents_so_far << " in:" << JASS::timer::stop(timer).nanoseconds() << " ns" << "\n";
+				std::cout << report.str();
 				}
-			}
-		while (!finished);
-		collection_length += document_length;
 
-		/*
-			ATIRE has a bug that results in the document length calculation being off by one (one too large in ATIRE)
-		*/
-		index.end_document(document_length + (parameter_atire_similar ? 1 : 0));
+			/*
+				ATIRE has a bug that results in the document length calculation being off by one (one too large in ATIRE)
+			*/
+			return document_length + (parameter_atire_similar ? 1 : 0);
+			});
+		total_documents = index.get_highest_document_id();
+		collection_length = terms_indexed;
 		}
-	while (!document.isempty());
+	else if (parameter_memory_budget != 0)
+		collection_length = index_sequentially(*source, external_index, timer, total_documents);
+	else
+		collection_length = index_sequentially(*source, in_memory_index, timer, total_documents);
 
 	auto time_to_end_parse = JASS::timer::stop(timer).nanoseconds();
 
 	std::cout << "Documents:" << total_documents << '\n';
 	std::cout << "Terms    :" << collection_length << '\n';
+	if (parameter_memory_budget != 0)
+		std::cout << "Runs     :" << external_index.get_number_of_runs() << '\n';
 
 	/*
 		quantize the index
 	*/
 	std::shared_ptr<JASS::ranking_function_atire_bm25> ranker(new JASS::ranking_function_atire_bm25(0.9, 0.4, index.get_document_length_vector()));
 	JASS::quantize<JASS::ranking_function_atire_bm25> quantizer(total_documents, ranker);
-	index.iterate(quantizer);
+	quantizer.compute_bounds(index, parameter_threads);
 	auto time_to_end_quantization = JASS::timer::stop(timer).nanoseconds();
 
 	/*
@@ -214,12 +299,12 @@ int main(int argc, const char *argv[])
 	if (parameter_compiled_index)
 		exporters.push_back(std::make_unique<JASS::serialise_ci>(index.get_highest_document_id()));
 	if (parameter_jass_v1_index)
-		exporters.push_back(std::make_unique<JASS::serialise_jass_v1>(index.get_highest_document_id()));
+		exporters.push_back(std::make_unique<JASS::serialise_jass_v1>(index.get_highest_document_id(), std::make_shared<JASS::compress_integer_qmx_jass_v1>(), 16, parameter_threads));
 	if (parameter_uint32_index)
 		exporters.push_back(std::make_unique<JASS::serialise_integers>(index.get_highest_document_id()));
 
 	/*
-		Write out the index in the desired formats.
+		Write out the index in the desired formats (all from the one pass over the index).
 	*/
 	if (exporters.size() != 0)
 		quantizer.serialise_index(index, exporters);
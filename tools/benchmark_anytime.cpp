@@ -0,0 +1,595 @@
+/*
+	BENCHMARK_ANYTIME.CPP
+	---------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@brief Reproducible end-to-end benchmark of JASS_anytime over a synthetic Zipfian collection.
+	@details A collection is generated (from a seed) with term occurrences drawn from a Zipfian distribution, indexed with
+	index_manager_sequential, and serialised as a JASS v1 index once for each codex (each into its own directory).  Query sets of
+	each length and document frequency mix are then generated, and JASS_anytime is run on each index for each query set, thread count,
+	rho, and top-k.  The queries per second, the search time percentiles, and the postings processed per second of each run are written
+	as one line of a CSV file.  The same parameters always give the same collection and the same queries, so two builds of JASS can be
+	compared by running this on each and comparing the CSV files.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef _MSC_VER
+	#include <direct.h>
+#else
+	#include <unistd.h>
+	#include <sys/stat.h>
+	#include <sys/types.h>
+#endif
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include "file.h"
+#include "timer.h"
+#include "parser.h"
+#include "quantize.h"
+#include "commandline.h"
+#include "serialise_jass_v1.h"
+#include "index_manager_sequential.h"
+#include "ranking_function_atire_bm25.h"
+#include "compress_integer_qmx_jass_v1.h"
+#include "compress_integer_elias_gamma_simd.h"
+#include "compress_integer_elias_delta_simd.h"
+
+/*
+	PARAMETERS
+	----------
+*/
+std::string parameter_anytime;								///< The full path of the JASS_anytime executable to benchmark
+std::string parameter_directory = "benchmark";			///< The directory to build the indexes and query sets in
+std::string parameter_output = "benchmark.csv";			///< The file to write the results to
+size_t parameter_documents = 100'000;						///< The number of documents in the collection
+size_t parameter_vocabulary = 100'000;						///< The number of unique terms in the collection
+size_t parameter_document_length = 100;					///< The average document length (in terms)
+double parameter_zipf = 1.0;									///< The Zipf exponent of the term distribution
+size_t parameter_seed = 1;										///< The seed for the random number generator
+size_t parameter_queries = 1'000;							///< The number of queries in each query set
+std::string parameter_codexes = "qmx,gamma,delta";		///< The codexes to benchmark
+std::string parameter_lengths = "1,2,4,8";				///< The query lengths to benchmark
+std::string parameter_mixes = "head,tail,zipf";			///< The document frequency mixes to benchmark
+std::string parameter_threads = "1";						///< The thread counts to benchmark
+std::string parameter_rho = "100,10";						///< The rho values to benchmark
+std::string parameter_top_k = "10";							///< The top-k values to benchmark
+bool parameter_help = false;
+
+std::string parameters_errors;						///< Any errors as a result of command line parsing
+auto parameters = std::make_tuple					///< The  command line parameter block
+	(
+	JASS::commandline::parameter("-?", "--help",          "Print this help.", parameter_help),
+	JASS::commandline::parameter("-a", "--anytime",       "<filename>  The full path of the JASS_anytime executable to benchmark (required)", parameter_anytime),
+	JASS::commandline::parameter("-w", "--directory",     "<directory> The directory to build the indexes and query sets in (default = benchmark)", parameter_directory),
+	JASS::commandline::parameter("-o", "--output",        "<filename>  The CSV file to write the results to (default = benchmark.csv)", parameter_output),
+	JASS::commandline::parameter("-d", "--documents",     "<count>     The number of documents in the collection (default = 100,000)", parameter_documents),
+	JASS::commandline::parameter("-v", "--vocabulary",    "<count>     The number of unique terms in the collection (default = 100,000)", parameter_vocabulary),
+	JASS::commandline::parameter("-l", "--length",        "<count>     The average document length in terms (default = 100)", parameter_document_length),
+	JASS::commandline::parameter("-z", "--zipf",          "<exponent>  The Zipf exponent of the term distribution (default = 1.0)", parameter_zipf),
+	JASS::commandline::parameter("-s", "--seed",          "<seed>      The seed for the random number generator (default = 1)", parameter_seed),
+	JASS::commandline::parameter("-n", "--queries",       "<count>     The number of queries in each query set (default = 1,000)", parameter_queries),
+	JASS::commandline::parameter("-c", "--codexes",       "<list>      The codexes to benchmark, from qmx, gamma, and delta (default = qmx,gamma,delta)", parameter_codexes),
+	JASS::commandline::parameter("-q", "--query-lengths", "<list>      The query lengths (in terms) to benchmark (default = 1,2,4,8)", parameter_lengths),
+	JASS::commandline::parameter("-m", "--mixes",         "<list>      The document frequency mixes to benchmark, from head (the 1% of terms with the highest df), torso (the next 9%), tail (the rest), and zipf (drawn like the collection) (default = head,tail,zipf)", parameter_mixes),
+	JASS::commandline::parameter("-t", "--threads",       "<list>      The thread counts to benchmark (default = 1)", parameter_threads),
+	JASS::commandline::parameter("-r", "--rho",           "<list>      The rho values to benchmark (default = 100,10)", parameter_rho),
+	JASS::commandline::parameter("-k", "--top-k",         "<list>      The top-k values to benchmark (default = 10)", parameter_top_k)
+	);
+
+/*
+	CLASS CODEX
+	-----------
+*/
+/*!
+	@brief A codex that the benchmark can build an index with.
+*/
+class codex
+	{
+	public:
+		const char *name;																	///< The name used on the command line and in the results
+		std::shared_ptr<JASS::compress_integer> (*encoder)(void);				///< Make the encoder
+		JASS::serialise_jass_v1::jass_v1_codex identifier;						///< The codex byte written into the index
+	};
+
+/*
+	CODEX_LIST
+	----------
+*/
+/*!
+	@brief The codexes that JASS_anytime can search.
+*/
+const codex codex_list[] =
+	{
+	{"qmx", [](){ return std::shared_ptr<JASS::compress_integer>(std::make_shared<JASS::compress_integer_qmx_jass_v1>()); }, JASS::serialise_jass_v1::jass_v1_codex::qmx},
+	{"gamma", [](){ return std::shared_ptr<JASS::compress_integer>(std::make_shared<JASS::compress_integer_elias_gamma_simd>()); }, JASS::serialise_jass_v1::jass_v1_codex::elias_gamma_simd},
+	{"delta", [](){ return std::shared_ptr<JASS::compress_integer>(std::make_shared<JASS::compress_integer_elias_delta_simd>()); }, JASS::serialise_jass_v1::jass_v1_codex::elias_delta_simd}
+	};
+
+/*
+	CLASS ZIPF_DISTRIBUTION
+	-----------------------
+*/
+/*!
+	@brief Draw term ranks (0 being the most frequent) from a Zipfian distribution.
+	@details std::discrete_distribution (and the other standard distributions) can give different sequences from different standard
+	libraries, so this does its own arithmetic to give the same sequence (from the same seed) everywhere.
+*/
+class zipf_distribution
+	{
+	private:
+		std::vector<double> cumulative;			///< The sum of the weights of the ranks up to (and including) each rank
+
+	public:
+		/*
+			ZIPF_DISTRIBUTION::ZIPF_DISTRIBUTION()
+			--------------------------------------
+		*/
+		/*!
+			@brief Constructor.
+			@param ranks [in] The number of ranks.
+			@param exponent [in] The Zipf exponent (the weight of rank r is 1 / (r + 1)^exponent).
+		*/
+		zipf_distribution(size_t ranks, double exponent)
+			{
+			double sum = 0;
+			for (size_t rank = 0; rank < ranks; rank++)
+				{
+				sum += 1.0 / std::pow(static_cast<double>(rank + 1), exponent);
+				cumulative.push_back(sum);
+				}
+			}
+
+		/*
+			ZIPF_DISTRIBUTION::UNIFORM()
+			----------------------------
+		*/
+		/*!
+			@brief Return a random number in [0, 1) with 53 bits of precision.
+			@param generator [in] The random number generator.
+			@return The random number.
+		*/
+		static double uniform(std::mt19937_64 &generator)
+			{
+			return (generator() >> 11) * (1.0 / 9007199254740992.0);
+			}
+
+		/*
+			ZIPF_DISTRIBUTION::OPERATOR()()
+			-------------------------------
+		*/
+		/*!
+			@brief Draw a rank.
+			@param generator [in] The random number generator.
+			@return The rank.
+		*/
+		size_t operator()(std::mt19937_64 &generator) const
+			{
+			size_t rank = std::upper_bound(cumulative.begin(), cumulative.end(), uniform(generator) * cumulative.back()) - cumulative.begin();
+			return rank < cumulative.size() ? rank : cumulative.size() - 1;
+			}
+	};
+
+/*
+	SPLIT()
+	-------
+*/
+/*!
+	@brief Split a comma separated list.
+	@param list [in] The list.
+	@return The members of the list.
+*/
+std::vector<std::string> split(const std::string &list)
+	{
+	std::vector<std::string> answer;
+	std::istringstream stream(list);
+	std::string member;
+
+	while (std::getline(stream, member, ','))
+		if (member.size() != 0)
+			answer.push_back(member);
+
+	return answer;
+	}
+
+/*
+	TERM_NAME()
+	-----------
+*/
+/*!
+	@brief Return the term of a given rank as a string of lowercase letters (which the JASS parsers keep as a single alphabetic token).
+	@param rank [in] The rank of the term.
+	@return The term.
+*/
+std::string term_name(size_t rank)
+	{
+	std::string answer;
+
+	for (rank++; rank != 0; rank = (rank - 1) / 26)
+		answer.insert(answer.begin(), static_cast<char>('a' + (rank - 1) % 26));
+
+	return answer;
+	}
+
+/*
+	MAKE_DIRECTORY()
+	----------------
+*/
+/*!
+	@brief Create a directory (it is not an error if it already exists).
+	@param name [in] The name of the directory.
+*/
+void make_directory(const std::string &name)
+	{
+	#ifdef _MSC_VER
+		_mkdir(name.c_str());
+	#else
+		mkdir(name.c_str(), 0777);
+	#endif
+	}
+
+/*
+	CHANGE_DIRECTORY()
+	------------------
+*/
+/*!
+	@brief Change the current working directory, exiting on failure.
+	@param name [in] The name of the directory.
+*/
+void change_directory(const std::string &name)
+	{
+	#ifdef _MSC_VER
+		int failed = _chdir(name.c_str());
+	#else
+		int failed = chdir(name.c_str());
+	#endif
+
+	if (failed)
+		exit(printf("Cannot change directory to %s\n", name.c_str()));
+	}
+
+/*
+	BUILD_COLLECTION()
+	------------------
+*/
+/*!
+	@brief Generate the collection and add it to the index.
+	@param index [in / out] The index to add the documents to.
+	@param terms [in] The term of each rank.
+	@param zipf [in] The distribution of term ranks.
+	@param generator [in] The random number generator.
+	@param document_frequency [out] The number of documents each rank occurs in.
+	@return The number of term occurrences in the collection.
+*/
+size_t build_collection(JASS::index_manager_sequential &index, const std::vector<std::string> &terms, const zipf_distribution &zipf, std::mt19937_64 &generator, std::vector<size_t> &document_frequency)
+	{
+	size_t collection_length = 0;
+	std::vector<size_t> last_seen(terms.size(), (std::numeric_limits<size_t>::max)());
+	JASS::parser::token token;
+	token.type = JASS::parser::token::alpha;
+
+	document_frequency.assign(terms.size(), 0);
+	for (size_t document = 0; document < parameter_documents; document++)
+		{
+		std::string primary_key = std::to_string(document);
+		size_t length = parameter_document_length / 2 + generator() % (parameter_document_length + 1);
+
+		index.begin_document(JASS::slice(primary_key.c_str()));
+		for (size_t which = 0; which < length; which++)
+			{
+			size_t rank = zipf(generator);
+			if (last_seen[rank] != document)
+				{
+				last_seen[rank] = document;
+				document_frequency[rank]++;
+				}
+			token.lexeme = JASS::slice(terms[rank].c_str());
+			index.term(token);
+			}
+		index.end_document(static_cast<JASS::compress_integer::integer>(length));
+		collection_length += length;
+		}
+
+	return collection_length;
+	}
+
+/*
+	WRITE_QUERY_SET()
+	-----------------
+*/
+/*!
+	@brief Generate a query set and write it to a file (one query per line, each prefixed with its query-id).
+	@param filename [in] The name of the file.
+	@param length [in] The number of terms in each query.
+	@param mix [in] The document frequency mix (head, torso, tail, or zipf).
+	@param terms [in] The term of each rank.
+	@param by_df [in] The ranks that occur in the collection, highest document frequency first.
+	@param zipf [in] The distribution of term ranks.
+	@param generator [in] The random number generator.
+	@return true on success, false if mix is not known.
+*/
+bool write_query_set(const std::string &filename, size_t length, const std::string &mix, const std::vector<std::string> &terms, const std::vector<size_t> &by_df, const zipf_distribution &zipf, std::mt19937_64 &generator)
+	{
+	size_t head = (std::max)(static_cast<size_t>(1), by_df.size() / 100);
+	size_t torso = (std::max)(head + 1, by_df.size() / 10);
+	size_t from;
+	size_t to;
+
+	if (mix == "head")
+		{
+		from = 0;
+		to = head;
+		}
+	else if (mix == "torso")
+		{
+		from = head;
+		to = torso;
+		}
+	else if (mix == "tail")
+		{
+		from = torso;
+		to = by_df.size();
+		}
+	else if (mix == "zipf")
+		from = to = 0;
+	else
+		return false;
+
+	/*
+		A query cannot have more distinct terms than there are in the band
+	*/
+	to = (std::min)(to, by_df.size());
+	from = (std::min)(from, to);
+	if (mix != "zipf")
+		length = (std::min)(length, to - from);
+
+	std::ostringstream query_set;
+	std::vector<size_t> query;
+	for (size_t query_id = 1; query_id <= parameter_queries; query_id++)
+		{
+		query.clear();
+		for (size_t attempt = 0; query.size() < length && attempt < length * 100; attempt++)
+			{
+			size_t rank = mix == "zipf" ? zipf(generator) : by_df[from + generator() % (to - from)];
+			if (std::find(query.begin(), query.end(), rank) == query.end())
+				query.push_back(rank);
+			}
+
+		query_set << query_id;
+		for (size_t rank : query)
+			query_set << ' ' << terms[rank];
+		query_set << '\n';
+		}
+
+	return JASS::file::write_entire_file(filename, query_set.str());
+	}
+
+/*
+	READ_STATISTIC()
+	----------------
+*/
+/*!
+	@brief Extract a statistic from the output of JASS_anytime (lines of the form "name : value").
+	@param output [in] The output of JASS_anytime.
+	@param name [in] The name of the statistic.
+	@return The value of the statistic (or 0 if it is not there).
+*/
+uint64_t read_statistic(const std::string &output, const std::string &name)
+	{
+	std::istringstream lines(output);
+	std::string line;
+
+	while (std::getline(lines, line))
+		if (line.compare(0, name.size(), name) == 0)
+			{
+			size_t colon = line.find(':', name.size());
+			if (colon != std::string::npos && line.find_first_not_of(' ', name.size()) == colon)
+				return strtoull(line.c_str() + colon + 1, nullptr, 10);
+			}
+
+	return 0;
+	}
+
+/*
+	READ_POSTINGS()
+	---------------
+*/
+/*!
+	@brief Sum the postings processed and the search time of each query in the CSV file written by JASS_anytime.
+	@param csv [in] The contents of the CSV file.
+	@param postings [out] The number of postings processed.
+	@param time_in_ns [out] The time spent searching.
+*/
+void read_postings(const std::string &csv, uint64_t &postings, uint64_t &time_in_ns)
+	{
+	std::istringstream lines(csv);
+	std::string line;
+
+	postings = 0;
+	time_in_ns = 0;
+	std::getline(lines, line);			// the header
+	while (std::getline(lines, line))
+		{
+		std::vector<std::string> columns;
+		std::istringstream fields(line);
+		std::string field;
+		while (std::getline(fields, field, ','))
+			columns.push_back(field);
+
+		if (columns.size() >= 6)
+			{
+			postings += strtoull(columns[3].c_str(), nullptr, 10);
+			time_in_ns += strtoull(columns[5].c_str(), nullptr, 10);
+			}
+		}
+	}
+
+/*
+	USAGE()
+	-------
+*/
+/*!
+	@brief Print the usage line
+*/
+uint8_t usage(const std::string &exename)
+	{
+	std::cout << JASS::commandline::usage(exename, parameters) << "\n";
+	return 1;
+	}
+
+/*
+	MAIN()
+	------
+*/
+/*!
+	@brief Build the synthetic collection and query sets, then benchmark JASS_anytime on them.
+*/
+int main(int argc, const char *argv[])
+	{
+	/*
+		Parse the commane line parameters
+	*/
+	auto success = JASS::commandline::parse(argc, argv, parameters, parameters_errors);
+	if (!success)
+		{
+		std::cout << parameters_errors;
+		exit(1);
+		}
+	if (parameter_help || parameter_anytime.size() == 0)
+		exit(usage(argv[0]));
+	if (parameter_documents == 0 || parameter_vocabulary == 0 || parameter_document_length == 0)
+		exit(printf("The collection must have documents, terms, and a non-zero document length\n"));
+
+	std::vector<const codex *> codexes;
+	for (const auto &name : split(parameter_codexes))
+		{
+		auto found = std::find_if(std::begin(codex_list), std::end(codex_list), [&](const codex &candidate){ return name == candidate.name; });
+		if (found == std::end(codex_list))
+			exit(printf("Unknown codex:%s\n", name.c_str()));
+		codexes.push_back(found);
+		}
+
+	/*
+		Create the work directory first as the results file might be in it (as it is with "make benchmark"), but open the results
+		file before moving into the work directory so that a relative -o is relative to where we were started
+	*/
+	make_directory(parameter_directory);
+	std::ofstream results(parameter_output);
+	if (!results)
+		exit(printf("Cannot open %s\n", parameter_output.c_str()));
+
+	change_directory(parameter_directory);
+
+	/*
+		Generate and index the collection
+	*/
+	auto timer = JASS::timer::start();
+	std::mt19937_64 generator(parameter_seed);
+	zipf_distribution zipf(parameter_vocabulary, parameter_zipf);
+	std::vector<std::string> terms;
+	for (size_t rank = 0; rank < parameter_vocabulary; rank++)
+		terms.push_back(term_name(rank));
+
+	JASS::index_manager_sequential index;
+	std::vector<size_t> document_frequency;
+	size_t collection_length = build_collection(index, terms, zipf, generator, document_frequency);
+	std::cout << "Documents:" << parameter_documents << " Terms:" << collection_length << " Seed:" << parameter_seed << " Zipf:" << parameter_zipf << " (" << JASS::timer::stop(timer).milliseconds() << " ms)\n";
+
+	/*
+		Quantize, then serialise an index for each codex (each into its own directory)
+	*/
+	std::shared_ptr<JASS::ranking_function_atire_bm25> ranker(new JASS::ranking_function_atire_bm25(0.9, 0.4, index.get_document_length_vector()));
+	JASS::quantize<JASS::ranking_function_atire_bm25> quantizer(parameter_documents, ranker);
+	quantizer.compute_bounds(index, 1);
+
+	for (const auto &current : codexes)
+		{
+		make_directory(current->name);
+		change_directory(current->name);
+		{
+		std::vector<std::unique_ptr<JASS::index_manager::delegate>> exporters;
+		exporters.push_back(std::make_unique<JASS::serialise_jass_v1>(index.get_highest_document_id(), current->encoder(), 16, 1, current->identifier));
+		quantizer.serialise_index(index, exporters);
+		}
+		change_directory("..");
+		}
+
+	/*
+		Generate the query sets (each is drawn from the terms that occur in the collection)
+	*/
+	std::vector<size_t> by_df;
+	for (size_t rank = 0; rank < parameter_vocabulary; rank++)
+		if (document_frequency[rank] != 0)
+			by_df.push_back(rank);
+	std::stable_sort(by_df.begin(), by_df.end(), [&](size_t first, size_t second){ return document_frequency[first] > document_frequency[second]; });
+
+	std::vector<std::pair<std::string, std::string>> query_sets;			// (length, mix)
+	for (const auto &length : split(parameter_lengths))
+		for (const auto &mix : split(parameter_mixes))
+			{
+			std::string filename = "queries_" + length + "_" + mix + ".txt";
+			if (!write_query_set(filename, strtoull(length.c_str(), nullptr, 10), mix, terms, by_df, zipf, generator))
+				exit(printf("Unknown mix:%s\n", mix.c_str()));
+			query_sets.push_back(std::make_pair(length, mix));
+			}
+	std::cout << "Indexes and query sets built (" << JASS::timer::stop(timer).milliseconds() << " ms)\n";
+
+	/*
+		Run JASS_anytime on each combination
+	*/
+	results << "codex,query_length,mix,threads,rho,top_k,queries,queries_per_second,mean_ns,p50_ns,p95_ns,p99_ns,p99_9_ns,max_ns,postings_processed,postings_per_second\n";
+	std::cout << "codex,query_length,mix,threads,rho,top_k,queries,queries_per_second,mean_ns,p50_ns,p95_ns,p99_ns,p99_9_ns,max_ns,postings_processed,postings_per_second\n";
+	for (const auto &current : codexes)
+		{
+		change_directory(current->name);
+		for (const auto &query_set : query_sets)
+			for (const auto &threads : split(parameter_threads))
+				for (const auto &rho : split(parameter_rho))
+					for (const auto &top_k : split(parameter_top_k))
+						{
+						std::string command = "\"" + parameter_anytime + "\" -q ../queries_" + query_set.first + "_" + query_set.second + ".txt -t " + threads + " -r " + rho + " -k " + top_k + " -c run.csv > run.txt";
+						if (system(command.c_str()) != 0)
+							exit(printf("Failed:%s\n", command.c_str()));
+
+						std::string output;
+						std::string csv;
+						JASS::file::read_entire_file("run.txt", output);
+						JASS::file::read_entire_file("run.csv", csv);
+						uint64_t postings;
+						uint64_t search_time_in_ns;
+						read_postings(csv, postings, search_time_in_ns);
+
+						std::ostringstream line;
+						line << current->name << ',' << query_set.first << ',' << query_set.second << ',' << threads << ',' << rho << ',' << top_k << ',';
+						line << read_statistic(output, "Queries") << ',';
+						line << read_statistic(output, "Throughput") << ',';
+						line << read_statistic(output, "Total time excluding I/O (per query)") << ',';
+						line << read_statistic(output, "Search time p50") << ',';
+						line << read_statistic(output, "Search time p95") << ',';
+						line << read_statistic(output, "Search time p99") << ',';
+						line << read_statistic(output, "Search time p99.9") << ',';
+						line << read_statistic(output, "Search time max") << ',';
+						line << postings << ',';
+						line << static_cast<uint64_t>(search_time_in_ns == 0 ? 0 : postings * 1'000'000'000.0 / search_time_in_ns) << '\n';
+
+						results << line.str() << std::flush;
+						std::cout << line.str() << std::flush;
+						}
+		change_directory("..");
+		}
+
+	return 0;
+	}
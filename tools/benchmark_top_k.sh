@@ -0,0 +1,46 @@
+#!/bin/sh
+#
+# BENCHMARK_TOP_K.SH
+# ------------------
+#
+# Compare the heap and the heapless (-H) top-k strategies of JASS_anytime across a range of rho
+# Copyright (c) 2019 Andrew Trotman
+#
+# Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+#
+# Usage: benchmark_top_k.sh <JASS_anytime> <queryfile> [<top-k> [<rho> ...]]
+# Run from the directory containing the index.  For each rho the per-query search time of each strategy is printed and the
+# two results lists are checked to be identical (they must be, the strategies differ only in how the top-k is found).
+#
+if [ $# -lt 2 ]; then
+	echo "Usage: $0 <JASS_anytime> <queryfile> [<top-k> [<rho> ...]]"
+	exit 1
+fi
+
+anytime=$1
+queries=$2
+top_k=${3:-10}
+shift 2
+if [ $# -gt 0 ]; then
+	shift
+fi
+rhos=${*:-"1 5 10 25 50 100"}
+
+per_query()
+	{
+	grep "excluding I/O (per query)" | sed -e 's/.*: *//' -e 's/ ns//'
+	}
+
+printf "%8s %16s %16s %8s\n" "rho" "heap (ns/query)" "scan (ns/query)" "same"
+for rho in $rhos; do
+	heap=`$anytime -q $queries -k $top_k -r $rho | per_query`
+	mv ranking.txt ranking_heap.txt
+	scan=`$anytime -q $queries -k $top_k -r $rho -H | per_query`
+	if cmp -s ranking.txt ranking_heap.txt; then
+		same=yes
+	else
+		same=NO
+	fi
+	rm -f ranking_heap.txt
+	printf "%8s %16s %16s %8s\n" $rho $heap $scan $same
+done
@@ -0,0 +1,149 @@
+/*
+	BENCHMARK_VOCABULARY.CPP
+	------------------------
+	Copyright (c) 2019 Andrew Trotman
+	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
+*/
+/*!
+	@brief Measure the number of vocabulary lookups per second of each way of finding a term in a JASS v1 index.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <random>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include "timer.h"
+#include "query_term.h"
+#include "commandline.h"
+#include "deserialised_jass_v1.h"
+
+/*
+	PARAMETERS
+	----------
+*/
+size_t parameter_lookups = 10'000'000;
+bool parameter_help = false;
+
+std::string parameters_errors;						///< Any errors as a result of command line parsing
+auto parameters = std::make_tuple					///< The  command line parameter block
+	(
+	JASS::commandline::parameter("-?", "--help", "Print this help.", parameter_help),
+	JASS::commandline::parameter("-n", "--lookups", "The number of lookups to time (default = 10,000,000)", parameter_lookups)
+	);
+
+/*
+	TIME_LOOKUPS()
+	--------------
+*/
+/*!
+	@brief Look up each term (round robin) until the given number of lookups have been done, and report the lookups per second.
+	@param name [in] The name of the method being timed.
+	@param terms [in] The terms to look up.
+	@param lookups [in] The number of lookups to do.
+	@param lookup [in] The method, returning true if the term is found.
+	@return The number of terms found (so that the compiler cannot optimise the lookups away).
+*/
+template <typename LOOKUP>
+size_t time_lookups(const char *name, const std::vector<JASS::query_term> &terms, size_t lookups, LOOKUP lookup)
+	{
+	size_t found = 0;
+	auto timer = JASS::timer::start();
+	for (size_t which = 0; which < lookups; which++)
+		found += lookup(terms[which % terms.size()]);
+	auto took = JASS::timer::stop(timer).nanoseconds();
+
+	printf("%-30s %12.0f lookups per second (%zu found)\n", name, took == 0 ? 0.0 : lookups / (took / 1'000'000'000.0), found);
+	return found;
+	}
+
+/*
+	USAGE()
+	-------
+*/
+/*!
+	@brief Print the usage line
+*/
+uint8_t usage(const std::string &exename)
+	{
+	std::cout << JASS::commandline::usage(exename, parameters) << "\n";
+	return 1;
+	}
+
+/*
+	MAIN()
+	------
+*/
+/*!
+	@brief Time vocabulary lookups on the index in the current directory.
+*/
+int main(int argc, const char *argv[])
+	{
+	/*
+		Parse the commane line parameters
+	*/
+	auto success = JASS::commandline::parse(argc, argv, parameters, parameters_errors);
+	if (!success)
+		{
+		std::cout << parameters_errors;
+		exit(1);
+		}
+	if (parameter_help)
+		exit(usage(argv[0]));
+
+	/*
+		Load the index twice, once into memory (hash table lookup) and once memory mapped (binary search in place)
+	*/
+	JASS::deserialised_jass_v1 index(false);
+	index.read_index();
+	JASS::deserialised_jass_v1 mapped_index(false, true);
+	mapped_index.read_index();
+
+	/*
+		Look up every term in the vocabulary (in random order) along with one mis-spelling of each (that is not in the vocabulary)
+	*/
+	std::vector<std::string> strings;
+	for (const auto &term : index)
+		{
+		strings.push_back(std::string(reinterpret_cast<const char *>(term.term.address()), term.term.size()));
+		strings.push_back(strings.back() + "~");
+		}
+	std::vector<JASS::query_term> terms;
+	for (const auto &string : strings)
+		terms.push_back(JASS::query_term(JASS::slice(string.c_str())));
+	std::shuffle(terms.begin(), terms.end(), std::mt19937_64(1));
+
+	printf("%zu terms, %zu lookups\n", terms.size(), parameter_lookups);
+
+	/*
+		The original search over the in-memory vocabulary list
+	*/
+	time_lookups("std::lower_bound()", terms, parameter_lookups, [&](const JASS::query_term &term)
+		{
+		auto found = std::lower_bound(index.begin(), index.end(), term.token());
+		return found != index.end() && term.token() == found->term;
+		});
+
+	/*
+		Binary search of the memory mapped vocabulary
+	*/
+	JASS::deserialised_jass_v1::metadata metadata;
+	time_lookups("binary search (mapped)", terms, parameter_lookups, [&](const JASS::query_term &term)
+		{
+		return mapped_index.postings_details(metadata, term);
+		});
+
+	/*
+		The vocabulary hash table
+	*/
+	time_lookups("vocabulary_hash", terms, parameter_lookups, [&](const JASS::query_term &term)
+		{
+		return index.postings_details(metadata, term);
+		});
+
+	return 0;
+	}
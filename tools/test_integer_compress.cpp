@@ -13,9 +13,15 @@
 	repreated until end of file
 
 	An example file is Lemire's dump of .gov2 which can be found here: https://lemire.me/data/integercompression2014.html
+
+	Alternatively (-i), extract every impact segment from the JASS v1 index in the current directory and time each codex on
+	decode, decode then D1 decode, and decode then accumulate into a JASS::query (as JASS_anytime does), bucketed by segment length.
 */
+#include <array>
 #include <limits>
+#include <vector>
 #include <iostream>
+#include <algorithm>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -24,8 +30,12 @@
 
 #include "file.h"
 #include "timer.h"
+#include "query.h"
+#include "decode_d1.h"
 #include "commandline.h"
+#include "hardware_support.h"
 #include "compress_integer_all.h"
+#include "deserialised_jass_v1.h"
 
 /*
 	The test set must contain no more that this number of documents.
@@ -108,6 +118,222 @@ void generate_example(const std::string &filename)
 		}
 	}
 
+/*
+	CLASS SEGMENT
+	-------------
+	An impact segment extracted from a JASS v1 index, as the d1-gaps of its document ids.
+*/
+class segment
+	{
+	public:
+		uint16_t impact;				///< The impact score of the segment
+		size_t start;					///< The index of the first d1-gap of this segment in the array of all the d1-gaps
+		uint32_t length;				///< The number of document ids in the segment
+	};
+
+/*
+	EXTRACT_SEGMENTS()
+	------------------
+	Decode every impact segment of every term in the index into d1-gaps.
+*/
+void extract_segments(JASS::deserialised_jass_v1 &index, std::vector<segment> &segments, std::vector<uint32_t> &gaps)
+	{
+	std::string codex_name;
+	JASS::compress_integer &decompressor = index.codex(codex_name);
+	std::vector<uint32_t> decoded(index.document_count() + 4096);			// Some decoders write past the end of the output buffer (e.g. GroupVarInt)
+
+	for (const auto &term : index)
+		for (uint64_t current_segment = 0; current_segment < term.impacts; current_segment++)
+			{
+			uint64_t *postings = (uint64_t *)term.offset + current_segment;
+			const JASS::deserialised_jass_v1::segment_header &header = *reinterpret_cast<const JASS::deserialised_jass_v1::segment_header *>(index.postings() + *postings);
+
+			decompressor.decode(decoded.data(), header.segment_frequency, index.postings() + header.offset, header.end - header.offset);
+			if (codex_name == "None")
+				JASS::compress_integer::d1_encode(decoded.data(), decoded.data(), header.segment_frequency);			// uncompressed indexes hold the document ids (D0)
+
+			segments.push_back(segment{header.impact, gaps.size(), header.segment_frequency});
+			gaps.insert(gaps.end(), decoded.begin(), decoded.begin() + header.segment_frequency);
+			}
+
+	/*
+		If the index counts from 0 then add 1 to the first d1-gap of each segment, as generate_differences() does, so that the codexes
+		that cannot encode 0s (e.g. Elias gamma and Elias delta) can be measured.
+	*/
+	if (std::any_of(segments.begin(), segments.end(), [&](const segment &current){ return current.length != 0 && gaps[current.start] == 0; }))
+		for (const auto &current : segments)
+			if (current.length != 0)
+				gaps[current.start]++;
+	}
+
+/*
+	TIME_BUCKET()
+	-------------
+	Time (the fastest of repeats runs) method over each segment in a bucket.
+*/
+template <typename METHOD>
+uint64_t time_bucket(const std::vector<const segment *> &bucket, uint64_t repeats, METHOD method)
+	{
+	uint64_t fastest = (std::numeric_limits<uint64_t>::max)();
+
+	for (uint64_t repeat = 0; repeat < repeats; repeat++)
+		{
+		auto timer = JASS::timer::start();
+		for (const auto current : bucket)
+			method(*current);
+		fastest = (std::min)(fastest, static_cast<uint64_t>(JASS::timer::stop(timer).nanoseconds()));
+		}
+
+	return fastest;
+	}
+
+/*
+	BENCHMARK_INDEX()
+	-----------------
+	For each selected codex (or every codex if none are selected), compress each impact segment of the index in the current directory
+	then time decode, decode then D1 decode, decode then accumulate into a JASS::query (as JASS_anytime does, with decoder_d1), decode then
+	accumulate with decoder_d1's SIMD prefix sum used for every segment length, and decode then a scalar cumulative sum and accumulate,
+	reporting the compressed size and the nanoseconds per posting of each for segments with lengths in [2^n, 2^(n+1)).  The last two
+	are used to choose decoder_d1::default_simd_from.
+*/
+void benchmark_index(const std::array<bool, JASS::compress_integer_all::compressors_size> &selectors, uint64_t repeats)
+	{
+	JASS::deserialised_jass_v1 index(false);
+	index.read_index();
+
+	std::vector<segment> segments;
+	std::vector<uint32_t> gaps;
+	extract_segments(index, segments, gaps);
+	std::cout << "Segments:" << segments.size() << " Postings:" << gaps.size() << '\n';
+	if (segments.size() == 0)
+		return;
+
+	/*
+		Bucket the segments by length (bucket n holds lengths in [2^n, 2^(n+1)))
+	*/
+	std::vector<std::vector<const segment *>> buckets;
+	uint32_t longest = 0;
+	for (const auto &current : segments)
+		{
+		size_t bucket = 0;
+		while ((static_cast<uint64_t>(2) << bucket) <= current.length)
+			bucket++;
+		if (bucket >= buckets.size())
+			buckets.resize(bucket + 1);
+		buckets[bucket].push_back(&current);
+		longest = (std::max)(longest, current.length);
+		}
+
+	JASS::decoder_d1 decoder(index.document_count() + 4096);			// Some decoders write past the end of the output buffer (e.g. GroupVarInt)
+	JASS::decoder_d1 simd_decoder(index.document_count() + 4096, 0);
+	std::vector<uint32_t> decoded(index.document_count() + 4096);
+	JASS::query<uint16_t, 0, 1'000> accumulators(index.primary_keys(), index.document_count() + 1, 10);		// + 1 in case extract_segments() added 1 to each document id
+	std::vector<uint8_t> scratch((longest + 1024) * sizeof(uint32_t) * 2);
+
+	bool any_selected = std::find(selectors.begin(), selectors.end(), true) != selectors.end();
+	for (size_t which = 0; which < JASS::compress_integer_all::compressors_size; which++)
+		{
+		if (any_selected && !selectors[which])
+			continue;
+
+		std::array<bool, JASS::compress_integer_all::compressors_size> only = {};
+		only[which] = true;
+		JASS::compress_integer &codex = JASS::compress_integer_all::compressor(only);
+		std::cout << '\n' << JASS::compress_integer_all::name(only) << '\n';
+		if (!JASS::compress_integer_all::supported(only))
+			{
+			std::cout << "Cannot run on this CPU (it needs AVX2)\n";
+			continue;
+			}
+
+		/*
+			Compress each segment (each starting on a 16-byte boundary as they do in the index) and check that it decodes correctly
+		*/
+		std::vector<size_t> offset(segments.size());
+		std::vector<size_t> size(segments.size());
+		std::vector<uint8_t> compressed;
+		bool failed = false;
+		for (size_t current = 0; current < segments.size() && !failed; current++)
+			{
+			const segment &source = segments[current];
+			size[current] = codex.encode(scratch.data(), scratch.size(), gaps.data() + source.start, source.length);
+			offset[current] = (compressed.size() + 15) & ~static_cast<size_t>(15);
+			compressed.resize(offset[current]);
+			compressed.insert(compressed.end(), scratch.begin(), scratch.begin() + size[current]);
+
+			codex.decode(decoded.data(), source.length, scratch.data(), size[current]);
+			failed = size[current] == 0 || !std::equal(gaps.begin() + source.start, gaps.begin() + source.start + source.length, decoded.begin());
+			}
+		if (failed)
+			{
+			std::cout << "Cannot encode the segments of this index\n";
+			continue;
+			}
+		compressed.resize(compressed.size() + 1024);			// Some decoders read past the end of the input buffer
+
+		std::cout << "length segments postings BytesPerPosting DecodeNsPerPosting DecodeD1NsPerPosting DecodeAccumulateNsPerPosting DecodeSimdAccumulateNsPerPosting DecodeScalarAccumulateNsPerPosting\n";
+		for (size_t bucket = 0; bucket < buckets.size(); bucket++)
+			{
+			if (buckets[bucket].size() == 0)
+				continue;
+
+			uint64_t postings = 0;
+			uint64_t bytes = 0;
+			for (const auto current : buckets[bucket])
+				{
+				postings += current->length;
+				bytes += size[current - segments.data()];
+				}
+
+			uint64_t decode_time = time_bucket(buckets[bucket], repeats, [&](const segment &current)
+				{
+				size_t which = &current - segments.data();
+				codex.decode(decoded.data(), current.length, compressed.data() + offset[which], size[which]);
+				});
+
+			uint64_t d1_time = time_bucket(buckets[bucket], repeats, [&](const segment &current)
+				{
+				size_t which = &current - segments.data();
+				codex.decode(decoded.data(), current.length, compressed.data() + offset[which], size[which]);
+				JASS::compress_integer::d1_decode(decoded.data(), decoded.data(), current.length);
+				});
+
+			accumulators.rewind();
+			uint64_t accumulate_time = time_bucket(buckets[bucket], repeats, [&](const segment &current)
+				{
+				size_t which = &current - segments.data();
+				decoder.decode(codex, current.length, compressed.data() + offset[which], size[which]);
+				decoder.process(current.impact, accumulators);
+				});
+
+			accumulators.rewind();
+			uint64_t simd_time = time_bucket(buckets[bucket], repeats, [&](const segment &current)
+				{
+				size_t which = &current - segments.data();
+				simd_decoder.decode(codex, current.length, compressed.data() + offset[which], size[which]);
+				simd_decoder.process(current.impact, accumulators);
+				});
+
+			accumulators.rewind();
+			uint64_t scalar_time = time_bucket(buckets[bucket], repeats, [&](const segment &current)
+				{
+				size_t which = &current - segments.data();
+				codex.decode(decoded.data(), current.length, compressed.data() + offset[which], size[which]);
+				uint32_t document_id = 0;
+				for (const uint32_t *gap = decoded.data(); gap < decoded.data() + current.length; gap++)
+					{
+					document_id += *gap;
+					accumulators.add_rsv(document_id, current.impact);
+					}
+				});
+
+			std::cout << (static_cast<uint64_t>(1) << bucket) << '-' << ((static_cast<uint64_t>(2) << bucket) - 1) << ' ' << buckets[bucket].size() << ' ' << postings << ' ';
+			std::cout << static_cast<double>(bytes) / postings << ' ' << static_cast<double>(decode_time) / postings << ' ' << static_cast<double>(d1_time) / postings << ' ' << static_cast<double>(accumulate_time) / postings << ' ' << static_cast<double>(simd_time) / postings << ' ' << static_cast<double>(scalar_time) / postings << '\n';
+			}
+		}
+	std::cout << "DONE" << std::endl;
+	}
+
 /*
 	USAGE()
 	-------
@@ -131,6 +357,9 @@ int main(int argc, const char *argv[])
 	*/
 	uint64_t report_every = (std::numeric_limits<uint64_t>::max)();							// print a message every this number of postings lists
 	bool verify = false;
+	bool index_mode = false;															// benchmark on the segments of the JASS v1 index in the current directory
+	uint64_t repeats = 5;																// in index mode, report the fastest of this many runs
+	std::string simd = "";																// the widest instruction set to use (default whatever the CPU has)
 	bool generate = false;																// should we generate a sample file (usually false)
 	std::string filename = "";															// the name of the postings list file to check with
 	std::array<bool, JASS::compress_integer_all::compressors_size> selectors = {};		// which compressor does the user select
@@ -144,6 +373,11 @@ int main(int argc, const char *argv[])
 			JASS::commandline::parameter("-z", "--has-zeros", "The postings file counts from 0, so add 1 to avoid compressing 0s", data_counts_from_zero),
 			JASS::commandline::parameter("-v", "--verify", "verify the decoded sequence matches the original sequence", verify),
 
+			JASS::commandline::note("\nINDEX\n-----"),
+			JASS::commandline::parameter("-i", "--index", "Time decode, decode+d1, decode+accumulate (as JASS_anytime does, then with SIMD D1 at all lengths), and decode+scalar accumulate of each selected codex (default all) on the impact segments of the JASS v1 index in the current directory", index_mode),
+			JASS::commandline::parameter("-R", "--repeats", "<n> In index mode report the fastest of <n> runs (default = 5)", repeats),
+			JASS::commandline::parameter("-S", "--simd", "<sse41 | avx2 | avx512> Use no wider instructions than this (default = the widest this CPU has)", simd),
+
 			JASS::commandline::note("\nCOMPRESSORS\n-----------")
 			),
 		command_line,
@@ -166,6 +400,21 @@ int main(int argc, const char *argv[])
 	/*
 		Check parameters
 	*/
+	if (simd == "sse41")
+		JASS::hardware_support::limit(JASS::hardware_support::simd::sse41);
+	else if (simd == "avx2")
+		JASS::hardware_support::limit(JASS::hardware_support::simd::avx2);
+	else if (simd == "avx512")
+		JASS::hardware_support::limit(JASS::hardware_support::simd::avx512);
+	else if (simd != "")
+		usage(argv[0], all_parameters);
+	std::cout << "SIMD:" << JASS::hardware_support::name(JASS::hardware_support::instruction_set()) << '\n';
+
+	if (index_mode)
+		{
+		benchmark_index(selectors, repeats);
+		return 0;
+		}
 	if (filename == "")
 		usage(argv[0], all_parameters);
 
@@ -180,6 +429,11 @@ int main(int argc, const char *argv[])
 		}
 	JASS::compress_integer &shrinkerator = JASS::compress_integer_all::compressor(selectors);
 	std::cout << "Check " << JASS::compress_integer_all::name(selectors) << " on file " << filename << '\n';
+	if (!JASS::compress_integer_all::supported(selectors))
+		{
+		std::cout << JASS::compress_integer_all::name(selectors) << " cannot run on this CPU (it needs AVX2)\n";
+		return 1;
+		}
 
 	/*
 		Initialise by setting the count buffers to 0
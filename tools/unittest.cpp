@@ -5,6 +5,7 @@
 	Released under the 2-clause BSD license (See:https://en.wikipedia.org/wiki/BSD_licenses)
 */
 #include "file.h"
+#include "file_map.h"
 #include "heap.h"
 #include "ascii.h"
 #include "maths.h"
@@ -16,6 +17,9 @@
 #include "version.h"
 #include "reverse.h"
 #include "threads.h"
+#include "numa_topology.h"
+#include "barrier.h"
+#include "thread_pool_work_stealing.h"
 #include "checksum.h"
 #include "quantize.h"
 #include "bitstream.h"
@@ -23,6 +27,7 @@
 #include "decode_d1.h"
 #include "bitstring.h"
 #include "hash_table.h"
+#include "vocabulary_hash.h"
 #include "run_export.h"
 #include "top_k_heap.h"
 #include "top_k_qsort.h"
@@ -33,6 +38,8 @@
 #include "hash_pearson.h"
 #include "parser_query.h"
 #include "channel_file.h"
+#include "socket_listener.h"
+#include "channel_connection.h"
 #include "dynamic_array.h"
 #include "allocator_cpp.h"
 #include "instream_file.h"
@@ -54,6 +61,8 @@
 #include "compress_general_zlib.h"
 #include "instream_document_trec.h"
 #include "index_manager_sequential.h"
+#include "index_manager_parallel.h"
+#include "index_manager_external.h"
 #include "compress_integer_carry_8b.h"
 #include "compress_integer_simple_9.h"
 #include "compress_integer_simple_8b.h"
@@ -102,29 +111,31 @@ int main(void)
 	try
 		{
 		JASS::hardware_support hardware;
-		if (hardware.AVX)
+		if (hardware.fastest() >= JASS::hardware_support::simd::avx2)
 			{
 			puts("compress_integer_bitpack_256");
 			JASS::compress_integer_bitpack_256::unittest();
 
-			puts("compress_integer_elias_gamma_simd");
-			JASS::compress_integer_elias_gamma_simd::unittest();
+			puts("compress_integer_elias_gamma");
+			JASS::compress_integer_elias_gamma::unittest();
+
+			puts("compress_integer_elias_delta");
+			JASS::compress_integer_elias_delta::unittest();
 			}
 		else
 			{
 	// LCOV_EXCL_START
 			puts("compress_integer_bitpack_256");
-			puts("Cannot test as no 256-bit SIMD instructions on this CPU");
-			puts("compress_integer_elias_gamma_simd");
-			puts("Cannot test as no 256-bit SIMD instructions on this CPU");
+			puts("Cannot test as no AVX2 instructions on this CPU");
+			puts("compress_integer_elias_gamma");
+			puts("Cannot test as no BMI instructions on this CPU");
+			puts("compress_integer_elias_delta");
+			puts("Cannot test as no BMI instructions on this CPU");
 	// LCOV_EXCL_STOP
 			}
 
-		puts("compress_integer_elias_gamma");
-		JASS::compress_integer_elias_gamma::unittest();
-
-		puts("compress_integer_elias_delta");
-		JASS::compress_integer_elias_delta::unittest();
+		puts("compress_integer_elias_gamma_simd");
+		JASS::compress_integer_elias_gamma_simd::unittest();
 
 		puts("compress_integer_elias_delta_simd");
 		JASS::compress_integer_elias_delta_simd::unittest();
@@ -149,6 +160,15 @@ int main(void)
 
 		puts("threads");
 		JASS::thread::unittest();
+
+		puts("numa_topology");
+		JASS::numa_topology::unittest();
+
+		puts("barrier");
+		JASS::barrier::unittest();
+
+		puts("thread_pool_work_stealing");
+		JASS::thread_pool_work_stealing::unittest();
 		
 		puts("top_k_sort");
 		JASS::top_k_qsort::unittest();
@@ -172,6 +192,9 @@ int main(void)
 
 		puts("file");
 		JASS::file::unittest();
+
+		puts("file_map");
+		JASS::file_map::unittest();
 		
 		puts("bitstring");
 		JASS::bitstring::unittest();
@@ -221,6 +244,12 @@ int main(void)
 		puts("channel_file");
 		JASS::channel_file::unittest();
 
+		puts("socket_listener");
+		JASS::socket_listener::unittest();
+
+		puts("channel_connection");
+		JASS::channel_connection::unittest();
+
 		puts("parser");
 		JASS::parser::unittest();
 
@@ -239,6 +268,9 @@ int main(void)
 		puts("hash_table");
 		JASS::hash_table<JASS::slice, JASS::slice>::unittest();
 
+		puts("vocabulary_hash");
+		JASS::vocabulary_hash::unittest();
+
 		puts("dynamic_array");
 		JASS::dynamic_array<JASS::slice>::unittest();
 
@@ -254,6 +286,12 @@ int main(void)
 		puts("index_manager_sequential");
 		JASS::index_manager_sequential::unittest();
 
+		puts("index_manager_parallel");
+		JASS::index_manager_parallel::unittest();
+
+		puts("index_manager_external");
+		JASS::index_manager_external::unittest();
+
 		puts("serialise_ci");
 		JASS::serialise_ci::unittest();
 